@@ -0,0 +1,257 @@
+//By Monica Moniot and Alyssa Riceman
+#include <stdlib.h>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "types.h"
+#include "book.h"
+#include "eviction.h"
+#include "adaptive.h"
+
+constexpr uint32_t SAMPLE_BITS = 24;
+constexpr uint64_t SAMPLE_MODULUS = static_cast<uint64_t>(1)<<SAMPLE_BITS;
+constexpr uint32_t DEFAULT_SAMPLE_PERIOD = 64;
+constexpr uint32_t DEFAULT_WINDOW_GETS = 4096;
+constexpr double SWITCH_MARGIN = .01;//a policy has to hit a point more of the gets than the live one to replace it
+constexpr Index INIT_GHOST_PAGES = 64;
+constexpr uint32_t MAX_GHOSTS = 6;//one for each list policy
+
+struct Ghost {
+	Evictor evictor;
+	Book book;
+	std::vector<Page> pages;//an entry's cur_i holds its key's hash, and it has no key or value
+	uint64_t mem_total;
+	uint64_t window_hit_total;
+	double score;//hits, each window counting half as much as the one after it
+};
+struct Ghost_key {
+	Bookmark bookmarks[MAX_GHOSTS];//where the key is in each ghost, INVALID_PAGE in those it isn't in
+};
+
+struct Adaptive {
+	uint64_t threshold;//keys whose sample value is under this are sampled
+	uint32_t window_gets;
+	uint32_t window_get_total;//sampled gets so far this window
+	double weight_total;//sampled gets, weighed as the scores weigh hits
+	std::vector<Ghost> ghosts;//never grows once made, since each ghost's book points into its own pages
+	//the ghosts share a map of the keys any of them hold, so a get or set looks its key up once rather than once a ghost
+	std::unordered_map<Index, Ghost_key> keys;
+	evictor_type policy;//the one the cache is using
+	Adaptive_stats stats;
+};
+
+inline uint32_t get_sample_value(Index key_hash) {
+	//the same remix the hit ratio estimator uses, since the table's hash leaves its low bits poorly spread
+	return static_cast<uint32_t>((static_cast<uint64_t>(key_hash)*0x9E3779B97F4A7C15ull)>>(64 - SAMPLE_BITS));
+}
+inline uint64_t get_ghost_capacity(const Adaptive* adaptive, Index capacity) {
+	return (static_cast<uint64_t>(capacity)*adaptive->threshold)>>SAMPLE_BITS;
+}
+
+inline Bookmark alloc_ghost_page(Ghost* ghost) {
+	if(ghost->book.first_unused == INVALID_PAGE and ghost->book.end == ghost->pages.size()) {
+		ghost->pages.resize(2*ghost->pages.size());
+		ghost->book.pages = ghost->pages.data();
+	}
+	return alloc_book_page(&ghost->book);
+}
+inline void forget_ghost_key(Adaptive* adaptive, std::unordered_map<Index, Ghost_key>::iterator found, uint32_t ghost_i) {
+	//the key has left a ghost, and once it has left them all the map lets go of it too
+	found->second.bookmarks[ghost_i] = INVALID_PAGE;
+	for(uint32_t i = 0; i < adaptive->ghosts.size(); i += 1) {
+		if(found->second.bookmarks[i] != INVALID_PAGE) {
+			return;
+		}
+	}
+	adaptive->keys.erase(found);
+}
+inline void evict_ghost(Adaptive* adaptive, uint32_t ghost_i, uint64_t ghost_capacity) {
+	Ghost* ghost = &adaptive->ghosts[ghost_i];
+	while(ghost->mem_total > ghost_capacity) {
+		Bookmark bookmark = get_evict_item(&ghost->evictor, &ghost->book);
+		Entry* entry = read_book(&ghost->book, bookmark);
+		ghost->mem_total -= entry->value_size;
+		forget_ghost_key(adaptive, adaptive->keys.find(entry->cur_i), ghost_i);
+		free_book_page(&ghost->book, bookmark);
+	}
+}
+inline void put_ghost(Ghost* ghost, Bookmark* bookmark, Index key_hash, Index value_size) {
+	//as a set would, adds the key or touches it; the ghost is left to be evicted from afterwards
+	if(*bookmark != INVALID_PAGE) {
+		Entry* entry = read_book(&ghost->book, *bookmark);
+		ghost->mem_total += value_size;
+		ghost->mem_total -= entry->value_size;
+		entry->value_size = value_size;
+		touch_evict_item(&ghost->evictor, *bookmark, &entry->evict_item, &ghost->book);
+		return;
+	}
+	*bookmark = alloc_ghost_page(ghost);
+	Entry* entry = read_book(&ghost->book, *bookmark);
+	entry->cur_i = key_hash;
+	entry->key = NULL;
+	entry->key_size = 0;
+	entry->value = NULL;
+	entry->value_size = value_size;
+	ghost->mem_total += value_size;
+	add_evict_item(&ghost->evictor, *bookmark, &entry->evict_item, &ghost->book);
+}
+inline void evict_ghosts(Adaptive* adaptive, Index capacity) {
+	//only once every ghost has the key can they evict, since evicting may drop the key from the map
+	uint64_t ghost_capacity = get_ghost_capacity(adaptive, capacity);
+	for(uint32_t i = 0; i < adaptive->ghosts.size(); i += 1) {
+		evict_ghost(adaptive, i, ghost_capacity);
+	}
+}
+inline Ghost_key* find_or_add_ghost_key(Adaptive* adaptive, Index key_hash) {
+	auto found = adaptive->keys.find(key_hash);
+	if(found != adaptive->keys.end()) {
+		return &found->second;
+	}
+	Ghost_key* key = &adaptive->keys[key_hash];
+	for(uint32_t i = 0; i < MAX_GHOSTS; i += 1) {
+		key->bookmarks[i] = INVALID_PAGE;
+	}
+	return key;
+}
+inline evictor_type end_window(Adaptive* adaptive) {
+	//scores the window that just ended, and returns the policy that should be live for the next one
+	adaptive->weight_total = adaptive->weight_total/2 + adaptive->window_get_total;
+	const Ghost* best = NULL;
+	const Ghost* live = NULL;
+	for(Ghost& ghost : adaptive->ghosts) {
+		ghost.score = ghost.score/2 + ghost.window_hit_total;
+		adaptive->stats.hit_ratios[ghost.evictor.policy] = static_cast<double>(ghost.window_hit_total)/adaptive->window_get_total;
+		ghost.window_hit_total = 0;
+		if(best == NULL or ghost.score > best->score) {
+			best = &ghost;
+		}
+		if(ghost.evictor.policy == adaptive->policy) {
+			live = &ghost;
+		}
+	}
+	adaptive->window_get_total = 0;
+	adaptive->stats.window_total += 1;
+	if(best->score - live->score > SWITCH_MARGIN*adaptive->weight_total) {
+		return best->evictor.policy;
+	}
+	return adaptive->policy;
+}
+
+
+Adaptive* create_adaptive(const evictor_type* policies, uint32_t policy_total, evictor_type live_policy, uint32_t sample_period, uint32_t window_gets) {
+	Adaptive* adaptive = new Adaptive;
+	sample_period = sample_period == 0 ? DEFAULT_SAMPLE_PERIOD : sample_period;
+	adaptive->threshold = SAMPLE_MODULUS/sample_period;
+	adaptive->threshold = adaptive->threshold == 0 ? 1 : adaptive->threshold;
+	adaptive->window_gets = window_gets == 0 ? DEFAULT_WINDOW_GETS : window_gets;
+	adaptive->window_get_total = 0;
+	adaptive->weight_total = 0;
+	adaptive->policy = live_policy;
+	memset(&adaptive->stats, 0, sizeof(Adaptive_stats));
+	adaptive->stats.policy = live_policy;
+	//the live policy is always simulated, since the others are judged against it
+	std::vector<evictor_type> candidates(1, live_policy);
+	for(uint32_t i = 0; i < policy_total; i += 1) {
+		bool is_new = true;
+		for(evictor_type candidate : candidates) {
+			is_new = is_new and candidate != policies[i];
+		}
+		if(is_new) {
+			candidates.push_back(policies[i]);
+		}
+	}
+	adaptive->ghosts.resize(candidates.size());
+	for(size_t i = 0; i < candidates.size(); i += 1) {
+		Ghost* ghost = &adaptive->ghosts[i];
+		ghost->pages.resize(INIT_GHOST_PAGES);
+		create_book(&ghost->book, ghost->pages.data());
+		ghost->evictor.mem_arena = NULL;//list policies have no data of their own
+		create_evictor(&ghost->evictor, candidates[i]);
+		ghost->mem_total = 0;
+		ghost->window_hit_total = 0;
+		ghost->score = 0;
+	}
+	return adaptive;
+}
+void destroy_adaptive(Adaptive* adaptive) {
+	delete adaptive;
+}
+
+evictor_type adaptive_get(Adaptive* adaptive, Index key_hash, Index value_size, bool is_hit, Index capacity) {
+	if(get_sample_value(key_hash) >= adaptive->threshold) {
+		return adaptive->policy;
+	}
+	auto found = adaptive->keys.find(key_hash);
+	if(found != adaptive->keys.end() or is_hit) {
+		Ghost_key* key = found != adaptive->keys.end() ? &found->second : find_or_add_ghost_key(adaptive, key_hash);
+		for(uint32_t i = 0; i < adaptive->ghosts.size(); i += 1) {
+			Ghost* ghost = &adaptive->ghosts[i];
+			Bookmark bookmark = key->bookmarks[i];
+			if(bookmark != INVALID_PAGE) {
+				ghost->window_hit_total += 1;
+				Entry* entry = read_book(&ghost->book, bookmark);
+				touch_evict_item(&ghost->evictor, bookmark, &entry->evict_item, &ghost->book);
+			} else if(is_hit) {
+				//the ghost would have missed, and no set is coming to fill it in, since the cache didn't miss
+				put_ghost(ghost, &key->bookmarks[i], key_hash, value_size);
+			}
+		}
+		if(is_hit) {
+			evict_ghosts(adaptive, capacity);
+		}
+	}
+	adaptive->window_get_total += 1;
+	if(adaptive->window_get_total == adaptive->window_gets) {
+		return end_window(adaptive);
+	}
+	return adaptive->policy;
+}
+void adaptive_set(Adaptive* adaptive, Index key_hash, Index value_size, Index capacity) {
+	if(get_sample_value(key_hash) >= adaptive->threshold) {
+		return;
+	}
+	Ghost_key* key = find_or_add_ghost_key(adaptive, key_hash);
+	for(uint32_t i = 0; i < adaptive->ghosts.size(); i += 1) {
+		put_ghost(&adaptive->ghosts[i], &key->bookmarks[i], key_hash, value_size);
+	}
+	evict_ghosts(adaptive, capacity);
+}
+void adaptive_delete(Adaptive* adaptive, Index key_hash) {
+	if(get_sample_value(key_hash) >= adaptive->threshold) {
+		return;
+	}
+	auto found = adaptive->keys.find(key_hash);
+	if(found == adaptive->keys.end()) {
+		return;
+	}
+	for(uint32_t i = 0; i < adaptive->ghosts.size(); i += 1) {
+		Ghost* ghost = &adaptive->ghosts[i];
+		Bookmark bookmark = found->second.bookmarks[i];
+		if(bookmark != INVALID_PAGE) {
+			Entry* entry = read_book(&ghost->book, bookmark);
+			remove_evict_item(&ghost->evictor, bookmark, &entry->evict_item, &ghost->book);
+			ghost->mem_total -= entry->value_size;
+			free_book_page(&ghost->book, bookmark);
+		}
+	}
+	adaptive->keys.erase(found);
+}
+void note_adaptive_switch(Adaptive* adaptive, evictor_type policy, uint64_t switch_ns) {
+	adaptive->policy = policy;
+	adaptive->stats.policy = policy;
+	adaptive->stats.switch_total += 1;
+	adaptive->stats.switch_ns += switch_ns;
+}
+Adaptive_stats get_adaptive_stats(const Adaptive* adaptive) {
+	return adaptive->stats;
+}
+uint64_t get_adaptive_size(const Adaptive* adaptive) {
+	//each ghost's pages, and a node of the map for every key any ghost holds, with the map's buckets
+	uint64_t size = sizeof(Adaptive) + sizeof(Ghost)*adaptive->ghosts.capacity() + sizeof(void*)*adaptive->keys.bucket_count();
+	size += adaptive->keys.size()*(sizeof(void*) + sizeof(std::pair<const Index, Ghost_key>));
+	for(const Ghost& ghost : adaptive->ghosts) {
+		size += sizeof(Page)*ghost.pages.capacity();
+	}
+	return size;
+}
@@ -0,0 +1,29 @@
+//By Monica Moniot and Alyssa Riceman
+#ifndef ADAPTIVE_H
+#define ADAPTIVE_H
+#include "types.h"
+
+//Picks the eviction policy that would be doing best on the traffic of late, so the cache can switch to it
+//A small cache is simulated for each candidate policy, a ghost, over a sample of the keys: a key is sampled when a
+//remix of its hash falls under a threshold, as the hit ratio estimator does, and each ghost gets the same fraction
+//of the cache's capacity, so it sees the hits and misses the policy would have had in the whole cache
+//Ghosts are run by the evictors of eviction.cpp themselves, over a book of pages of their own, holding only the hash
+//and size of each key
+//Every window of sampled gets, the ghosts' hits are added into a score that halves every window, so a change in the
+//traffic shows up within a few windows; the best policy is only chosen over the live one if it beats it by a margin,
+//so that two policies doing about as well don't trade places back and forth
+
+Adaptive* create_adaptive(const evictor_type* policies, uint32_t policy_total, evictor_type live_policy, uint32_t sample_period, uint32_t window_gets);
+void destroy_adaptive(Adaptive* adaptive);
+
+//key_hash is the hash as the table stores it, and capacity is the cache's mem_capacity
+//adaptive_get returns the policy the cache should be using, which is the live one unless a window just ended
+evictor_type adaptive_get(Adaptive* adaptive, Index key_hash, Index value_size, bool is_hit, Index capacity);
+void adaptive_set(Adaptive* adaptive, Index key_hash, Index value_size, Index capacity);
+void adaptive_delete(Adaptive* adaptive, Index key_hash);
+//tells adaptive that the cache now uses policy, having taken switch_ns to move over to it
+void note_adaptive_switch(Adaptive* adaptive, evictor_type policy, uint64_t switch_ns);
+Adaptive_stats get_adaptive_stats(const Adaptive* adaptive);
+//bytes of memory the ghosts have allocated
+uint64_t get_adaptive_size(const Adaptive* adaptive);
+#endif
@@ -0,0 +1,159 @@
+//By Monica Moniot and Alyssa Riceman
+//Runs traffic that changes character from phase to phase, skewed reads by "day" and a loop over every key by
+//"night", against caches fixed to one policy and against one left to switch with cache_set_adaptive
+//The hit ratio each got in each phase is printed, with the time per operation and how long switching took
+//What the simulations cost is timed apart, on day traffic alone, which SLRU does best at, so that a cache starting
+//out on SLRU has no reason to switch and the difference is only the simulating
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "cache.h"
+
+constexpr int RUN_TOTAL = 3;
+
+struct Options {
+	uint32_t key_total;
+	uint32_t value_size;
+	uint32_t phase_ops;
+	uint32_t phase_total;
+	uint32_t cache_percent;
+	uint32_t sample_period;
+};
+
+inline uint64_t get_time_ns() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+
+inline void make_key(char* key, uint32_t i) {
+	snprintf(key, 32, "key:%u", i);
+}
+
+void print_usage(const char* name) {
+	printf("Usage: %s [-k keys] [-v value bytes] [-n operations per phase] [-p phases] [-c percent of the keys the cache holds] [-s sample period]\n", name);
+}
+
+const char* get_policy_name(evictor_type policy) {
+	const char* names[] = {"FIFO", "LIFO", "LRU", "MRU", "CLOCK", "SLRU", "RR"};
+	return names[policy];
+}
+
+double run_phases(const Options* options, evictor_type policy, bool is_adaptive, std::vector<double>* ret_hit_ratios, Adaptive_stats* ret_stats) {
+	uint64_t max_mem = static_cast<uint64_t>(options->key_total)*options->value_size/100*options->cache_percent;
+	cache_type cache = create_cache(max_mem > UINT32_MAX ? UINT32_MAX : max_mem, policy, NULL);
+	if(is_adaptive) {
+		evictor_type policies[] = {FIFO, LIFO, LRU, MRU, CLOCK, SLRU};
+		cache_set_adaptive(cache, policies, 6, options->sample_period, 0);
+	}
+	std::vector<char> value(options->value_size, 'v');
+	char key[32];
+	uint32_t seed = 1;
+	uint32_t scan_i = 0;
+	ret_hit_ratios->clear();
+	uint64_t start_time = get_time_ns();
+	for(uint32_t phase = 0; phase < options->phase_total; phase += 1) {
+		bool is_night = phase%2 == 1;
+		uint64_t hit_total = 0;
+		for(uint32_t i = 0; i < options->phase_ops; i += 1) {
+			if(is_night) {
+				make_key(key, scan_i);
+				scan_i = (scan_i + 1)%options->key_total;
+			} else {
+				//the key is the product of two uniform picks, so small keys are far more popular than large ones
+				seed = seed*1103515245 + 12345;
+				uint64_t a = (seed>>8)%options->key_total;
+				seed = seed*1103515245 + 12345;
+				uint64_t b = (seed>>8)%options->key_total;
+				make_key(key, a*b/options->key_total);
+			}
+			index_type val_size;
+			if(cache_get(cache, key, &val_size) == NULL) {
+				cache_set(cache, key, value.data(), options->value_size);
+			} else {
+				hit_total += 1;
+			}
+		}
+		ret_hit_ratios->push_back(static_cast<double>(hit_total)/options->phase_ops);
+	}
+	double ns = static_cast<double>(get_time_ns() - start_time)/(static_cast<uint64_t>(options->phase_ops)*options->phase_total);
+	*ret_stats = cache_adaptive_stats(cache);
+	destroy_cache(cache);
+	return ns;
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	options.key_total = 1000000;
+	options.value_size = 64;
+	options.phase_ops = 2000000;
+	options.phase_total = 4;
+	options.cache_percent = 10;
+	options.sample_period = 64;
+	int opt;
+	while((opt = getopt(argc, argv, "k:v:n:p:c:s:h")) != -1) {
+		if(opt == 'k') {
+			options.key_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'v') {
+			options.value_size = strtoul(optarg, NULL, 10);
+		} else if(opt == 'n') {
+			options.phase_ops = strtoul(optarg, NULL, 10);
+		} else if(opt == 'p') {
+			options.phase_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'c') {
+			options.cache_percent = strtoul(optarg, NULL, 10);
+		} else if(opt == 's') {
+			options.sample_period = strtoul(optarg, NULL, 10);
+		} else {
+			print_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if(options.key_total == 0 or options.phase_ops == 0 or options.phase_total == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	printf("%u phases of %u operations over %u keys, skewed by day and a loop by night, in a cache for %u%% of them\n",
+		options.phase_total, options.phase_ops, options.key_total, options.cache_percent);
+	printf("%-10s %8s", "policy", "ns/op");
+	for(uint32_t phase = 0; phase < options.phase_total; phase += 1) {
+		printf(" %7s%-2u", phase%2 == 1 ? "night" : "day", phase/2 + 1);
+	}
+	printf(" %8s\n", "overall");
+
+	const evictor_type fixed[] = {LRU, SLRU, MRU};
+	std::vector<double> hit_ratios;
+	Adaptive_stats stats;
+	for(int run = 0; run < 4; run += 1) {
+		bool is_adaptive = run == 3;
+		double ns = run_phases(&options, is_adaptive ? static_cast<evictor_type>(LRU) : fixed[run], is_adaptive, &hit_ratios, &stats);
+		printf("%-10s %8.1f", is_adaptive ? "adaptive" : get_policy_name(fixed[run]), ns);
+		double sum = 0;
+		for(double hit_ratio : hit_ratios) {
+			printf(" %9.4f", hit_ratio);
+			sum += hit_ratio;
+		}
+		printf(" %8.4f\n", sum/hit_ratios.size());
+	}
+	printf("adaptive ended on %s after %llu windows, switching %llu times in %.3f ms, %.3f ms each\n", get_policy_name(stats.policy),
+		static_cast<unsigned long long>(stats.window_total), static_cast<unsigned long long>(stats.switch_total), stats.switch_ns/1e6,
+		stats.switch_total == 0 ? 0 : stats.switch_ns/1e6/stats.switch_total);
+
+	//the two take turns, and each keeps its best run, since the difference is small next to the noise of one run
+	Options day_options = options;
+	day_options.phase_total = 1;
+	double plain_ns = 0;
+	double adaptive_ns = 0;
+	for(int run = 0; run < RUN_TOTAL; run += 1) {
+		double ns = run_phases(&day_options, SLRU, false, &hit_ratios, &stats);
+		plain_ns = run == 0 or ns < plain_ns ? ns : plain_ns;
+		ns = run_phases(&day_options, SLRU, true, &hit_ratios, &stats);
+		adaptive_ns = run == 0 or ns < adaptive_ns ? ns : adaptive_ns;
+	}
+	printf("day alone: SLRU %6.1f ns/op  adaptive %6.1f ns/op  %+5.1f%%, switching %llu times\n", plain_ns, adaptive_ns,
+		100*(adaptive_ns - plain_ns)/plain_ns, static_cast<unsigned long long>(stats.switch_total));
+	return 0;
+}
@@ -0,0 +1,86 @@
+//By Monica Moniot and Alyssa Riceman
+//Measures loading a cache from scratch three ways: a plain cache_set loop, the same loop after cache_reserve,
+//and cache_set_bulk
+//The keys and values are made up front so only the loading is timed
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "cache.h"
+
+struct Options {
+	uint32_t key_total;
+	uint32_t value_size;
+	uint32_t thread_total;
+};
+
+inline uint64_t get_time_ns() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+
+void print_usage(const char* name) {
+	printf("Usage: %s [-k keys] [-v value bytes] [-t threads for cache_set_bulk, 0 for one per core]\n", name);
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	options.key_total = 10000000;
+	options.value_size = 16;
+	options.thread_total = 0;
+	int opt;
+	while((opt = getopt(argc, argv, "k:v:t:h")) != -1) {
+		if(opt == 'k') {
+			options.key_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'v') {
+			options.value_size = strtoul(optarg, NULL, 10);
+		} else if(opt == 't') {
+			options.thread_total = strtoul(optarg, NULL, 10);
+		} else {
+			print_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if(options.key_total == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	const uint32_t KEY_SIZE = 16;
+	std::vector<char> keys(static_cast<uint64_t>(options.key_total)*KEY_SIZE);
+	std::vector<char> value(options.value_size, 'v');
+	std::vector<Bulk_item> items(options.key_total);
+	for(uint32_t i = 0; i < options.key_total; i += 1) {
+		char* key = &keys[static_cast<uint64_t>(i)*KEY_SIZE];
+		snprintf(key, KEY_SIZE, "key:%u", i);
+		items[i].key = key;
+		items[i].val = value.data();
+		items[i].val_size = options.value_size;
+	}
+	uint64_t mem_capacity = 4*static_cast<uint64_t>(options.key_total)*options.value_size;
+	index_type max_mem = mem_capacity > UINT32_MAX ? UINT32_MAX : mem_capacity;
+	printf("loading %u keys of %u bytes\n", options.key_total, options.value_size);
+
+	for(int mode = 0; mode < 3; mode += 1) {
+		cache_type cache = create_cache(max_mem, LRU, NULL);
+		uint64_t start_time = get_time_ns();
+		if(mode == 2) {
+			cache_set_bulk(cache, items.data(), options.key_total, options.thread_total);
+		} else {
+			if(mode == 1) {
+				cache_reserve(cache, options.key_total);
+			}
+			for(uint32_t i = 0; i < options.key_total; i += 1) {
+				cache_set(cache, items[i].key, items[i].val, items[i].val_size);
+			}
+		}
+		double ms = (get_time_ns() - start_time)/1e6;
+		const char* names[] = {"cache_set loop", "reserve + loop", "cache_set_bulk"};
+		printf("%-16s %9.1f ms  %9.0f sets/s\n", names[mode], ms, options.key_total/(ms/1e3));
+		destroy_cache(cache);
+	}
+	return 0;
+}
@@ -2,9 +2,31 @@
 #include <stdlib.h>
 #include <cstring>
 #include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <new>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include <type_traits>
 #include "types.h"
 #include "book.h"
 #include "eviction.h"
+#include "lz.h"
+#include "value.h"
+#include "disk_tier.h"
+#include "mutation_log.h"
+#include "prefix_index.h"
+#include "linear_index.h"
+#include "trace.h"
+#include "mrc.h"
+#include "adaptive.h"
 #include "cache.h"
 
 constexpr Index INIT_ENTRY_CAPACITY = 64;//must be a power of 2
@@ -13,9 +35,19 @@ constexpr Index INIT_HASH_TABLE_CAPACITY = static_cast<Index>(INIT_ENTRY_CAPACIT
 
 constexpr Index EMPTY = 0;
 constexpr Index DELETED = 1;
-constexpr Index HIGH_BIT = 1<<(8*sizeof(Index) - 1);
-constexpr Index HASH_MULTIPLIER = 2654435769;
+constexpr Index HIGH_BIT = static_cast<Index>(1)<<(8*sizeof(Index) - 1);
+//2^bits divided by the golden ratio, for whichever width Index has
+constexpr Index HASH_MULTIPLIER = sizeof(Index) == 8 ? static_cast<Index>(11400714819323198485ull) : static_cast<Index>(2654435769u);
 constexpr char NULL_TERMINATOR = 0;
+constexpr Index REHASH_MIN_SLOTS = 1<<14;//fewer old slots per thread than this isn't worth a thread
+constexpr Index BULK_BATCH_SIZE = 1<<16;//items of cache_set_bulk prepared in parallel before they're inserted
+constexpr Index BULK_MIN_ITEMS = 1<<10;//fewer items per thread than this isn't worth a thread
+constexpr Index SCAN_MAX_VISITS = 8;//cache_scan looks at no more than this many pages per entry it's asked for
+constexpr Index MAINTENANCE_BATCH = 1024;//entries the maintenance thread evicts before letting callers have the lock again
+constexpr uint64_t MAX_GARBAGE = 1<<16;//keys or values left for the maintenance thread to free before callers free their own
+constexpr uint64_t MAINTENANCE_INTERVAL_MS = 10;//how long the maintenance thread sleeps if nothing wakes it
+constexpr Index DEFAULT_LINEAR_THRESHOLD = 32;//caches of up to this many entries find keys with a linear index
+constexpr Index MAX_LINEAR_REBUILD_CAPACITY = 1024;//a table bigger than this isn't walked to go back to a linear index
 
 constexpr inline Index get_hash(Index key_hash) {
 	//we want to flag entries by setting their key_hash to EMPTY and DELETED
@@ -54,6 +86,9 @@ Index default_key_hasher(Key_ptr key) {
 	for(Index j = sizeof(Index)*key_as_index_size; j < size; j += 1) {
 		hash = (hash^key[j])*HASH_MULTIPLIER;
 	}
+	//a multiply only carries upward, so the low bits the table indexes by would only see the first few bits of each
+	//word, and keys that differ further in would cluster; folding the high half down lets them see the rest
+	hash ^= hash>>(4*sizeof(Index));
 	return hash;
 }
 bool are_keys_equal(Key_ptr key0, Key_ptr key1) {
@@ -85,25 +120,25 @@ constexpr inline bool is_exceeding_load(Index entry_total, Index dead_total, Ind
 }
 
 //instead of storing pointers to our tables, we calculate them jit
-constexpr inline Index* get_hashes    (byte* mem_arena) {
+inline Index* get_hashes    (byte* mem_arena) {
 	//hashes is part of the hash table
 	//in order to traverse the hash table, we traverse hashes
 	//the hash marks if an entry is empty, deleted or populated
 	return reinterpret_cast<Index*>(mem_arena);
 }
-constexpr inline Index* get_bookmarks (byte* mem_arena, Index entry_capacity) {
+inline Index* get_bookmarks (byte* mem_arena, Index entry_capacity) {
 	//bookmarks is part of the hash table
 	//it stores the index of the page in the book connected to the hash table entry
 	const auto hash_table_capacity = get_hash_table_capacity(entry_capacity);
 	return reinterpret_cast<Index*>(mem_arena + sizeof(Index)*hash_table_capacity);
 }
-constexpr inline Page*  get_pages     (byte* mem_arena, Index entry_capacity) {
+inline Page*  get_pages     (byte* mem_arena, Index entry_capacity) {
 	//pages stores the primary data structure of Book
 	const auto hash_table_capacity = get_hash_table_capacity(entry_capacity);
 	const auto hash_table_size = (2*sizeof(Index))*hash_table_capacity;
 	return reinterpret_cast<Page*>(mem_arena + hash_table_size);
 }
-constexpr inline void*  get_evict_data(byte* mem_arena, Index entry_capacity) {
+inline void*  get_evict_data(byte* mem_arena, Index entry_capacity) {
 	//evict_data points to the internal data used by the evictor
 	//the evictor might not use this data, so it may be an invalid pointer
 	const auto hash_table_capacity = get_hash_table_capacity(entry_capacity);
@@ -112,6 +147,13 @@ constexpr inline void*  get_evict_data(byte* mem_arena, Index entry_capacity) {
 	return reinterpret_cast<void*>(mem_arena + hash_table_size + book_size);
 }
 
+inline uint64_t get_arena_size(Index entry_capacity, evictor_type policy) {
+	const auto hash_table_capacity = get_hash_table_capacity(entry_capacity);
+	const auto hash_table_size = (2*sizeof(Index))*hash_table_capacity;
+	const auto book_size = sizeof(Page)*entry_capacity;
+	const auto evictor_size = get_evictor_mem_size(policy, entry_capacity);
+	return hash_table_size + book_size + evictor_size;
+}
 inline byte* allocate(Index entry_capacity, evictor_type policy) {
 	//we allocate all of our dynamic memory right here
 	//we do a joint allocation of everything for many reasons:
@@ -120,91 +162,625 @@ inline byte* allocate(Index entry_capacity, evictor_type policy) {
 	//a joint allocation greatly improves locality
 	//we don't have to store pointers to every data structure
 	//a jointly allocated block is easily serializable
-	const auto hash_table_capacity = get_hash_table_capacity(entry_capacity);
-	const auto hash_table_size = (2*sizeof(Index))*hash_table_capacity;
-	const auto book_size = sizeof(Page)*entry_capacity;
-	const auto evictor_size = get_evictor_mem_size(policy, entry_capacity);
-	return new byte[hash_table_size + book_size + evictor_size];
+	return new byte[get_arena_size(entry_capacity, policy)];
+}
+
+constexpr uint64_t MALLOC_ALIGNMENT = 16;
+constexpr uint64_t MALLOC_MIN_CHUNK = 32;
+constexpr uint64_t MALLOC_MMAP_THRESHOLD = 128*1024;
+constexpr uint64_t MMAP_PAGE_SIZE = 4096;
+constexpr inline uint64_t get_alloc_size(uint64_t size) {
+	//what an allocation of size bytes really costs under glibc's malloc:
+	//a chunk has an 8 byte header and is rounded up to 16 bytes, and big ones are mmapped whole pages
+	if(size == 0) {
+		return 0;
+	} else if(size >= MALLOC_MMAP_THRESHOLD) {
+		return (size + MALLOC_ALIGNMENT + MMAP_PAGE_SIZE - 1)/MMAP_PAGE_SIZE*MMAP_PAGE_SIZE;
+	}
+	uint64_t chunk = (size + 8 + MALLOC_ALIGNMENT - 1)/MALLOC_ALIGNMENT*MALLOC_ALIGNMENT;
+	return chunk < MALLOC_MIN_CHUNK ? MALLOC_MIN_CHUNK : chunk;
+}
+inline uint64_t get_value_footprint(Index capacity) {
+	//a value mutated in place may have been given more room than it's using, so this goes by its capacity
+	return get_alloc_size(sizeof(Value) + capacity);
+}
+//the state of cache_get_or_load: the loads in flight and when the entries it loaded go stale
+//it only exists once cache_get_or_load has been called, and is guarded by the same lock as the rest of the cache
+struct Load {//a load in flight; every caller that misses on its key while it runs waits for it
+	std::condition_variable is_done_signal;
+	bool is_done;
+	Value* value;//the loaded value, uncompressed and holding a reference of its own, NULL if loading failed
+	Index value_size;
+	Index waiter_total;//including the loader; the last to leave deletes the load
+};
+struct Expiry {//in ns of CLOCK_MONOTONIC
+	uint64_t fresh_until;
+	uint64_t stale_until;//after this the entry is as good as missing
+};
+struct Load_table {
+	std::unordered_map<std::string, Load*> in_flight;
+	std::unordered_map<Bookmark, Expiry> expiries;//only entries loaded with a ttl are here
+};
+inline uint64_t get_load_table_size(const Load_table* loads) {
+	//an unordered_map allocates a node per element, holding the element and the next pointer, and an array of buckets
+	const auto expiries = &loads->expiries;
+	uint64_t size = get_alloc_size(sizeof(Load_table)) + get_alloc_size(sizeof(void*)*expiries->bucket_count());
+	size += expiries->size()*get_alloc_size(sizeof(void*) + sizeof(std::pair<const Bookmark, Expiry>));
+	return size;
+}
+inline void forget_expiry(Cache* cache, Bookmark bookmark) {
+	if(cache->loads != NULL) {
+		cache->loads->expiries.erase(bookmark);
+	}
+}
+
+constexpr uint32_t MAX_PARTITIONS = 255;
+struct Partition {
+	std::string prefix;
+	Evictor evictor;//partition 0 uses the cache's own instead
+	Partition_stats stats;//the quota, mem_total and entry_total are what eviction goes by
+};
+struct Partitions {
+	std::vector<Partition> list;//0 is the keys in no partition
+};
+inline uint64_t get_partitions_size(const Partitions* partitions) {
+	uint64_t size = get_alloc_size(sizeof(Partitions)) + get_alloc_size(sizeof(Partition)*partitions->list.capacity());
+	for(const Partition& partition : partitions->list) {
+		//short prefixes are kept inside the string itself
+		if(partition.prefix.capacity() >= sizeof(std::string)) {
+			size += get_alloc_size(partition.prefix.capacity() + 1);
+		}
+	}
+	return size;
+}
+inline uint16_t find_partition(const Cache* cache, Key_ptr key) {
+	//the partition with the longest prefix key starts with, or 0 if none
+	const auto& list = cache->partitions->list;
+	uint16_t found = 0;
+	size_t found_size = 0;
+	for(uint32_t p = 1; p < list.size(); p += 1) {
+		const auto& prefix = list[p].prefix;
+		if((found == 0 or prefix.size() > found_size) and strncmp(key, prefix.data(), prefix.size()) == 0) {
+			found = p;
+			found_size = prefix.size();
+		}
+	}
+	return found;
+}
+inline Evictor* get_partition_evictor(Cache* cache, uint16_t partition) {
+	return partition == 0 ? &cache->evictor : &cache->partitions->list[partition].evictor;
+}
+inline Evictor* get_evictor(Cache* cache, const Entry* entry) {
+	//the evictor tracking entry, which is the cache's own unless the entry is in a partition
+	return cache->partitions == NULL ? &cache->evictor : get_partition_evictor(cache, entry->partition);
+}
+inline void add_to_partition(Cache* cache, const Entry* entry, Index mem_change, Index entry_change) {
+	//both changes may be negative, wrapping around
+	if(cache->partitions != NULL) {
+		auto stats = &cache->partitions->list[entry->partition].stats;
+		stats->mem_total += static_cast<int64_t>(static_cast<std::make_signed<Index>::type>(mem_change));
+		stats->entry_total += static_cast<int64_t>(static_cast<std::make_signed<Index>::type>(entry_change));
+	}
+}
+
+inline uint64_t get_fixed_footprint(const Cache* cache) {
+	//everything the cache has allocated but its keys and values, which is all that evicting frees in bulk
+	uint64_t footprint = get_alloc_size(sizeof(Cache));
+	footprint += get_alloc_size(get_arena_size(cache->entry_capacity, cache->evictor.policy));
+	footprint += get_alloc_size(cache->compress_buffer_size) + get_alloc_size(cache->read_buffer_size);
+	if(cache->prefix_index != NULL) {
+		footprint += get_prefix_index_size(cache->prefix_index);
+	}
+	if(cache->loads != NULL) {
+		footprint += get_load_table_size(cache->loads);
+	}
+	if(cache->linear != NULL) {
+		footprint += get_alloc_size(get_linear_index_size(cache->linear));
+	}
+	if(cache->trace != NULL) {
+		footprint += get_trace_size(cache->trace);
+	}
+	if(cache->mrc != NULL) {
+		footprint += get_mrc_size(cache->mrc);
+	}
+	if(cache->adaptive != NULL) {
+		footprint += get_adaptive_size(cache->adaptive);
+	}
+	if(cache->partitions != NULL) {
+		footprint += get_partitions_size(cache->partitions);
+	}
+	return footprint;
+}
+inline uint64_t get_footprint(const Cache* cache) {
+	//everything the cache has allocated, by what it costs rather than what was asked for
+	return get_fixed_footprint(cache) + cache->key_footprint + cache->value_footprint;
+}
+inline bool is_over_limit(const Cache* cache, uint64_t limit) {
+	if(cache->is_counting_footprint) {
+		return get_footprint(cache) > limit;
+	}
+	return cache->mem_total > limit;
+}
+inline bool is_over_capacity(const Cache* cache) {
+	return is_over_limit(cache, cache->mem_capacity);
 }
 
 
+inline uint64_t get_time_ns() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+template<typename Func>
+inline void run_in_parallel(uint32_t thread_total, Func func) {
+	//calls func(0) to func(thread_total - 1) on as many threads, the first on the caller's
+	std::vector<std::thread> threads;
+	for(uint32_t t = 1; t < thread_total; t += 1) {
+		threads.emplace_back(func, t);
+	}
+	func(0);
+	for(auto& thread : threads) {
+		thread.join();
+	}
+}
+inline byte* reserve_buffer(byte** buffer, Index* buffer_size, Index size) {
+	//grows a scratch buffer of the cache to at least size bytes
+	if(*buffer_size < size) {
+		delete[] *buffer;
+		*buffer = new byte[size];
+		*buffer_size = size;
+	}
+	return *buffer;
+}
+inline Index get_raw_size(const Entry* entry) {
+	return entry->value->raw_size == 0 ? entry->value_size : entry->value->raw_size;
+}
+inline Value* compress_value(Index compress_threshold, const byte* src, Index val_size, byte** compress_buffer, Index* compress_buffer_size, Compression_stats* stats) {
+	//a compressed copy of the value, or NULL if compression is off, the value is too small or it didn't pay off
+	if(compress_threshold == 0 or val_size < compress_threshold) {
+		return NULL;
+	}
+	auto start_time = get_time_ns();
+	//the value must shrink by at least an eighth to be worth decompressing on every read
+	Index max_size = val_size - val_size/8;
+	byte* buffer = reserve_buffer(compress_buffer, compress_buffer_size, max_size);
+	Index compressed_size = lz_compress(src, val_size, buffer, max_size);
+	stats->compress_total += 1;
+	stats->compress_ns += get_time_ns() - start_time;
+	if(compressed_size == 0) {
+		stats->incompressible_total += 1;
+		return NULL;
+	}
+	Value* value = alloc_value(compressed_size);
+	memcpy(value->data, buffer, compressed_size);
+	value->raw_size = val_size;
+	return value;
+}
+inline Value* make_value(Index compress_threshold, Value_ptr val, Index val_size, Index* ret_stored_size, byte** compress_buffer, Index* compress_buffer_size, Compression_stats* stats) {
+	//copies the caller's value into a new Value, compressing it if that's turned on and it pays off
+	//the scratch buffer and stats are passed in so that threads making values in parallel can each have their own
+	auto src = static_cast<const byte*>(val);
+	Value* value = compress_value(compress_threshold, src, val_size, compress_buffer, compress_buffer_size, stats);
+	if(value != NULL) {
+		*ret_stored_size = value->capacity;
+		return value;
+	}
+	value = alloc_value(val_size);
+	memcpy(value->data, src, val_size);
+	*ret_stored_size = val_size;
+	return value;
+}
+inline Value* make_value(Cache* cache, Value_ptr val, Index val_size, Index* ret_stored_size) {
+	return make_value(cache->compress_threshold, val, val_size, ret_stored_size, &cache->compress_buffer, &cache->compress_buffer_size, &cache->compression_stats);
+}
+inline Value* compress_made_value(Cache* cache, Value* value, Index val_size, Index* ret_stored_size) {
+	//like make_value, but for a value we already have uncompressed, which is let go of if it's compressed
+	Value* compressed = compress_value(cache->compress_threshold, value->data, val_size, &cache->compress_buffer, &cache->compress_buffer_size, &cache->compression_stats);
+	if(compressed == NULL) {
+		*ret_stored_size = val_size;
+		return value;
+	}
+	release_value(value);
+	*ret_stored_size = compressed->capacity;
+	return compressed;
+}
+inline bool decompress_value(Cache* cache, const Entry* entry, byte* dst) {
+	auto stats = &cache->compression_stats;
+	auto start_time = get_time_ns();
+	bool is_valid = lz_decompress(entry->value->data, entry->value_size, dst, entry->value->raw_size);
+	stats->decompress_total += 1;
+	stats->decompress_ns += get_time_ns() - start_time;
+	return is_valid;
+}
+
 void mark_as_empty(Index* key_hashes, Index hash_table_capacity) {
 	for(Index i = 0; i < hash_table_capacity; i += 1) {
 		key_hashes[i] = EMPTY;
 	}
 }
 
+//what cache_set_table_dump keeps: each line it prints is about the lookups since the one before
+struct Table_dump {
+	FILE* file;
+	uint64_t lookup_interval;
+	uint64_t lookups_left;
+	Table_stats last;//the counts as of the last line
+};
+Table_stats get_table_stats(const Cache* cache) {
+	Table_stats stats = cache->table_stats;
+	stats.slot_total = get_hash_table_capacity(cache->entry_capacity);
+	stats.entry_total = cache->entry_total;
+	stats.dead_total = cache->dead_total;
+	Index used_total = cache->entry_total + cache->dead_total;
+	stats.dead_ratio = used_total == 0 ? 0 : static_cast<double>(cache->dead_total)/used_total;
+	stats.hit_total = 0;
+	stats.miss_total = 0;
+	for(uint32_t i = 0; i < PROBE_BUCKET_TOTAL; i += 1) {
+		stats.hit_total += stats.hit_probes[i];
+		stats.miss_total += stats.miss_probes[i];
+	}
+	//graves are stepped over like live keys, so they count toward the load; under uniform hashing a miss looks at
+	//1/(1 - load) slots on average, and a hit at ln(1/(1 - load))/load
+	double load = static_cast<double>(used_total)/stats.slot_total;
+	stats.expected_miss_probes = 1/(1 - load);
+	stats.expected_hit_probes = load == 0 ? 1 : log(1/(1 - load))/load;
+	//the history is a ring, which we hand back in order
+	uint64_t record_total = stats.resize_total;
+	if(record_total > RESIZE_HISTORY_TOTAL) {
+		record_total = RESIZE_HISTORY_TOTAL;
+	}
+	for(uint32_t i = 0; i < record_total; i += 1) {
+		stats.resizes[i] = cache->table_stats.resizes[(stats.resize_total - record_total + i)%RESIZE_HISTORY_TOTAL];
+	}
+	return stats;
+}
+void dump_table_stats(Cache* cache) {
+	auto dump = cache->table_dump;
+	Table_stats stats = get_table_stats(cache);
+	uint64_t hit_total = stats.hit_total - dump->last.hit_total;
+	uint64_t miss_total = stats.miss_total - dump->last.miss_total;
+	double hit_mean = hit_total == 0 ? 0 : static_cast<double>(stats.hit_probe_total - dump->last.hit_probe_total)/hit_total;
+	double miss_mean = miss_total == 0 ? 0 : static_cast<double>(stats.miss_probe_total - dump->last.miss_probe_total)/miss_total;
+	bool is_clustered = hit_mean > 2*stats.expected_hit_probes or miss_mean > 2*stats.expected_miss_probes;
+	fprintf(dump->file, "table: %llu slots, %llu entries, %llu graves (%.1f%%), hits %.2f probes (%.2f even), misses %.2f probes (%.2f even), longest probe %llu, longest chain %llu, %llu full traversals, %llu resizes%s\n",
+		static_cast<unsigned long long>(stats.slot_total), static_cast<unsigned long long>(stats.entry_total),
+		static_cast<unsigned long long>(stats.dead_total), 100*stats.dead_ratio, hit_mean, stats.expected_hit_probes,
+		miss_mean, stats.expected_miss_probes, static_cast<unsigned long long>(stats.max_probe),
+		static_cast<unsigned long long>(stats.max_chain), static_cast<unsigned long long>(stats.full_traversal_total),
+		static_cast<unsigned long long>(stats.resize_total), is_clustered ? ", clustered" : "");
+	fflush(dump->file);
+	dump->last = stats;
+	dump->lookups_left = dump->lookup_interval;
+}
+inline void note_probes(Cache* cache, bool is_hit, Index probe_total) {
+	//counts a lookup of the table that looked at probe_total slots
+	auto stats = &cache->table_stats;
+	uint32_t bucket = 63 - __builtin_clzll(probe_total);
+	bucket = bucket < PROBE_BUCKET_TOTAL ? bucket : PROBE_BUCKET_TOTAL - 1;
+	if(is_hit) {
+		stats->hit_probes[bucket] += 1;
+		stats->hit_probe_total += probe_total;
+	} else {
+		stats->miss_probes[bucket] += 1;
+		stats->miss_probe_total += probe_total;
+	}
+	stats->max_probe = probe_total > stats->max_probe ? probe_total : stats->max_probe;
+	if(cache->table_dump != NULL) {
+		cache->table_dump->lookups_left -= 1;
+		if(cache->table_dump->lookups_left == 0) {
+			dump_table_stats(cache);
+		}
+	}
+}
+inline void note_full_traversal(Cache* cache, Key_ptr key) {
+	//a lookup only looks at every slot if the table has no empty ones left, which the load factor should never let
+	//happen; if it does it would happen on nearly every lookup, so it's only reported the first time
+	cache->table_stats.full_traversal_total += 1;
+	if(cache->table_stats.full_traversal_total == 1) {
+		printf("Error when attempting to find entry in cache: Full table traversal of %llu slots, key was %s; further ones are only counted, in cache_table_stats\n", static_cast<unsigned long long>(get_hash_table_capacity(cache->entry_capacity)), key);
+	}
+}
+
 constexpr Index KEY_NOT_FOUND = -1;
-inline Index find_entry(Cache* cache, Key_ptr key) {
-	//gets the hash table index associated to key
+inline Index find_entry(Cache* cache, Key_ptr key, Index* ret_key_hash) {
+	//gets the hash table index associated to key, and the hash of key if it was needed, or EMPTY if it wasn't
+	*ret_key_hash = EMPTY;
+	if(cache->linear != NULL) {
+		//a small cache scans its linear index instead, which doesn't need the key's hash
+		const auto entry_book = &cache->entry_book;
+		Bookmark bookmark = linear_index_find(cache->linear, entry_book, key, get_key_size(key));
+		return bookmark == NO_BOOKMARK ? KEY_NOT_FOUND : read_book(entry_book, bookmark)->cur_i;
+	}
 	const auto hash_table_capacity = get_hash_table_capacity(cache->entry_capacity);
 	const auto bookmarks = get_bookmarks(cache->mem_arena, cache->entry_capacity);
 	const auto key_hashes = get_hashes(cache->mem_arena);
 	const auto key_hash = get_hash(cache->hash(key));
 	const auto entry_book = &cache->entry_book;
+	*ret_key_hash = key_hash;
 	//check if key is in cache
 	Index expected_i = key_hash%hash_table_capacity;
 	Index step_size = get_step_size(key_hash);
 	for(Index count = 0; count < hash_table_capacity; count += 1) {
 		auto cur_key_hash = key_hashes[expected_i];
 		if(cur_key_hash == EMPTY) {
+			note_probes(cache, false, count + 1);
 			return KEY_NOT_FOUND;
 		} else if(cur_key_hash == DELETED) {
 			// continue;
 		} else if(cur_key_hash == key_hash) {
 			Entry* entry = read_book(entry_book, bookmarks[expected_i]);
 			if(are_keys_equal(entry->key, key)) {//found key
+				note_probes(cache, true, count + 1);
 				return expected_i;
 			}
 		}
 		expected_i = (expected_i + step_size)%hash_table_capacity;
 	}
-	printf("Error when attempting to find entry in cache: Full table traversal; index was %d, step was %d, key was %s, size was %d\n", expected_i, step_size, key, hash_table_capacity);
+	note_probes(cache, false, hash_table_capacity);
+	note_full_traversal(cache, key);
 	return KEY_NOT_FOUND;
 }
+inline Index find_entry(Cache* cache, Key_ptr key) {
+	Index key_hash;
+	return find_entry(cache, key, &key_hash);
+}
+inline Index get_key_hash(Cache* cache, Key_ptr key, Index i, Index key_hash) {
+	//the hash of key as the table stores it, taken from the table if key was found at i, or else from key_hash
+	//as find_entry gave it, so that key is only hashed if find_entry didn't have to
+	if(i != KEY_NOT_FOUND) {
+		return get_hashes(cache->mem_arena)[i];
+	}
+	return key_hash != EMPTY ? key_hash : get_hash(cache->hash(key));
+}
 
-inline void remove_entry(Cache* cache, Index i) {
-	//removes an entry to our cache, including from the hash table
-	//this is the only code that removes entries;
-	//it handles everything necessary for removing an entry
+inline void use_linear_index(Cache* cache) {
+	//indexes every entry of a cache small enough to find its keys by scanning
+	const auto hash_table_capacity = get_hash_table_capacity(cache->entry_capacity);
+	const auto key_hashes = get_hashes(cache->mem_arena);
+	const auto bookmarks = get_bookmarks(cache->mem_arena, cache->entry_capacity);
+	const auto entry_book = &cache->entry_book;
+	cache->linear = create_linear_index(cache->linear_threshold);
+	for(Index i = 0; i < hash_table_capacity; i += 1) {
+		auto key_hash = key_hashes[i];
+		if(key_hash != EMPTY and key_hash != DELETED) {
+			Entry* entry = read_book(entry_book, bookmarks[i]);
+			linear_index_insert(cache->linear, get_linear_tag(entry->key, entry->key_size), bookmarks[i]);
+		}
+	}
+}
+inline void use_hash_table(Cache* cache) {
+	destroy_linear_index(cache->linear);
+	cache->linear = NULL;
+}
+
+//a snapshot writes a copy of the cache's arena taken when it started, so the keys and values that copy points to
+//must outlive the snapshot; while it's running we hold on to the ones the cache lets go of instead of freeing them
+struct Snapshot {
+	std::thread writer;
+	std::atomic<bool> is_done;
+	bool is_ok;
+	FILE* file;
+	Cache cache_copy;
+	byte* mem_arena;
+	bool is_log_compaction;//whether this writes a compacted mutation log rather than a snapshot
+	std::string compaction_path;
+	uint64_t log_tail_start;//what was logged after this still has to be copied to the compacted log
+	std::vector<byte*> deferred_keys;
+	std::vector<Value*> deferred_values;
+};
+//the maintenance thread does a cache's housekeeping between its callers' calls, taking the same lock they do:
+//it evicts to keep some headroom under capacity, grows the table before it has to grow, and frees the keys and
+//values the cache lets go of, outside the lock; callers still do all of this themselves when it falls behind
+struct Maintenance {
+	std::thread worker;
+	std::mutex* lock;
+	std::condition_variable wake_signal;
+	bool is_woken;
+	bool is_stopping;
+	uint32_t headroom_percent;
+	std::vector<byte*> garbage_keys;
+	std::vector<Value*> garbage_values;
+};
+inline void drop_key(Cache* cache, Key_ptr key) {
+	byte* key_mem = reinterpret_cast<byte*>(const_cast<char*>(key));
+	if(cache->snapshot != NULL) {
+		cache->snapshot->deferred_keys.push_back(key_mem);
+	} else if(cache->maintenance != NULL and cache->maintenance->garbage_keys.size() < MAX_GARBAGE) {
+		cache->maintenance->garbage_keys.push_back(key_mem);
+	} else {
+		delete[] key_mem;
+	}
+}
+inline void drop_value(Cache* cache, Value* value) {
+	//front caches may still hold the value, and this is how they find out it's no longer the key's
+	value->is_retired.store(true, std::memory_order_release);
+	if(cache->snapshot != NULL) {
+		cache->snapshot->deferred_values.push_back(value);
+	} else if(cache->maintenance != NULL and cache->maintenance->garbage_values.size() < MAX_GARBAGE) {
+		cache->maintenance->garbage_values.push_back(value);
+	} else {
+		release_value(value);
+	}
+}
+inline bool finish_snapshot(Cache* cache) {
+	//waits for the snapshot and frees everything it held on to
+	Snapshot* snapshot = cache->snapshot;
+	snapshot->writer.join();
+	for(auto key : snapshot->deferred_keys) {
+		delete[] key;
+	}
+	for(auto value : snapshot->deferred_values) {
+		release_value(value);
+	}
+	bool is_ok = snapshot->is_ok;
+	if(snapshot->is_log_compaction) {
+		if(is_ok) {
+			is_ok = replace_mutation_log(cache->log, snapshot->compaction_path.c_str(), snapshot->log_tail_start);
+		} else {
+			unlink(snapshot->compaction_path.c_str());
+		}
+	}
+	delete[] snapshot->mem_arena;
+	delete snapshot;
+	cache->snapshot = NULL;
+	return is_ok;
+}
+inline void check_snapshot(Cache* cache) {
+	//cleans up after a snapshot as soon as we notice it's done, so what it deferred doesn't pile up
+	if(cache->snapshot != NULL and cache->snapshot->is_done.load(std::memory_order_acquire)) {
+		cache->is_snapshot_ok = finish_snapshot(cache);
+	}
+}
+
+inline void release_entry(Cache* cache, Index i) {
+	//frees an entry that the evictor no longer tracks, including from the hash table
+	//this is the only code that frees entries;
+	//it handles everything necessary for removing an entry except the evictor
 	const auto key_hashes = get_hashes(cache->mem_arena);
 	const auto bookmarks = get_bookmarks(cache->mem_arena, cache->entry_capacity);
 	const auto entry_book = &cache->entry_book;
-	const auto evictor = &cache->evictor;
 
 	auto bookmark = bookmarks[i];
 	Entry* entry = read_book(entry_book, bookmark);
 
-	delete[] entry->key;
+	if(cache->prefix_index != NULL) {
+		//the index finds the entry by its key, so this must come before the key goes
+		prefix_index_remove(cache->prefix_index, entry_book, bookmark);
+	}
+	forget_expiry(cache, bookmark);
+	if(cache->linear != NULL) {
+		linear_index_remove(cache->linear, bookmark);
+	}
+	drop_key(cache, entry->key);
 	entry->key = NULL;
 	key_hashes[i] = DELETED;
 	cache->entry_total -= 1;
 	cache->dead_total += 1;
+	cache->key_total -= entry->key_size;
+	cache->key_footprint -= get_alloc_size(entry->key_size);
 
 	cache->mem_total -= entry->value_size;
-	delete[] entry->value;
+	add_to_partition(cache, entry, -entry->value_size, -1);
+	cache->value_footprint -= get_value_footprint(entry->value->capacity);
+	cache->raw_total -= get_raw_size(entry);
+	drop_value(cache, entry->value);
 	entry->value = NULL;
 
-	remove_evict_item(evictor, bookmark, &entry->evict_item, entry_book);
 	free_book_page(entry_book, bookmark);
+	if(cache->linear == NULL and cache->linear_threshold != 0 and cache->entry_total <= cache->linear_threshold/2 and cache->entry_capacity <= MAX_LINEAR_REBUILD_CAPACITY) {
+		//half the threshold, so that a cache hovering around it doesn't keep switching
+		use_linear_index(cache);
+	}
+}
+inline void remove_entry(Cache* cache, Index i) {
+	//removes an entry from our cache and from the evictor
+	const auto bookmarks = get_bookmarks(cache->mem_arena, cache->entry_capacity);
+	const auto entry_book = &cache->entry_book;
+	auto bookmark = bookmarks[i];
+	Entry* entry = read_book(entry_book, bookmark);
+	remove_evict_item(get_evictor(cache, entry), bookmark, &entry->evict_item, entry_book);
+	release_entry(cache, i);
 }
 
+inline void evict_from(Cache* cache, Evictor* evictor) {
+	const auto entry_book = &cache->entry_book;
+	//get_evict_item has already removed the victim from the evictor
+	Index bookmark = get_evict_item(evictor, entry_book);
+	Entry* entry = read_book(entry_book, bookmark);
+	if(cache->disk_tier != NULL) {
+		disk_tier_put(cache->disk_tier, entry->key, entry->key_size, entry->value, entry->value_size);
+	}
+	if(cache->partitions != NULL) {
+		cache->partitions->list[entry->partition].stats.evict_total += 1;
+	}
+	release_entry(cache, entry->cur_i);
+}
+inline void evict_entry(Cache* cache) {
+	//with partitions, the victim comes from whichever is furthest over its quota
+	if(cache->partitions == NULL) {
+		evict_from(cache, &cache->evictor);
+		return;
+	}
+	const auto& list = cache->partitions->list;
+	uint16_t victim = 0;
+	int64_t victim_excess = 0;
+	for(uint32_t p = 0; p < list.size(); p += 1) {
+		int64_t excess = static_cast<int64_t>(list[p].stats.mem_total) - static_cast<int64_t>(list[p].stats.quota);
+		if(list[p].stats.entry_total > 0 and (list[victim].stats.entry_total == 0 or excess > victim_excess)) {
+			victim = p;
+			victim_excess = excess;
+		}
+	}
+	evict_from(cache, get_partition_evictor(cache, victim));
+}
+inline void enforce_quota(Cache* cache, uint16_t partition) {
+	//a partition over its quota evicts from itself alone, down to the low watermark of its quota
+	if(partition == 0) {
+		//the keys in no partition may use whatever room the others leave, so only the cache's capacity limits them
+		return;
+	}
+	auto stats = &cache->partitions->list[partition].stats;
+	if(stats->mem_total > stats->quota) {
+		uint64_t low_water = stats->quota*cache->low_water_percent/100;
+		while(stats->mem_total > low_water and stats->entry_total > 0) {
+			evict_from(cache, get_partition_evictor(cache, partition));
+			cache->maintenance_stats.inline_evict_total += 1;
+		}
+	}
+}
+inline uint64_t get_headroom_limit(const Cache* cache) {
+	//what the maintenance thread evicts the cache down to
+	return static_cast<uint64_t>(cache->mem_capacity)*(100 - cache->maintenance->headroom_percent)/100;
+}
+inline uint64_t get_wake_limit(const Cache* cache) {
+	//the maintenance thread is only woken once half the headroom is used up, or it would be woken on every set
+	return static_cast<uint64_t>(cache->mem_capacity)*(200 - cache->maintenance->headroom_percent)/200;
+}
+inline bool is_nearing_load(const Cache* cache) {
+	//whether the table is within an eighth of having to grow
+	Index entry_capacity = cache->entry_capacity;
+	Index margin = entry_capacity/8;
+	return is_exceeding_load(cache->entry_total + margin, cache->dead_total, entry_capacity);
+}
+inline void nudge_maintenance(Cache* cache) {
+	//wakes the maintenance thread if there's work for it; callers hold the lock, so is_woken is safe to touch
+	auto maintenance = cache->maintenance;
+	if(not maintenance->is_woken and (is_nearing_load(cache) or is_over_limit(cache, get_wake_limit(cache)))) {
+		maintenance->is_woken = true;
+		maintenance->wake_signal.notify_one();
+	}
+}
 inline void update_mem_size(Cache* cache, Index mem_change) {
 	//sets the mem_total of the cache and evicts if necessary
-	const auto entry_book = &cache->entry_book;
-	const auto evictor = &cache->evictor;
-	const auto mem_capacity = cache->mem_capacity;
+	//when counting the full footprint, the table alone may be over capacity, so we stop once the cache is empty
+	//once over capacity we evict down to the low watermark, so that a full cache evicts in batches
+	//rather than on nearly every set
 	cache->mem_total += mem_change;
-	while(cache->mem_total > mem_capacity) {//Evict
-		Index bookmark = get_evict_item(evictor, entry_book);
-		Entry* entry = read_book(entry_book, bookmark);
-		remove_entry(cache, entry->cur_i);
+	if(is_over_capacity(cache)) {
+		uint64_t low_water = static_cast<uint64_t>(cache->mem_capacity)*cache->low_water_percent/100;
+		if(cache->is_counting_footprint) {
+			//the rest of the footprint is added up once, since evicting barely changes it, rather than on every eviction
+			const uint64_t fixed_footprint = get_fixed_footprint(cache);
+			while(fixed_footprint + cache->key_footprint + cache->value_footprint > low_water and cache->entry_total > 0) {
+				evict_entry(cache);
+				cache->maintenance_stats.inline_evict_total += 1;
+			}
+		} else {
+			while(cache->mem_total > low_water and cache->entry_total > 0) {
+				evict_entry(cache);
+				cache->maintenance_stats.inline_evict_total += 1;
+			}
+		}
+	}
+	if(cache->maintenance != NULL) {
+		nudge_maintenance(cache);
 	}
 }
-inline void grow_cache_size(Cache* cache) {
+inline void resize_table(Cache* cache, Index new_capacity) {
+	//moves every entry into a new table of new_capacity entries, clearing out the graves on the way
+	auto start_time = get_time_ns();
 	const auto pre_capacity = cache->entry_capacity;
-	const auto new_capacity = 2*pre_capacity;
-
+	const auto policy = cache->evictor.policy;
 	const auto pre_mem_arena = cache->mem_arena;
 	const auto pre_key_hashes = get_hashes(pre_mem_arena);
 	const auto pre_bookmarks = get_bookmarks(pre_mem_arena, pre_capacity);
@@ -212,7 +788,7 @@ inline void grow_cache_size(Cache* cache) {
 	const auto pre_evict_data = get_evict_data(pre_mem_arena, pre_capacity);
 	const auto entry_book = &cache->entry_book;
 
-	auto new_mem_arena = allocate(new_capacity, cache->evictor.policy);
+	auto new_mem_arena = allocate(new_capacity, policy);
 	cache->mem_arena = new_mem_arena;
 	cache->entry_capacity = new_capacity;
 
@@ -221,44 +797,184 @@ inline void grow_cache_size(Cache* cache) {
 	const auto new_pages = get_pages(new_mem_arena, new_capacity);
 	const auto new_evict_data = get_evict_data(new_mem_arena, new_capacity);
 
-	//make sure all entries are marked as EMPTY, so they can be populated
-	mark_as_empty(new_key_hashes, get_hash_table_capacity(new_capacity));
-	memcpy(new_pages, pre_pages, sizeof(Page)*pre_capacity);
-	memcpy(new_evict_data, pre_evict_data, get_evictor_mem_size(cache->evictor.policy, pre_capacity));
-	entry_book->pages = new_pages;
-	cache->evictor.mem_arena = new_evict_data;
-
-	//rehash our entries back into the new table
-	auto entries_left = cache->entry_total;
-	for(Index i = 0; entries_left > 0; i += 1) {
-		auto key_hash = pre_key_hashes[i];
-		if(key_hash != EMPTY and key_hash != DELETED) {
-			entries_left -= 1;
-			Index key_hash = pre_key_hashes[i];
-			//find empty index
-			Index i = key_hash%new_capacity;
-			Index step_size = get_step_size(key_hash);
-			while(true) {
-				auto cur_key_hash = new_key_hashes[i];
-				if(cur_key_hash == EMPTY) {
-					break;
+	const auto pre_hash_table_capacity = get_hash_table_capacity(pre_capacity);
+	const auto new_hash_table_capacity = get_hash_table_capacity(new_capacity);
+	Index max_chain = 0;
+	uint32_t thread_total = cache->rehash_thread_total;
+	if(thread_total > pre_hash_table_capacity/REHASH_MIN_SLOTS) {
+		thread_total = pre_hash_table_capacity/REHASH_MIN_SLOTS;
+	}
+	if(thread_total <= 1) {
+		//make sure all entries are marked as EMPTY, so they can be populated
+		mark_as_empty(new_key_hashes, new_hash_table_capacity);
+		memcpy(new_pages, pre_pages, sizeof(Page)*pre_capacity);
+		memcpy(new_evict_data, pre_evict_data, get_evictor_mem_size(cache->evictor.policy, pre_capacity));
+		entry_book->pages = new_pages;
+		cache->evictor.mem_arena = new_evict_data;
+
+		//rehash our entries back into the new table
+		auto entries_left = cache->entry_total;
+		for(Index pre_i = 0; entries_left > 0; pre_i += 1) {
+			auto key_hash = pre_key_hashes[pre_i];
+			if(key_hash != EMPTY and key_hash != DELETED) {
+				entries_left -= 1;
+				//find empty index
+				Index i = key_hash%new_hash_table_capacity;
+				Index step_size = get_step_size(key_hash);
+				Index chain = 1;
+				while(true) {
+					auto cur_key_hash = new_key_hashes[i];
+					if(cur_key_hash == EMPTY) {
+						break;
+					}
+					i = (i + step_size)%new_hash_table_capacity;
+					chain += 1;
 				}
-				i = (i + step_size)%new_capacity;
+				max_chain = chain > max_chain ? chain : max_chain;
+				//write to new entry it's new location
+				auto bookmark = pre_bookmarks[pre_i];
+				Entry* entry = read_book(entry_book, bookmark);
+				entry->cur_i = i;
+
+				new_key_hashes[i] = key_hash;
+				new_bookmarks[i] = bookmark;
 			}
-			//write to new entry it's new location
-			auto bookmark = pre_bookmarks[i];
-			Entry* entry = read_book(entry_book, bookmark);
-			entry->cur_i = i;
+		}
+	} else {
+		//the same as above, split between threads: first each clears a slice of the new table and copies a slice of
+		//the pages, faulting them in in parallel, then each rehashes a range of the old table
+		run_in_parallel(thread_total, [&](uint32_t t) {
+			Index slots_per_thread = new_hash_table_capacity/thread_total;
+			Index start = t*slots_per_thread;
+			mark_as_empty(&new_key_hashes[start], t + 1 == thread_total ? new_hash_table_capacity - start : slots_per_thread);
+			Index pages_per_thread = pre_capacity/thread_total;
+			start = t*pages_per_thread;
+			memcpy(&new_pages[start], &pre_pages[start], sizeof(Page)*(t + 1 == thread_total ? pre_capacity - start : pages_per_thread));
+		});
+		memcpy(new_evict_data, pre_evict_data, get_evictor_mem_size(cache->evictor.policy, pre_capacity));
+		entry_book->pages = new_pages;
+		cache->evictor.mem_arena = new_evict_data;
 
-			new_key_hashes[i] = key_hash;
-			new_bookmarks[i] = bookmark;
+		std::vector<Index> max_chains(thread_total, 0);
+		run_in_parallel(thread_total, [&](uint32_t t) {
+			Index slots_per_thread = pre_hash_table_capacity/thread_total;
+			Index start = t*slots_per_thread;
+			Index end = t + 1 == thread_total ? pre_hash_table_capacity : start + slots_per_thread;
+			for(Index pre_i = start; pre_i < end; pre_i += 1) {
+				auto key_hash = pre_key_hashes[pre_i];
+				if(key_hash != EMPTY and key_hash != DELETED) {
+					//claim an empty index; another thread may claim the one we find first, in which case we keep probing
+					Index i = key_hash%new_hash_table_capacity;
+					Index step_size = get_step_size(key_hash);
+					Index chain = 1;
+					while(true) {
+						Index cur_key_hash = __atomic_load_n(&new_key_hashes[i], __ATOMIC_RELAXED);
+						if(cur_key_hash == EMPTY and __atomic_compare_exchange_n(&new_key_hashes[i], &cur_key_hash, key_hash, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+							break;
+						}
+						i = (i + step_size)%new_hash_table_capacity;
+						chain += 1;
+					}
+					max_chains[t] = chain > max_chains[t] ? chain : max_chains[t];
+					//the index and the entry are ours alone now, and joining the threads publishes them
+					auto bookmark = pre_bookmarks[pre_i];
+					Entry* entry = read_book(entry_book, bookmark);
+					entry->cur_i = i;
+					new_bookmarks[i] = bookmark;
+				}
+			}
+		});
+		for(Index chain : max_chains) {
+			max_chain = chain > max_chain ? chain : max_chain;
 		}
 	}
+	auto stats = &cache->table_stats;
+	Resize_record* record = &stats->resizes[stats->resize_total%RESIZE_HISTORY_TOTAL];
+	stats->resize_total += 1;
+	stats->max_probe = 0;
+	stats->max_chain = max_chain;
+	record->pre_slot_total = pre_hash_table_capacity;
+	record->slot_total = new_hash_table_capacity;
+	record->entry_total = cache->entry_total;
+	record->dead_total = cache->dead_total;
 	cache->dead_total = 0;
 
 	delete[] pre_mem_arena;
+	record->time_ns = get_time_ns();
+	record->ns = record->time_ns - start_time;
+}
+inline Index make_room_to_grow(Cache* cache) {
+	//picks the capacity the table grows to, evicting from the one we have if a bigger one wouldn't fit
+	//a set calls this before linking in its new entry, so that the entry can't be one of those evicted
+	const auto pre_capacity = cache->entry_capacity;
+	const auto policy = cache->evictor.policy;
+	auto new_capacity = 2*pre_capacity;
+	if(cache->entry_total < pre_capacity/2) {
+		//the table is mostly graves, so rehashing it at the same size is enough to clear them
+		//otherwise a cache that evicts a lot would keep doubling its table for nothing
+		new_capacity = pre_capacity;
+	} else if(cache->is_counting_footprint) {
+		auto growth = get_alloc_size(get_arena_size(new_capacity, policy)) - get_alloc_size(get_arena_size(pre_capacity, policy));
+		if(get_footprint(cache) + growth > cache->mem_capacity) {
+			//a bigger table wouldn't fit, so we make room in the one we have
+			//evicting a quarter of it now keeps us from rehashing again on the very next set
+			new_capacity = pre_capacity;
+			while(cache->entry_total > 3*(pre_capacity/4)) {
+				evict_entry(cache);
+			}
+		}
+	}
+	return new_capacity;
+}
+inline void grow_cache_size(Cache* cache) {
+	resize_table(cache, make_room_to_grow(cache));
 }
 
+void run_maintenance(Cache* cache) {
+	auto maintenance = cache->maintenance;
+	auto stats = &cache->maintenance_stats;
+	std::vector<byte*> keys;
+	std::vector<Value*> values;
+	std::unique_lock<std::mutex> guard(*maintenance->lock);
+	while(not maintenance->is_stopping) {
+		maintenance->wake_signal.wait_for(guard, std::chrono::milliseconds(MAINTENANCE_INTERVAL_MS), [maintenance] {
+			return maintenance->is_woken or maintenance->is_stopping;
+		});
+		maintenance->is_woken = false;
+		while(not maintenance->is_stopping) {
+			//a batch of work at a time, letting callers in between, until there's none left
+			bool is_idle = true;
+			if(is_nearing_load(cache)) {
+				grow_cache_size(cache);
+				stats->background_grow_total += 1;
+				is_idle = false;
+			}
+			const uint64_t limit = get_headroom_limit(cache);
+			for(Index i = 0; i < MAINTENANCE_BATCH and is_over_limit(cache, limit) and cache->entry_total > 0; i += 1) {
+				evict_entry(cache);
+				stats->background_evict_total += 1;
+				is_idle = false;
+			}
+			keys.swap(maintenance->garbage_keys);
+			values.swap(maintenance->garbage_values);
+			stats->deferred_free_total += keys.size() + values.size();
+			guard.unlock();
+			for(auto key : keys) {
+				delete[] key;
+			}
+			for(auto value : values) {
+				release_value(value);
+			}
+			is_idle = is_idle and keys.empty() and values.empty();
+			keys.clear();
+			values.clear();
+			guard.lock();
+			if(is_idle) {
+				break;
+			}
+		}
+	}
+}
 
 Cache* create_cache(Index max_mem, evictor_type policy, Hash_func hash) {
 	Index entry_capacity = INIT_ENTRY_CAPACITY;
@@ -268,6 +984,39 @@ Cache* create_cache(Index max_mem, evictor_type policy, Hash_func hash) {
 	cache->entry_capacity = entry_capacity;
 	cache->entry_total = 0;
 	cache->dead_total = 0;
+	cache->compress_threshold = 0;
+	cache->raw_total = 0;
+	cache->compress_buffer = NULL;
+	cache->compress_buffer_size = 0;
+	cache->read_buffer = NULL;
+	cache->read_buffer_size = 0;
+	memset(&cache->compression_stats, 0, sizeof(Compression_stats));
+	memset(&cache->mutation_stats, 0, sizeof(Mutation_stats));
+	cache->disk_tier = NULL;
+	cache->is_counting_footprint = false;
+	cache->key_total = 0;
+	cache->key_footprint = 0;
+	cache->value_footprint = 0;
+	cache->snapshot = NULL;
+	cache->is_snapshot_ok = true;
+	cache->log = NULL;
+	cache->log_sequence = 0;
+	cache->rehash_thread_total = 1;
+	cache->prefix_index = NULL;
+	cache->loads = NULL;
+	cache->low_water_percent = 100;
+	cache->maintenance = NULL;
+	memset(&cache->maintenance_stats, 0, sizeof(Maintenance_stats));
+	cache->linear_threshold = DEFAULT_LINEAR_THRESHOLD;
+	cache->linear = NULL;
+	cache->trace = NULL;
+	memset(&cache->trace_stats, 0, sizeof(Trace_stats));
+	cache->mrc = NULL;
+	cache->adaptive = NULL;
+	cache->partitions = NULL;
+	cache->partition_total = 0;
+	memset(&cache->table_stats, 0, sizeof(Table_stats));
+	cache->table_dump = NULL;
 	if(hash == NULL) {
 		cache->hash = &default_key_hasher;
 	} else {
@@ -280,9 +1029,22 @@ Cache* create_cache(Index max_mem, evictor_type policy, Hash_func hash) {
 	create_book(&cache->entry_book, get_pages(mem_arena, entry_capacity));
 	cache->evictor.mem_arena = get_evict_data(mem_arena, entry_capacity);
 	create_evictor(&cache->evictor, policy);
+	use_linear_index(cache);
 	return cache;
 }
 void destroy_cache(Cache* cache) {
+	if(cache->maintenance != NULL) {
+		cache_stop_maintenance(cache);
+	}
+	if(cache->snapshot != NULL) {
+		finish_snapshot(cache);
+	}
+	if(cache->log != NULL) {
+		close_mutation_log(cache->log);
+	}
+	if(cache->trace != NULL) {
+		cache_stop_trace(cache);
+	}
 	const auto hash_table_capacity = get_hash_table_capacity(cache->entry_capacity);
 	const auto key_hashes = get_hashes(cache->mem_arena);
 	const auto bookmarks = get_bookmarks(cache->mem_arena, cache->entry_capacity);
@@ -296,59 +1058,102 @@ void destroy_cache(Cache* cache) {
 			delete[] entry->key;
 			entry->key = NULL;
 			//no need to free the entry, it isn't generally allocated
-			delete[] entry->value;
+			release_value(entry->value);
 			entry->value = NULL;
 		}
 	}
+	if(cache->disk_tier != NULL) {
+		destroy_disk_tier(cache->disk_tier);
+	}
+	if(cache->prefix_index != NULL) {
+		destroy_prefix_index(cache->prefix_index);
+	}
+	delete cache->loads;
+	if(cache->linear != NULL) {
+		destroy_linear_index(cache->linear);
+	}
+	if(cache->mrc != NULL) {
+		destroy_mrc(cache->mrc);
+	}
+	if(cache->adaptive != NULL) {
+		destroy_adaptive(cache->adaptive);
+	}
+	delete cache->partitions;
+	delete cache->table_dump;
 	delete[] cache->mem_arena;
 	cache->mem_arena = NULL;
 	entry_book->pages = NULL;
+	delete[] cache->compress_buffer;
+	delete[] cache->read_buffer;
 	delete cache;
 }
 
-void cache_set(Cache* cache, Key_ptr key, Value_ptr val, Index val_size) {
-	if(val_size > cache->mem_capacity) {
-		printf("Error in call to cache_set: Value exceeds max_mem, value was %d, max was %d", val_size, cache->mem_capacity);
-		return;
-	}
+inline void set_value(Cache* cache, Key_ptr key, Index key_hash, Value* val_copy, Index stored_size) {
+	//puts a value we've already made into the table under key, whose hash has been through get_hash, taking over the reference to it
 	const auto entry_capacity = cache->entry_capacity;
 	const auto hash_table_capacity = get_hash_table_capacity(entry_capacity);
 	const auto key_hashes = get_hashes(cache->mem_arena);
 	const auto bookmarks = get_bookmarks(cache->mem_arena, cache->entry_capacity);
 	auto entry_book = &cache->entry_book;
-	auto evictor = &cache->evictor;
-
-	const auto key_hash = get_hash(cache->hash(key));
 
-	byte* val_copy = new byte[val_size];//we assume val_size is in bytes
-	memcpy(val_copy, val, val_size);
+	cache->raw_total += val_copy->raw_size == 0 ? stored_size : val_copy->raw_size;
 	//check if key is in cache
 	Index expected_i = key_hash%hash_table_capacity;
 	Index step_size = get_step_size(key_hash);
-	for(Index count = 0; count < hash_table_capacity; count += 1) {
+	Index new_i = KEY_NOT_FOUND;
+	Index chain = 0;//slots looked at to reach new_i, counting it
+	Index count = 0;
+	for(; count < hash_table_capacity; count += 1) {
 		auto cur_key_hash = key_hashes[expected_i];
 		if(cur_key_hash == EMPTY) {
 			break;
 		} else if(cur_key_hash == DELETED) {
-			cache->dead_total -= 1;//we want to ressurect this entry
-			break;
+			//the key may still be further along, but we can reuse the first grave we pass
+			if(new_i == KEY_NOT_FOUND) {
+				new_i = expected_i;
+				chain = count + 1;
+			}
 		} else if(cur_key_hash == key_hash) {
 			auto bookmark = bookmarks[expected_i];
 			Entry* entry = read_book(entry_book, bookmark);
 			if(are_keys_equal(entry->key, key)) {//found key
-				update_mem_size(cache, val_size - entry->value_size);
-				//delete previous value
-				delete[] entry->value;
+				note_probes(cache, true, count + 1);
+				Index mem_change = stored_size - entry->value_size;
+				cache->value_footprint += get_value_footprint(val_copy->capacity) - get_value_footprint(entry->value->capacity);
+				cache->raw_total -= get_raw_size(entry);
+				//delete previous value, and when it was to expire
+				drop_value(cache, entry->value);
+				forget_expiry(cache, bookmark);
 				//add new value
+				val_copy->is_retired.store(false, std::memory_order_relaxed);//a value back from the disk tier may have been retired
 				entry->value = val_copy;
-				entry->value_size = val_size;
-				touch_evict_item(evictor, bookmark, &entry->evict_item, entry_book);
+				entry->value_size = stored_size;
+				touch_evict_item(get_evictor(cache, entry), bookmark, &entry->evict_item, entry_book);
+				add_to_partition(cache, entry, mem_change, 0);
+				uint16_t partition = entry->partition;
+				//these may evict the entry itself, so they must come last
+				update_mem_size(cache, mem_change);
+				if(cache->partitions != NULL) {
+					enforce_quota(cache, partition);
+				}
 				return;
 			}
 		}
 		expected_i = (expected_i + step_size)%hash_table_capacity;
 	}
-	Index new_i = expected_i;
+	if(count == hash_table_capacity) {
+		note_probes(cache, false, hash_table_capacity);
+		note_full_traversal(cache, key);
+	} else {
+		note_probes(cache, false, count + 1);
+	}
+	if(new_i == KEY_NOT_FOUND) {
+		new_i = expected_i;
+		chain = count + 1;
+	} else {
+		cache->dead_total -= 1;//we want to ressurect this entry
+	}
+	cache->table_stats.max_chain = chain > cache->table_stats.max_chain ? chain : cache->table_stats.max_chain;
 
 	//add key at new_i
 	Key_ptr key_copy;
@@ -359,7 +1164,16 @@ void cache_set(Cache* cache, Key_ptr key, Value_ptr val, Index val_size) {
 		key_copy = reinterpret_cast<Key_ptr>(key_mem);
 	}
 	//add new value
-	update_mem_size(cache, val_size);
+	uint16_t partition = cache->partitions == NULL ? 0 : find_partition(cache, key);
+	cache->key_total += key_size;
+	cache->key_footprint += get_alloc_size(key_size);
+	cache->value_footprint += get_value_footprint(val_copy->capacity);
+	update_mem_size(cache, stored_size);
+	//the table only grows once the entry is in it, but any room it needs is made now, while the entry can't be evicted
+	Index new_capacity = 0;
+	if(is_exceeding_load(cache->entry_total + 1, cache->dead_total, entry_capacity)) {
+		new_capacity = make_room_to_grow(cache);
+	}
 	cache->entry_total += 1;
 	auto bookmark = alloc_book_page(entry_book);
 	Entry* entry = read_book(entry_book, bookmark);
@@ -367,52 +1181,1395 @@ void cache_set(Cache* cache, Key_ptr key, Value_ptr val, Index val_size) {
 	entry->cur_i = new_i;
 	entry->key = key_copy;
 	entry->key_size = key_size;
+	entry->partition = partition;
+	val_copy->is_retired.store(false, std::memory_order_relaxed);//a value back from the disk tier may have been retired
 	entry->value = val_copy;
-	entry->value_size = val_size;
-	add_evict_item(evictor, bookmark, &entry->evict_item, entry_book);
+	entry->value_size = stored_size;
+	add_to_partition(cache, entry, stored_size, 1);
+	add_evict_item(get_evictor(cache, entry), bookmark, &entry->evict_item, entry_book);
+	if(cache->prefix_index != NULL) {
+		prefix_index_insert(cache->prefix_index, entry_book, bookmark);
+	}
+	if(cache->linear != NULL and not linear_index_insert(cache->linear, get_linear_tag(key_copy, key_size), bookmark)) {
+		//the cache has outgrown scanning, so from here on it only uses the hash table
+		use_hash_table(cache);
+	}
 
 	key_hashes[new_i] = key_hash;
 	bookmarks[new_i] = bookmark;
-	if(is_exceeding_load(cache->entry_total, cache->dead_total, entry_capacity)) {
-		grow_cache_size(cache);
+	if(new_capacity != 0) {
+		cache->maintenance_stats.inline_grow_total += 1;
+		resize_table(cache, new_capacity);
+	}
+	if(cache->partitions != NULL) {
+		//this may evict the entry itself, so it must come last
+		enforce_quota(cache, partition);
 	}
 }
+inline void set_value(Cache* cache, Key_ptr key, Value* val_copy, Index stored_size) {
+	set_value(cache, key, get_hash(cache->hash(key)), val_copy, stored_size);
+}
+inline bool is_too_big_to_set(Cache* cache, Key_ptr key, Index val_size, const char* caller) {
+	if(val_size > cache->mem_capacity) {
+		printf("Error in call to %s: Value exceeds max_mem, value was %llu, max was %llu\n", caller, static_cast<unsigned long long>(val_size), static_cast<unsigned long long>(cache->mem_capacity));
+		return true;
+	}
+	if(cache->partitions != NULL) {
+		uint16_t partition = find_partition(cache, key);
+		if(partition != 0 and val_size > cache->partitions->list[partition].stats.quota) {
+			printf("Error in call to %s: Value exceeds the quota of its partition, value was %llu, quota was %llu\n", caller, static_cast<unsigned long long>(val_size), static_cast<unsigned long long>(cache->partitions->list[partition].stats.quota));
+			return true;
+		}
+	}
+	return false;
+}
+inline void put_hashed_value(Cache* cache, Key_ptr key, Index key_hash, Value* val_copy, Index stored_size) {
+	//sets a value made by one of the calls that set values, taking over the reference to it
+	//key_hash must be get_hash(cache->hash(key)), so callers that hashed ahead of time don't hash again
+	if(cache->trace != NULL) {
+		trace_op(cache->trace, TRACE_SET, key, val_copy->raw_size == 0 ? stored_size : val_copy->raw_size, false);
+	}
+	if(cache->log != NULL) {
+		cache->log_sequence += 1;
+		mutation_log_set(cache->log, cache->log_sequence, key, get_key_size(key), val_copy, stored_size);
+	}
+	if(cache->disk_tier != NULL) {
+		//any copy of key on disk is stale now
+		disk_tier_remove(cache->disk_tier, key);
+	}
+	if(cache->mrc != NULL) {
+		mrc_set(cache->mrc, key_hash, stored_size);
+	}
+	if(cache->adaptive != NULL) {
+		adaptive_set(cache->adaptive, key_hash, stored_size, cache->mem_capacity);
+	}
+	set_value(cache, key, key_hash, val_copy, stored_size);
+}
+inline void put_value(Cache* cache, Key_ptr key, Value* val_copy, Index stored_size) {
+	check_snapshot(cache);
+	put_hashed_value(cache, key, get_hash(cache->hash(key)), val_copy, stored_size);
+}
+void cache_set(Cache* cache, Key_ptr key, Value_ptr val, Index val_size) {
+	if(is_too_big_to_set(cache, key, val_size, "cache_set")) {
+		return;
+	}
+	Index stored_size;
+	Value* val_copy = make_value(cache, val, val_size, &stored_size);//we assume val_size is in bytes
+	put_value(cache, key, val_copy, stored_size);
+}
 
-Value_ptr cache_get(Cache* cache, Key_ptr key, Index* ret_val_size) {
-	const auto bookmarks = get_bookmarks(cache->mem_arena, cache->entry_capacity);
-	const auto entry_book = &cache->entry_book;
-	const auto evictor = &cache->evictor;
-
-	Index i = find_entry(cache, key);
-	if(i == KEY_NOT_FOUND) {
+Reservation* cache_set_reserve(Cache* cache, Key_ptr key, Index val_size, void** ret_buffer) {
+	if(val_size > cache->mem_capacity) {
+		printf("Error in call to cache_set_reserve: Value exceeds max_mem, value was %llu, max was %llu\n", static_cast<unsigned long long>(val_size), static_cast<unsigned long long>(cache->mem_capacity));
 		return NULL;
+	}
+	Reservation* reservation = new Reservation;
+	Index key_size = get_key_size(key);
+	reservation->key = new byte[key_size];
+	memcpy(reservation->key, key, key_size);
+	reservation->value = alloc_value(val_size);
+	*ret_buffer = reservation->value->data;
+	return reservation;
+}
+bool cache_set_commit(Cache* cache, Reservation* reservation) {
+	Key_ptr key = reinterpret_cast<Key_ptr>(reservation->key);
+	Value* value = reservation->value;
+	Index val_size = value->capacity;
+	bool is_set = not is_too_big_to_set(cache, key, val_size, "cache_set_commit");
+	if(is_set) {
+		Index stored_size;
+		value = compress_made_value(cache, value, val_size, &stored_size);
+		put_value(cache, key, value, stored_size);
 	} else {
-		auto bookmark = bookmarks[i];
-		Entry* entry = read_book(entry_book, bookmark);
-		//let the evictor know this value was accessed
-		touch_evict_item(evictor, bookmark, &entry->evict_item, entry_book);
-		*ret_val_size = entry->value_size;
-		return static_cast<Value_ptr>(entry->value);
+		release_value(value);
 	}
+	delete[] reservation->key;
+	delete reservation;
+	return is_set;
+}
+void cache_set_abort(Reservation* reservation) {
+	release_value(reservation->value);
+	delete[] reservation->key;
+	delete reservation;
 }
 
-void cache_delete(Cache* cache, Key_ptr key) {
-	Index i = find_entry(cache, key);
-	if(i != KEY_NOT_FOUND) {
-		remove_entry(cache, i);
+inline void free_with_free(void*, void* val) {
+	//the deleter of values that were allocated with malloc
+	free(val);
+}
+void cache_set_owned(Cache* cache, Key_ptr key, void* val, Index val_size, Free_func deleter, void* data) {
+	Value* value = alloc_owned_value(val, val_size, deleter == NULL ? &free_with_free : deleter, data);
+	if(is_too_big_to_set(cache, key, val_size, "cache_set_owned")) {
+		release_value(value);
+		return;
 	}
+	Index stored_size;
+	value = compress_made_value(cache, value, val_size, &stored_size);
+	put_value(cache, key, value, stored_size);
 }
 
-Index cache_space_used(Cache* cache) {
-	return cache->mem_total;
+inline bool reserve_entries(Cache* cache, Index entry_total) {
+	//grows the table once to fit entry_total entries, rather than doubling its way there
+	const Index max_capacity = HIGH_BIT/4;//the table is twice the capacity, and that must still fit in an Index
+	if(entry_total >= max_capacity) {
+		return false;
+	}
+	const auto policy = cache->evictor.policy;
+	auto new_capacity = cache->entry_capacity;
+	while(new_capacity <= entry_total) {
+		new_capacity *= 2;
+	}
+	if(new_capacity == cache->entry_capacity) {
+		return true;
+	}
+	if(cache->is_counting_footprint) {
+		auto growth = get_alloc_size(get_arena_size(new_capacity, policy)) - get_alloc_size(get_arena_size(cache->entry_capacity, policy));
+		if(get_footprint(cache) + growth > cache->mem_capacity) {
+			return false;
+		}
+	}
+	resize_table(cache, new_capacity);
+	return true;
+}
+bool cache_reserve(Cache* cache, Index entry_total) {
+	if(not reserve_entries(cache, entry_total)) {
+		printf("Error in call to cache_reserve: A table for %llu entries would not fit\n", static_cast<unsigned long long>(entry_total));
+		return false;
+	}
+	return true;
+}
+Table_stats cache_table_stats(Cache* cache) {
+	return get_table_stats(cache);
+}
+void cache_set_table_dump(Cache* cache, FILE* file, uint64_t lookup_interval) {
+	delete cache->table_dump;
+	cache->table_dump = NULL;
+	if(file != NULL and lookup_interval > 0) {
+		Table_dump* dump = new Table_dump;
+		dump->file = file;
+		dump->lookup_interval = lookup_interval;
+		dump->lookups_left = lookup_interval;
+		dump->last = get_table_stats(cache);
+		cache->table_dump = dump;
+	}
 }
 
-
-Mem_array serialize_cache(Cache* cache) {
-	const auto entry_capacity = cache->entry_capacity;
-	const auto hash_table_capacity = get_hash_table_capacity(entry_capacity);
-	const auto key_hashes = get_hashes(cache->mem_arena);
-	const auto bookmarks = get_bookmarks(cache->mem_arena, cache->entry_capacity);
+struct Bulk_value {//an item of cache_set_bulk, ready to be inserted
+	Index key_hash;
+	Value* value;//NULL if the item was too big to store
+	Index stored_size;
+};
+Index cache_set_bulk(Cache* cache, const Bulk_item* items, Index item_total, uint32_t thread_total) {
+	check_snapshot(cache);
+	//only as many entries as fit in max_mem are ever in the cache at once, and those are the last items to fit,
+	//since setting them evicts the ones before; compressed values make this an underestimate, and the table grows as usual
+	uint64_t fit_size = 0;
+	Index fit_total = 0;
+	for(Index i = item_total; i > 0 and fit_size <= cache->mem_capacity; i -= 1) {
+		if(items[i - 1].val_size <= cache->mem_capacity) {
+			fit_size += items[i - 1].val_size;
+			fit_total += fit_size <= cache->mem_capacity ? 1 : 0;
+		}
+	}
+	Index max_entry_total = fit_total;
+	if(fit_size <= cache->mem_capacity) {
+		//every item fits, so some of what's already there may stay too
+		max_entry_total = cache->entry_total + item_total;
+		max_entry_total = max_entry_total < cache->entry_total ? static_cast<Index>(-1) : max_entry_total;
+	}
+	//the reservation is only a hint; if the table can't be grown up front, it grows as usual while inserting
+	(void)reserve_entries(cache, max_entry_total);
+	if(thread_total == 0) {
+		thread_total = std::thread::hardware_concurrency();
+	}
+	if(thread_total == 0) {
+		thread_total = 1;
+	}
+	//hashing and copying values is split between threads a batch at a time, then the batch is inserted in order
+	//thread 0 is the caller, so it can use the cache's own compression buffer and stats
+	std::vector<byte*> buffers(thread_total, NULL);
+	std::vector<Index> buffer_sizes(thread_total, 0);
+	std::vector<Compression_stats> stats(thread_total);
+	memset(stats.data(), 0, sizeof(Compression_stats)*thread_total);
+	std::vector<Bulk_value> batch(item_total < BULK_BATCH_SIZE ? item_total : BULK_BATCH_SIZE);
+	Index set_total = 0;
+	for(Index batch_start = 0; batch_start < item_total; batch_start += BULK_BATCH_SIZE) {
+		Index batch_size = item_total - batch_start < BULK_BATCH_SIZE ? item_total - batch_start : BULK_BATCH_SIZE;
+		uint32_t batch_thread_total = batch_size/BULK_MIN_ITEMS < thread_total ? batch_size/BULK_MIN_ITEMS : thread_total;
+		if(batch_thread_total == 0) {
+			batch_thread_total = 1;
+		}
+		run_in_parallel(batch_thread_total, [&](uint32_t t) {
+			Index items_per_thread = batch_size/batch_thread_total;
+			Index start = t*items_per_thread;
+			Index end = t + 1 == batch_thread_total ? batch_size : start + items_per_thread;
+			byte** buffer = t == 0 ? &cache->compress_buffer : &buffers[t];
+			Index* buffer_size = t == 0 ? &cache->compress_buffer_size : &buffer_sizes[t];
+			Compression_stats* thread_stats = t == 0 ? &cache->compression_stats : &stats[t];
+			for(Index i = start; i < end; i += 1) {
+				const Bulk_item* item = &items[batch_start + i];
+				Bulk_value* prepared = &batch[i];
+				prepared->key_hash = get_hash(cache->hash(item->key));
+				prepared->value = NULL;
+				if(item->val_size <= cache->mem_capacity) {
+					prepared->value = make_value(cache->compress_threshold, item->val, item->val_size, &prepared->stored_size, buffer, buffer_size, thread_stats);
+				}
+			}
+		});
+		for(Index i = 0; i < batch_size; i += 1) {
+			const Bulk_item* item = &items[batch_start + i];
+			Bulk_value* prepared = &batch[i];
+			if(is_too_big_to_set(cache, item->key, item->val_size, "cache_set_bulk")) {
+				if(prepared->value != NULL) {
+					release_value(prepared->value);
+				}
+				continue;
+			}
+			put_hashed_value(cache, item->key, prepared->key_hash, prepared->value, prepared->stored_size);
+			set_total += 1;
+		}
+	}
+	auto cache_stats = &cache->compression_stats;
+	for(uint32_t t = 1; t < thread_total; t += 1) {
+		cache_stats->compress_total += stats[t].compress_total;
+		cache_stats->incompressible_total += stats[t].incompressible_total;
+		cache_stats->compress_ns += stats[t].compress_ns;
+		delete[] buffers[t];
+	}
+	return set_total;
+}
+
+inline Index find_or_promote(Cache* cache, Key_ptr key, Index* ret_key_hash) {
+	//like find_entry, but on a miss it checks the disk tier and brings key back into memory if it's there
+	Index i = find_entry(cache, key, ret_key_hash);
+	if(i == KEY_NOT_FOUND and cache->disk_tier != NULL) {
+		Index value_size;
+		Value* value = disk_tier_take(cache->disk_tier, key, &value_size);
+		if(value != NULL) {
+			set_value(cache, key, value, value_size);
+			//setting may have grown the table, so we look it up again
+			i = find_entry(cache, key);
+		}
+	}
+	return i;
+}
+inline bool is_noting_gets(const Cache* cache) {
+	return cache->trace != NULL or cache->mrc != NULL or cache->adaptive != NULL or cache->partitions != NULL;
+}
+inline void note_get(Cache* cache, Key_ptr key, Index i, Index key_hash) {
+	//tells the trace, the hit ratio estimator, adaptive eviction and the partitions' stats, whichever are on, about
+	//a get; i is where key was found, if it was, and key_hash is what find_entry gave us
+	const Entry* entry = NULL;
+	if(i != KEY_NOT_FOUND) {
+		const auto bookmarks = get_bookmarks(cache->mem_arena, cache->entry_capacity);
+		entry = read_book(&cache->entry_book, bookmarks[i]);
+	}
+	if(cache->trace != NULL) {
+		trace_op(cache->trace, TRACE_GET, key, entry == NULL ? 0 : get_raw_size(entry), entry != NULL);
+	}
+	if(cache->mrc != NULL) {
+		mrc_get(cache->mrc, get_key_hash(cache, key, i, key_hash), entry == NULL ? 0 : entry->value_size, entry != NULL);
+	}
+	if(cache->adaptive != NULL) {
+		auto policy = adaptive_get(cache->adaptive, get_key_hash(cache, key, i, key_hash), entry == NULL ? 0 : entry->value_size, entry != NULL, cache->mem_capacity);
+		if(policy != cache->evictor.policy) {
+			uint64_t start_time = get_time_ns();
+			Index item_total = cache->partitions == NULL ? cache->entry_total : cache->partitions->list[0].stats.entry_total;
+			switch_evictor(&cache->evictor, policy, &cache->entry_book, item_total);
+			note_adaptive_switch(cache->adaptive, policy, get_time_ns() - start_time);
+		}
+	}
+	if(cache->partitions != NULL) {
+		auto stats = &cache->partitions->list[entry == NULL ? find_partition(cache, key) : entry->partition].stats;
+		if(entry == NULL) {
+			stats->miss_total += 1;
+		} else {
+			stats->hit_total += 1;
+		}
+	}
+}
+
+Value_ptr cache_get(Cache* cache, Key_ptr key, Index* ret_val_size) {
+	const auto entry_book = &cache->entry_book;
+
+	//promoting may grow the table, so we get its bookmarks afterwards
+	Index key_hash;
+	Index i = find_or_promote(cache, key, &key_hash);
+	if(is_noting_gets(cache)) {
+		note_get(cache, key, i, key_hash);
+	}
+	const auto bookmarks = get_bookmarks(cache->mem_arena, cache->entry_capacity);
+	if(i == KEY_NOT_FOUND) {
+		return NULL;
+	} else {
+		auto bookmark = bookmarks[i];
+		Entry* entry = read_book(entry_book, bookmark);
+		//let the evictor know this value was accessed
+		touch_evict_item(get_evictor(cache, entry), bookmark, &entry->evict_item, entry_book);
+		if(entry->value->raw_size == 0) {
+			*ret_val_size = entry->value_size;
+			return static_cast<Value_ptr>(entry->value->data);
+		}
+		Index raw_size = entry->value->raw_size;
+		byte* buffer = reserve_buffer(&cache->read_buffer, &cache->read_buffer_size, raw_size);
+		if(not decompress_value(cache, entry, buffer)) {
+			printf("Error in call to cache_get: Compressed value is corrupt, key was %s\n", key);
+			return NULL;
+		}
+		*ret_val_size = raw_size;
+		return static_cast<Value_ptr>(buffer);
+	}
+}
+
+bool cache_get_into(Cache* cache, Key_ptr key, void* buffer, Index buffer_size, Index* ret_val_size) {
+	const auto entry_book = &cache->entry_book;
+
+	//promoting may grow the table, so we get its bookmarks afterwards
+	Index key_hash;
+	Index i = find_or_promote(cache, key, &key_hash);
+	if(is_noting_gets(cache)) {
+		note_get(cache, key, i, key_hash);
+	}
+	const auto bookmarks = get_bookmarks(cache->mem_arena, cache->entry_capacity);
+	if(i == KEY_NOT_FOUND) {
+		return false;
+	}
+	auto bookmark = bookmarks[i];
+	Entry* entry = read_book(entry_book, bookmark);
+	Index raw_size = get_raw_size(entry);
+	*ret_val_size = raw_size;
+	if(raw_size > buffer_size) {
+		return false;
+	}
+	touch_evict_item(get_evictor(cache, entry), bookmark, &entry->evict_item, entry_book);
+	if(entry->value->raw_size == 0) {
+		memcpy(buffer, entry->value->data, raw_size);
+		return true;
+	}
+	return decompress_value(cache, entry, static_cast<byte*>(buffer));
+}
+
+inline Value* pin_entry(Cache* cache, Index i, Value_ptr* ret_val, Index* ret_val_size) {
+	const auto bookmarks = get_bookmarks(cache->mem_arena, cache->entry_capacity);
+	const auto entry_book = &cache->entry_book;
+
+	auto bookmark = bookmarks[i];
+	Entry* entry = read_book(entry_book, bookmark);
+	touch_evict_item(get_evictor(cache, entry), bookmark, &entry->evict_item, entry_book);
+	Value* value = entry->value;
+	if(value->raw_size != 0) {
+		//a compressed value can't be read in place, so the pin gets its own decompressed copy
+		Value* raw_value = alloc_value(value->raw_size);
+		if(not decompress_value(cache, entry, raw_value->data)) {
+			release_value(raw_value);
+			return NULL;
+		}
+		*ret_val = static_cast<Value_ptr>(raw_value->data);
+		*ret_val_size = value->raw_size;
+		return raw_value;
+	}
+	retain_value(value);
+	*ret_val = static_cast<Value_ptr>(value->data);
+	*ret_val_size = entry->value_size;
+	return value;
+}
+Value* cache_pin(Cache* cache, Key_ptr key, Value_ptr* ret_val, Index* ret_val_size) {
+	Index key_hash;
+	Index i = find_or_promote(cache, key, &key_hash);
+	if(is_noting_gets(cache)) {
+		note_get(cache, key, i, key_hash);
+	}
+	if(i == KEY_NOT_FOUND) {
+		return NULL;
+	}
+	return pin_entry(cache, i, ret_val, ret_val_size);
+}
+
+void cache_unpin(Value* value) {
+	release_value(value);
+}
+
+//a mutation finds its entry, reserves room for the value's new size, writes into it and then accounts for the change
+struct Mutation {
+	Index i;
+	Index key_hash;
+	Entry* entry;
+	const byte* data;//the value as it was, decompressed if it was compressed
+	Index raw_size;
+	Index stored_size;
+	bool was_compressed;
+	Value* old_value;//the value as it was, if the change is being made to a copy; it's let go of once the change is done
+};
+inline bool begin_mutation(Cache* cache, Key_ptr key, Mutation* ret_mutation) {
+	check_snapshot(cache);
+	Index key_hash;
+	Index i = find_or_promote(cache, key, &key_hash);
+	if(i == KEY_NOT_FOUND) {
+		cache->mutation_stats.failed_total += 1;
+		return false;
+	}
+	const auto bookmarks = get_bookmarks(cache->mem_arena, cache->entry_capacity);
+	Entry* entry = read_book(&cache->entry_book, bookmarks[i]);
+	ret_mutation->i = i;
+	ret_mutation->key_hash = get_key_hash(cache, key, i, key_hash);
+	ret_mutation->entry = entry;
+	ret_mutation->raw_size = get_raw_size(entry);
+	ret_mutation->stored_size = entry->value_size;
+	ret_mutation->was_compressed = entry->value->raw_size != 0;
+	ret_mutation->old_value = NULL;
+	if(not ret_mutation->was_compressed) {
+		ret_mutation->data = entry->value->data;
+		return true;
+	}
+	byte* buffer = reserve_buffer(&cache->read_buffer, &cache->read_buffer_size, ret_mutation->raw_size);
+	if(not decompress_value(cache, entry, buffer)) {
+		printf("Error in call to mutate a value: Compressed value is corrupt, key was %s\n", key);
+		cache->mutation_stats.failed_total += 1;
+		return false;
+	}
+	ret_mutation->data = buffer;
+	return true;
+}
+inline byte* reserve_mutation(Cache* cache, Mutation* mutation, uint64_t new_size, const char* caller) {
+	//returns where to write the value's new_size bytes, with its old bytes already there, or NULL if it can't be that big
+	Entry* entry = mutation->entry;
+	uint64_t limit = cache->mem_capacity;
+	if(entry->partition != 0 and cache->partitions->list[entry->partition].stats.quota < limit) {
+		limit = cache->partitions->list[entry->partition].stats.quota;
+	}
+	if(new_size > limit) {
+		printf("Error in call to %s: Value would exceed max_mem or the quota of its partition, value would be %llu, limit was %llu\n", caller, static_cast<unsigned long long>(new_size), static_cast<unsigned long long>(limit));
+		cache->mutation_stats.failed_total += 1;
+		return NULL;
+	}
+	Value* value = entry->value;
+	//only the cache holds a reference to a value no one has pinned, and while there's no snapshot, no other thread reads it
+	if(not mutation->was_compressed and new_size <= value->capacity and cache->snapshot == NULL and value->refs.load(std::memory_order_acquire) == 1) {
+		cache->mutation_stats.in_place_total += 1;
+		return value->data;
+	}
+	uint64_t capacity = new_size + new_size/2;
+	if(capacity > limit) {
+		capacity = new_size > mutation->raw_size ? new_size : mutation->raw_size;
+	}
+	Value* new_value = alloc_value(capacity);
+	memcpy(new_value->data, mutation->data, mutation->raw_size < new_size ? mutation->raw_size : new_size);
+	cache->value_footprint += get_value_footprint(new_value->capacity) - get_value_footprint(value->capacity);
+	entry->value = new_value;
+	mutation->old_value = value;
+	cache->mutation_stats.copy_total += 1;
+	return new_value->data;
+}
+inline void finish_mutation(Cache* cache, Key_ptr key, Mutation* mutation, Index new_size) {
+	Entry* entry = mutation->entry;
+	Index stored_size = new_size;
+	if(mutation->was_compressed) {
+		//no one else has seen the uncompressed copy, so it can go straight away
+		uint64_t raw_footprint = get_value_footprint(entry->value->capacity);
+		entry->value = compress_made_value(cache, entry->value, new_size, &stored_size);
+		cache->value_footprint += get_value_footprint(entry->value->capacity) - raw_footprint;
+	}
+	if(mutation->old_value != NULL) {
+		//this waits until now, in case the caller's bytes were in it
+		drop_value(cache, mutation->old_value);
+	}
+	entry->value_size = stored_size;
+	cache->raw_total += new_size;
+	cache->raw_total -= mutation->raw_size;
+	if(cache->log != NULL) {
+		cache->log_sequence += 1;
+		mutation_log_set(cache->log, cache->log_sequence, key, entry->key_size, entry->value, stored_size);
+	}
+	if(cache->trace != NULL) {
+		trace_op(cache->trace, TRACE_SET, key, new_size, false);
+	}
+	if(cache->mrc != NULL) {
+		mrc_set(cache->mrc, mutation->key_hash, stored_size);
+	}
+	if(cache->adaptive != NULL) {
+		adaptive_set(cache->adaptive, mutation->key_hash, stored_size, cache->mem_capacity);
+	}
+	const auto bookmarks = get_bookmarks(cache->mem_arena, cache->entry_capacity);
+	touch_evict_item(get_evictor(cache, entry), bookmarks[mutation->i], &entry->evict_item, &cache->entry_book);
+	Index mem_change = stored_size - mutation->stored_size;
+	add_to_partition(cache, entry, mem_change, 0);
+	uint16_t partition = entry->partition;
+	//these may evict the entry itself, so they must come last
+	update_mem_size(cache, mem_change);
+	if(cache->partitions != NULL) {
+		enforce_quota(cache, partition);
+	}
+}
+
+constexpr Index MAX_INTEGER_SIZE = 20;//"-9223372036854775808"
+inline bool parse_integer(const byte* data, Index size, int64_t* ret_value) {
+	if(size == 0 or size > MAX_INTEGER_SIZE) {
+		return false;
+	}
+	bool is_negative = data[0] == '-';
+	Index start = is_negative ? 1 : 0;
+	if(start == size) {
+		return false;
+	}
+	//accumulated negatively, since there's one more negative integer than positive ones
+	int64_t value = 0;
+	for(Index i = start; i < size; i += 1) {
+		if(data[i] < '0' or data[i] > '9') {
+			return false;
+		}
+		if(__builtin_mul_overflow(value, 10, &value) or __builtin_sub_overflow(value, data[i] - '0', &value)) {
+			return false;
+		}
+	}
+	if(not is_negative and value == INT64_MIN) {
+		return false;
+	}
+	*ret_value = is_negative ? value : -value;
+	return true;
+}
+inline bool add_to_integer(Cache* cache, Key_ptr key, int64_t delta, bool is_subtracting, int64_t* ret_value, const char* caller) {
+	Mutation mutation;
+	if(not begin_mutation(cache, key, &mutation)) {
+		return false;
+	}
+	int64_t value;
+	if(not parse_integer(mutation.data, mutation.raw_size, &value)) {
+		printf("Error in call to %s: Value is not a decimal integer, key was %s\n", caller, key);
+		cache->mutation_stats.failed_total += 1;
+		return false;
+	}
+	bool is_overflowing = is_subtracting ? __builtin_sub_overflow(value, delta, &value) : __builtin_add_overflow(value, delta, &value);
+	if(is_overflowing) {
+		printf("Error in call to %s: Result does not fit in 64 bits, key was %s\n", caller, key);
+		cache->mutation_stats.failed_total += 1;
+		return false;
+	}
+	char digits[MAX_INTEGER_SIZE + 1];
+	Index size = snprintf(digits, sizeof(digits), "%lld", static_cast<long long>(value));
+	byte* data = reserve_mutation(cache, &mutation, size, caller);
+	if(data == NULL) {
+		return false;
+	}
+	memcpy(data, digits, size);
+	finish_mutation(cache, key, &mutation, size);
+	*ret_value = value;
+	return true;
+}
+bool cache_incr(Cache* cache, Key_ptr key, int64_t delta, int64_t* ret_value) {
+	return add_to_integer(cache, key, delta, false, ret_value, "cache_incr");
+}
+bool cache_decr(Cache* cache, Key_ptr key, int64_t delta, int64_t* ret_value) {
+	return add_to_integer(cache, key, delta, true, ret_value, "cache_decr");
+}
+
+bool cache_append(Cache* cache, Key_ptr key, Value_ptr val, Index val_size) {
+	Mutation mutation;
+	if(not begin_mutation(cache, key, &mutation)) {
+		return false;
+	}
+	uint64_t new_size = static_cast<uint64_t>(mutation.raw_size) + val_size;
+	byte* data = reserve_mutation(cache, &mutation, new_size, "cache_append");
+	if(data == NULL) {
+		return false;
+	}
+	memcpy(data + mutation.raw_size, val, val_size);
+	finish_mutation(cache, key, &mutation, new_size);
+	return true;
+}
+bool cache_prepend(Cache* cache, Key_ptr key, Value_ptr val, Index val_size) {
+	Mutation mutation;
+	if(not begin_mutation(cache, key, &mutation)) {
+		return false;
+	}
+	uint64_t new_size = static_cast<uint64_t>(mutation.raw_size) + val_size;
+	byte* data = reserve_mutation(cache, &mutation, new_size, "cache_prepend");
+	if(data == NULL) {
+		return false;
+	}
+	memmove(data + val_size, data, mutation.raw_size);
+	memcpy(data, val, val_size);
+	finish_mutation(cache, key, &mutation, new_size);
+	return true;
+}
+
+bool cache_write_range(Cache* cache, Key_ptr key, Index offset, Value_ptr val, Index val_size) {
+	Mutation mutation;
+	if(not begin_mutation(cache, key, &mutation)) {
+		return false;
+	}
+	uint64_t end = static_cast<uint64_t>(offset) + val_size;
+	uint64_t new_size = end > mutation.raw_size ? end : mutation.raw_size;
+	byte* data = reserve_mutation(cache, &mutation, new_size, "cache_write_range");
+	if(data == NULL) {
+		return false;
+	}
+	if(offset > mutation.raw_size) {
+		memset(data + mutation.raw_size, 0, offset - mutation.raw_size);
+	}
+	memcpy(data + offset, val, val_size);
+	finish_mutation(cache, key, &mutation, new_size);
+	return true;
+}
+
+Mutation_stats cache_mutation_stats(Cache* cache) {
+	return cache->mutation_stats;
+}
+
+inline Value* take_load_result(Load* load, Value_ptr* ret_val, Index* ret_val_size) {
+	//pins the result of a finished load for one of its callers, who then leaves it
+	Value* value = load->value;
+	if(value != NULL) {
+		retain_value(value);
+		*ret_val = static_cast<Value_ptr>(value->data);
+		*ret_val_size = load->value_size;
+	}
+	load->waiter_total -= 1;
+	if(load->waiter_total == 0) {
+		if(value != NULL) {
+			release_value(value);
+		}
+		delete load;
+	}
+	return value;
+}
+Value* cache_get_or_load(Cache* cache, std::mutex* lock, Key_ptr key, Load_func loader, void* data, uint64_t ttl_ms, uint64_t stale_ms, Value_ptr* ret_val, Index* ret_val_size) {
+	//lock guards the cache, and is only let go of while we wait for a load or run the loader
+	std::unique_lock<std::mutex> guard;
+	if(lock != NULL) {
+		guard = std::unique_lock<std::mutex>(*lock);
+	}
+	if(cache->loads == NULL) {
+		cache->loads = new Load_table;
+	}
+	auto loads = cache->loads;
+	if(ttl_ms != 0 and cache->disk_tier != NULL) {
+		printf("Error in call to cache_get_or_load: Entries of a cache with a disk tier can't expire\n");
+		return NULL;
+	}
+	uint64_t now = get_time_ns();
+	bool is_stale = false;
+	Index key_hash;
+	Index i = find_or_promote(cache, key, &key_hash);
+	if(i != KEY_NOT_FOUND) {
+		const auto bookmarks = get_bookmarks(cache->mem_arena, cache->entry_capacity);
+		auto expiry = loads->expiries.find(bookmarks[i]);
+		if(expiry == loads->expiries.end() or now < expiry->second.fresh_until) {
+			if(is_noting_gets(cache)) {
+				note_get(cache, key, i, key_hash);
+			}
+			return pin_entry(cache, i, ret_val, ret_val_size);
+		}
+		is_stale = now < expiry->second.stale_until;
+	}
+	if(is_noting_gets(cache)) {
+		//an expired entry counts as a miss, even when it's handed out stale, since neither the trace nor the
+		//estimator knows about expiry
+		note_get(cache, key, KEY_NOT_FOUND, key_hash);
+	}
+	std::string key_string(key);
+	auto in_flight = loads->in_flight.find(key_string);
+	if(in_flight != loads->in_flight.end()) {
+		if(is_stale) {
+			//someone is already refreshing the entry, so we make do with what's there
+			return pin_entry(cache, i, ret_val, ret_val_size);
+		}
+		if(lock == NULL) {
+			//only the loader itself could be here, and it can't wait on itself
+			printf("Error in call to cache_get_or_load: Key is already being loaded, key was %s\n", key);
+			return NULL;
+		}
+		Load* load = in_flight->second;
+		load->waiter_total += 1;
+		load->is_done_signal.wait(guard, [load] {return load->is_done;});
+		return take_load_result(load, ret_val, ret_val_size);
+	}
+
+	//we are the first to miss, so we run the loader and everyone who misses meanwhile waits for us
+	Load* load = new Load;
+	load->is_done = false;
+	load->value = NULL;
+	load->value_size = 0;
+	load->waiter_total = 1;
+	loads->in_flight[key_string] = load;
+	if(lock != NULL) {
+		guard.unlock();
+	}
+	Index loaded_size = 0;
+	void* loaded = loader(data, key, &loaded_size);
+	if(lock != NULL) {
+		guard.lock();
+	}
+	if(loaded != NULL) {
+		//the loaded value is taken over rather than copied, and the load holds a reference of its own to hand out,
+		//whether or not the value fits, and even if the cache keeps a compressed copy instead
+		Value* value = alloc_owned_value(loaded, loaded_size, &free_with_free, NULL);
+		retain_value(value);
+		load->value = value;
+		load->value_size = loaded_size;
+		if(is_too_big_to_set(cache, key, loaded_size, "cache_get_or_load")) {
+			release_value(value);
+		} else {
+			Index stored_size;
+			value = compress_made_value(cache, value, loaded_size, &stored_size);
+			put_value(cache, key, value, stored_size);
+			i = find_entry(cache, key);
+			if(i != KEY_NOT_FOUND and ttl_ms != 0) {
+				const auto bookmarks = get_bookmarks(cache->mem_arena, cache->entry_capacity);
+				uint64_t fresh_until = get_time_ns() + ttl_ms*1000000;
+				loads->expiries[bookmarks[i]] = {fresh_until, fresh_until + stale_ms*1000000};
+				update_mem_size(cache, 0);
+			}
+		}
+	}
+	loads->in_flight.erase(key_string);
+	load->is_done = true;
+	load->is_done_signal.notify_all();
+	return take_load_result(load, ret_val, ret_val_size);
+}
+
+//a front cache belongs to one thread, and only ever touches the cache with its lock held; what it reads without the
+//lock is the values it holds references to, whose is_retired the cache sets when it lets go of them
+constexpr Index DEFAULT_FRONT_SLOTS = 256;
+constexpr uint8_t MAX_FRONT_HITS = 3;//how many misses a key that keeps being hit can hold off
+struct Front_slot {
+	byte* key;//NULL if the slot is empty
+	Index key_size;
+	Value* version;//the value the cache holds for key, compressed or not, which tells us when it's stale
+	Value* pin;//the value to hand out: the same as version, unless that's compressed
+	Index pin_size;
+	uint8_t hits;
+	uint32_t candidate;//a tag of the last key to miss in the slot without taking it; a key must miss twice to take it
+};
+struct cache_front {//Definition of Front
+	Cache* cache;
+	std::mutex* lock;
+	Index slot_mask;
+	std::vector<Front_slot> slots;
+	Front_stats stats;
+};
+inline void clear_front_slot(Front_slot* slot) {
+	delete[] slot->key;
+	release_value(slot->version);
+	release_value(slot->pin);
+	slot->key = NULL;
+}
+Front* cache_create_front(Cache* cache, std::mutex* lock, Index slot_total) {
+	Index size = 1;
+	while(size < (slot_total == 0 ? DEFAULT_FRONT_SLOTS : slot_total)) {
+		size *= 2;
+	}
+	Front* front = new Front;
+	front->cache = cache;
+	front->lock = lock;
+	front->slot_mask = size - 1;
+	front->slots.resize(size);
+	for(auto& slot : front->slots) {
+		slot.key = NULL;
+		slot.candidate = 0;
+	}
+	memset(&front->stats, 0, sizeof(Front_stats));
+	return front;
+}
+void cache_destroy_front(Front* front) {
+	for(auto& slot : front->slots) {
+		if(slot.key != NULL) {
+			clear_front_slot(&slot);
+		}
+	}
+	delete front;
+}
+Value* cache_front_pin(Front* front, Key_ptr key, Value_ptr* ret_val, Index* ret_val_size) {
+	Cache* cache = front->cache;
+	Index key_size = get_key_size(key);
+	//the cache's hash may be poor in its low bits, so it's remixed before picking a slot
+	uint64_t mixed_hash = static_cast<uint64_t>(cache->hash(key))*0x9E3779B97F4A7C15ull;
+	Front_slot* slot = &front->slots[(mixed_hash>>32)&front->slot_mask];
+	uint32_t tag = static_cast<uint32_t>(mixed_hash) | 1;
+	bool is_match = slot->key != NULL and slot->key_size == key_size and memcmp(slot->key, key, key_size) == 0;
+	if(is_match) {
+		if(not slot->version->is_retired.load(std::memory_order_acquire)) {
+			front->stats.hit_total += 1;
+			slot->hits += slot->hits < MAX_FRONT_HITS ? 1 : 0;
+			retain_value(slot->pin);
+			*ret_val = static_cast<Value_ptr>(slot->pin->data);
+			*ret_val_size = slot->pin_size;
+			return slot->pin;
+		}
+		front->stats.stale_total += 1;
+		clear_front_slot(slot);
+	}
+	front->stats.miss_total += 1;
+
+	std::unique_lock<std::mutex> guard;
+	if(front->lock != NULL) {
+		guard = std::unique_lock<std::mutex>(*front->lock);
+	}
+	Index table_key_hash;
+	Index i = find_or_promote(cache, key, &table_key_hash);
+	if(is_noting_gets(cache)) {
+		note_get(cache, key, i, table_key_hash);
+	}
+	if(i == KEY_NOT_FOUND) {
+		return NULL;
+	}
+	Value* pin = pin_entry(cache, i, ret_val, ret_val_size);
+	if(pin == NULL) {
+		return NULL;
+	}
+	const auto bookmarks = get_bookmarks(cache->mem_arena, cache->entry_capacity);
+	Value* version = read_book(&cache->entry_book, bookmarks[i])->value;
+	retain_value(version);
+	if(front->lock != NULL) {
+		guard.unlock();
+	}
+
+	if(slot->key != NULL and slot->hits > 0) {
+		//the key in the slot has been hit since it last held off a miss, so it stays
+		slot->hits -= 1;
+		release_value(version);
+		return pin;
+	}
+	if(slot->candidate != tag and not is_match) {
+		//most keys that miss are never used again, so a key only takes a slot the second time in a row it misses there
+		slot->candidate = tag;
+		release_value(version);
+		return pin;
+	}
+	if(slot->key != NULL) {
+		clear_front_slot(slot);
+	}
+	slot->key = new byte[key_size];
+	memcpy(slot->key, key, key_size);
+	slot->key_size = key_size;
+	slot->version = version;
+	retain_value(pin);
+	slot->pin = pin;
+	slot->pin_size = *ret_val_size;
+	slot->hits = 0;
+	front->stats.admit_total += 1;
+	return pin;
+}
+Front_stats cache_front_stats(Front* front) {
+	return front->stats;
+}
+
+Index cache_scan(Cache* cache, Index cursor, Index count, Scan_func func, void* data) {
+	//walks the entries in the order of their pages rather than of the table, since growing the table moves
+	//entries to new slots but leaves every one on its page; the cursor is just the next page to look at
+	//nothing is touched, so the evictor never knows we were here
+	const auto entry_book = &cache->entry_book;
+	count = count == 0 ? 1 : count;
+	Index max_visit_total = count < static_cast<Index>(-1)/SCAN_MAX_VISITS ? count*SCAN_MAX_VISITS : static_cast<Index>(-1);
+	Index visit_total = 0;
+	Index found_total = 0;
+	while(cursor < entry_book->end and found_total < count and visit_total < max_visit_total) {
+		Bookmark bookmark = cursor;
+		cursor += 1;
+		visit_total += 1;
+		//func may have changed the cache, so nothing about the table is kept between pages
+		const auto hash_table_capacity = get_hash_table_capacity(cache->entry_capacity);
+		const auto key_hashes = get_hashes(cache->mem_arena);
+		const auto bookmarks = get_bookmarks(cache->mem_arena, cache->entry_capacity);
+		Entry* entry = read_book(entry_book, bookmark);
+		//a free page holds the next free page where an entry holds cur_i, so a page is only live if the table points back at it
+		Index i = entry->cur_i;
+		if(i >= hash_table_capacity or key_hashes[i] == EMPTY or key_hashes[i] == DELETED or bookmarks[i] != bookmark) {
+			continue;
+		}
+		found_total += 1;
+		if(entry->value->raw_size == 0) {
+			func(data, entry->key, static_cast<Value_ptr>(entry->value->data), entry->value_size);
+			continue;
+		}
+		Index raw_size = entry->value->raw_size;
+		byte* buffer = reserve_buffer(&cache->read_buffer, &cache->read_buffer_size, raw_size);
+		if(not decompress_value(cache, entry, buffer)) {
+			printf("Error in call to cache_scan: Compressed value is corrupt, key was %s\n", entry->key);
+			continue;
+		}
+		func(data, entry->key, static_cast<Value_ptr>(buffer), raw_size);
+	}
+	return cursor < entry_book->end ? cursor : 0;
+}
+
+bool cache_set_prefix_index(Cache* cache, bool is_on) {
+	if(not is_on) {
+		if(cache->prefix_index != NULL) {
+			destroy_prefix_index(cache->prefix_index);
+			cache->prefix_index = NULL;
+		}
+		return true;
+	}
+	if(cache->disk_tier != NULL) {
+		printf("Error in call to cache_set_prefix_index: The cache has a disk tier, whose keys can't be indexed\n");
+		return false;
+	}
+	if(cache->prefix_index == NULL) {
+		const auto hash_table_capacity = get_hash_table_capacity(cache->entry_capacity);
+		const auto key_hashes = get_hashes(cache->mem_arena);
+		const auto bookmarks = get_bookmarks(cache->mem_arena, cache->entry_capacity);
+		cache->prefix_index = create_prefix_index();
+		for(Index i = 0; i < hash_table_capacity; i += 1) {
+			auto key_hash = key_hashes[i];
+			if(key_hash != EMPTY and key_hash != DELETED) {
+				prefix_index_insert(cache->prefix_index, &cache->entry_book, bookmarks[i]);
+			}
+		}
+		update_mem_size(cache, 0);
+	}
+	return true;
+}
+inline bool find_prefix(Cache* cache, Key_ptr prefix, std::vector<Bookmark>* ret_bookmarks, const char* caller) {
+	if(cache->prefix_index == NULL) {
+		printf("Error in call to %s: The cache has no prefix index\n", caller);
+		return false;
+	}
+	auto prefix_bytes = reinterpret_cast<const byte*>(prefix);
+	prefix_index_find(cache->prefix_index, &cache->entry_book, prefix_bytes, get_key_size(prefix) - 1, ret_bookmarks);
+	return true;
+}
+Index cache_scan_prefix(Cache* cache, Key_ptr prefix, Scan_func func, void* data) {
+	std::vector<Bookmark> found;
+	if(not find_prefix(cache, prefix, &found, "cache_scan_prefix")) {
+		return 0;
+	}
+	const auto entry_book = &cache->entry_book;
+	Index prefix_size = get_key_size(prefix) - 1;
+	Index visit_total = 0;
+	for(Bookmark bookmark : found) {
+		//like cache_scan, func may change the cache, so each entry is checked to still be live and still match
+		const auto hash_table_capacity = get_hash_table_capacity(cache->entry_capacity);
+		const auto key_hashes = get_hashes(cache->mem_arena);
+		const auto bookmarks = get_bookmarks(cache->mem_arena, cache->entry_capacity);
+		Entry* entry = read_book(entry_book, bookmark);
+		Index i = entry->cur_i;
+		if(i >= hash_table_capacity or key_hashes[i] == EMPTY or key_hashes[i] == DELETED or bookmarks[i] != bookmark) {
+			continue;
+		}
+		if(entry->key_size <= prefix_size or memcmp(entry->key, prefix, prefix_size) != 0) {
+			continue;
+		}
+		visit_total += 1;
+		if(entry->value->raw_size == 0) {
+			func(data, entry->key, static_cast<Value_ptr>(entry->value->data), entry->value_size);
+			continue;
+		}
+		Index raw_size = entry->value->raw_size;
+		byte* buffer = reserve_buffer(&cache->read_buffer, &cache->read_buffer_size, raw_size);
+		if(not decompress_value(cache, entry, buffer)) {
+			printf("Error in call to cache_scan_prefix: Compressed value is corrupt, key was %s\n", entry->key);
+			continue;
+		}
+		func(data, entry->key, static_cast<Value_ptr>(buffer), raw_size);
+	}
+	return visit_total;
+}
+Index cache_delete_prefix(Cache* cache, Key_ptr prefix) {
+	check_snapshot(cache);
+	std::vector<Bookmark> found;
+	if(not find_prefix(cache, prefix, &found, "cache_delete_prefix")) {
+		return 0;
+	}
+	const auto entry_book = &cache->entry_book;
+	for(Bookmark bookmark : found) {
+		Entry* entry = read_book(entry_book, bookmark);
+		if(cache->trace != NULL) {
+			trace_op(cache->trace, TRACE_DELETE, entry->key, 0, false);
+		}
+		if(cache->mrc != NULL) {
+			mrc_delete(cache->mrc, get_hashes(cache->mem_arena)[entry->cur_i]);
+		}
+		if(cache->adaptive != NULL) {
+			adaptive_delete(cache->adaptive, get_hashes(cache->mem_arena)[entry->cur_i]);
+		}
+		if(cache->log != NULL) {
+			cache->log_sequence += 1;
+			mutation_log_delete(cache->log, cache->log_sequence, entry->key, entry->key_size);
+		}
+		remove_entry(cache, entry->cur_i);
+	}
+	return found.size();
+}
+
+void cache_set_compression(Cache* cache, Index threshold) {
+	//values already in the cache keep whatever form they were stored in
+	cache->compress_threshold = threshold;
+}
+
+Compression_stats cache_compression_stats(Cache* cache) {
+	Compression_stats stats = cache->compression_stats;
+	stats.raw_bytes = cache->raw_total;
+	stats.stored_bytes = cache->mem_total;
+	return stats;
+}
+
+bool cache_delete(Cache* cache, Key_ptr key) {
+	check_snapshot(cache);
+	if(cache->trace != NULL) {
+		trace_op(cache->trace, TRACE_DELETE, key, 0, false);
+	}
+	if(cache->log != NULL) {
+		cache->log_sequence += 1;
+		mutation_log_delete(cache->log, cache->log_sequence, key, get_key_size(key));
+	}
+	Index key_hash;
+	Index i = find_entry(cache, key, &key_hash);
+	if(cache->mrc != NULL) {
+		mrc_delete(cache->mrc, get_key_hash(cache, key, i, key_hash));
+	}
+	if(cache->adaptive != NULL) {
+		adaptive_delete(cache->adaptive, get_key_hash(cache, key, i, key_hash));
+	}
+	if(i != KEY_NOT_FOUND) {
+		remove_entry(cache, i);
+		return true;
+	} else if(cache->disk_tier != NULL) {
+		return disk_tier_remove(cache->disk_tier, key);
+	}
+	return false;
+}
+
+bool cache_set_disk_tier(Cache* cache, const char* dir, uint64_t capacity) {
+	if(cache->disk_tier != NULL) {
+		printf("Error in call to cache_set_disk_tier: The cache already has a disk tier\n");
+		return false;
+	}
+	if(cache->prefix_index != NULL) {
+		//the disk tier's keys can't be indexed, so cache_delete_prefix would leave them to be promoted back
+		printf("Error in call to cache_set_disk_tier: The cache has a prefix index\n");
+		return false;
+	}
+	if(cache->loads != NULL and not cache->loads->expiries.empty()) {
+		//entries lose their expiry when they're evicted, so they'd come back from disk never to expire
+		printf("Error in call to cache_set_disk_tier: The cache has entries that expire\n");
+		return false;
+	}
+	cache->disk_tier = create_disk_tier(dir, capacity);
+	return cache->disk_tier != NULL;
+}
+
+void cache_flush_disk_tier(Cache* cache) {
+	if(cache->disk_tier != NULL) {
+		disk_tier_flush(cache->disk_tier);
+	}
+}
+
+Disk_tier_stats cache_disk_tier_stats(Cache* cache) {
+	if(cache->disk_tier == NULL) {
+		Disk_tier_stats stats;
+		memset(&stats, 0, sizeof(Disk_tier_stats));
+		return stats;
+	}
+	return get_disk_tier_stats(cache->disk_tier);
+}
+
+Index cache_space_used(Cache* cache) {
+	if(cache->is_counting_footprint) {
+		uint64_t footprint = get_footprint(cache);
+		return footprint > static_cast<Index>(-1) ? static_cast<Index>(-1) : static_cast<Index>(footprint);
+	}
+	return cache->mem_total;
+}
+
+void cache_set_footprint_mode(Cache* cache, bool is_on) {
+	cache->is_counting_footprint = is_on;
+	update_mem_size(cache, 0);
+}
+
+Memory_report cache_memory_report(Cache* cache) {
+	const auto entry_capacity = cache->entry_capacity;
+	const auto policy = cache->evictor.policy;
+	Memory_report report;
+	report.value_bytes = cache->mem_total;
+	report.value_overhead = cache->value_footprint - cache->mem_total;
+	report.key_bytes = cache->key_total;
+	report.key_overhead = cache->key_footprint - cache->key_total;
+	report.table_bytes = (2*sizeof(Index))*get_hash_table_capacity(entry_capacity);
+	report.page_bytes = sizeof(Page)*entry_capacity;
+	report.evictor_bytes = get_evictor_mem_size(policy, entry_capacity);
+	report.buffer_bytes = get_alloc_size(cache->compress_buffer_size) + get_alloc_size(cache->read_buffer_size);
+	report.prefix_index_bytes = cache->prefix_index == NULL ? 0 : get_prefix_index_size(cache->prefix_index);
+	report.load_bytes = cache->loads == NULL ? 0 : get_load_table_size(cache->loads);
+	report.cache_bytes = get_alloc_size(sizeof(Cache)) + get_alloc_size(get_arena_size(entry_capacity, policy)) - get_arena_size(entry_capacity, policy);
+	if(cache->linear != NULL) {
+		report.cache_bytes += get_alloc_size(get_linear_index_size(cache->linear));
+	}
+	report.trace_bytes = cache->trace == NULL ? 0 : get_trace_size(cache->trace);
+	report.mrc_bytes = cache->mrc == NULL ? 0 : get_mrc_size(cache->mrc);
+	report.adaptive_bytes = cache->adaptive == NULL ? 0 : get_adaptive_size(cache->adaptive);
+	report.partition_bytes = cache->partitions == NULL ? 0 : get_partitions_size(cache->partitions);
+	report.total = get_footprint(cache);
+	report.capacity = cache->mem_capacity;
+	report.is_counting_footprint = cache->is_counting_footprint;
+	return report;
+}
+bool cache_start_maintenance(Cache* cache, std::mutex* lock, uint32_t headroom_percent) {
+	if(cache->maintenance != NULL) {
+		printf("Error in call to cache_start_maintenance: The cache already has a maintenance thread\n");
+		return false;
+	} else if(lock == NULL) {
+		printf("Error in call to cache_start_maintenance: A lock is required, since the thread works on the cache between calls\n");
+		return false;
+	}
+	Maintenance* maintenance = new Maintenance;
+	maintenance->lock = lock;
+	maintenance->is_woken = false;
+	maintenance->is_stopping = false;
+	maintenance->headroom_percent = headroom_percent > 100 ? 100 : headroom_percent;
+	{
+		std::lock_guard<std::mutex> guard(*lock);
+		cache->maintenance = maintenance;
+	}
+	maintenance->worker = std::thread(run_maintenance, cache);
+	return true;
+}
+void cache_stop_maintenance(Cache* cache) {
+	Maintenance* maintenance = cache->maintenance;
+	if(maintenance == NULL) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> guard(*maintenance->lock);
+		maintenance->is_stopping = true;
+		maintenance->wake_signal.notify_one();
+	}
+	maintenance->worker.join();
+	std::lock_guard<std::mutex> guard(*maintenance->lock);
+	for(auto key : maintenance->garbage_keys) {
+		delete[] key;
+	}
+	for(auto value : maintenance->garbage_values) {
+		release_value(value);
+	}
+	cache->maintenance = NULL;
+	delete maintenance;
+}
+Maintenance_stats cache_maintenance_stats(Cache* cache) {
+	return cache->maintenance_stats;
+}
+void cache_set_linear_threshold(Cache* cache, Index entry_total) {
+	if(cache->linear != NULL) {
+		use_hash_table(cache);
+	}
+	cache->linear_threshold = entry_total > MAX_LINEAR_CAPACITY ? MAX_LINEAR_CAPACITY : entry_total;
+	if(cache->entry_total < cache->linear_threshold) {
+		use_linear_index(cache);
+	}
+}
+void cache_set_low_watermark(Cache* cache, uint32_t percent) {
+	cache->low_water_percent = percent > 100 ? 100 : percent;
+}
+bool cache_start_trace(Cache* cache, const char* path, uint32_t ring_records) {
+	if(cache->trace != NULL) {
+		printf("Error in call to cache_start_trace: Cache is already being traced\n");
+		return false;
+	}
+	cache->trace = open_trace(path, ring_records);
+	if(cache->trace == NULL) {
+		return false;
+	}
+	//the ring is allocated up front, so in footprint mode starting a trace may evict
+	update_mem_size(cache, 0);
+	return true;
+}
+bool cache_stop_trace(Cache* cache) {
+	if(cache->trace == NULL) {
+		return false;
+	}
+	bool is_ok = close_trace(cache->trace, &cache->trace_stats);
+	cache->trace = NULL;
+	return is_ok;
+}
+Trace_stats cache_trace_stats(Cache* cache) {
+	if(cache->trace != NULL) {
+		return get_trace_stats(cache->trace);
+	}
+	return cache->trace_stats;
+}
+void cache_set_mrc(Cache* cache, uint32_t max_sampled_keys) {
+	if(cache->mrc != NULL) {
+		destroy_mrc(cache->mrc);
+		cache->mrc = NULL;
+	}
+	if(max_sampled_keys != 0) {
+		cache->mrc = create_mrc(max_sampled_keys);
+	}
+}
+void cache_estimate_hit_ratios(Cache* cache, const uint64_t* capacities, double* ret_hit_ratios, uint32_t capacity_total) {
+	for(uint32_t i = 0; i < capacity_total; i += 1) {
+		ret_hit_ratios[i] = cache->mrc == NULL ? 0 : mrc_estimate_hit_ratio(cache->mrc, capacities[i]);
+	}
+}
+Mrc_stats cache_mrc_stats(Cache* cache) {
+	if(cache->mrc == NULL) {
+		Mrc_stats stats;
+		memset(&stats, 0, sizeof(Mrc_stats));
+		return stats;
+	}
+	return get_mrc_stats(cache->mrc);
+}
+bool cache_set_adaptive(Cache* cache, const evictor_type* policies, uint32_t policy_total, uint32_t sample_period, uint32_t window_gets) {
+	if(not is_list_policy(cache->evictor.policy)) {
+		printf("Error in call to cache_set_adaptive: The cache's policy keeps no list to move to another policy\n");
+		return false;
+	}
+	for(uint32_t i = 0; i < policy_total; i += 1) {
+		if(not is_list_policy(policies[i])) {
+			printf("Error in call to cache_set_adaptive: Policy %ld keeps no list to move the cache's entries to\n", policies[i]);
+			return false;
+		}
+	}
+	if(cache->adaptive != NULL) {
+		destroy_adaptive(cache->adaptive);
+		cache->adaptive = NULL;
+	}
+	if(policy_total != 0) {
+		cache->adaptive = create_adaptive(policies, policy_total, cache->evictor.policy, sample_period, window_gets);
+	}
+	return true;
+}
+Adaptive_stats cache_adaptive_stats(Cache* cache) {
+	if(cache->adaptive == NULL) {
+		Adaptive_stats stats;
+		memset(&stats, 0, sizeof(Adaptive_stats));
+		stats.policy = cache->evictor.policy;
+		return stats;
+	}
+	return get_adaptive_stats(cache->adaptive);
+}
+uint32_t cache_add_partition(Cache* cache, const char* prefix, Index quota, evictor_type policy) {
+	if(not is_list_policy(policy)) {
+		printf("Error in call to cache_add_partition: A partition can't use RR\n");
+		return 0;
+	}
+	//everything is checked before the cache is touched, so that a failed first call leaves it without partitions
+	Index rest_quota = cache->mem_capacity;
+	if(cache->partitions != NULL) {
+		const auto& list = cache->partitions->list;
+		if(list.size() > MAX_PARTITIONS) {
+			printf("Error in call to cache_add_partition: The cache already has %u partitions\n", MAX_PARTITIONS);
+			return 0;
+		}
+		for(const Partition& partition : list) {
+			if(&partition != &list[0] and partition.prefix == prefix) {
+				printf("Error in call to cache_add_partition: There is already a partition for %s\n", prefix);
+				return 0;
+			}
+		}
+		rest_quota = list[0].stats.quota;
+	}
+	if(quota > rest_quota) {
+		printf("Error in call to cache_add_partition: Quota exceeds what the other partitions leave of max_mem, quota was %llu, what's left was %llu\n", static_cast<unsigned long long>(quota), static_cast<unsigned long long>(rest_quota));
+		return 0;
+	}
+	if(cache->partitions == NULL) {
+		//everything so far is in partition 0
+		cache->partitions = new Partitions;
+		Partition partition;
+		partition.evictor.policy = cache->evictor.policy;
+		memset(&partition.stats, 0, sizeof(Partition_stats));
+		partition.stats.quota = cache->mem_capacity;
+		partition.stats.mem_total = cache->mem_total;
+		partition.stats.entry_total = cache->entry_total;
+		cache->partitions->list.push_back(partition);
+	}
+	auto& list = cache->partitions->list;
+	Partition partition;
+	partition.prefix = prefix;
+	partition.evictor.mem_arena = NULL;//list policies have no data of their own
+	create_evictor(&partition.evictor, policy);
+	memset(&partition.stats, 0, sizeof(Partition_stats));
+	partition.stats.quota = quota;
+	list.push_back(partition);
+	list[0].stats.quota -= quota;
+	uint16_t new_partition = list.size() - 1;
+	cache->partition_total = new_partition;
+
+	//keys already in the cache move over, from partition 0 or from a partition with a shorter prefix
+	const auto hash_table_capacity = get_hash_table_capacity(cache->entry_capacity);
+	const auto key_hashes = get_hashes(cache->mem_arena);
+	const auto bookmarks = get_bookmarks(cache->mem_arena, cache->entry_capacity);
+	const auto entry_book = &cache->entry_book;
+	for(Index i = 0; i < hash_table_capacity; i += 1) {
+		auto key_hash = key_hashes[i];
+		if(key_hash != EMPTY and key_hash != DELETED) {
+			Entry* entry = read_book(entry_book, bookmarks[i]);
+			if(find_partition(cache, entry->key) == new_partition) {
+				remove_evict_item(get_evictor(cache, entry), bookmarks[i], &entry->evict_item, entry_book);
+				add_to_partition(cache, entry, -entry->value_size, -1);
+				entry->partition = new_partition;
+				add_to_partition(cache, entry, entry->value_size, 1);
+				add_evict_item(get_evictor(cache, entry), bookmarks[i], &entry->evict_item, entry_book);
+			}
+		}
+	}
+	enforce_quota(cache, new_partition);
+	return new_partition;
+}
+Partition_stats cache_partition_stats(Cache* cache, uint32_t partition) {
+	if(cache->partitions == NULL or partition >= cache->partitions->list.size()) {
+		Partition_stats stats;
+		memset(&stats, 0, sizeof(Partition_stats));
+		if(partition == 0) {
+			stats.quota = cache->mem_capacity;
+			stats.mem_total = cache->mem_total;
+			stats.entry_total = cache->entry_total;
+		}
+		return stats;
+	}
+	return cache->partitions->list[partition].stats;
+}
+void cache_set_rehash_threads(Cache* cache, uint32_t thread_total) {
+	cache->rehash_thread_total = thread_total == 0 ? std::thread::hardware_concurrency() : thread_total;
+}
+
+
+//a snapshot, or what serialize_cache returns, is this header, then the Cache, its arena, and last its keys and values
+//the Cache is written as it is in memory, so the header is how we know it was written by a build that lays it out the same
+constexpr uint64_t SNAPSHOT_MAGIC = 0x50414E5348434143ull;//"CACHSNAP"
+//bumped whenever what's written changes meaning without changing its size
+//2: the default hash folds its high half into its low on 32 bit builds too, so a table written before sits its keys
+//in slots the hash no longer leads to
+constexpr uint32_t SNAPSHOT_VERSION = 2;
+struct Snapshot_header {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t index_size;//sizeof(Index)
+	uint64_t cache_size;//sizeof(Cache), which changes whenever a field is added to it
+};
+constexpr uint64_t SNAPSHOT_CACHE_OFFSET = sizeof(Snapshot_header);
+constexpr uint64_t SNAPSHOT_ARENA_OFFSET = sizeof(Snapshot_header) + sizeof(Cache);
+
+inline Snapshot_header make_snapshot_header() {
+	Snapshot_header header;
+	header.magic = SNAPSHOT_MAGIC;
+	header.version = SNAPSHOT_VERSION;
+	header.index_size = sizeof(Index);
+	header.cache_size = sizeof(Cache);
+	return header;
+}
+inline bool check_snapshot_header(const Snapshot_header* header, const char* caller, const char* name) {
+	if(header->magic != SNAPSHOT_MAGIC) {
+		printf("Error in call to %s: %s is not a snapshot of a cache\n", caller, name);
+		return false;
+	} else if(header->version != SNAPSHOT_VERSION) {
+		printf("Error in call to %s: %s was written in format %u, but this build reads %u\n", caller, name, header->version, SNAPSHOT_VERSION);
+		return false;
+	} else if(header->index_size != sizeof(Index)) {
+		printf("Error in call to %s: %s was written with %u byte indexes, but this build uses %u\n", caller, name, header->index_size, static_cast<uint32_t>(sizeof(Index)));
+		return false;
+	} else if(header->cache_size != sizeof(Cache)) {
+		printf("Error in call to %s: %s was written by a build whose cache is %llu bytes, but this build's is %llu\n", caller, name, static_cast<unsigned long long>(header->cache_size), static_cast<unsigned long long>(sizeof(Cache)));
+		return false;
+	}
+	return true;
+}
+
+Mem_array serialize_cache(Cache* cache) {
+	const auto entry_capacity = cache->entry_capacity;
+	const auto hash_table_capacity = get_hash_table_capacity(entry_capacity);
+	const auto key_hashes = get_hashes(cache->mem_arena);
+	const auto bookmarks = get_bookmarks(cache->mem_arena, cache->entry_capacity);
 	const auto entry_book = &cache->entry_book;
 	const auto evictor = &cache->evictor;
 
@@ -420,15 +2577,16 @@ Mem_array serialize_cache(Cache* cache) {
 	auto book_size = sizeof(Page)*entry_capacity;
 	auto evictor_size = get_evictor_mem_size(evictor->policy, entry_capacity);
 
-	auto key_mem_size = 0;
-	auto value_mem_size = cache->mem_total;
+	Index key_mem_size = 0;
 	auto entry_total = cache->entry_total;
+	//every value is stored behind its raw_size, so compressed values survive the trip
+	auto value_mem_size = cache->mem_total + sizeof(Index)*entry_total;
 
 	auto entries_left = entry_total;
 	for(Index i = 0; entries_left > 0; i += 1) {
 		auto key_hash = key_hashes[i];
 		if(key_hash != EMPTY and key_hash != DELETED) {
-			Entry* entry = read_book(entry_book, i);
+			Entry* entry = read_book(entry_book, bookmarks[i]);
 			entries_left -= 1;
 			key_mem_size += entry->key_size;
 		}
@@ -438,14 +2596,17 @@ Mem_array serialize_cache(Cache* cache) {
 	auto string_space_size = key_mem_size + value_mem_size;
 
 	Mem_array ret;
-	ret.size = sizeof(Cache) + mem_arena_size + string_space_size;
+	ret.size = SNAPSHOT_ARENA_OFFSET + mem_arena_size + string_space_size;
 	ret.data = new byte[ret.size];//--allocation here
 
-	byte* mem_cache = static_cast<byte*>(ret.data);
-	Cache* cache_copy = static_cast<Cache*>(ret.data);
-	byte* mem_arena_copy = mem_cache + sizeof(Cache);
-	byte* string_space = mem_cache + sizeof(Cache) + mem_arena_size;
+	byte* mem = static_cast<byte*>(ret.data);
+	byte* mem_cache = mem + SNAPSHOT_CACHE_OFFSET;
+	Cache* cache_copy = reinterpret_cast<Cache*>(mem_cache);
+	byte* mem_arena_copy = mem + SNAPSHOT_ARENA_OFFSET;
+	byte* string_space = mem + SNAPSHOT_ARENA_OFFSET + mem_arena_size;
 
+	Snapshot_header header = make_snapshot_header();
+	memcpy(mem, &header, sizeof(Snapshot_header));
 	memcpy(mem_cache, cache, sizeof(Cache));
 	// memset(mem_arena_copy, 'a', mem_arena_size);
 	memcpy(mem_arena_copy, cache->mem_arena, mem_arena_size);
@@ -453,6 +2614,23 @@ Mem_array serialize_cache(Cache* cache) {
 	//replace all pointers with relative pointers
 	auto entry_book_copy = &cache_copy->entry_book;
 	cache_copy->mem_arena = NULL;
+	cache_copy->compress_buffer = NULL;
+	cache_copy->compress_buffer_size = 0;
+	cache_copy->read_buffer = NULL;
+	cache_copy->read_buffer_size = 0;
+	cache_copy->disk_tier = NULL;//the disk tier isn't part of the snapshot
+	cache_copy->snapshot = NULL;
+	cache_copy->log = NULL;
+	cache_copy->prefix_index = NULL;//nor is the prefix index, which a loaded cache can turn back on
+	cache_copy->loads = NULL;//nor are expiry times
+	cache_copy->maintenance = NULL;
+	cache_copy->linear = NULL;
+	cache_copy->trace = NULL;
+	cache_copy->mrc = NULL;
+	cache_copy->adaptive = NULL;
+	cache_copy->partitions = NULL;
+	cache_copy->table_dump = NULL;
+	cache_copy->hash = NULL;//a function pointer doesn't survive into another process, so the caller gives it back
 	entry_book_copy->pages = get_pages(mem_arena_copy, entry_capacity);
 	cache_copy->evictor.mem_arena = NULL;
 
@@ -475,13 +2653,14 @@ Mem_array serialize_cache(Cache* cache) {
 				string_space_end += key_size;
 			}
 			{//copy value to string space
-				byte* value = entry_copy->value;
+				byte* value = entry_copy->value->data;
 				Index value_size = entry_copy->value_size;
-				byte* value_copy = &string_space[string_space_end];
+				memcpy(&string_space[string_space_end], &entry_copy->value->raw_size, sizeof(Index));
+				byte* value_copy = &string_space[string_space_end + sizeof(Index)];
 				memcpy(value_copy, value, value_size);
 				//store a relative pointer instead
-				entry_copy->value = reinterpret_cast<byte*>(string_space_end);
-				string_space_end += value_size;
+				entry_copy->value = reinterpret_cast<Value*>(string_space_end);
+				string_space_end += sizeof(Index) + value_size;
 			}
 		}
 	}
@@ -490,65 +2669,511 @@ Mem_array serialize_cache(Cache* cache) {
 	return ret;
 }
 
-cache_type deserialize_cache(Mem_array arr) {
-	byte* mem_cache = static_cast<byte*>(arr.data);
-	Cache* cache_copy = static_cast<Cache*>(arr.data);
-	byte* mem_arena_copy = mem_cache + sizeof(Cache);
+constexpr uint64_t RESTORE_WINDOW_SIZE = 1<<20;//how much of a snapshot's strings a restoring thread reads at once
+constexpr Index RESTORE_MIN_SLOTS = 1<<14;//fewer slots per thread than this isn't worth a thread
 
-	const auto entry_capacity = cache_copy->entry_capacity;
-	const auto hash_table_capacity = get_hash_table_capacity(entry_capacity);
-	const auto key_hashes_copy = get_hashes(mem_arena_copy);
-	const auto bookmarks_copy = get_bookmarks(mem_arena_copy, entry_capacity);
-	const auto evictor_copy = &cache_copy->evictor;
-
-	const auto hash_table_size = (2*sizeof(Index))*hash_table_capacity;
-	auto book_size = sizeof(Page)*entry_capacity;
-	auto evictor_size = get_evictor_mem_size(evictor_copy->policy, entry_capacity);
+inline bool read_all(int fd, byte* buffer, uint64_t size, uint64_t offset) {
+	while(size > 0) {
+		ssize_t read_size = pread(fd, buffer, size, offset);
+		if(read_size <= 0) {
+			return false;
+		}
+		buffer += read_size;
+		size -= read_size;
+		offset += read_size;
+	}
+	return true;
+}
 
-	auto mem_arena_size = hash_table_size + book_size + evictor_size;
-	// auto string_space_size = key_mem_size + value_mem_size;
+struct Restore_part {
+	Cache* cache;//the restored cache, whose arena is already in place
+	Index slot_start;
+	Index slot_end;
+	Index slot_done;//every entry before this has its key and value allocated
+	const byte* string_space;//the strings, if the whole snapshot is in memory
+	int fd;//otherwise the file they're read from, starting at string_offset
+	uint64_t string_offset;
+	uint64_t value_footprint;//of the values restored, which are allocated without the room to grow their originals may have had
+	bool is_ok;
+};
+void restore_entries(Restore_part* part) {
+	//replaces the relative pointers of every entry in our share of the table with keys and values of their own
+	//each thread allocates its own share, so they come from its own malloc arena and are faulted in in parallel
+	Cache* cache = part->cache;
+	const auto key_hashes = get_hashes(cache->mem_arena);
+	const auto bookmarks = get_bookmarks(cache->mem_arena, cache->entry_capacity);
+	std::vector<byte> window;
+	uint64_t window_start = 0;
+	uint64_t window_end = 0;
+	for(Index i = part->slot_start; i < part->slot_end; i += 1) {
+		part->slot_done = i;
+		auto key_hash = key_hashes[i];
+		if(key_hash == EMPTY or key_hash == DELETED) continue;
+		Entry* entry = read_book(&cache->entry_book, bookmarks[i]);
+		uint64_t key_start = reinterpret_cast<uint_ptr>(entry->key);
+		uint64_t value_start = reinterpret_cast<uint_ptr>(entry->value);
+		const byte* key;
+		const byte* value_mem;
+		if(part->string_space != NULL) {
+			key = &part->string_space[key_start];
+			value_mem = &part->string_space[value_start];
+		} else {
+			//entries are written in table order, so our strings are one contiguous run that we read a window at a time
+			uint64_t start = key_start < value_start ? key_start : value_start;
+			uint64_t end = key_start + entry->key_size;
+			if(value_start + sizeof(Index) + entry->value_size > end) {
+				end = value_start + sizeof(Index) + entry->value_size;
+			}
+			if(start < window_start or end > window_end) {
+				uint64_t size = end - start > RESTORE_WINDOW_SIZE ? end - start : RESTORE_WINDOW_SIZE;
+				window.resize(size);
+				ssize_t read_size = pread(part->fd, window.data(), size, part->string_offset + start);
+				if(read_size < 0 or static_cast<uint64_t>(read_size) < end - start) {
+					if(read_size < 0 or not read_all(part->fd, window.data(), end - start, part->string_offset + start)) {
+						part->is_ok = false;
+						return;
+					}
+					read_size = end - start;
+				}
+				window_start = start;
+				window_end = start + read_size;
+			}
+			key = &window[key_start - window_start];
+			value_mem = &window[value_start - window_start];
+		}
+		auto new_key = new byte[entry->key_size];
+		memcpy(new_key, key, entry->key_size);
+		auto new_value = alloc_value(entry->value_size);
+		memcpy(&new_value->raw_size, value_mem, sizeof(Index));
+		memcpy(new_value->data, value_mem + sizeof(Index), entry->value_size);
+		part->value_footprint += get_value_footprint(entry->value_size);
+		//store absolute pointers instead
+		entry->key = reinterpret_cast<Key_ptr>(new_key);
+		entry->value = new_value;
+	}
+	part->slot_done = part->slot_end;
+	part->is_ok = true;
+}
 
-	byte* string_space = mem_cache + sizeof(Cache) + mem_arena_size;
+Cache* restore_cache(const Cache* cache_copy, const byte* mem, int fd, Hash_func hash, uint32_t thread_total) {
+	//rebuilds a cache from the layout serialize_cache writes, either all in memory at mem or in the file fd
+	//the header has already been checked
+	const auto entry_capacity = cache_copy->entry_capacity;
+	const auto hash_table_capacity = get_hash_table_capacity(entry_capacity);
+	const auto mem_arena_size = get_arena_size(entry_capacity, cache_copy->evictor.policy);
+	if(thread_total == 0) {
+		thread_total = std::thread::hardware_concurrency();
+	}
+	if(thread_total > hash_table_capacity/RESTORE_MIN_SLOTS) {
+		thread_total = hash_table_capacity/RESTORE_MIN_SLOTS;
+	}
+	if(thread_total == 0) {
+		thread_total = 1;
+	}
 
 	Cache* new_cache = new Cache;
 	byte* new_mem_arena = new byte[mem_arena_size];
-
 	memcpy(new_cache, cache_copy, sizeof(Cache));
-	memcpy(new_mem_arena, mem_arena_copy, mem_arena_size);
+
+	//the arena is copied in page aligned slices, so that each thread faults in its own pages
+	bool is_ok = true;
+	uint64_t slice_size = ((mem_arena_size/thread_total + 4095)/4096)*4096;
+	std::vector<uint8_t> is_copied(thread_total, true);//not vector<bool>, whose bits the threads would share
+	run_in_parallel(thread_total, [&](uint32_t t) {
+		uint64_t start = t*slice_size;
+		uint64_t end = start + slice_size < mem_arena_size ? start + slice_size : mem_arena_size;
+		if(start >= end) return;
+		if(mem != NULL) {
+			memcpy(&new_mem_arena[start], &mem[SNAPSHOT_ARENA_OFFSET + start], end - start);
+		} else if(not read_all(fd, &new_mem_arena[start], end - start, SNAPSHOT_ARENA_OFFSET + start)) {
+			is_copied[t] = false;
+		}
+	});
+	for(uint32_t t = 0; t < thread_total; t += 1) {
+		is_ok = is_ok and is_copied[t];
+	}
+	if(not is_ok) {
+		delete[] new_mem_arena;
+		delete new_cache;
+		return NULL;
+	}
 
 	//replace all pointers with absolute pointers
 	auto new_entry_book = &new_cache->entry_book;
 	new_cache->mem_arena = new_mem_arena;
 	new_entry_book->pages = get_pages(new_mem_arena, entry_capacity);
 	new_cache->evictor.mem_arena = get_evict_data(new_mem_arena, entry_capacity);
+	new_cache->snapshot = NULL;
+	new_cache->is_snapshot_ok = true;
+	new_cache->log = NULL;
+	new_cache->prefix_index = NULL;
+	new_cache->loads = NULL;
+	new_cache->maintenance = NULL;
+	new_cache->linear = NULL;
+	new_cache->trace = NULL;
+	new_cache->mrc = NULL;
+	new_cache->adaptive = NULL;
+	new_cache->partitions = NULL;
+	memset(&new_cache->trace_stats, 0, sizeof(Trace_stats));
+	memset(&new_cache->table_stats, 0, sizeof(Table_stats));
+	new_cache->table_dump = NULL;
+	new_cache->hash = hash == NULL ? &default_key_hasher : hash;
 
+	//the table is split between the threads by slot, since the strings were written in slot order
+	std::vector<Restore_part> parts(thread_total);
+	Index slots_per_part = hash_table_capacity/thread_total;
+	for(uint32_t t = 0; t < thread_total; t += 1) {
+		auto part = &parts[t];
+		part->cache = new_cache;
+		part->slot_start = t*slots_per_part;
+		part->slot_end = t + 1 == thread_total ? hash_table_capacity : (t + 1)*slots_per_part;
+		part->slot_done = part->slot_start;
+		part->string_space = mem == NULL ? NULL : &mem[SNAPSHOT_ARENA_OFFSET + mem_arena_size];
+		part->fd = fd;
+		part->string_offset = SNAPSHOT_ARENA_OFFSET + mem_arena_size;
+		part->value_footprint = 0;
+		part->is_ok = false;
+	}
+	run_in_parallel(thread_total, [&](uint32_t t) {
+		restore_entries(&parts[t]);
+	});
+	new_cache->value_footprint = 0;
+	for(uint32_t t = 0; t < thread_total; t += 1) {
+		is_ok = is_ok and parts[t].is_ok;
+		new_cache->value_footprint += parts[t].value_footprint;
+	}
+	if(not is_ok) {
+		//free what was restored before whatever went wrong; everything else still holds relative pointers
+		const auto key_hashes = get_hashes(new_mem_arena);
+		const auto bookmarks = get_bookmarks(new_mem_arena, entry_capacity);
+		for(auto& part : parts) {
+			for(Index i = part.slot_start; i < part.slot_done; i += 1) {
+				auto key_hash = key_hashes[i];
+				if(key_hash != EMPTY and key_hash != DELETED) {
+					Entry* entry = read_book(new_entry_book, bookmarks[i]);
+					delete[] reinterpret_cast<byte*>(const_cast<char*>(entry->key));
+					release_value(entry->value);
+				}
+			}
+		}
+		delete[] new_mem_arena;
+		delete new_cache;
+		return NULL;
+	}
+	if(new_cache->partition_total != 0) {
+		//the partitions' evictors weren't kept, so their entries go back to the cache's own
+		const auto key_hashes = get_hashes(new_mem_arena);
+		const auto bookmarks = get_bookmarks(new_mem_arena, entry_capacity);
+		for(Index i = 0; i < hash_table_capacity; i += 1) {
+			auto key_hash = key_hashes[i];
+			if(key_hash != EMPTY and key_hash != DELETED) {
+				Entry* entry = read_book(new_entry_book, bookmarks[i]);
+				if(entry->partition != 0) {
+					entry->partition = 0;
+					add_evict_item(&new_cache->evictor, bookmarks[i], &entry->evict_item, new_entry_book);
+				}
+			}
+		}
+		new_cache->partition_total = 0;
+	}
+	if(new_cache->entry_total < new_cache->linear_threshold and new_cache->entry_capacity <= MAX_LINEAR_REBUILD_CAPACITY) {
+		use_linear_index(new_cache);
+	}
+	return new_cache;
+}
 
-	auto entries_left = cache_copy->entry_total;
-	for(Index i = 0; entries_left > 0; i += 1) {
-		auto key_hash = key_hashes_copy[i];
+cache_type deserialize_cache(Mem_array arr, Hash_func hash) {
+	return deserialize_cache_with_threads(arr, hash, 1);
+}
+cache_type deserialize_cache_with_threads(Mem_array arr, Hash_func hash, uint32_t thread_total) {
+	const byte* mem = static_cast<const byte*>(arr.data);
+	if(arr.size < SNAPSHOT_ARENA_OFFSET) {
+		printf("Error in call to deserialize_cache: The array is too small to hold a cache\n");
+		return NULL;
+	}
+	Snapshot_header header;
+	memcpy(&header, mem, sizeof(Snapshot_header));
+	if(not check_snapshot_header(&header, "deserialize_cache", "The array")) {
+		return NULL;
+	}
+	Cache cache_copy;
+	memcpy(&cache_copy, &mem[SNAPSHOT_CACHE_OFFSET], sizeof(Cache));
+	return restore_cache(&cache_copy, mem, -1, hash, thread_total);
+}
+
+
+inline bool write_snapshot(Snapshot* snapshot) {
+	//writes the same layout as serialize_cache, but from the copy of the arena we took at the start
+	//the strings go first, after room for the header and the arena, since writing them is what gives us their relative pointers
+	Cache* cache_copy = &snapshot->cache_copy;
+	FILE* file = snapshot->file;
+	const auto entry_capacity = cache_copy->entry_capacity;
+	const auto hash_table_capacity = get_hash_table_capacity(entry_capacity);
+	const auto mem_arena_size = get_arena_size(entry_capacity, cache_copy->evictor.policy);
+	const auto key_hashes = get_hashes(snapshot->mem_arena);
+	const auto bookmarks = get_bookmarks(snapshot->mem_arena, entry_capacity);
+	Book entry_book = cache_copy->entry_book;
+	entry_book.pages = get_pages(snapshot->mem_arena, entry_capacity);
+
+	if(fseek(file, SNAPSHOT_ARENA_OFFSET + mem_arena_size, SEEK_SET) != 0) {
+		return false;
+	}
+	uint_ptr string_space_end = 0;
+	for(Index i = 0; i < hash_table_capacity; i += 1) {
+		auto key_hash = key_hashes[i];
 		if(key_hash != EMPTY and key_hash != DELETED) {
-			entries_left -= 1;
-			auto bookmark = bookmarks_copy[i];
-			Entry* new_entry = read_book(new_entry_book, bookmark);
-			{//copy key into memory
-				auto key = new_entry->key;
-				Key_ptr actual_key = reinterpret_cast<Key_ptr>(&string_space[reinterpret_cast<uint_ptr>(key)]);
-				auto key_size = new_entry->key_size;
-				auto new_key = new byte[key_size];
-				memcpy(new_key, actual_key, key_size);
-				//store a absolute pointer to the key
-				new_entry->key = reinterpret_cast<Key_ptr>(new_key);
+			Entry* entry = read_book(&entry_book, bookmarks[i]);
+			Value* value = entry->value;
+			bool is_written = fwrite(entry->key, 1, entry->key_size, file) == entry->key_size;
+			is_written = is_written and fwrite(&value->raw_size, sizeof(Index), 1, file) == 1;
+			is_written = is_written and fwrite(value->data, 1, entry->value_size, file) == entry->value_size;
+			if(not is_written) {
+				return false;
 			}
-			{//copy value into memory
-				byte* actual_value = &string_space[reinterpret_cast<uint_ptr>(new_entry->value)];
-				Index value_size = new_entry->value_size;
-				auto new_value = new byte[value_size];
-				memcpy(new_value, actual_value, value_size);
-				//store a absolute pointer to the value
-				new_entry->value = new_value;
+			//store relative pointers instead
+			entry->key = reinterpret_cast<Key_ptr>(string_space_end);
+			string_space_end += entry->key_size;
+			entry->value = reinterpret_cast<Value*>(string_space_end);
+			string_space_end += sizeof(Index) + entry->value_size;
+		}
+	}
+	cache_copy->mem_arena = NULL;
+	cache_copy->entry_book.pages = NULL;
+	cache_copy->evictor.mem_arena = NULL;
+	cache_copy->hash = NULL;
+	if(fseek(file, 0, SEEK_SET) != 0) {
+		return false;
+	}
+	Snapshot_header header = make_snapshot_header();
+	bool is_written = fwrite(&header, sizeof(Snapshot_header), 1, file) == 1;
+	is_written = is_written and fwrite(cache_copy, sizeof(Cache), 1, file) == 1;
+	is_written = is_written and fwrite(snapshot->mem_arena, 1, mem_arena_size, file) == mem_arena_size;
+	return is_written and fflush(file) == 0 and fsync(fileno(file)) == 0;
+}
+inline bool write_compacted_log(Snapshot* snapshot) {
+	//writes a set for every entry of the copy, behind a clear so that replaying it can't resurrect anything deleted
+	Cache* cache_copy = &snapshot->cache_copy;
+	FILE* file = snapshot->file;
+	const auto entry_capacity = cache_copy->entry_capacity;
+	const auto hash_table_capacity = get_hash_table_capacity(entry_capacity);
+	const auto key_hashes = get_hashes(snapshot->mem_arena);
+	const auto bookmarks = get_bookmarks(snapshot->mem_arena, entry_capacity);
+	const auto sequence = cache_copy->log_sequence;
+	Book entry_book = cache_copy->entry_book;
+	entry_book.pages = get_pages(snapshot->mem_arena, entry_capacity);
+
+	std::vector<byte> buffer;
+	append_log_record(&buffer, LOG_CLEAR, sequence, "", 1, NULL, 0);
+	for(Index i = 0; i < hash_table_capacity; i += 1) {
+		auto key_hash = key_hashes[i];
+		if(key_hash != EMPTY and key_hash != DELETED) {
+			Entry* entry = read_book(&entry_book, bookmarks[i]);
+			append_log_record(&buffer, LOG_SET, sequence, entry->key, entry->key_size, entry->value, entry->value_size);
+			if(buffer.size() >= (1<<20)) {
+				if(fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+					return false;
+				}
+				buffer.clear();
 			}
 		}
 	}
+	bool is_written = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+	return is_written and fflush(file) == 0 and fsync(fileno(file)) == 0;
+}
+void run_snapshot(Snapshot* snapshot) {
+	if(snapshot->is_log_compaction) {
+		snapshot->is_ok = write_compacted_log(snapshot);
+	} else {
+		snapshot->is_ok = write_snapshot(snapshot);
+	}
+	if(fclose(snapshot->file) != 0) {
+		snapshot->is_ok = false;
+	}
+	snapshot->is_done.store(true, std::memory_order_release);
+}
 
-	return new_cache;
+inline Snapshot* begin_snapshot(Cache* cache, FILE* file) {
+	//copying the arena is the only part that scales with the cache, and it's one memcpy of its metadata
+	const auto mem_arena_size = get_arena_size(cache->entry_capacity, cache->evictor.policy);
+	Snapshot* snapshot = new Snapshot;
+	snapshot->is_done.store(false, std::memory_order_relaxed);
+	snapshot->is_ok = false;
+	snapshot->file = file;
+	memcpy(&snapshot->cache_copy, cache, sizeof(Cache));
+	snapshot->cache_copy.compress_buffer = NULL;
+	snapshot->cache_copy.compress_buffer_size = 0;
+	snapshot->cache_copy.read_buffer = NULL;
+	snapshot->cache_copy.read_buffer_size = 0;
+	snapshot->cache_copy.disk_tier = NULL;
+	snapshot->cache_copy.snapshot = NULL;
+	snapshot->cache_copy.log = NULL;
+	snapshot->cache_copy.prefix_index = NULL;
+	snapshot->cache_copy.loads = NULL;
+	snapshot->cache_copy.maintenance = NULL;
+	snapshot->cache_copy.linear = NULL;
+	snapshot->cache_copy.trace = NULL;
+	snapshot->cache_copy.mrc = NULL;
+	snapshot->cache_copy.adaptive = NULL;
+	snapshot->cache_copy.partitions = NULL;
+	snapshot->cache_copy.table_dump = NULL;
+	snapshot->mem_arena = new byte[mem_arena_size];
+	memcpy(snapshot->mem_arena, cache->mem_arena, mem_arena_size);
+	snapshot->is_log_compaction = false;
+	snapshot->log_tail_start = 0;
+	cache->snapshot = snapshot;
+	return snapshot;
+}
+
+bool cache_start_snapshot(Cache* cache, const char* path) {
+	check_snapshot(cache);
+	if(cache->snapshot != NULL) {
+		printf("Error in call to cache_start_snapshot: A snapshot is already being written\n");
+		return false;
+	}
+	FILE* file = fopen(path, "wb");
+	if(file == NULL) {
+		printf("Error in call to cache_start_snapshot: Could not open %s\n", path);
+		return false;
+	}
+	Snapshot* snapshot = begin_snapshot(cache, file);
+	snapshot->writer = std::thread(run_snapshot, snapshot);
+	return true;
+}
+
+bool cache_is_snapshotting(Cache* cache) {
+	check_snapshot(cache);
+	return cache->snapshot != NULL;
+}
+
+bool cache_finish_snapshot(Cache* cache) {
+	if(cache->snapshot != NULL) {
+		cache->is_snapshot_ok = finish_snapshot(cache);
+	}
+	return cache->is_snapshot_ok;
+}
+
+cache_type cache_load_snapshot(const char* path, Hash_func hash) {
+	return cache_load_snapshot_with_threads(path, hash, 0);
+}
+cache_type cache_load_snapshot_with_threads(const char* path, Hash_func hash, uint32_t thread_total) {
+	//the file is read by the threads restoring it, each reading only its own share, rather than all up front
+	int fd = open(path, O_RDONLY);
+	if(fd == -1) {
+		printf("Error in call to cache_load_snapshot: Could not open %s\n", path);
+		return NULL;
+	}
+	Snapshot_header header;
+	Cache cache_copy;
+	struct stat file_stat;
+	bool is_read = fstat(fd, &file_stat) == 0 and read_all(fd, reinterpret_cast<byte*>(&header), sizeof(Snapshot_header), 0);
+	if(is_read and not check_snapshot_header(&header, "cache_load_snapshot", path)) {
+		close(fd);
+		return NULL;
+	}
+	is_read = is_read and read_all(fd, reinterpret_cast<byte*>(&cache_copy), sizeof(Cache), SNAPSHOT_CACHE_OFFSET);
+	if(is_read) {
+		auto mem_arena_size = get_arena_size(cache_copy.entry_capacity, cache_copy.evictor.policy);
+		is_read = static_cast<uint64_t>(file_stat.st_size) >= SNAPSHOT_ARENA_OFFSET + mem_arena_size;
+	}
+	cache_type cache = NULL;
+	if(is_read) {
+		cache = restore_cache(&cache_copy, NULL, fd, hash, thread_total);
+	}
+	close(fd);
+	if(cache == NULL) {
+		printf("Error in call to cache_load_snapshot: Could not read %s\n", path);
+		return NULL;
+	}
+	return cache;
+}
+
+
+bool cache_open_log(Cache* cache, const char* path, int sync_mode, uint32_t sync_interval_ms) {
+	if(cache->log != NULL) {
+		printf("Error in call to cache_open_log: The cache already has a log\n");
+		return false;
+	}
+	cache->log = open_mutation_log(path, sync_mode, sync_interval_ms);
+	return cache->log != NULL;
+}
+
+bool cache_flush_log(Cache* cache) {
+	return cache->log != NULL and flush_mutation_log(cache->log);
+}
+
+bool cache_compact_log(Cache* cache) {
+	check_snapshot(cache);
+	if(cache->log == NULL or cache->snapshot != NULL) {
+		printf("Error in call to cache_compact_log: The cache has no log, or a snapshot is being written\n");
+		return false;
+	}
+	Log_stats stats = get_mutation_log_stats(cache->log);
+	char path[4096];
+	snprintf(path, sizeof(path), "%s.compact", get_mutation_log_path(cache->log));
+	FILE* file = fopen(path, "wb");
+	if(file == NULL) {
+		printf("Error in call to cache_compact_log: Could not open %s\n", path);
+		return false;
+	}
+	Snapshot* snapshot = begin_snapshot(cache, file);
+	snapshot->is_log_compaction = true;
+	snapshot->compaction_path = path;
+	//everything logged from here on comes after the copy we're compacting
+	snapshot->log_tail_start = stats.log_size;
+	snapshot->writer = std::thread(run_snapshot, snapshot);
+	return true;
+}
+
+Log_stats cache_log_stats(Cache* cache) {
+	if(cache->log == NULL) {
+		Log_stats stats;
+		memset(&stats, 0, sizeof(Log_stats));
+		return stats;
+	}
+	return get_mutation_log_stats(cache->log);
+}
+
+inline void clear_cache(Cache* cache) {
+	const auto hash_table_capacity = get_hash_table_capacity(cache->entry_capacity);
+	const auto key_hashes = get_hashes(cache->mem_arena);
+	for(Index i = 0; i < hash_table_capacity and cache->entry_total > 0; i += 1) {
+		auto key_hash = key_hashes[i];
+		if(key_hash != EMPTY and key_hash != DELETED) {
+			remove_entry(cache, i);
+		}
+	}
+}
+void replay_record(void* data, const Log_record* record, Key_ptr key, const byte* value_data) {
+	Cache* cache = static_cast<Cache*>(data);
+	if(record->type == LOG_SET) {
+		if(record->value_size <= cache->mem_capacity) {
+			Value* value = alloc_value(record->value_size);
+			memcpy(value->data, value_data, record->value_size);
+			value->raw_size = record->raw_size;
+			set_value(cache, key, value, record->value_size);
+		}
+	} else if(record->type == LOG_DELETE) {
+		Index i = find_entry(cache, key);
+		if(i != KEY_NOT_FOUND) {
+			remove_entry(cache, i);
+		}
+	} else if(record->type == LOG_CLEAR) {
+		clear_cache(cache);
+	}
+	cache->log_sequence = record->sequence;
+}
+
+cache_type cache_recover(const char* snapshot_path, const char* log_path, Index max_mem, evictor_type policy, Hash_func hash) {
+	Cache* cache = NULL;
+	if(snapshot_path != NULL and access(snapshot_path, F_OK) == 0) {
+		cache = cache_load_snapshot(snapshot_path, hash);
+	}
+	if(cache == NULL) {
+		cache = create_cache(max_mem, policy, hash);
+	}
+	//the snapshot already holds everything logged up to its sequence
+	if(not replay_mutation_log(log_path, cache->log_sequence, &replay_record, cache)) {
+		printf("Error in call to cache_recover: Could not read %s\n", log_path);
+	}
+	return cache;
 }
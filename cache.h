@@ -7,6 +7,8 @@
  */
 
 #include <inttypes.h>
+#include <stdio.h>
+#include <mutex>
 
 // An unspecified (implementation dependent, in the C file) cache object.
 struct cache_obj;
@@ -14,7 +16,13 @@ typedef struct cache_obj *cache_type;
 
 typedef const char *key_type;  // C string, null terminated
 typedef const void *val_type;
+#ifdef CACHE_INDEX_64
+// Build with -DCACHE_INDEX_64 for caches past 4 GiB, or of more than about 2^30 entries;
+// this widens the table, every entry and every hash, so small caches are better off without it.
+typedef uint64_t index_type;
+#else
 typedef uint32_t index_type;
+#endif
 
 // For a given key string, return a pseudo-random integer:
 typedef index_type (*hash_func)(key_type key);
@@ -48,8 +56,9 @@ void cache_set(cache_type cache, key_type key, val_type val, index_type val_size
 // or NULL if not found.
 val_type cache_get(cache_type cache, key_type key, index_type *val_size);
 
-// Delete an object from the cache, if it's still there
-void cache_delete(cache_type cache, key_type key);
+// Delete an object from the cache, if it's still there; returns whether it was. Unlike checking with cache_get
+// first, this doesn't count as a use of the key.
+bool cache_delete(cache_type cache, key_type key);
 
 // Compute the total amount of memory used up by all cache values (not keys)
 index_type cache_space_used(cache_type cache);
@@ -65,5 +74,450 @@ struct Mem_array {
 };
 Mem_array serialize_cache(cache_type cache);
 
-cache_type deserialize_cache(Mem_array arr);
+// hash must be the hash function the cache was created with, NULL if it was the default; it isn't stored, since a
+// function pointer means nothing to another process. Returns NULL if arr was serialized by a build that lays the
+// cache out differently.
+cache_type deserialize_cache(Mem_array arr, hash_func hash);
+
+// Like deserialize_cache, but the table is split between thread_total threads, each allocating the keys and
+// values of its own share; 0 uses a thread per core.
+cache_type deserialize_cache_with_threads(Mem_array arr, hash_func hash, uint32_t thread_total);
+
+// A value pinned in place, so that it stays readable after its key is overwritten, evicted or deleted.
+struct cache_value;
+typedef struct cache_value *pin_type;
+
+// Retrieve a value like cache_get, but pin it so it can be read without holding on to the cache.
+// Returns NULL if not found. Every pin must be released with cache_unpin.
+// cache_unpin may be called from any thread, even while another thread is using the cache.
+pin_type cache_pin(cache_type cache, key_type key, val_type* val, index_type* val_size);
+
+void cache_unpin(pin_type pin);
+
+// Change the value of key where it's stored, rather than getting, copying and setting it again. Each returns false,
+// changing nothing, if key isn't found or the value would grow past max_mem or its partition's quota. The change is
+// made in place unless the value is pinned, a snapshot is being written, the value is compressed or it has outgrown
+// its room; then it's made to a copy, given half again the room it needs so that a value that keeps growing is only
+// copied every so often, and pins and the snapshot keep reading the value as it was. That room counts toward the
+// footprint but not toward cache_space_used. A compressed value is compressed again afterwards; any other is left
+// as it is. Every call is one set as far as the mutation log, tracing and eviction are concerned, and is as atomic
+// as any other call on the cache: it's whole once it returns, to whoever holds the cache's lock next.
+// val mustn't point into the cache's own memory, as what cache_get returns does.
+
+// Add delta to the value of key, a decimal integer such as "-42" of up to 20 characters, and put the result in
+// ret_value. Returns false as well if the value isn't such an integer or the result wouldn't fit in 64 bits.
+bool cache_incr(cache_type cache, key_type key, int64_t delta, int64_t* ret_value);
+bool cache_decr(cache_type cache, key_type key, int64_t delta, int64_t* ret_value);
+
+bool cache_append(cache_type cache, key_type key, val_type val, index_type val_size);
+bool cache_prepend(cache_type cache, key_type key, val_type val, index_type val_size);
+
+// Overwrite val_size bytes of the value of key starting at offset, growing the value if they go past its end;
+// an offset past the end fills the gap with zeros.
+bool cache_write_range(cache_type cache, key_type key, index_type offset, val_type val, index_type val_size);
+
+struct Mutation_stats {
+	uint64_t in_place_total;//changes made to the value where it was
+	uint64_t copy_total;//changes made to a copy, because the value was pinned, snapshotted, compressed or outgrown
+	uint64_t failed_total;
+};
+Mutation_stats cache_mutation_stats(cache_type cache);
+
+// Called by cache_get_or_load on a miss to make the value for key, with the cache's lock let go of.
+// Returns the value, allocated with malloc for the cache to copy and free, or NULL if it couldn't be made.
+typedef void *(*load_func)(void* data, key_type key, index_type* val_size);
+
+// Retrieve and pin a value like cache_pin, but on a miss call loader to make it and set it in the cache.
+// When several threads miss on the same key at once, only the first calls loader; the rest wait for it and
+// are handed the same value, or NULL if loading failed. lock is whatever guards the cache; it must be held by
+// every other use of the cache, and is taken by this call, so it mustn't be held by the caller. Pass NULL if
+// only one thread uses the cache.
+// A ttl_ms other than 0 makes the loaded entry expire that many milliseconds after it was set. For stale_ms
+// more, an expired entry is still handed out to callers while the first of them loads it again; after that it
+// counts as a miss. Only cache_get_or_load heeds the expiry: cache_get and the like, a snapshot, and the
+// mutation log don't know about it, and setting the key any other way makes it never expire.
+// A cache with a disk tier can't have entries that expire.
+pin_type cache_get_or_load(cache_type cache, std::mutex* lock, key_type key, load_func loader, void* data, uint64_t ttl_ms, uint64_t stale_ms, val_type* val, index_type* val_size);
+
+// A small cache of hot keys in front of a cache, for one thread alone, so that the gets of the keys it holds take
+// neither the cache's lock nor a probe of its table. Each thread wanting one creates its own.
+struct cache_front;
+typedef struct cache_front *front_type;
+
+// Create a front cache of slot_total slots (rounded up to a power of 2; 0 for 256) for cache, whose lock is what
+// guards the cache, as for cache_get_or_load; NULL if only one thread uses the cache. A slot holds a key and its
+// value as the cache last had it, which is handed out for as long as the cache keeps that value: setting, changing,
+// deleting or evicting the key lets go of it, and the next get through the front fetches the key again. A key that
+// misses only takes the place of the one in its slot once that one has gone a miss without a hit, so a stream of
+// keys used once doesn't push out the hot ones. Hits aren't seen by the cache: not by its evictor, which may then
+// evict a key only the front is using, nor by tracing, the hit ratio estimator, adaptive eviction or partition stats.
+// Nor does the front know about cache_get_or_load's expiry. The values it holds can't be changed in place, and are
+// copied by cache_incr and the like instead. A front must be destroyed before its cache.
+front_type cache_create_front(cache_type cache, std::mutex* lock, index_type slot_total);
+
+void cache_destroy_front(front_type front);
+
+// Retrieve and pin a value like cache_pin, from the front if it holds key, or else from the cache, taking its lock.
+pin_type cache_front_pin(front_type front, key_type key, val_type* val, index_type* val_size);
+
+struct Front_stats {
+	uint64_t hit_total;
+	uint64_t miss_total;//including stale hits
+	uint64_t stale_total;//keys found in the front whose value the cache had let go of
+	uint64_t admit_total;//keys that took a slot
+};
+Front_stats cache_front_stats(front_type front);
+
+// Called by cache_scan with each entry it visits. val stays readable until the next call on the cache.
+typedef void (*scan_func)(void* data, key_type key, val_type val, index_type val_size);
+
+// Visit up to count entries, starting from cursor, and return the cursor to carry on from: 0 starts a scan
+// and is returned once every entry has been visited. The cache may be used freely between calls, and even
+// by func: an entry in the cache for the whole scan is visited exactly once, however much the cache changes or
+// grows meanwhile, while one set or deleted during the scan may or may not be. Visiting an entry doesn't count
+// as using it, so a scan leaves eviction order alone. Entries in the disk tier aren't visited.
+index_type cache_scan(cache_type cache, index_type cursor, index_type count, scan_func func, void* data);
+
+// Keep the keys in order in an index alongside the table, which cache_scan_prefix and cache_delete_prefix need.
+// Turning it on indexes every key already in the cache; it costs a node of about 24 bytes per key and a little
+// time on every set and delete. A cache with a disk tier can't have one, since the tier's keys aren't indexed.
+bool cache_set_prefix_index(cache_type cache, bool is_on);
+
+// Call func on every entry whose key starts with prefix, in order of their keys, like cache_scan does:
+// without counting it as a use of the entry, and letting func change the cache. Returns how many were visited.
+// This takes time in proportion to the entries found, not to the size of the cache.
+index_type cache_scan_prefix(cache_type cache, key_type prefix, scan_func func, void* data);
+
+// Delete every entry whose key starts with prefix, as cache_delete would; returns how many were deleted.
+index_type cache_delete_prefix(cache_type cache, key_type prefix);
+
+// Compress every value of at least threshold bytes that gets set from now on; 0 turns compression off.
+// Space used, and so eviction, counts compressed bytes. cache_get on a compressed value decompresses it
+// into a buffer owned by the cache, which stays valid until the next call on the cache.
+void cache_set_compression(cache_type cache, index_type threshold);
+
+// Copy the value associated with key into buffer, decompressing it if needed.
+// Returns false if the key isn't found or buffer is too small; val_size is set to the value's size either way,
+// so that a caller can retry with a large enough buffer.
+bool cache_get_into(cache_type cache, key_type key, void* buffer, index_type buffer_size, index_type* val_size);
+
+struct Compression_stats {
+	uint64_t raw_bytes;//bytes of every value in the cache before compression
+	uint64_t stored_bytes;//bytes they take up as stored, the same as cache_space_used
+	uint64_t compress_total;//values we tried to compress, including ones that didn't shrink enough
+	uint64_t incompressible_total;//values stored uncompressed because they didn't shrink enough
+	uint64_t compress_ns;
+	uint64_t decompress_total;
+	uint64_t decompress_ns;
+};
+Compression_stats cache_compression_stats(cache_type cache);
+
+// Keep entries evicted from memory in files under dir, up to capacity bytes of them, instead of losing them.
+// A later get, get_into or pin of an evicted key reads it back and moves it into memory again.
+// Evicted entries are written by a background thread, so evicting never waits on the disk.
+// Returns false if dir can't be written to. A cache can only be given one disk tier.
+bool cache_set_disk_tier(cache_type cache, const char* dir, uint64_t capacity);
+
+// Wait until every entry evicted so far has been written to disk.
+void cache_flush_disk_tier(cache_type cache);
+
+struct Disk_tier_stats {
+	uint64_t hit_total;//misses in memory that were found on disk
+	uint64_t miss_total;
+	uint64_t write_total;//records written, including ones rewritten by garbage collection
+	uint64_t bytes_written;
+	uint64_t dropped_total;//evicted entries lost, because the writer was behind or the tier was full
+	uint64_t gc_total;//segments garbage collected
+	uint64_t relocated_total;//live records garbage collection rewrote
+	uint64_t segments_dropped;//segments deleted with their records to stay under capacity
+	uint64_t entry_total;
+	uint64_t pending_bytes;//value bytes waiting to be written
+	uint64_t live_bytes;
+	uint64_t disk_bytes;
+	uint64_t segment_total;
+};
+Disk_tier_stats cache_disk_tier_stats(cache_type cache);
+
+// Make max_mem bound everything the cache allocates rather than just its values: keys, values with their
+// headers, the hash table, the entry pages, the evictor's data, scratch buffers and the allocator's
+// overhead on each of these. Eviction and cache_space_used then go by this total.
+// The table never shrinks, so a cache with too little memory for its own table evicts everything.
+void cache_set_footprint_mode(cache_type cache, bool is_on);
+
+struct Memory_report {
+	uint64_t value_bytes;//bytes of values as stored, what cache_space_used counts by default
+	uint64_t value_overhead;//value headers and allocator overhead
+	uint64_t key_bytes;
+	uint64_t key_overhead;//allocator overhead
+	uint64_t table_bytes;//the hash table, twice the entry capacity
+	uint64_t page_bytes;//entries, one page for each of the entry capacity
+	uint64_t evictor_bytes;//the evictor's own data, only RR has any
+	uint64_t buffer_bytes;//scratch buffers for compression
+	uint64_t prefix_index_bytes;//the prefix index, if there is one
+	uint64_t load_bytes;//what cache_get_or_load keeps, mostly the expiry times of entries it loaded
+	uint64_t trace_bytes;//the ring buffer of the trace being recorded, if any
+	uint64_t mrc_bytes;//the hit ratio estimator, if it's on
+	uint64_t adaptive_bytes;//the simulated caches of adaptive eviction, if it's on
+	uint64_t partition_bytes;//the partitions' prefixes and stats, if there are any
+	uint64_t cache_bytes;//the cache object, a small cache's linear index, and the allocator's overhead on them and on the table
+	uint64_t total;//the sum of the above
+	uint64_t capacity;
+	bool is_counting_footprint;
+};
+Memory_report cache_memory_report(cache_type cache);
+
+// A cache of only a few entries finds keys by comparing a small tag of each with the key's, several at once,
+// instead of hashing the key and probing the table; past entry_total entries it switches to the table, and it
+// switches back once it has half that many again, unless its table has grown big in the meantime. The default
+// is 32, 0 turns scanning off, and no more than 256 is allowed. Sets of new keys still hash them either way.
+void cache_set_linear_threshold(cache_type cache, index_type entry_total);
+
+// Once the cache goes over capacity, evict down to percent of it rather than just back under it, so that a full
+// cache evicts a batch every so often instead of an entry on nearly every set. The default is 100, evicting
+// only what it must; lower keeps less in the cache in exchange for cheaper sets.
+void cache_set_low_watermark(cache_type cache, uint32_t percent);
+
+// Start a thread that does the cache's housekeeping between calls, so that they don't have to: it evicts to keep
+// headroom_percent of the capacity free, grows the table shortly before it would have to grow, and frees the keys
+// and values the cache lets go of. lock is what guards the cache, as for cache_get_or_load; the thread takes it
+// for a batch of work at a time, and frees memory without it. Calls still evict, grow and free for themselves
+// whenever the thread falls behind. Returns false if the cache already has a maintenance thread or lock is NULL.
+bool cache_start_maintenance(cache_type cache, std::mutex* lock, uint32_t headroom_percent);
+
+// Stop the maintenance thread and wait for it; destroy_cache does this too. Mustn't be called holding the lock.
+void cache_stop_maintenance(cache_type cache);
+
+struct Maintenance_stats {
+	uint64_t background_evict_total;
+	uint64_t background_grow_total;//including rehashes at the same size to clear out deleted entries
+	uint64_t deferred_free_total;//keys and values freed by the maintenance thread rather than by a call
+	uint64_t inline_evict_total;//evictions and growths calls did themselves, whether or not there's a maintenance thread
+	uint64_t inline_grow_total;
+};
+Maintenance_stats cache_maintenance_stats(cache_type cache);
+
+// Record every get, set and delete to path, as a 24 byte record holding the operation, a hash and the size of the
+// key, the size of the value and the time, for trace_replay to play back against every policy and size. A get made
+// through cache_get_into, cache_pin or cache_get_or_load counts too. Records go into a ring buffer of ring_records
+// (0 for 65536) that a background thread writes out; if it falls behind, records are dropped rather than waited
+// for. Returns false if the cache is already being traced or path can't be opened.
+bool cache_start_trace(cache_type cache, const char* path, uint32_t ring_records);
+
+// Stop tracing and write out what's left; destroy_cache does this too. Returns false if the trace couldn't all be written.
+bool cache_stop_trace(cache_type cache);
+
+struct Trace_stats {
+	uint64_t record_total;
+	uint64_t dropped_total;//records lost because the ring was full
+	uint64_t bytes_written;
+};
+// The stats of the trace being recorded, or else of the last one stopped.
+Trace_stats cache_trace_stats(cache_type cache);
+
+// Estimate the hit ratio gets would have at any capacity, for capacity planning, by keeping the recent history of a
+// sample of the keys: those whose hash falls in a fraction of its range, which starts at 1 in 64 and is narrowed as
+// needed to keep no more than max_sampled_keys, so memory stays at about 100 bytes per sampled key. A few thousand
+// keys are enough to be within a point or two of the real curve. What it estimates is an LRU cache counting
+// only values against its capacity, the default, whatever this cache's own policy. The sample is only as good as
+// the hash, so a poor hash function makes for a poor estimate. 0 turns it off; turning it on starts afresh.
+void cache_set_mrc(cache_type cache, uint32_t max_sampled_keys);
+
+// Fill ret_hit_ratios with the estimated hit ratio of gets at each of capacities, in bytes, since the estimator was
+// turned on. The first get of every key is a miss at any capacity.
+void cache_estimate_hit_ratios(cache_type cache, const uint64_t* capacities, double* ret_hit_ratios, uint32_t capacity_total);
+
+struct Mrc_stats {
+	double sample_rate;//the fraction of keys being sampled
+	uint64_t sampled_key_total;
+	uint64_t sampled_get_total;//gets the estimate is made from
+};
+Mrc_stats cache_mrc_stats(cache_type cache);
+
+// Let the cache switch its eviction policy to whichever of policies would be doing best on its recent traffic.
+// A small cache is simulated for each of them, and for the cache's own policy, over 1 in sample_period keys (0 for
+// 64) with that fraction of the capacity; every window_gets gets of those keys (0 for 4096), a policy whose
+// simulation hit more than a point more of them than the live policy's, weighing recent windows most, replaces it.
+// Switching reorders the entries' lists in place: between FIFO, LRU and CLOCK it takes no time, while switching
+// to or from LIFO, MRU or SLRU walks every entry once. RR keeps no list, so it can't be used either way.
+// Memory is under 100 bytes per sampled key per policy. 0 policies turns it off, leaving the policy where it is;
+// turning it on starts afresh. Returns false if RR is among policies or is the cache's own policy.
+bool cache_set_adaptive(cache_type cache, const evictor_type* policies, uint32_t policy_total, uint32_t sample_period, uint32_t window_gets);
+
+struct Adaptive_stats {
+	evictor_type policy;//the one the cache is using now
+	uint64_t window_total;
+	uint64_t switch_total;
+	uint64_t switch_ns;//spent moving the entries from one policy to another, in all
+	double hit_ratios[RR + 1];//of each simulated policy over the last window, by policy; 0 for the rest
+};
+Adaptive_stats cache_adaptive_stats(cache_type cache);
+
+// Give the keys starting with prefix a partition of the cache to themselves, with a quota of bytes of values and an
+// evictor running policy over them alone, so that one tenant's keys can't push out another's. A set that takes a
+// partition over its quota evicts from that partition; when the cache as a whole is over capacity, it evicts from
+// whichever partition is furthest over its quota. Keys in no partition make up partition 0, under the cache's own
+// policy, whose quota is what the others leave of max_mem; it may use whatever room they aren't using, until they
+// need it back. A key belongs to the partition with the longest prefix it starts with, and keys already in the
+// cache are moved into the new partition. Partitions aren't part of a snapshot or serialize_cache: a cache loaded
+// from one holds every entry in partition 0, and adding the partitions again moves their keys back into them.
+// Returns the partition's number, from 1 up, or 0 if the prefix already has a partition, the quotas would add up
+// to more than max_mem, there are already 255 partitions or policy is RR.
+uint32_t cache_add_partition(cache_type cache, const char* prefix, index_type quota, evictor_type policy);
+
+struct Partition_stats {
+	uint64_t quota;
+	uint64_t mem_total;
+	uint64_t entry_total;
+	uint64_t hit_total;//gets, counted from when the first partition was added
+	uint64_t miss_total;
+	uint64_t evict_total;
+};
+// The stats of a partition by its number, 0 being the keys in no partition; all 0 if there is no such partition.
+Partition_stats cache_partition_stats(cache_type cache, uint32_t partition);
+
+// Split rehashing the table, when it grows, between up to thread_total threads, each rehashing a range of the
+// old table into the new one; 0 uses a thread per core and 1, the default, rehashes on the calling thread.
+// Tables too small to be worth splitting are still rehashed on the calling thread.
+void cache_set_rehash_threads(cache_type cache, uint32_t thread_total);
+
+// Grow the table once so that it holds entry_total entries without growing again, instead of doubling its way
+// there one rehash at a time. Returns false if a table that big can't be made or, in footprint mode, wouldn't fit.
+bool cache_reserve(cache_type cache, index_type entry_total);
+
+enum {
+	PROBE_BUCKET_TOTAL = 16,
+	RESIZE_HISTORY_TOTAL = 8,
+};
+struct Resize_record {
+	uint64_t time_ns;//on CLOCK_MONOTONIC, when it finished
+	uint64_t ns;//how long it took
+	index_type pre_slot_total;//the same as slot_total for a rehash that only cleared out graves
+	index_type slot_total;
+	index_type entry_total;
+	index_type dead_total;//graves it cleared out
+};
+struct Table_stats {
+	index_type slot_total;
+	index_type entry_total;
+	index_type dead_total;//graves, the slots of deleted keys, which lookups step over until the next resize
+	double dead_ratio;//of the slots in use, live or dead
+	//every lookup of a key in the table, by gets, sets and deletes alike, by how many slots it looked at: bucket b
+	//counts those that looked at 2^b to 2^(b+1) - 1, and the last bucket everything longer
+	uint64_t hit_probes[PROBE_BUCKET_TOTAL];
+	uint64_t miss_probes[PROBE_BUCKET_TOTAL];
+	uint64_t hit_total;
+	uint64_t miss_total;
+	uint64_t hit_probe_total;//slots looked at in all, for the mean
+	uint64_t miss_probe_total;
+	double expected_hit_probes;//what a hash that spreads keys evenly would average at the table's current load
+	double expected_miss_probes;
+	index_type max_probe;//the longest lookup since the last resize
+	index_type max_chain;//the most slots any entry had to be placed past since the last resize, counting its own
+	uint64_t full_traversal_total;//lookups that looked at every slot, which can only happen to a table with no empty slots
+	uint64_t resize_total;
+	Resize_record resizes[RESIZE_HISTORY_TOTAL];//the last few, oldest first, only the first resize_total if there have been fewer
+};
+// The health of the hash table, to tell whether hash spreads the keys well: with a hash that clusters them, lookups
+// average far more slots than expected_hit_probes and expected_miss_probes. Counted from when the cache was made.
+// A cache small enough to scan its keys finds them without the table, so only its sets are counted.
+Table_stats cache_table_stats(cache_type cache);
+
+// Print a line of the table's health to file after every lookup_interval lookups, with the mean probes of the
+// lookups since the last line next to what an even hash would average, ending in "clustered" once they're more
+// than twice that. The line is printed by whichever call makes the last lookup, holding whatever lock it holds.
+// 0 turns it off.
+void cache_set_table_dump(cache_type cache, FILE* file, uint64_t lookup_interval);
+
+struct Bulk_item {
+	key_type key;
+	val_type val;
+	index_type val_size;
+};
+// Set every item in order, as if by cache_set, after reserving room for all of them. Hashing, copying and
+// compressing the values is split between thread_total threads (0 for a thread per core), so hash must be safe
+// to call from several threads at once. Returns how many items were set; values over max_mem or their partition's
+// quota are skipped, as cache_set skips them.
+index_type cache_set_bulk(cache_type cache, const Bulk_item* items, index_type item_total, uint32_t thread_total);
+
+// Reserve val_size bytes of the cache's own memory for the value of key, to be filled in through *ret_buffer and then
+// set by cache_set_commit, so that a value read from a socket or a file is written once, straight into the cache,
+// rather than into a buffer of the caller's and then copied by cache_set. Neither this nor cache_set_abort touches
+// the cache, so the buffer can be filled without holding the cache's lock. Nothing counts against max_mem until the
+// commit. Returns NULL if val_size is over max_mem. Every reservation must be either committed or aborted.
+struct cache_reservation;
+typedef struct cache_reservation *reservation_type;
+reservation_type cache_set_reserve(cache_type cache, key_type key, index_type val_size, void** ret_buffer);
+
+// Set the reserved value under its key, as cache_set would, and let go of the reservation. Returns false if the
+// value is over its partition's quota, and so couldn't be set.
+bool cache_set_commit(cache_type cache, reservation_type reservation);
+
+void cache_set_abort(reservation_type reservation);
+
+// Frees a value handed over to cache_set_owned. It's called once neither the cache nor any pin needs the value,
+// which may be on any thread, even one of the cache's own or one calling cache_unpin.
+typedef void (*free_func)(void* data, void* val);
+
+// Set key to val like cache_set, but keep val itself rather than a copy of it. val then belongs to the cache, which
+// calls deleter(data, val) once it's done with it; straight away if val is over max_mem or its partition's quota,
+// or is compressed into a copy of its own. A NULL deleter means val was allocated with malloc, and is freed with free.
+void cache_set_owned(cache_type cache, key_type key, void* val, index_type val_size, free_func deleter, void* data);
+
+// Start writing a point-in-time snapshot of the cache to path in the background. The cache stays usable the
+// whole time: only its table is copied up front, and keys and values the cache frees meanwhile are kept alive
+// until the snapshot is done. The file holds the same bytes serialize_cache would have returned.
+// Returns false if a snapshot is already being written or path can't be opened.
+bool cache_start_snapshot(cache_type cache, const char* path);
+
+// Whether a snapshot is still being written; never blocks.
+bool cache_is_snapshotting(cache_type cache);
+
+// Wait for the snapshot being written, if any; returns false if the last snapshot failed to be written.
+bool cache_finish_snapshot(cache_type cache);
+
+// Read a snapshot written by cache_start_snapshot back into a new cache, or NULL if it can't be read.
+// hash must be the hash function the cache was created with, NULL if it was the default.
+// The file is read and restored by a thread per core, as cache_load_snapshot_with_threads does.
+cache_type cache_load_snapshot(const char* path, hash_func hash);
+
+// Like cache_load_snapshot, but with thread_total threads, each reading and allocating its own share of the
+// snapshot; 0 uses a thread per core.
+cache_type cache_load_snapshot_with_threads(const char* path, hash_func hash, uint32_t thread_total);
+
+enum {//log_sync_modes
+	LOG_SYNC_NEVER,//leave syncing to the OS; a crash of the machine, not just the process, loses what it hadn't written
+	LOG_SYNC_INTERVAL,//sync every sync_interval_ms, so a crash loses at most that long of mutations
+	LOG_SYNC_ALWAYS,//every set and delete waits until it's synced
+};
+
+// Log every set and delete to path, appending to what's already there, so that cache_recover can rebuild the
+// cache after a crash from its last snapshot and the log. Mutations are written out and synced in batches by a
+// background thread, so apart from LOG_SYNC_ALWAYS a set only waits on the disk if the writer falls far behind.
+// Evictions and reads aren't logged, so a recovered cache holds what was set, evicting again as it replays.
+bool cache_open_log(cache_type cache, const char* path, int sync_mode, uint32_t sync_interval_ms);
+
+// Write and sync everything logged so far; returns false if there is no log or writing it failed.
+bool cache_flush_log(cache_type cache);
+
+// Rewrite the log from what's in the cache, in the background like cache_start_snapshot, so it stops growing
+// without bound. Mutations keep being logged meanwhile and are carried over to the new log, which replaces
+// the old one once cache_finish_snapshot or a later call notices it's done.
+bool cache_compact_log(cache_type cache);
+
+struct Log_stats {
+	uint64_t record_total;
+	uint64_t write_total;//group commits, each a single write of every record logged since the last
+	uint64_t sync_total;
+	uint64_t stall_total;//times a mutation waited because the writer was far behind
+	uint64_t compaction_total;
+	uint64_t log_size;
+	uint64_t unsynced_size;//bytes a crash of the machine could still lose
+};
+Log_stats cache_log_stats(cache_type cache);
+
+// Rebuild a cache from the snapshot at snapshot_path, if there is one, and the mutations in the log at log_path
+// that came after it. Without a snapshot a new cache is created from max_mem, policy and hash; with one, the
+// cache keeps the snapshot's capacity and policy. A record torn by the crash is cut off the end of the log,
+// so cache_open_log can keep appending to it.
+cache_type cache_recover(const char* snapshot_path, const char* log_path, index_type max_mem, evictor_type policy, hash_func hash);
 #endif
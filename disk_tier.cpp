@@ -0,0 +1,499 @@
+//By Monica Moniot and Alyssa Riceman
+#include <stdio.h>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "value.h"
+#include "disk_tier.h"
+
+constexpr uint64_t MIN_SEGMENT_SIZE = 1<<20;
+constexpr uint64_t MAX_SEGMENT_SIZE = 64<<20;
+constexpr Index MAX_BATCH_IOVECS = 1023;//must be a multiple of 3 and at most IOV_MAX, every record takes 3
+constexpr uint32_t NO_SEGMENT = -1;
+constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+//a record on disk is this header, then the key, then the value as the cache stored it
+struct Record_header {
+	uint64_t hash;
+	uint32_t key_size;
+	uint32_t value_size;
+	uint32_t raw_size;//carried over from the value, so compressed values stay compressed
+	uint32_t unused;
+};
+struct Disk_write {//a record waiting on the writer
+	uint64_t hash;
+	byte* key;
+	Index key_size;
+	Value* value;
+	Index value_size;
+	bool is_cancelled;//the index has forgotten this record, so it needn't be written
+	uint32_t segment;//where the writer put it, NO_SEGMENT if it failed to
+	uint64_t offset;
+};
+struct Disk_location {
+	Disk_write* pending;//until the record is written it's read from here, after that from segment and offset
+	uint32_t segment;
+	uint32_t record_size;
+	uint64_t offset;
+};
+struct Segment {
+	int fd;
+	uint64_t size;
+	uint64_t live_size;//bytes of records the index still points to
+};
+
+struct Disk_tier {
+	std::mutex lock;//guards everything but the writer's own fields
+	std::condition_variable work_ready;
+	std::condition_variable work_done;
+	std::thread writer;
+	bool is_stopping;
+	std::string dir;
+	uint32_t id;
+	uint64_t capacity;
+	uint64_t segment_size;
+	uint64_t pending_capacity;//victims past this many bytes waiting on the writer are dropped instead
+	uint64_t pending_size;
+	std::unordered_map<uint64_t, Disk_location> index;
+	std::vector<Disk_write*> queue;
+	uint64_t queued_total;
+	uint64_t finished_total;
+	std::map<uint32_t, Segment> segments;//ordered from oldest to newest
+	uint64_t disk_size;
+	Disk_tier_stats stats;
+	//only the writer touches these
+	uint32_t active_segment;
+	int active_fd;
+	uint64_t active_size;
+};
+
+static std::atomic<uint32_t> tier_total(0);
+
+inline uint64_t get_disk_hash(Key_ptr key, Index key_size) {
+	//FNV-1a; the cache's own hash is too narrow to index a disk with
+	uint64_t hash = FNV_OFFSET;
+	for(Index i = 0; i < key_size; i += 1) {
+		hash = (hash^static_cast<byte>(key[i]))*FNV_PRIME;
+	}
+	return hash;
+}
+inline uint64_t get_record_size(Index key_size, Index value_size) {
+	return sizeof(Record_header) + key_size + value_size;
+}
+inline void get_segment_path(Disk_tier* tier, uint32_t segment, char* path, size_t path_size) {
+	snprintf(path, path_size, "%s/cache-%d-%u-%u.log", tier->dir.c_str(), getpid(), tier->id, segment);
+}
+
+inline bool open_segment(Disk_tier* tier, uint32_t segment) {
+	//starts a new active segment, sealing the previous one
+	char path[4096];
+	get_segment_path(tier, segment, path, sizeof(path));
+	int fd = open(path, O_RDWR|O_CREAT|O_TRUNC|O_CLOEXEC, 0600);
+	if(fd < 0) {
+		printf("Error in disk tier: Could not open segment %s: %s\n", path, strerror(errno));
+		return false;
+	}
+	std::lock_guard<std::mutex> guard(tier->lock);
+	auto active = tier->segments.find(tier->active_segment);
+	if(active != tier->segments.end()) {
+		active->second.size = tier->active_size;
+	}
+	tier->segments[segment] = {fd, 0, 0};
+	tier->active_segment = segment;
+	tier->active_fd = fd;
+	tier->active_size = 0;
+	return true;
+}
+inline void delete_segment(Disk_tier* tier, std::map<uint32_t, Segment>::iterator segment) {
+	char path[4096];
+	get_segment_path(tier, segment->first, path, sizeof(path));
+	close(segment->second.fd);
+	unlink(path);
+	tier->disk_size -= segment->second.size;
+	tier->segments.erase(segment);
+}
+inline void forget_location(Disk_tier* tier, Disk_location* location) {
+	//the record is dead, either it was taken back by the cache or it's stale
+	if(location->pending != NULL) {
+		location->pending->is_cancelled = true;
+	} else {
+		tier->segments[location->segment].live_size -= location->record_size;
+	}
+}
+inline void finish_write(Disk_tier* tier, Disk_write* write) {
+	tier->pending_size -= write->value_size;
+	tier->finished_total += 1;
+	release_value(write->value);
+	delete[] write->key;
+	delete write;
+}
+
+inline bool write_all(int fd, iovec* iov, Index iov_total, uint64_t offset) {
+	//pwritev may write less than asked, so we keep going from where it stopped
+	while(iov_total > 0) {
+		ssize_t written = pwritev(fd, iov, iov_total, offset);
+		if(written < 0) {
+			if(errno == EINTR) continue;
+			return false;
+		}
+		offset += written;
+		while(iov_total > 0 and static_cast<size_t>(written) >= iov->iov_len) {
+			written -= iov->iov_len;
+			iov += 1;
+			iov_total -= 1;
+		}
+		if(iov_total > 0) {
+			iov->iov_base = static_cast<byte*>(iov->iov_base) + written;
+			iov->iov_len -= written;
+		}
+	}
+	return true;
+}
+inline void write_run(Disk_tier* tier, Disk_write** writes, Index write_total, iovec* iov, Index iov_total, uint64_t offset) {
+	if(iov_total > 0 and not write_all(tier->active_fd, iov, iov_total, offset)) {
+		printf("Error in disk tier: Could not write to segment %u: %s\n", tier->active_segment, strerror(errno));
+		for(Index i = 0; i < write_total; i += 1) {
+			writes[i]->segment = NO_SEGMENT;
+		}
+	}
+}
+inline void write_batch(Disk_tier* tier, std::vector<Disk_write*>* batch) {
+	//appends the whole batch to the log with one pwritev per run of records that fit in a segment
+	std::vector<Record_header> headers(batch->size());
+	iovec iov[MAX_BATCH_IOVECS];
+	Index iov_total = 0;
+	Index run_start = 0;
+	uint64_t run_offset = tier->active_size;
+	for(Index i = 0; i < batch->size(); i += 1) {
+		Disk_write* write = (*batch)[i];
+		uint64_t record_size = get_record_size(write->key_size, write->value_size);
+		bool is_segment_full = tier->active_size > 0 and tier->active_size + record_size > tier->segment_size;
+		if(is_segment_full or iov_total == MAX_BATCH_IOVECS) {
+			write_run(tier, &(*batch)[run_start], i - run_start, iov, iov_total, run_offset);
+			iov_total = 0;
+			run_start = i;
+			//if we can't start a new segment the current one just keeps growing
+			if(is_segment_full) {
+				open_segment(tier, tier->active_segment + 1);
+			}
+			run_offset = tier->active_size;
+		}
+		auto header = &headers[i];
+		header->hash = write->hash;
+		header->key_size = write->key_size;
+		header->value_size = write->value_size;
+		header->raw_size = write->value->raw_size;
+		header->unused = 0;
+		iov[iov_total] = {header, sizeof(Record_header)};
+		iov[iov_total + 1] = {write->key, write->key_size};
+		iov[iov_total + 2] = {write->value->data, write->value_size};
+		iov_total += 3;
+		write->segment = tier->active_segment;
+		write->offset = tier->active_size;
+		tier->active_size += record_size;
+	}
+	write_run(tier, &(*batch)[run_start], batch->size() - run_start, iov, iov_total, run_offset);
+}
+inline void finish_batch(Disk_tier* tier, std::vector<Disk_write*>* batch) {
+	//points the index at where each record landed, unless it was taken or replaced in the meantime
+	auto stats = &tier->stats;
+	for(auto write : *batch) {
+		uint64_t record_size = get_record_size(write->key_size, write->value_size);
+		auto found = tier->index.find(write->hash);
+		if(found != tier->index.end() and found->second.pending == write) {
+			auto location = &found->second;
+			if(write->segment == NO_SEGMENT) {
+				tier->index.erase(found);
+				stats->dropped_total += 1;
+			} else {
+				location->pending = NULL;
+				location->segment = write->segment;
+				location->offset = write->offset;
+				location->record_size = record_size;
+				tier->segments[write->segment].live_size += record_size;
+			}
+		}
+		if(write->segment != NO_SEGMENT) {
+			stats->write_total += 1;
+			stats->bytes_written += record_size;
+		}
+		finish_write(tier, write);
+	}
+	batch->clear();
+	tier->segments[tier->active_segment].size = tier->active_size;
+	uint64_t disk_size = 0;
+	for(auto& segment : tier->segments) {
+		disk_size += segment.second.size;
+	}
+	tier->disk_size = disk_size;
+}
+
+inline void relocate_segment(Disk_tier* tier, uint32_t segment_i) {
+	//queues the live records of a sealed segment to be written again at the end of the log
+	auto segment = &tier->segments[segment_i];
+	for(auto& item : tier->index) {
+		auto location = &item.second;
+		if(location->pending != NULL or location->segment != segment_i) {
+			continue;
+		}
+		byte* record = new byte[location->record_size];
+		ssize_t read_size = pread(segment->fd, record, location->record_size, location->offset);
+		Record_header header;
+		memcpy(&header, record, sizeof(Record_header));
+		if(read_size != location->record_size or header.hash != item.first) {
+			printf("Error in disk tier: Could not read back a record of segment %u\n", segment_i);
+			delete[] record;
+			location->segment = NO_SEGMENT;//erased below
+			continue;
+		}
+		Disk_write* write = new Disk_write;
+		write->hash = header.hash;
+		write->key_size = header.key_size;
+		write->key = new byte[header.key_size];
+		memcpy(write->key, record + sizeof(Record_header), header.key_size);
+		write->value_size = header.value_size;
+		write->value = alloc_value(header.value_size);
+		write->value->raw_size = header.raw_size;
+		memcpy(write->value->data, record + sizeof(Record_header) + header.key_size, header.value_size);
+		write->is_cancelled = false;
+		delete[] record;
+		location->pending = write;
+		tier->queue.push_back(write);
+		tier->queued_total += 1;
+		tier->pending_size += write->value_size;
+		tier->stats.relocated_total += 1;
+	}
+	for(auto item = tier->index.begin(); item != tier->index.end();) {
+		if(item->second.pending == NULL and item->second.segment == NO_SEGMENT) {
+			item = tier->index.erase(item);
+			tier->stats.dropped_total += 1;
+		} else {
+			++item;
+		}
+	}
+}
+inline void drop_segment(Disk_tier* tier, uint32_t segment_i) {
+	//forgets every record of a segment
+	for(auto item = tier->index.begin(); item != tier->index.end();) {
+		if(item->second.pending == NULL and item->second.segment == segment_i) {
+			item = tier->index.erase(item);
+			tier->stats.dropped_total += 1;
+		} else {
+			++item;
+		}
+	}
+}
+inline void collect_garbage(Disk_tier* tier) {
+	//compacts every sealed segment that is mostly dead, then drops the oldest segments while we're over capacity
+	for(auto segment = tier->segments.begin(); segment != tier->segments.end();) {
+		auto cur = segment;
+		++segment;
+		if(cur->first != tier->active_segment and 2*cur->second.live_size < cur->second.size) {
+			if(cur->second.live_size > 0) {
+				relocate_segment(tier, cur->first);
+			}
+			delete_segment(tier, cur);
+			tier->stats.gc_total += 1;
+		}
+	}
+	while(tier->disk_size > tier->capacity and tier->segments.begin()->first != tier->active_segment) {
+		auto oldest = tier->segments.begin();
+		drop_segment(tier, oldest->first);
+		delete_segment(tier, oldest);
+		tier->stats.segments_dropped += 1;
+	}
+}
+
+void run_writer(Disk_tier* tier) {
+	std::vector<Disk_write*> batch;
+	std::unique_lock<std::mutex> guard(tier->lock);
+	while(true) {
+		tier->work_ready.wait(guard, [tier]() {return tier->is_stopping or not tier->queue.empty();});
+		if(tier->is_stopping) {
+			break;
+		}
+		//everything queued so far goes out in one batch, minus what was taken back while it waited
+		for(auto write : tier->queue) {
+			if(write->is_cancelled) {
+				finish_write(tier, write);
+			} else {
+				batch.push_back(write);
+			}
+		}
+		tier->queue.clear();
+		guard.unlock();
+		write_batch(tier, &batch);
+		guard.lock();
+		finish_batch(tier, &batch);
+		collect_garbage(tier);
+		tier->work_done.notify_all();
+	}
+}
+
+
+Disk_tier* create_disk_tier(const char* dir, uint64_t capacity) {
+	Disk_tier* tier = new Disk_tier;
+	tier->is_stopping = false;
+	tier->dir = dir;
+	tier->id = tier_total.fetch_add(1);
+	tier->capacity = capacity;
+	uint64_t segment_size = capacity/8;
+	if(segment_size < MIN_SEGMENT_SIZE) segment_size = MIN_SEGMENT_SIZE;
+	if(segment_size > MAX_SEGMENT_SIZE) segment_size = MAX_SEGMENT_SIZE;
+	tier->segment_size = segment_size;
+	tier->pending_capacity = 2*segment_size;
+	tier->pending_size = 0;
+	tier->queued_total = 0;
+	tier->finished_total = 0;
+	tier->disk_size = 0;
+	memset(&tier->stats, 0, sizeof(Disk_tier_stats));
+	tier->active_segment = NO_SEGMENT;
+	tier->active_fd = -1;
+	tier->active_size = 0;
+	if(not open_segment(tier, 0)) {
+		delete tier;
+		return NULL;
+	}
+	tier->writer = std::thread(run_writer, tier);
+	return tier;
+}
+void destroy_disk_tier(Disk_tier* tier) {
+	{
+		std::lock_guard<std::mutex> guard(tier->lock);
+		tier->is_stopping = true;
+	}
+	tier->work_ready.notify_one();
+	tier->writer.join();
+	for(auto write : tier->queue) {
+		finish_write(tier, write);
+	}
+	while(not tier->segments.empty()) {
+		delete_segment(tier, tier->segments.begin());
+	}
+	delete tier;
+}
+
+void disk_tier_put(Disk_tier* tier, Key_ptr key, Index key_size, Value* value, Index value_size) {
+	uint64_t hash = get_disk_hash(key, key_size);
+	std::unique_lock<std::mutex> guard(tier->lock);
+	if(tier->pending_size + value_size > tier->pending_capacity) {
+		//the writer is behind; rather than make eviction wait on it, this victim is lost like it would be without us
+		tier->stats.dropped_total += 1;
+		return;
+	}
+	guard.unlock();
+	Disk_write* write = new Disk_write;
+	write->hash = hash;
+	write->key = new byte[key_size];
+	memcpy(write->key, key, key_size);
+	write->key_size = key_size;
+	retain_value(value);
+	write->value = value;
+	write->value_size = value_size;
+	write->is_cancelled = false;
+	guard.lock();
+	auto found = tier->index.find(hash);
+	if(found != tier->index.end()) {
+		forget_location(tier, &found->second);
+	}
+	Disk_location location;
+	location.pending = write;
+	tier->index[hash] = location;
+	tier->queue.push_back(write);
+	tier->queued_total += 1;
+	tier->pending_size += value_size;
+	guard.unlock();
+	tier->work_ready.notify_one();
+}
+
+inline Value* read_record(Disk_tier* tier, const Disk_location* location, uint64_t hash, Key_ptr key, Index key_size, Index* ret_value_size) {
+	//reads the record straight into a new value, if it really is key's
+	if(location->record_size < get_record_size(key_size, 0)) {
+		return NULL;
+	}
+	Index value_size = location->record_size - get_record_size(key_size, 0);
+	Record_header header;
+	byte* key_copy = new byte[key_size];
+	Value* value = alloc_value(value_size);
+	iovec iov[3] = {{&header, sizeof(Record_header)}, {key_copy, key_size}, {value->data, value_size}};
+	ssize_t read_size = preadv(tier->segments[location->segment].fd, iov, 3, location->offset);
+	bool is_key = read_size == location->record_size and header.hash == hash and header.key_size == key_size and memcmp(key_copy, key, key_size) == 0;
+	delete[] key_copy;
+	if(not is_key) {
+		release_value(value);
+		return NULL;
+	}
+	value->raw_size = header.raw_size;
+	*ret_value_size = value_size;
+	return value;
+}
+Value* disk_tier_take(Disk_tier* tier, Key_ptr key, Index* ret_value_size) {
+	Index key_size = strlen(key) + 1;
+	uint64_t hash = get_disk_hash(key, key_size);
+	std::lock_guard<std::mutex> guard(tier->lock);
+	auto found = tier->index.find(hash);
+	Value* value = NULL;
+	if(found != tier->index.end()) {
+		auto location = &found->second;
+		auto write = location->pending;
+		if(write == NULL) {
+			value = read_record(tier, location, hash, key, key_size, ret_value_size);
+		} else if(write->key_size == key_size and memcmp(write->key, key, key_size) == 0) {
+			//the writer hasn't gotten to it yet, so we share its value
+			retain_value(write->value);
+			value = write->value;
+			*ret_value_size = write->value_size;
+		}
+		if(value != NULL) {
+			forget_location(tier, location);
+			tier->index.erase(found);
+		}
+	}
+	if(value == NULL) {
+		tier->stats.miss_total += 1;
+	} else {
+		tier->stats.hit_total += 1;
+	}
+	return value;
+}
+bool disk_tier_remove(Disk_tier* tier, Key_ptr key) {
+	//returns whether there was a record to remove
+	//we don't read the record back to check its key, so a colliding key loses its disk copy too
+	uint64_t hash = get_disk_hash(key, strlen(key) + 1);
+	std::lock_guard<std::mutex> guard(tier->lock);
+	auto found = tier->index.find(hash);
+	if(found == tier->index.end()) {
+		return false;
+	}
+	forget_location(tier, &found->second);
+	tier->index.erase(found);
+	return true;
+}
+void disk_tier_flush(Disk_tier* tier) {
+	std::unique_lock<std::mutex> guard(tier->lock);
+	uint64_t target = tier->queued_total;
+	tier->work_done.wait(guard, [tier, target]() {return tier->finished_total >= target;});
+}
+Disk_tier_stats get_disk_tier_stats(Disk_tier* tier) {
+	std::lock_guard<std::mutex> guard(tier->lock);
+	Disk_tier_stats stats = tier->stats;
+	stats.entry_total = tier->index.size();
+	stats.pending_bytes = tier->pending_size;
+	stats.live_bytes = 0;
+	for(auto& segment : tier->segments) {
+		stats.live_bytes += segment.second.live_size;
+	}
+	stats.disk_bytes = tier->disk_size;
+	stats.segment_total = tier->segments.size();
+	return stats;
+}
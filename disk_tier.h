@@ -0,0 +1,27 @@
+//By Monica Moniot and Alyssa Riceman
+#ifndef DISK_TIER_H
+#define DISK_TIER_H
+#include "types.h"
+
+//A second tier for the cache on local disk, made of the entries it evicts
+//Victims are appended to log structured segment files by a writer thread, so evicting never waits on I/O;
+//until the writer gets to them they are served straight from memory
+//An in memory index maps the hash of each key to where its record lives
+//A key is never in both tiers at once: taking a key out of the disk tier removes it, since the cache then holds it
+//Segments that are mostly dead get their live records rewritten to the end of the log and are deleted,
+//and once the files exceed the tier's capacity the oldest segment is dropped whole
+
+Disk_tier* create_disk_tier(const char* dir, uint64_t capacity);
+//waits for the writer and deletes every segment file
+void destroy_disk_tier(Disk_tier* tier);
+
+//queues an evicted entry to be written; the tier takes its own reference to value
+void disk_tier_put(Disk_tier* tier, Key_ptr key, Index key_size, Value* value, Index value_size);
+//removes key from the tier and returns its value, or NULL if it isn't there
+Value* disk_tier_take(Disk_tier* tier, Key_ptr key, Index* ret_value_size);
+//forgets key if the tier has it, because the cache's copy has replaced it
+bool disk_tier_remove(Disk_tier* tier, Key_ptr key);
+//waits until every queued record has been written
+void disk_tier_flush(Disk_tier* tier);
+Disk_tier_stats get_disk_tier_stats(Disk_tier* tier);
+#endif
@@ -0,0 +1,87 @@
+//By Monica Moniot and Alyssa Riceman
+//Measures cache_set on a cache that is already full, so that every set has to make room, for several low
+//watermarks; each set is timed on its own so the latency percentiles show what batching evictions costs the
+//unlucky sets that evict a whole batch
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#include "cache.h"
+
+struct Options {
+	uint32_t cached_total;
+	uint32_t value_size;
+	uint32_t op_total;
+	evictor_type policy;
+};
+
+inline uint64_t get_time_ns() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+
+inline void make_key(char* key, uint32_t i) {
+	snprintf(key, 32, "key:%u", i);
+}
+
+void print_usage(const char* name) {
+	printf("Usage: %s [-k keys the cache holds] [-v value bytes] [-n sets] [-p policy, 0 FIFO to 6 RR]\n", name);
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	options.cached_total = 1000000;
+	options.value_size = 32;
+	options.op_total = 4000000;
+	options.policy = LRU;
+	int opt;
+	while((opt = getopt(argc, argv, "k:v:n:p:h")) != -1) {
+		if(opt == 'k') {
+			options.cached_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'v') {
+			options.value_size = strtoul(optarg, NULL, 10);
+		} else if(opt == 'n') {
+			options.op_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'p') {
+			options.policy = strtol(optarg, NULL, 10);
+		} else {
+			print_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if(options.cached_total == 0 or options.value_size == 0 or options.op_total == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	printf("room for %u values of %u bytes, %u sets of new keys\n", options.cached_total, options.value_size, options.op_total);
+
+	const uint32_t watermarks[] = {100, 99, 95, 90, 80};
+	char key[32];
+	std::vector<char> value(options.value_size, 'v');
+	std::vector<uint32_t> latencies(options.op_total);
+	for(uint32_t percent : watermarks) {
+		cache_type cache = create_cache(static_cast<uint64_t>(options.cached_total)*options.value_size, options.policy, NULL);
+		cache_set_low_watermark(cache, percent);
+		for(uint32_t i = 0; i < options.cached_total; i += 1) {
+			make_key(key, i);
+			cache_set(cache, key, value.data(), options.value_size);
+		}
+		uint64_t start_time = get_time_ns();
+		for(uint32_t i = 0; i < options.op_total; i += 1) {
+			make_key(key, options.cached_total + i);
+			uint64_t op_start = get_time_ns();
+			cache_set(cache, key, value.data(), options.value_size);
+			latencies[i] = get_time_ns() - op_start;
+		}
+		double s = (get_time_ns() - start_time)/1e9;
+		std::sort(latencies.begin(), latencies.end());
+		printf("low watermark %3u%%  %9.0f sets/s  p50 %5u ns  p99 %6u ns  p99.9 %7u ns  max %8u ns\n", percent, options.op_total/s,
+			latencies[options.op_total/2], latencies[options.op_total/100*99], latencies[options.op_total/1000*999], latencies[options.op_total - 1]);
+		destroy_cache(cache);
+	}
+	return 0;
+}
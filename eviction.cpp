@@ -43,20 +43,9 @@ void append   (DLL* list, Bookmark item_i, Node* node, Book* book) {
 	}
 }
 void prepend  (DLL* list, Bookmark item_i, Node* node, Book* book) {
-	auto head = list->head;
+	//the list is circular, so the new first item goes right behind the old head
+	append(list, item_i, node, book);
 	list->head = item_i;
-	if(head == INVALID_NODE) {
-		node->next = item_i;
-		node->pre = item_i;
-	} else {
-		Node* head_node = get_node(book, head);
-		auto first = head_node->next;
-		Node* first_node = get_node(book, first);
-		first_node->pre = item_i;
-		head_node->next = item_i;
-		node->next = first;
-		node->pre = head;
-	}
 }
 void set_last (DLL* list, Bookmark item_i, Node* node, Book* book) {
 	auto head = list->head;
@@ -83,27 +72,22 @@ void set_last (DLL* list, Bookmark item_i, Node* node, Book* book) {
 }
 void set_first(DLL* list, Bookmark item_i, Node* node, Book* book) {
 	auto head = list->head;
-	auto head_node = get_node(book, head);
-	list->head = item_i;
 	if(item_i == head) {
 		return;
 	}
-
-	auto first = head_node->next;
-	auto first_node = get_node(book, first);
-	auto next_i = node->next;
-	auto pre_i = node->pre;
-
-	first_node->pre = item_i;
-	head_node->next = item_i;
-	node->next = first;
-	node->pre = head;
-
-	get_node(book, pre_i)->next = next_i;
-	get_node(book, next_i)->pre = pre_i;
+	//unlink the item from where it currently is
+	get_node(book, node->pre)->next = node->next;
+	get_node(book, node->next)->pre = node->pre;
+	//relink it between the last item and the head
+	auto head_node = get_node(book, head);
+	auto last = head_node->pre;
+	get_node(book, last)->next = item_i;
+	head_node->pre = item_i;
+	node->next = head;
+	node->pre = last;
+	list->head = item_i;
 }
 
-
 void create_evictor(Evictor* evictor, evictor_type policy) {
 	evictor->policy = policy;
 	if(policy == FIFO or policy == LIFO or policy == LRU or policy == MRU or policy == CLOCK) {
@@ -169,6 +153,7 @@ void remove_evict_item (Evictor* evictor, Bookmark item_i, Evict_item* item, Boo
 				auto p_item = protect->head;
 				auto p_node = get_node(book, p_item);
 				remove(protect, p_item, p_node, book);
+				p_node->rf_bit = false;
 				append(prohibate, p_item, p_node, book);
 				dlist->pp_delta += 1;
 			} else {
@@ -219,6 +204,7 @@ void touch_evict_item  (Evictor* evictor, Bookmark item_i, Evict_item* item, Boo
 				auto p_item = protect->head;
 				auto p_node = get_node(book, p_item);
 				remove(protect, p_item, p_node, book);
+				p_node->rf_bit = false;
 				append(prohibate, p_item, p_node, book);
 			} else {
 				dlist->pp_delta -= 2;
@@ -242,7 +228,8 @@ Bookmark get_evict_item(Evictor* evictor, Book* book) {
 		auto node = get_node(book, item_i);
 		while(node->rf_bit) {
 			node->rf_bit = false;
-			item_i = get_node(book, item_i)->next;
+			item_i = node->next;
+			node = get_node(book, item_i);
 			list->head = item_i;
 		}
 		remove(list, item_i, node, book);
@@ -255,6 +242,7 @@ Bookmark get_evict_item(Evictor* evictor, Book* book) {
 			auto p_item = protect->head;
 			auto p_node = get_node(book, p_item);
 			remove(protect, p_item, p_node, book);
+			p_node->rf_bit = false;
 			append(prohibate, p_item, p_node, book);
 			dlist->pp_delta += 1;
 		} else {
@@ -265,7 +253,12 @@ Bookmark get_evict_item(Evictor* evictor, Book* book) {
 	} else {//RANDOM
 		auto data = &evictor->data.rand_data;
 		auto rand_items = static_cast<Bookmark*>(evictor->mem_arena);
-		auto rand_i0 = rand()%data->total_items;
+		Index rand_i0 = rand();
+		if(sizeof(Index) == 8) {
+			//rand only gives 31 bits, which wouldn't reach most of a big enough table
+			rand_i0 = (rand_i0<<31)^rand();
+		}
+		rand_i0 = rand_i0%data->total_items;
 		item_i = rand_items[rand_i0];
 		//We need to delete rand_i0 from rand_items in place
 		//this requires us to relink some data objects
@@ -277,3 +270,77 @@ Bookmark get_evict_item(Evictor* evictor, Book* book) {
 	}
 	return item_i;
 }
+
+void reorder(DLL* list, Book* book, bool is_reversing, bool is_clearing) {
+	//in a single walk over the list, turns it around so its last item is its head, and clears the items' bits
+	if(list->head == INVALID_NODE) {
+		return;
+	}
+	auto item_i = list->head;
+	do {
+		auto node = get_node(book, item_i);
+		auto next_i = node->next;
+		if(is_reversing) {
+			node->next = node->pre;
+			node->pre = next_i;
+		}
+		if(is_clearing) {
+			node->rf_bit = false;
+		}
+		item_i = next_i;
+	} while(item_i != list->head);
+	if(is_reversing) {
+		list->head = get_node(book, list->head)->next;
+	}
+}
+void join(DLL* list, DLL* other, Book* book) {
+	//puts the items of other behind the last item of list, in order, leaving other empty
+	if(other->head == INVALID_NODE) {
+		return;
+	} else if(list->head == INVALID_NODE) {
+		list->head = other->head;
+	} else {
+		auto head_node = get_node(book, list->head);
+		auto other_head_node = get_node(book, other->head);
+		auto last = head_node->pre;
+		auto other_last = other_head_node->pre;
+		get_node(book, last)->next = other->head;
+		other_head_node->pre = last;
+		get_node(book, other_last)->next = list->head;
+		head_node->pre = other_last;
+	}
+	other->head = INVALID_NODE;
+}
+void switch_evictor(Evictor* evictor, evictor_type policy, Book* book, Index item_total) {
+	auto pre_policy = evictor->policy;
+	if(policy == pre_policy) {
+		return;
+	}
+	//every item goes into one list, from the one to be evicted first to the one to be evicted last, except that
+	//LIFO and MRU evict from the newest end, so their list runs the other way
+	DLL list;
+	if(pre_policy == SLRU) {
+		//probation is evicted from before protected, and the protected items keep their bits set
+		list = evictor->data.dlist.prohibate;
+		join(&list, &evictor->data.dlist.protect, book);
+	} else {
+		list = evictor->data.list;
+	}
+	bool was_newest_first = pre_policy == LIFO or pre_policy == MRU;
+	bool is_newest_first = policy == LIFO or policy == MRU;
+	//SLRU starts everything out on probation, and the bits of the other policies mean nothing to CLOCK, apart from
+	//SLRU's, which mark what it was protecting
+	bool is_clearing = policy == SLRU or (policy == CLOCK and pre_policy != SLRU);
+	if(was_newest_first != is_newest_first or is_clearing) {
+		reorder(&list, book, was_newest_first != is_newest_first, is_clearing);
+	}
+	evictor->policy = policy;
+	if(policy == SLRU) {
+		auto dlist = &evictor->data.dlist;
+		dlist->prohibate = list;
+		dlist->protect.head = INVALID_NODE;
+		dlist->pp_delta = item_total;
+	} else {
+		evictor->data.list = list;
+	}
+}
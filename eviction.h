@@ -19,4 +19,12 @@ void add_evict_item    (Evictor* evictor, Bookmark item_i, Evict_item* item, Boo
 void remove_evict_item (Evictor* evictor, Bookmark item_i, Evict_item* item, Book* book);
 void touch_evict_item  (Evictor* evictor, Bookmark item_i, Evict_item* item, Book* book);
 Bookmark get_evict_item(Evictor* evictor, Book* book);//also removes item
+
+//every policy but RR keeps its items in lists through their nodes, so it can be switched to another in place
+constexpr bool is_list_policy(evictor_type policy) {
+	return policy == FIFO or policy == LIFO or policy == LRU or policy == MRU or policy == CLOCK or policy == SLRU;
+}
+//moves the items evictor holds, item_total of them, over to policy, keeping the order they would be evicted in as far
+//as the new policy allows; both policies must be list policies
+void switch_evictor(Evictor* evictor, evictor_type policy, Book* book, Index item_total);
 #endif
@@ -0,0 +1,163 @@
+//By Monica Moniot and Alyssa Riceman
+//Measures what front caches save on hot keys: several threads share a cache behind one lock, each making a Zipf
+//distributed mix of gets and a few sets, with gets either taking the lock for cache_pin or going through a front of their own
+//Prints the total throughput of each at several thread counts, and how many gets the fronts answered
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "cache.h"
+
+constexpr int RUN_TOTAL = 3;
+
+struct Options {
+	uint32_t key_total;
+	uint32_t value_size;
+	uint32_t op_total;//per thread
+	uint32_t set_per_mille;
+	uint32_t max_threads;
+};
+
+inline uint64_t get_time_ns() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+
+inline void make_key(char* key, uint32_t i) {
+	snprintf(key, 32, "key:%u", i);
+}
+
+void print_usage(const char* name) {
+	printf("Usage: %s [-k keys] [-v value bytes] [-n operations per thread] [-s sets per 1000 operations] [-t most threads]\n", name);
+}
+
+double run_threads(const Options* options, uint32_t thread_total, bool is_fronted, double* ret_hit_ratio) {
+	cache_type cache = create_cache(static_cast<uint64_t>(options->key_total)*options->value_size, LRU, NULL);
+	std::mutex lock;
+	std::vector<char> value(options->value_size, 'v');
+	char key[32];
+	for(uint32_t i = 0; i < options->key_total; i += 1) {
+		make_key(key, i);
+		cache_set(cache, key, value.data(), options->value_size);
+	}
+	//the keys each thread uses are picked and formatted before the clock starts, so only the cache is timed
+	std::vector<std::vector<char>> keys(options->key_total, std::vector<char>(32));
+	for(uint32_t i = 0; i < options->key_total; i += 1) {
+		make_key(keys[i].data(), i);
+	}
+	std::vector<std::vector<uint32_t>> picks(thread_total, std::vector<uint32_t>(options->op_total));
+	double log_keys = log(options->key_total);
+	for(uint32_t t = 0; t < thread_total; t += 1) {
+		uint32_t seed = t + 1;
+		for(uint32_t i = 0; i < options->op_total; i += 1) {
+			//key k comes up about in proportion to 1/(k + 1), as in Zipf's law, so a few keys make up most gets
+			seed = seed*1103515245 + 12345;
+			double uniform = static_cast<double>(seed>>8)/(1<<24);
+			uint32_t pick = static_cast<uint32_t>(exp(uniform*log_keys)) - 1;
+			//the top bit marks a set
+			picks[t][i] = (seed>>4)%1000 < options->set_per_mille ? pick|0x80000000u : pick;
+		}
+	}
+	std::vector<Front_stats> stats(thread_total);
+	std::vector<std::thread> threads;
+	uint64_t start_time = get_time_ns();
+	for(uint32_t t = 0; t < thread_total; t += 1) {
+		threads.emplace_back([&, t] {
+			front_type front = is_fronted ? cache_create_front(cache, &lock, 0) : NULL;
+			uint64_t checksum = 0;
+			for(uint32_t pick : picks[t]) {
+				const char* thread_key = keys[pick&0x7FFFFFFFu].data();
+				if(pick&0x80000000u) {
+					std::lock_guard<std::mutex> guard(lock);
+					cache_set(cache, thread_key, value.data(), options->value_size);
+					continue;
+				}
+				val_type val;
+				index_type val_size;
+				pin_type pin;
+				if(is_fronted) {
+					pin = cache_front_pin(front, thread_key, &val, &val_size);
+				} else {
+					std::lock_guard<std::mutex> guard(lock);
+					pin = cache_pin(cache, thread_key, &val, &val_size);
+				}
+				if(pin != NULL) {
+					checksum += static_cast<const char*>(val)[0];
+					cache_unpin(pin);
+				}
+			}
+			if(is_fronted) {
+				stats[t] = cache_front_stats(front);
+				cache_destroy_front(front);
+			}
+			if(checksum == 0) {
+				printf("every get missed\n");
+			}
+		});
+	}
+	for(auto& thread : threads) {
+		thread.join();
+	}
+	double ops_per_s = static_cast<double>(options->op_total)*thread_total/((get_time_ns() - start_time)/1e9);
+	uint64_t hit_total = 0;
+	uint64_t get_total = 0;
+	for(auto& thread_stats : stats) {
+		hit_total += thread_stats.hit_total;
+		get_total += thread_stats.hit_total + thread_stats.miss_total;
+	}
+	*ret_hit_ratio = get_total == 0 ? 0 : static_cast<double>(hit_total)/get_total;
+	destroy_cache(cache);
+	return ops_per_s;
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	options.key_total = 100000;
+	options.value_size = 64;
+	options.op_total = 1000000;
+	options.set_per_mille = 10;
+	options.max_threads = 8;
+	int opt;
+	while((opt = getopt(argc, argv, "k:v:n:s:t:h")) != -1) {
+		if(opt == 'k') {
+			options.key_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'v') {
+			options.value_size = strtoul(optarg, NULL, 10);
+		} else if(opt == 'n') {
+			options.op_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 's') {
+			options.set_per_mille = strtoul(optarg, NULL, 10);
+		} else if(opt == 't') {
+			options.max_threads = strtoul(optarg, NULL, 10);
+		} else {
+			print_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if(options.key_total == 0 or options.op_total == 0 or options.max_threads == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	printf("%u operations per thread on %u keys, %u in 1000 of them sets, on %u cores\n", options.op_total, options.key_total, options.set_per_mille, std::thread::hardware_concurrency());
+	printf("%8s %14s %14s %8s %10s\n", "threads", "locked ops/s", "fronted ops/s", "change", "front hits");
+	for(uint32_t thread_total = 1; thread_total <= options.max_threads; thread_total *= 2) {
+		//the two take turns, and each keeps its best run, since the difference is small next to the noise of one run
+		double locked = 0;
+		double fronted = 0;
+		double hit_ratio = 0;
+		for(int run = 0; run < RUN_TOTAL; run += 1) {
+			double ops_per_s = run_threads(&options, thread_total, false, &hit_ratio);
+			locked = ops_per_s > locked ? ops_per_s : locked;
+			ops_per_s = run_threads(&options, thread_total, true, &hit_ratio);
+			fronted = ops_per_s > fronted ? ops_per_s : fronted;
+		}
+		printf("%8u %14.0f %14.0f %+7.1f%% %10.4f\n", thread_total, locked, fronted, 100*(fronted - locked)/locked, hit_ratio);
+	}
+	return 0;
+}
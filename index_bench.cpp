@@ -0,0 +1,89 @@
+//By Monica Moniot and Alyssa Riceman
+//Compares the two widths of index_type: make index_bench builds this as is and index_bench64 with CACHE_INDEX_64
+//A cache is filled with small values, then hit with random gets and sets, and the memory it takes per entry
+//is read back from cache_memory_report
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "cache.h"
+
+struct Options {
+	uint32_t key_total;
+	uint32_t value_size;
+	uint32_t op_total;
+};
+
+inline uint64_t get_time_ns() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+
+inline void make_key(char* key, uint32_t i) {
+	snprintf(key, 32, "key:%u", i);
+}
+
+void print_usage(const char* name) {
+	printf("Usage: %s [-k keys] [-v value bytes] [-n operations]\n", name);
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	options.key_total = 2000000;
+	options.value_size = 16;
+	options.op_total = 4000000;
+	int opt;
+	while((opt = getopt(argc, argv, "k:v:n:h")) != -1) {
+		if(opt == 'k') {
+			options.key_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'v') {
+			options.value_size = strtoul(optarg, NULL, 10);
+		} else if(opt == 'n') {
+			options.op_total = strtoul(optarg, NULL, 10);
+		} else {
+			print_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if(options.key_total == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	uint64_t mem_capacity = 4*static_cast<uint64_t>(options.key_total)*options.value_size;
+	cache_type cache = create_cache(mem_capacity > UINT32_MAX ? UINT32_MAX : mem_capacity, LRU, NULL);
+	char key[32];
+	std::vector<char> value(options.value_size, 'v');
+	uint64_t start_time = get_time_ns();
+	for(uint32_t i = 0; i < options.key_total; i += 1) {
+		make_key(key, i);
+		cache_set(cache, key, value.data(), options.value_size);
+	}
+	double fill_s = (get_time_ns() - start_time)/1e9;
+
+	uint32_t seed = 1;
+	start_time = get_time_ns();
+	for(uint32_t i = 0; i < options.op_total; i += 1) {
+		seed = seed*1103515245 + 12345;
+		make_key(key, (seed>>8)%options.key_total);
+		if(seed&(1<<30)) {
+			cache_set(cache, key, value.data(), options.value_size);
+		} else {
+			index_type val_size;
+			cache_get(cache, key, &val_size);
+		}
+	}
+	double mix_s = (get_time_ns() - start_time)/1e9;
+
+	Memory_report report = cache_memory_report(cache);
+	double entries = options.key_total;
+	printf("%u byte index, %u keys of %u bytes\n", static_cast<uint32_t>(sizeof(index_type)), options.key_total, options.value_size);
+	printf("table %6.1f B/entry  pages %6.1f B/entry  everything %6.1f B/entry\n",
+		report.table_bytes/entries, report.page_bytes/entries, report.total/entries);
+	printf("fill %9.0f sets/s  mix %9.0f ops/s\n", options.key_total/fill_s, options.op_total/mix_s);
+	destroy_cache(cache);
+	return 0;
+}
@@ -0,0 +1,97 @@
+//By Monica Moniot and Alyssa Riceman
+//Finds where scanning a linear index stops beating the hash table: for several key sizes and numbers of entries,
+//a cache is filled once with cache_set_linear_threshold at 0, so it only hashes, and once at 256, so it only
+//scans, and then hit with gets of random keys it holds
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "cache.h"
+
+struct Options {
+	uint32_t get_total;
+};
+
+inline uint64_t get_time_ns() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+
+inline std::string make_key(uint32_t i, uint32_t key_size, bool is_worst_case) {
+	//keys differ by a number near their start, or, in the worst case for the tags, only between the 8 byte windows
+	//the tags are made from, so that every key has the same tag and each get compares keys until it finds its own
+	std::string number = std::to_string(i);
+	std::string key(key_size, 'k');
+	key.replace(is_worst_case ? key_size/4 : 4, number.size(), number);
+	return key;
+}
+
+double time_gets(uint32_t entry_total, uint32_t key_size, bool is_worst_case, index_type threshold, uint32_t get_total) {
+	cache_type cache = create_cache(1<<24, LRU, NULL);
+	cache_set_linear_threshold(cache, threshold);
+	std::vector<std::string> keys;
+	uint64_t value = 0;
+	for(uint32_t i = 0; i < entry_total; i += 1) {
+		keys.push_back(make_key(i, key_size, is_worst_case));
+		cache_set(cache, keys[i].c_str(), &value, sizeof(value));
+	}
+	uint32_t seed = 1;
+	index_type val_size;
+	uint64_t found_total = 0;
+	uint64_t start_time = get_time_ns();
+	for(uint32_t i = 0; i < get_total; i += 1) {
+		seed = seed*1103515245 + 12345;
+		found_total += cache_get(cache, keys[(seed>>8)%entry_total].c_str(), &val_size) != NULL;
+	}
+	double ns = static_cast<double>(get_time_ns() - start_time)/get_total;
+	destroy_cache(cache);
+	if(found_total != get_total) {
+		printf("Error: a key went missing\n");
+	}
+	return ns;
+}
+
+void print_usage(const char* name) {
+	printf("Usage: %s [-n gets per measurement]\n", name);
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	options.get_total = 2000000;
+	int opt;
+	while((opt = getopt(argc, argv, "n:h")) != -1) {
+		if(opt == 'n') {
+			options.get_total = strtoul(optarg, NULL, 10);
+		} else {
+			print_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if(options.get_total == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	//the worst case needs keys too long for their windows to cover them
+	const uint32_t key_sizes[] = {8, 32, 128, 32, 128};
+	const bool is_worst_cases[] = {false, false, false, true, true};
+	const uint32_t entry_totals[] = {2, 4, 8, 16, 24, 32, 48, 64, 96, 128, 192, 256};
+	printf("ns per get, hash table / linear index\n%8s", "entries");
+	for(uint32_t k = 0; k < 5; k += 1) {
+		printf("  %3u byte keys%s", key_sizes[k], is_worst_cases[k] ? ", worst" : "       ");
+	}
+	printf("\n");
+	for(uint32_t entry_total : entry_totals) {
+		printf("%8u", entry_total);
+		for(uint32_t k = 0; k < 5; k += 1) {
+			double hash_ns = time_gets(entry_total, key_sizes[k], is_worst_cases[k], 0, options.get_total);
+			double linear_ns = time_gets(entry_total, key_sizes[k], is_worst_cases[k], 256, options.get_total);
+			printf("  %6.1f / %6.1f  ", hash_ns, linear_ns);
+		}
+		printf("\n");
+	}
+	return 0;
+}
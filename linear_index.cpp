@@ -0,0 +1,118 @@
+//By Monica Moniot and Alyssa Riceman
+#include <stdlib.h>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "types.h"
+#include "book.h"
+#include "linear_index.h"
+
+constexpr Index TAGS_PER_VECTOR = 4;
+
+struct Linear_index {
+	Index total;
+	Index capacity;
+	//tags and bookmarks are in the same order, and the tags past total are kept as 0 so that whole vectors can be
+	//compared; no key has the tag 0, since every tag has its top bit set
+	uint32_t* tags;
+	Bookmark* bookmarks;
+};
+
+inline Index round_to_vector(Index capacity) {
+	return (capacity + TAGS_PER_VECTOR - 1)/TAGS_PER_VECTOR*TAGS_PER_VECTOR;
+}
+
+Linear_index* create_linear_index(Index capacity) {
+	capacity = capacity > MAX_LINEAR_CAPACITY ? MAX_LINEAR_CAPACITY : capacity;
+	Index tag_capacity = round_to_vector(capacity);
+	//one allocation holds the index and both arrays, so a lookup touches as few lines as possible
+	byte* mem = new byte[sizeof(Linear_index) + sizeof(uint32_t)*tag_capacity + sizeof(Bookmark)*capacity];
+	Linear_index* index = reinterpret_cast<Linear_index*>(mem);
+	index->total = 0;
+	index->capacity = capacity;
+	index->tags = reinterpret_cast<uint32_t*>(mem + sizeof(Linear_index));
+	index->bookmarks = reinterpret_cast<Bookmark*>(mem + sizeof(Linear_index) + sizeof(uint32_t)*tag_capacity);
+	memset(index->tags, 0, sizeof(uint32_t)*tag_capacity);
+	return index;
+}
+void destroy_linear_index(Linear_index* index) {
+	delete[] reinterpret_cast<byte*>(index);
+}
+
+uint32_t get_linear_tag(Key_ptr key, Index key_size) {
+	//mixes the size with the first, middle and last 8 bytes of the key, which covers all of a key up to 16 bytes
+	uint64_t head = 0;
+	uint64_t middle = 0;
+	uint64_t tail = 0;
+	Index size = key_size - 1;
+	if(size >= 8) {
+		memcpy(&head, key, 8);
+		memcpy(&tail, key + size - 8, 8);
+		if(size > 16) {
+			memcpy(&middle, key + size/2 - 4, 8);
+		}
+	} else {
+		memcpy(&head, key, size);
+	}
+	uint64_t mix = (head*0x9E3779B97F4A7C15ull)^(middle*0xFF51AFD7ED558CCDull)^(tail*0xC2B2AE3D27D4EB4Full)^(static_cast<uint64_t>(size)*0x165667B19E3779F9ull);
+	return static_cast<uint32_t>(mix>>32)|0x80000000u;
+}
+
+bool linear_index_insert(Linear_index* index, uint32_t tag, Bookmark bookmark) {
+	if(index->total >= index->capacity) {
+		return false;
+	}
+	index->tags[index->total] = tag;
+	index->bookmarks[index->total] = bookmark;
+	index->total += 1;
+	return true;
+}
+void linear_index_remove(Linear_index* index, Bookmark bookmark) {
+	//the last entry takes the removed one's place, so the tags stay packed
+	for(Index i = 0; i < index->total; i += 1) {
+		if(index->bookmarks[i] == bookmark) {
+			Index last_i = index->total - 1;
+			index->tags[i] = index->tags[last_i];
+			index->bookmarks[i] = index->bookmarks[last_i];
+			index->tags[last_i] = 0;
+			index->total = last_i;
+			return;
+		}
+	}
+}
+
+inline bool is_match(const Linear_index* index, const Book* book, Index i, Key_ptr key, Index key_size) {
+	const Entry* entry = read_book(book, index->bookmarks[i]);
+	return entry->key_size == key_size and memcmp(entry->key, key, key_size) == 0;
+}
+Bookmark linear_index_find(const Linear_index* index, const Book* book, Key_ptr key, Index key_size) {
+	uint32_t tag = get_linear_tag(key, key_size);
+	const uint32_t* tags = index->tags;
+	Index total = index->total;
+#ifdef __SSE2__
+	const __m128i tag_vector = _mm_set1_epi32(static_cast<int>(tag));
+	for(Index i = 0; i < total; i += TAGS_PER_VECTOR) {
+		__m128i cur = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tags + i));
+		int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(cur, tag_vector)));
+		while(mask != 0) {
+			Index match_i = i + __builtin_ctz(mask);
+			if(is_match(index, book, match_i, key, key_size)) {
+				return index->bookmarks[match_i];
+			}
+			mask &= mask - 1;
+		}
+	}
+#else
+	for(Index i = 0; i < total; i += 1) {
+		if(tags[i] == tag and is_match(index, book, i, key, key_size)) {
+			return index->bookmarks[i];
+		}
+	}
+#endif
+	return NO_BOOKMARK;
+}
+
+uint64_t get_linear_index_size(const Linear_index* index) {
+	return sizeof(Linear_index) + sizeof(uint32_t)*round_to_vector(index->capacity) + sizeof(Bookmark)*index->capacity;
+}
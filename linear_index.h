@@ -0,0 +1,27 @@
+//By Monica Moniot and Alyssa Riceman
+#ifndef LINEAR_INDEX_H
+#define LINEAR_INDEX_H
+#include "types.h"
+#include "book.h"
+
+//An index for caches of a few dozen entries, where scanning every entry beats hashing the key and probing the table
+//Each entry has a 32 bit tag made from its key's size and its first, middle and last 8 bytes, so a tag takes no pass over
+//the key beyond finding its size; the tags are packed together and compared with the key's 4 at a time using SSE2
+//Only entries whose tag matches have their keys compared
+//The hash table stays the cache's record of its entries; this only answers lookups, by Bookmark
+
+constexpr Bookmark NO_BOOKMARK = -1;
+constexpr Index MAX_LINEAR_CAPACITY = 256;
+
+Linear_index* create_linear_index(Index capacity);
+void destroy_linear_index(Linear_index* index);
+
+uint32_t get_linear_tag(Key_ptr key, Index key_size);
+//returns false without inserting if the index is full
+bool linear_index_insert(Linear_index* index, uint32_t tag, Bookmark bookmark);
+void linear_index_remove(Linear_index* index, Bookmark bookmark);
+//key_size includes the null terminator; returns NO_BOOKMARK if key isn't in the index
+Bookmark linear_index_find(const Linear_index* index, const Book* book, Key_ptr key, Index key_size);
+//bytes of memory the index has allocated
+uint64_t get_linear_index_size(const Linear_index* index);
+#endif
@@ -0,0 +1,128 @@
+//By Monica Moniot and Alyssa Riceman
+//Measures how many times a slow backend is called when many threads share a cache too small for their keys
+//Each thread picks random keys; with cache_get the threads that miss on a key at once all call the backend,
+//then all set it, while with cache_get_or_load only the first calls it and the rest wait for its value
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "cache.h"
+
+struct Options {
+	uint32_t thread_total;
+	uint32_t key_total;
+	uint32_t cached_total;
+	uint32_t op_total;
+	uint32_t load_us;
+};
+
+inline uint64_t get_time_ns() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+
+inline void make_key(char* key, uint32_t i) {
+	snprintf(key, 32, "key:%u", i);
+}
+
+const uint32_t VALUE_SIZE = 100;
+struct Backend {
+	std::atomic<uint64_t> load_total;
+	uint32_t load_us;
+};
+void* load_from_backend(void* data, key_type, index_type* val_size) {
+	Backend* backend = static_cast<Backend*>(data);
+	backend->load_total += 1;
+	usleep(backend->load_us);
+	void* val = malloc(VALUE_SIZE);
+	memset(val, 'v', VALUE_SIZE);
+	*val_size = VALUE_SIZE;
+	return val;
+}
+
+void print_usage(const char* name) {
+	printf("Usage: %s [-t threads] [-k keys] [-c keys the cache holds] [-n gets per thread] [-l backend us]\n", name);
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	options.thread_total = 32;
+	options.key_total = 20;
+	options.cached_total = 10;
+	options.op_total = 2000;
+	options.load_us = 1000;
+	int opt;
+	while((opt = getopt(argc, argv, "t:k:c:n:l:h")) != -1) {
+		if(opt == 't') {
+			options.thread_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'k') {
+			options.key_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'c') {
+			options.cached_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'n') {
+			options.op_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'l') {
+			options.load_us = strtoul(optarg, NULL, 10);
+		} else {
+			print_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if(options.thread_total == 0 or options.key_total == 0 or options.cached_total == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	printf("%u threads, %u keys, room for %u, backend takes %u us\n", options.thread_total, options.key_total, options.cached_total, options.load_us);
+
+	for(int is_single_flight = 0; is_single_flight < 2; is_single_flight += 1) {
+		cache_type cache = create_cache(options.cached_total*VALUE_SIZE, LRU, NULL);
+		std::mutex lock;
+		Backend backend;
+		backend.load_total = 0;
+		backend.load_us = options.load_us;
+		uint64_t start_time = get_time_ns();
+		std::vector<std::thread> threads;
+		for(uint32_t t = 0; t < options.thread_total; t += 1) {
+			threads.emplace_back([&, t] {
+				char key[32];
+				uint32_t seed = t + 1;
+				for(uint32_t i = 0; i < options.op_total; i += 1) {
+					seed = seed*1103515245 + 12345;
+					make_key(key, (seed>>8)%options.key_total);
+					val_type val;
+					index_type val_size;
+					if(is_single_flight) {
+						cache_unpin(cache_get_or_load(cache, &lock, key, &load_from_backend, &backend, 0, 0, &val, &val_size));
+						continue;
+					}
+					lock.lock();
+					pin_type pin = cache_pin(cache, key, &val, &val_size);
+					lock.unlock();
+					if(pin != NULL) {
+						cache_unpin(pin);
+						continue;
+					}
+					void* loaded = load_from_backend(&backend, key, &val_size);
+					lock.lock();
+					cache_set(cache, key, loaded, val_size);
+					lock.unlock();
+					free(loaded);
+				}
+			});
+		}
+		for(auto& thread : threads) {
+			thread.join();
+		}
+		double s = (get_time_ns() - start_time)/1e9;
+		double get_total = static_cast<double>(options.thread_total)*options.op_total;
+		printf("%-18s %8llu backend calls  %9.0f gets/s\n", is_single_flight ? "cache_get_or_load" : "cache_pin + set", static_cast<unsigned long long>(backend.load_total.load()), get_total/s);
+		destroy_cache(cache);
+	}
+	return 0;
+}
@@ -0,0 +1,415 @@
+//By Monica Moniot and Alyssa Riceman
+//A load generator for the cache server speaking the memcached text protocol
+//Every thread drives many non-blocking connections from its own epoll loop,
+//each with one request in flight, and records the latency of every request
+//Values are derived from their key, so every hit is also checked for corruption
+//With -b it speaks the binary protocol of protocol.h instead, which is what large value runs should use
+#include <stdlib.h>
+#include <stdio.h>
+#include <cstring>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "protocol.h"
+
+struct Options {
+	const char* host;
+	uint16_t port;
+	uint32_t thread_total;
+	uint32_t conn_total;//per thread
+	double duration;
+	uint32_t key_total;
+	uint32_t value_size;
+	double get_ratio;
+	bool is_prefilling;
+	bool is_binary;
+};
+struct Conn_state {
+	int fd;
+	bool is_get;
+	uint32_t key_i;
+	uint64_t sent_time;
+	std::string out;
+	size_t out_start;
+	std::string in;
+};
+struct Thread_result {
+	std::vector<uint64_t> latencies;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t sets;
+	uint64_t errors;
+};
+
+static Options options;
+static std::atomic<bool> is_running;
+
+inline uint64_t now_ns() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+inline uint64_t xorshift(uint64_t* state) {
+	auto x = *state;
+	x ^= x<<13;
+	x ^= x>>7;
+	x ^= x<<17;
+	*state = x;
+	return x;
+}
+
+void make_key(uint32_t key_i, char* key) {
+	sprintf(key, "key:%u", key_i);
+}
+void make_value(uint32_t key_i, std::string* value) {
+	char key[32];
+	make_key(key_i, key);
+	auto key_size = strlen(key);
+	value->resize(options.value_size);
+	for(uint32_t i = 0; i < options.value_size; i += 1) {
+		(*value)[i] = key[i%key_size];
+	}
+}
+
+int connect_to_server(bool is_blocking) {
+	int fd = socket(AF_INET, SOCK_STREAM | (is_blocking ? 0 : SOCK_NONBLOCK), 0);
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(options.port);
+	inet_pton(AF_INET, options.host, &addr.sin_addr);
+	if(connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 and errno != EINPROGRESS) {
+		perror("connect");
+		exit(1);
+	}
+	return fd;
+}
+
+void make_binary_request(std::string* request, uint8_t opcode, const char* key, const std::string* value) {
+	Binary_request header;
+	header.magic = BINARY_REQUEST_MAGIC;
+	header.opcode = opcode;
+	header.key_size = strlen(key);
+	header.value_size = value == NULL ? 0 : value->size();
+	header.opaque = 0;
+	request->assign(reinterpret_cast<const char*>(&header), sizeof(header));
+	*request += key;
+	if(value != NULL) {
+		*request += *value;
+	}
+}
+
+void prefill() {
+	//populates every key before the measured run, so gets start out hitting
+	int fd = connect_to_server(true);
+	std::string value;
+	std::string request;
+	char key[32];
+	char reply[64];
+	for(uint32_t i = 0; i < options.key_total; i += 1) {
+		make_key(i, key);
+		make_value(i, &value);
+		size_t reply_size;
+		if(options.is_binary) {
+			make_binary_request(&request, BINARY_SET, key, &value);
+			reply_size = sizeof(Binary_response);
+		} else {
+			request = "set " + std::string(key) + " 0 0 " + std::to_string(value.size()) + "\r\n" + value + "\r\n";
+			reply_size = 8;//"STORED\r\n"
+		}
+		size_t sent = 0;
+		while(sent < request.size()) {
+			auto n = send(fd, request.data() + sent, request.size() - sent, 0);
+			if(n <= 0) {
+				printf("Error during prefill: connection lost\n");
+				exit(1);
+			}
+			sent += n;
+		}
+		size_t got = 0;
+		while(got < reply_size) {
+			auto n = recv(fd, reply + got, sizeof(reply) - got, 0);
+			if(n <= 0) {
+				printf("Error during prefill: connection lost\n");
+				exit(1);
+			}
+			got += n;
+		}
+	}
+	close(fd);
+}
+
+void send_next_request(Conn_state* conn, uint64_t* rng, std::string* value) {
+	char key[32];
+	conn->key_i = xorshift(rng)%options.key_total;
+	conn->is_get = (xorshift(rng)%10000) < options.get_ratio*10000;
+	make_key(conn->key_i, key);
+	conn->out.clear();
+	conn->out_start = 0;
+	if(options.is_binary) {
+		if(conn->is_get) {
+			make_binary_request(&conn->out, BINARY_GET, key, NULL);
+		} else {
+			make_value(conn->key_i, value);
+			make_binary_request(&conn->out, BINARY_SET, key, value);
+		}
+	} else if(conn->is_get) {
+		conn->out += "get ";
+		conn->out += key;
+		conn->out += "\r\n";
+	} else {
+		make_value(conn->key_i, value);
+		conn->out += "set ";
+		conn->out += key;
+		conn->out += " 0 0 " + std::to_string(value->size()) + "\r\n";
+		conn->out += *value;
+		conn->out += "\r\n";
+	}
+	conn->sent_time = now_ns();
+}
+
+int parse_binary_response(Conn_state* conn, Thread_result* result, std::string* value) {
+	auto& in = conn->in;
+	if(in.size() < sizeof(Binary_response)) {
+		return 0;
+	}
+	Binary_response response;
+	memcpy(&response, in.data(), sizeof(response));
+	size_t total = sizeof(response) + response.value_size;
+	if(in.size() < total) {
+		return 0;
+	}
+	if(response.magic != BINARY_RESPONSE_MAGIC) {
+		result->errors += 1;
+		in.clear();
+		return 1;
+	}
+	if(not conn->is_get) {
+		result->sets += 1;
+		if(response.status != BINARY_OK) {
+			result->errors += 1;
+		}
+	} else if(response.status == BINARY_NOT_FOUND) {
+		result->misses += 1;
+	} else {
+		result->hits += 1;
+		make_value(conn->key_i, value);
+		if(response.status != BINARY_OK or response.value_size != value->size() or in.compare(sizeof(response), response.value_size, *value) != 0) {
+			result->errors += 1;
+		}
+	}
+	in.erase(0, total);
+	return 1;
+}
+int parse_response(Conn_state* conn, Thread_result* result, std::string* value) {
+	//returns 1 once a full response has been consumed, 0 if more data is needed
+	if(options.is_binary) {
+		return parse_binary_response(conn, result, value);
+	}
+	auto& in = conn->in;
+	if(not conn->is_get) {
+		auto end = in.find("\r\n");
+		if(end == std::string::npos) {
+			return 0;
+		}
+		if(in.compare(0, end, "STORED") != 0) {
+			result->errors += 1;
+		}
+		result->sets += 1;
+		in.erase(0, end + 2);
+		return 1;
+	}
+	if(in.compare(0, 5, "END\r\n") == 0) {
+		result->misses += 1;
+		in.erase(0, 5);
+		return 1;
+	}
+	auto line_end = in.find("\r\n");
+	if(line_end == std::string::npos) {
+		return 0;
+	}
+	unsigned flags;
+	size_t data_size;
+	char key[256];
+	if(sscanf(in.c_str(), "VALUE %255s %u %zu", key, &flags, &data_size) != 3) {
+		result->errors += 1;
+		in.clear();
+		return 1;
+	}
+	auto total = line_end + 2 + data_size + 2 + 5;
+	if(in.size() < total) {
+		return 0;
+	}
+	make_value(conn->key_i, value);
+	if(data_size != value->size() or in.compare(line_end + 2, data_size, *value) != 0 or in.compare(total - 5, 5, "END\r\n") != 0) {
+		result->errors += 1;
+	}
+	result->hits += 1;
+	in.erase(0, total);
+	return 1;
+}
+
+void run_thread(uint32_t thread_i, Thread_result* result) {
+	uint64_t rng = 0x9E3779B97F4A7C15ull*(thread_i + 1);
+	int epoll_fd = epoll_create1(0);
+	std::vector<Conn_state> conns(options.conn_total);
+	std::string value;
+	for(auto& conn : conns) {
+		conn.fd = connect_to_server(false);
+		epoll_event event;
+		event.events = EPOLLIN | EPOLLOUT;
+		event.data.ptr = &conn;
+		epoll_ctl(epoll_fd, EPOLL_CTL_ADD, conn.fd, &event);
+		send_next_request(&conn, &rng, &value);
+	}
+	epoll_event events[256];
+	char buffer[64*1024];
+	while(is_running.load(std::memory_order_relaxed)) {
+		int event_total = epoll_wait(epoll_fd, events, 256, 10);
+		for(int i = 0; i < event_total; i += 1) {
+			auto conn = static_cast<Conn_state*>(events[i].data.ptr);
+			if(events[i].events & (EPOLLERR | EPOLLHUP)) {
+				printf("Error: connection to server lost\n");
+				exit(1);
+			}
+			if(events[i].events & EPOLLIN) {
+				while(true) {
+					auto got = recv(conn->fd, buffer, sizeof(buffer), 0);
+					if(got <= 0) {
+						if(got == 0) {
+							printf("Error: server closed the connection\n");
+							exit(1);
+						}
+						break;
+					}
+					conn->in.append(buffer, got);
+				}
+				if(parse_response(conn, result, &value)) {
+					result->latencies.push_back(now_ns() - conn->sent_time);
+					send_next_request(conn, &rng, &value);
+				}
+			}
+			while(conn->out_start < conn->out.size()) {
+				auto sent = send(conn->fd, conn->out.data() + conn->out_start, conn->out.size() - conn->out_start, MSG_NOSIGNAL);
+				if(sent <= 0) {
+					break;
+				}
+				conn->out_start += sent;
+			}
+			epoll_event event;
+			event.events = conn->out_start < conn->out.size() ? EPOLLIN | EPOLLOUT : EPOLLIN;
+			event.data.ptr = conn;
+			epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+		}
+	}
+	for(auto& conn : conns) {
+		close(conn.fd);
+	}
+	close(epoll_fd);
+}
+
+
+void print_usage(const char* name) {
+	printf("Usage: %s [-H host] [-p port] [-t threads] [-c connections per thread] [-d seconds] [-k keys] [-v value bytes] [-r get ratio] [-n (no prefill)] [-b (binary protocol)]\n", name);
+}
+
+int main(int argc, char** argv) {
+	options.host = "127.0.0.1";
+	options.port = 11211;
+	options.thread_total = 4;
+	options.conn_total = 32;
+	options.duration = 5;
+	options.key_total = 10000;
+	options.value_size = 100;
+	options.get_ratio = .9;
+	options.is_prefilling = true;
+	options.is_binary = false;
+	int opt;
+	while((opt = getopt(argc, argv, "H:p:t:c:d:k:v:r:nbh")) != -1) {
+		if(opt == 'H') {
+			options.host = optarg;
+		} else if(opt == 'p') {
+			options.port = atoi(optarg);
+		} else if(opt == 't') {
+			options.thread_total = atoi(optarg);
+		} else if(opt == 'c') {
+			options.conn_total = atoi(optarg);
+		} else if(opt == 'd') {
+			options.duration = atof(optarg);
+		} else if(opt == 'k') {
+			options.key_total = atoi(optarg);
+		} else if(opt == 'v') {
+			options.value_size = atoi(optarg);
+		} else if(opt == 'r') {
+			options.get_ratio = atof(optarg);
+		} else if(opt == 'n') {
+			options.is_prefilling = false;
+		} else if(opt == 'b') {
+			options.is_binary = true;
+		} else {
+			print_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if(options.thread_total == 0 or options.conn_total == 0 or options.key_total == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	if(options.is_prefilling) {
+		prefill();
+	}
+
+	is_running = true;
+	std::vector<Thread_result> results(options.thread_total);
+	std::vector<std::thread> threads;
+	auto start_time = now_ns();
+	for(uint32_t i = 0; i < options.thread_total; i += 1) {
+		results[i] = Thread_result();
+		threads.emplace_back(run_thread, i, &results[i]);
+	}
+	usleep(static_cast<useconds_t>(options.duration*1000000));
+	is_running = false;
+	for(auto& thread : threads) {
+		thread.join();
+	}
+	double elapsed = (now_ns() - start_time)/1e9;
+
+	std::vector<uint64_t> latencies;
+	uint64_t hits = 0, misses = 0, sets = 0, errors = 0;
+	for(auto& result : results) {
+		latencies.insert(latencies.end(), result.latencies.begin(), result.latencies.end());
+		hits += result.hits;
+		misses += result.misses;
+		sets += result.sets;
+		errors += result.errors;
+	}
+	if(latencies.empty()) {
+		printf("Error: no requests completed\n");
+		return 1;
+	}
+	std::sort(latencies.begin(), latencies.end());
+	auto percentile = [&](double p) {
+		return latencies[static_cast<size_t>(p*(latencies.size() - 1))]/1000.0;
+	};
+	printf("connections: %u\n", options.thread_total*options.conn_total);
+	printf("requests:    %zu in %.2fs (%.0f req/s)\n", latencies.size(), elapsed, latencies.size()/elapsed);
+	printf("throughput:  %.1f MB/s of values\n", (hits + sets)*static_cast<double>(options.value_size)/elapsed/1e6);
+	printf("gets:        %llu hits, %llu misses (%.2f%% hit ratio)\n", static_cast<unsigned long long>(hits), static_cast<unsigned long long>(misses), hits + misses == 0 ? 0 : 100.0*hits/(hits + misses));
+	printf("sets:        %llu\n", static_cast<unsigned long long>(sets));
+	printf("latency us:  p50 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n", percentile(.5), percentile(.99), percentile(.999), percentile(1));
+	printf("errors:      %llu\n", static_cast<unsigned long long>(errors));
+	return errors == 0 ? 0 : 1;
+}
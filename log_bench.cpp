@@ -0,0 +1,138 @@
+//By Monica Moniot and Alyssa Riceman
+//Measures what the mutation log costs the caller of a busy cache
+//The cache is filled, then a single thread runs a mix of sets, deletes and gets against it, once with no log
+//and once for each sync mode, timing every mutation
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#include "cache.h"
+
+struct Options {
+	uint32_t key_total;
+	uint32_t value_size;
+	double duration;
+	uint32_t sync_interval_ms;
+	const char* path;
+};
+
+inline uint64_t get_time_ns() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+
+inline void make_key(char* key, uint32_t i) {
+	snprintf(key, 32, "key:%u", i);
+}
+
+void print_latencies(const char* name, std::vector<uint64_t>* latencies, uint64_t duration_ns) {
+	if(latencies->empty()) {
+		printf("%-16s no operations\n", name);
+		return;
+	}
+	std::sort(latencies->begin(), latencies->end());
+	auto at = [latencies](double quantile) {
+		size_t i = static_cast<size_t>(quantile*(latencies->size() - 1));
+		return (*latencies)[i]/1000.0;
+	};
+	printf("%-16s %9.0f mutations/s  p50 %7.2f us  p99 %8.2f us  p99.9 %9.2f us  max %10.2f us\n", name,
+		latencies->size()/(duration_ns/1e9), at(.5), at(.99), at(.999), latencies->back()/1000.0);
+}
+
+void run(const Options& options, const char* name, int sync_mode) {
+	uint64_t mem_capacity = 4*static_cast<uint64_t>(options.key_total)*options.value_size;
+	cache_type cache = create_cache(mem_capacity > UINT32_MAX ? UINT32_MAX : mem_capacity, LRU, NULL);
+	char key[32];
+	std::vector<char> value(options.value_size, 'v');
+	for(uint32_t i = 0; i < options.key_total; i += 1) {
+		make_key(key, i);
+		cache_set(cache, key, value.data(), options.value_size);
+	}
+	unlink(options.path);
+	if(sync_mode >= 0 and not cache_open_log(cache, options.path, sync_mode, options.sync_interval_ms)) {
+		destroy_cache(cache);
+		return;
+	}
+
+	std::vector<uint64_t> latencies;
+	uint64_t start_time = get_time_ns();
+	uint64_t end_time = start_time + static_cast<uint64_t>(options.duration*1e9);
+	uint32_t seed = 1;
+	uint64_t now = start_time;
+	while(now < end_time) {
+		seed = seed*1103515245 + 12345;
+		make_key(key, (seed>>8)%options.key_total);
+		uint64_t op_start = now;
+		uint32_t op = (seed>>28)%4;
+		if(op == 0) {
+			index_type val_size;
+			cache_get(cache, key, &val_size);
+			now = get_time_ns();
+			continue;
+		} else if(op == 1) {
+			cache_delete(cache, key);
+		} else {
+			cache_set(cache, key, value.data(), options.value_size);
+		}
+		now = get_time_ns();
+		latencies.push_back(now - op_start);
+	}
+	//what's still buffered is part of the cost of logging it
+	if(sync_mode >= 0) {
+		cache_flush_log(cache);
+	}
+	end_time = get_time_ns();
+	print_latencies(name, &latencies, end_time - start_time);
+	if(sync_mode >= 0) {
+		Log_stats stats = cache_log_stats(cache);
+		printf("%-16s %llu records in %llu writes and %llu syncs, %llu stalls, %.1f MB\n", "",
+			static_cast<unsigned long long>(stats.record_total), static_cast<unsigned long long>(stats.write_total),
+			static_cast<unsigned long long>(stats.sync_total), static_cast<unsigned long long>(stats.stall_total), stats.log_size/1e6);
+	}
+	destroy_cache(cache);
+	unlink(options.path);
+}
+
+void print_usage(const char* name) {
+	printf("Usage: %s [-k keys] [-v value bytes] [-d seconds per mode] [-i sync interval ms] [-o path]\n", name);
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	options.key_total = 100000;
+	options.value_size = 100;
+	options.duration = 2;
+	options.sync_interval_ms = 10;
+	options.path = "/tmp/log_bench.log";
+	int opt;
+	while((opt = getopt(argc, argv, "k:v:d:i:o:h")) != -1) {
+		if(opt == 'k') {
+			options.key_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'v') {
+			options.value_size = strtoul(optarg, NULL, 10);
+		} else if(opt == 'd') {
+			options.duration = atof(optarg);
+		} else if(opt == 'i') {
+			options.sync_interval_ms = strtoul(optarg, NULL, 10);
+		} else if(opt == 'o') {
+			options.path = optarg;
+		} else {
+			print_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if(options.key_total == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	printf("%u keys of %u bytes, a quarter of operations gets, %.1fs per mode\n", options.key_total, options.value_size, options.duration);
+	run(options, "no log", -1);
+	run(options, "sync never", LOG_SYNC_NEVER);
+	run(options, "sync interval", LOG_SYNC_INTERVAL);
+	run(options, "sync always", LOG_SYNC_ALWAYS);
+	return 0;
+}
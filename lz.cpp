@@ -0,0 +1,161 @@
+//By Monica Moniot and Alyssa Riceman
+#include <cstring>
+#include "lz.h"
+
+constexpr Index LZ_MIN_MATCH = 4;
+constexpr Index LZ_MAX_OFFSET = 65535;
+constexpr Index LZ_LAST_LITERALS = 5;//the block always ends in at least this many literals
+constexpr Index LZ_MATCH_LIMIT = 12;//no match may start this close to the end
+constexpr Index LZ_HASH_BITS = 12;
+constexpr uint32_t LZ_HASH_MULTIPLIER = 2654435761u;
+
+inline uint32_t read_u32(const byte* src) {
+	uint32_t ret;
+	memcpy(&ret, src, sizeof(ret));
+	return ret;
+}
+inline Index get_length_size(Index length) {
+	//bytes needed to extend a nibble with this length
+	return length < 15 ? 0 : (length - 15)/255 + 1;
+}
+inline byte* write_length(byte* out, Index length) {
+	//writes the bytes that extend a nibble of 15
+	length -= 15;
+	while(length >= 255) {
+		*out = 255;
+		out += 1;
+		length -= 255;
+	}
+	*out = static_cast<byte>(length);
+	return out + 1;
+}
+
+Index lz_compress(const byte* src, Index src_size, byte* dst, Index dst_capacity) {
+	//greedy single pass, finding matches through a hash of the next 4 bytes
+	Index table[1<<LZ_HASH_BITS];
+	memset(table, 0, sizeof(table));
+	byte* out = dst;
+	byte* out_end = dst + dst_capacity;
+	Index anchor = 0;
+	Index pos = 0;
+	if(src_size > LZ_MATCH_LIMIT) {
+		const Index match_start_limit = src_size - LZ_MATCH_LIMIT;
+		const Index match_end_limit = src_size - LZ_LAST_LITERALS;
+		while(pos < match_start_limit) {
+			uint32_t sequence = read_u32(src + pos);
+			Index hash = (sequence*LZ_HASH_MULTIPLIER)>>(32 - LZ_HASH_BITS);
+			Index candidate = table[hash];
+			table[hash] = pos;
+			if(candidate >= pos or pos - candidate > LZ_MAX_OFFSET or read_u32(src + candidate) != sequence) {
+				pos += 1;
+				continue;
+			}
+			//stretch the match backwards into the literals, then forwards
+			while(pos > anchor and candidate > 0 and src[pos - 1] == src[candidate - 1]) {
+				pos -= 1;
+				candidate -= 1;
+			}
+			Index match_size = LZ_MIN_MATCH;
+			while(pos + match_size < match_end_limit and src[pos + match_size] == src[candidate + match_size]) {
+				match_size += 1;
+			}
+			Index literal_size = pos - anchor;
+			Index match_code = match_size - LZ_MIN_MATCH;
+			Index sequence_size = 1 + get_length_size(literal_size) + literal_size + 2 + get_length_size(match_code);
+			if(sequence_size > static_cast<Index>(out_end - out)) {
+				return 0;
+			}
+			byte* token = out;
+			out += 1;
+			*token = static_cast<byte>((literal_size < 15 ? literal_size : 15)<<4);
+			if(literal_size >= 15) {
+				out = write_length(out, literal_size);
+			}
+			memcpy(out, src + anchor, literal_size);
+			out += literal_size;
+			Index offset = pos - candidate;
+			out[0] = static_cast<byte>(offset);
+			out[1] = static_cast<byte>(offset>>8);
+			out += 2;
+			*token |= static_cast<byte>(match_code < 15 ? match_code : 15);
+			if(match_code >= 15) {
+				out = write_length(out, match_code);
+			}
+			pos += match_size;
+			anchor = pos;
+		}
+	}
+	//the last sequence is literals only
+	Index literal_size = src_size - anchor;
+	if(1 + get_length_size(literal_size) + literal_size > static_cast<Index>(out_end - out)) {
+		return 0;
+	}
+	*out = static_cast<byte>((literal_size < 15 ? literal_size : 15)<<4);
+	out += 1;
+	if(literal_size >= 15) {
+		out = write_length(out, literal_size);
+	}
+	memcpy(out, src + anchor, literal_size);
+	out += literal_size;
+	return static_cast<Index>(out - dst);
+}
+
+inline bool read_length(const byte* src, Index src_size, Index* in, Index* length) {
+	//reads the bytes that extend a nibble of 15
+	while(true) {
+		if(*in >= src_size) {
+			return false;
+		}
+		byte b = src[*in];
+		*in += 1;
+		*length += b;
+		if(b != 255) {
+			return true;
+		}
+	}
+}
+
+bool lz_decompress(const byte* src, Index src_size, byte* dst, Index dst_size) {
+	Index in = 0;
+	Index out = 0;
+	while(in < src_size) {
+		byte token = src[in];
+		in += 1;
+		Index literal_size = token>>4;
+		if(literal_size == 15 and not read_length(src, src_size, &in, &literal_size)) {
+			return false;
+		}
+		if(literal_size > src_size - in or literal_size > dst_size - out) {
+			return false;
+		}
+		memcpy(dst + out, src + in, literal_size);
+		in += literal_size;
+		out += literal_size;
+		if(in == src_size) {//the last sequence has no match
+			break;
+		}
+		if(src_size - in < 2) {
+			return false;
+		}
+		Index offset = src[in] | (src[in + 1]<<8);
+		in += 2;
+		Index match_size = token&15;
+		if(match_size == 15 and not read_length(src, src_size, &in, &match_size)) {
+			return false;
+		}
+		match_size += LZ_MIN_MATCH;
+		if(offset == 0 or offset > out or match_size > dst_size - out) {
+			return false;
+		}
+		byte* match = dst + out - offset;
+		if(offset >= match_size) {
+			memcpy(dst + out, match, match_size);
+		} else {//the match overlaps what it's writing, so it repeats
+			for(Index i = 0; i < match_size; i += 1) {
+				dst[out + i] = match[i];
+			}
+		}
+		out += match_size;
+	}
+	return out == dst_size;
+}
@@ -0,0 +1,16 @@
+//By Monica Moniot and Alyssa Riceman
+#ifndef LZ_H
+#define LZ_H
+#include "types.h"
+
+//A small LZ77 codec in the style of LZ4's block format, used to compress values in place
+//A block is a series of sequences, each a token byte, some literal bytes and a back reference into the output:
+//the token's high nibble counts the literals and its low nibble counts the match length past the minimum,
+//and a nibble of 15 means more length bytes follow, each adding up to 255
+//The last sequence of a block is literals only
+
+//returns the compressed size, or 0 if the result wouldn't fit in dst_capacity
+Index lz_compress(const byte* src, Index src_size, byte* dst, Index dst_capacity);
+//returns false if src is not a valid block that decompresses to exactly dst_size bytes
+bool lz_decompress(const byte* src, Index src_size, byte* dst, Index dst_size);
+#endif
@@ -0,0 +1,101 @@
+//By Monica Moniot and Alyssa Riceman
+//Measures what a maintenance thread takes off the caller: a cache with room for a fixed number of entries is
+//given new keys, each set made under the cache's lock and timed, with and without cache_start_maintenance
+//Between sets the caller spends some time outside the lock, as a server would handling requests, which is when
+//the maintenance thread gets its work done
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+#include "cache.h"
+
+struct Options {
+	uint32_t cached_total;
+	uint32_t value_size;
+	uint32_t op_total;
+	uint32_t work_ns;
+	uint32_t headroom_percent;
+};
+
+inline uint64_t get_time_ns() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+
+inline void make_key(char* key, uint32_t i) {
+	snprintf(key, 32, "key:%u", i);
+}
+
+void print_usage(const char* name) {
+	printf("Usage: %s [-k keys the cache holds] [-v value bytes] [-n sets] [-w ns of work between sets] [-r headroom percent]\n", name);
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	options.cached_total = 1000000;
+	options.value_size = 32;
+	options.op_total = 4000000;
+	options.work_ns = 1000;
+	options.headroom_percent = 5;
+	int opt;
+	while((opt = getopt(argc, argv, "k:v:n:w:r:h")) != -1) {
+		if(opt == 'k') {
+			options.cached_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'v') {
+			options.value_size = strtoul(optarg, NULL, 10);
+		} else if(opt == 'n') {
+			options.op_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'w') {
+			options.work_ns = strtoul(optarg, NULL, 10);
+		} else if(opt == 'r') {
+			options.headroom_percent = strtoul(optarg, NULL, 10);
+		} else {
+			print_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if(options.cached_total == 0 or options.value_size == 0 or options.op_total == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	printf("room for %u values of %u bytes, %u sets of new keys, %u ns between sets\n", options.cached_total, options.value_size, options.op_total, options.work_ns);
+
+	char key[32];
+	std::vector<char> value(options.value_size, 'v');
+	std::vector<uint32_t> latencies(options.op_total);
+	for(int is_maintained = 0; is_maintained < 2; is_maintained += 1) {
+		cache_type cache = create_cache(static_cast<uint64_t>(options.cached_total)*options.value_size, LRU, NULL);
+		std::mutex lock;
+		if(is_maintained) {
+			cache_start_maintenance(cache, &lock, options.headroom_percent);
+		}
+		uint64_t start_time = get_time_ns();
+		for(uint32_t i = 0; i < options.op_total; i += 1) {
+			make_key(key, i);
+			uint64_t op_start = get_time_ns();
+			lock.lock();
+			cache_set(cache, key, value.data(), options.value_size);
+			lock.unlock();
+			uint64_t op_end = get_time_ns();
+			latencies[i] = op_end - op_start;
+			while(get_time_ns() - op_end < options.work_ns) {}
+		}
+		double s = (get_time_ns() - start_time)/1e9;
+		lock.lock();
+		Maintenance_stats stats = cache_maintenance_stats(cache);
+		lock.unlock();
+		destroy_cache(cache);
+		std::sort(latencies.begin(), latencies.end());
+		printf("%-19s %8.0f sets/s  p50 %5u ns  p99 %6u ns  p99.9 %7u ns  max %9u ns\n", is_maintained ? "maintenance thread" : "inline", options.op_total/s,
+			latencies[options.op_total/2], latencies[options.op_total/100*99], latencies[options.op_total/1000*999], latencies[options.op_total - 1]);
+		printf("%19s evictions %llu inline %llu background, growths %llu inline %llu background\n", "",
+			static_cast<unsigned long long>(stats.inline_evict_total), static_cast<unsigned long long>(stats.background_evict_total),
+			static_cast<unsigned long long>(stats.inline_grow_total), static_cast<unsigned long long>(stats.background_grow_total));
+	}
+	return 0;
+}
@@ -0,0 +1,250 @@
+//By Monica Moniot and Alyssa Riceman
+#include <stdlib.h>
+#include <cstring>
+#include <algorithm>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "types.h"
+#include "mrc.h"
+
+constexpr uint32_t SAMPLE_BITS = 24;
+constexpr uint64_t SAMPLE_MODULUS = static_cast<uint64_t>(1)<<SAMPLE_BITS;
+constexpr uint64_t INITIAL_THRESHOLD = SAMPLE_MODULUS/64;//start by sampling 1 key in 64, only lowering it from there
+constexpr uint32_t SUB_BUCKET_BITS = 3;//each doubling of distance is split into 8 buckets, so a bucket is within 12.5%
+constexpr uint32_t SUB_BUCKETS = 1<<SUB_BUCKET_BITS;
+constexpr uint32_t BUCKET_TOTAL = (64 - SUB_BUCKET_BITS + 1)*SUB_BUCKETS;
+constexpr uint32_t MIN_MAX_KEYS = 64;
+
+struct Mrc_key {
+	uint64_t time;//when the key was last used, its place in the tree
+	Index size;
+	uint32_t sample_value;
+};
+
+struct Mrc {
+	uint32_t max_keys;
+	uint64_t threshold;//keys whose sample value is under this are sampled
+	std::unordered_map<Index, Mrc_key> keys;//sampled keys are told apart by their hash alone
+	std::set<std::pair<uint32_t, Index>> by_sample_value;//so the keys to drop when the threshold is lowered are found
+	std::vector<uint64_t> tree;//Fenwick tree over times, holding the size of the key last used at each time
+	uint64_t now;
+	double reuse_counts[BUCKET_TOTAL];//gets of keys used before, by their scaled reuse distance
+	double cold_total;//gets of keys never used before, which no capacity hits
+	double get_total;
+	uint64_t sampled_get_total;
+};
+
+inline uint32_t get_sample_value(Index key_hash) {
+	//the table's hash is remixed, since a multiplicative hash leaves its low bits poorly spread
+	return static_cast<uint32_t>((static_cast<uint64_t>(key_hash)*0x9E3779B97F4A7C15ull)>>(64 - SAMPLE_BITS));
+}
+
+inline uint32_t get_bucket(uint64_t distance) {
+	if(distance < SUB_BUCKETS) {
+		return distance;
+	}
+	uint32_t exponent = 63 - __builtin_clzll(distance);
+	uint32_t sub_bucket = (distance>>(exponent - SUB_BUCKET_BITS))&(SUB_BUCKETS - 1);
+	return (exponent - SUB_BUCKET_BITS + 1)*SUB_BUCKETS + sub_bucket;
+}
+inline double get_bucket_start(uint32_t bucket) {
+	if(bucket < SUB_BUCKETS) {
+		return bucket;
+	}
+	uint32_t exponent = bucket/SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+	double sub_bucket = bucket%SUB_BUCKETS;
+	return (SUB_BUCKETS + sub_bucket)*static_cast<double>(static_cast<uint64_t>(1)<<(exponent - SUB_BUCKET_BITS));
+}
+
+inline void add_to_tree(Mrc* mrc, uint64_t time, uint64_t delta) {
+	//delta may be negative, wrapping around; the sums come out right all the same
+	for(uint64_t i = time + 1; i <= mrc->tree.size(); i += i&(~i + 1)) {
+		mrc->tree[i - 1] += delta;
+	}
+}
+inline uint64_t sum_tree(const Mrc* mrc, uint64_t end) {
+	//the sizes of the keys last used before end
+	uint64_t sum = 0;
+	for(uint64_t i = end; i > 0; i -= i&(~i + 1)) {
+		sum += mrc->tree[i - 1];
+	}
+	return sum;
+}
+inline void compact_times(Mrc* mrc) {
+	//we've run out of times, so the keys are renumbered from 0 in the order they were last used
+	std::vector<std::pair<uint64_t, Index>> order;
+	order.reserve(mrc->keys.size());
+	for(const auto& key : mrc->keys) {
+		order.push_back({key.second.time, key.first});
+	}
+	std::sort(order.begin(), order.end());
+	std::fill(mrc->tree.begin(), mrc->tree.end(), 0);
+	for(uint64_t time = 0; time < order.size(); time += 1) {
+		Mrc_key* key = &mrc->keys[order[time].second];
+		key->time = time;
+		mrc->tree[time] = key->size;
+	}
+	//builds the tree in place in linear time, each slot passing its sum on to its parent
+	for(uint64_t i = 1; i <= mrc->tree.size(); i += 1) {
+		uint64_t parent = i + (i&(~i + 1));
+		if(parent <= mrc->tree.size()) {
+			mrc->tree[parent - 1] += mrc->tree[i - 1];
+		}
+	}
+	mrc->now = order.size();
+}
+inline uint64_t take_time(Mrc* mrc) {
+	if(mrc->now == mrc->tree.size()) {
+		compact_times(mrc);
+	}
+	uint64_t time = mrc->now;
+	mrc->now += 1;
+	return time;
+}
+inline void lower_threshold(Mrc* mrc) {
+	//drops the sampled keys with the highest sample values until there are few enough, sampling at a lower rate
+	uint64_t old_threshold = mrc->threshold;
+	while(mrc->keys.size() > mrc->max_keys) {
+		auto highest = std::prev(mrc->by_sample_value.end());
+		mrc->threshold = highest->first;
+		while(not mrc->by_sample_value.empty()) {
+			highest = std::prev(mrc->by_sample_value.end());
+			if(highest->first < mrc->threshold) {
+				break;
+			}
+			auto key = mrc->keys.find(highest->second);
+			add_to_tree(mrc, key->second.time, -static_cast<uint64_t>(key->second.size));
+			mrc->keys.erase(key);
+			mrc->by_sample_value.erase(highest);
+		}
+	}
+	//what was counted at the old rate is scaled down to what the new rate would have counted
+	double scale = static_cast<double>(mrc->threshold)/old_threshold;
+	for(uint32_t i = 0; i < BUCKET_TOTAL; i += 1) {
+		mrc->reuse_counts[i] *= scale;
+	}
+	mrc->cold_total *= scale;
+	mrc->get_total *= scale;
+}
+inline void use_key(Mrc* mrc, Index key_hash, uint32_t sample_value, Mrc_key* key, Index size) {
+	//moves a key to the top of the stack, or puts a new one there if key is NULL
+	if(key == NULL) {
+		key = &mrc->keys[key_hash];
+		key->sample_value = sample_value;
+		//taking a time may renumber every key, this one included, so it must look like a key of no size until then
+		key->time = 0;
+		key->size = 0;
+		key->time = take_time(mrc);
+		key->size = size;
+		add_to_tree(mrc, key->time, size);
+		mrc->by_sample_value.insert({sample_value, key_hash});
+		if(mrc->keys.size() > mrc->max_keys) {
+			lower_threshold(mrc);
+		}
+		return;
+	}
+	add_to_tree(mrc, key->time, -static_cast<uint64_t>(key->size));
+	//taking a time may renumber every key, so the old one is taken out first
+	key->size = 0;
+	key->time = take_time(mrc);
+	key->size = size;
+	add_to_tree(mrc, key->time, size);
+}
+
+
+Mrc* create_mrc(uint32_t max_keys) {
+	Mrc* mrc = new Mrc;
+	mrc->max_keys = max_keys < MIN_MAX_KEYS ? MIN_MAX_KEYS : max_keys;
+	mrc->threshold = INITIAL_THRESHOLD;
+	mrc->keys.reserve(mrc->max_keys + 1);
+	//twice as many times as keys, so the tree is compacted at most once per max_keys uses
+	mrc->tree.assign(2*static_cast<uint64_t>(mrc->max_keys) + 2, 0);
+	mrc->now = 0;
+	memset(mrc->reuse_counts, 0, sizeof(mrc->reuse_counts));
+	mrc->cold_total = 0;
+	mrc->get_total = 0;
+	mrc->sampled_get_total = 0;
+	return mrc;
+}
+void destroy_mrc(Mrc* mrc) {
+	delete mrc;
+}
+
+void mrc_get(Mrc* mrc, Index key_hash, Index value_size, bool is_hit) {
+	uint32_t sample_value = get_sample_value(key_hash);
+	if(sample_value >= mrc->threshold) {
+		return;
+	}
+	mrc->get_total += 1;
+	mrc->sampled_get_total += 1;
+	auto found = mrc->keys.find(key_hash);
+	if(found == mrc->keys.end()) {
+		mrc->cold_total += 1;
+		//we don't know its size until it's set
+		use_key(mrc, key_hash, sample_value, NULL, 0);
+		return;
+	}
+	Mrc_key* key = &found->second;
+	Index size = is_hit ? value_size : key->size;
+	//every byte of the sampled keys used since stands for SAMPLE_MODULUS/threshold bytes of the whole cache
+	uint64_t between = sum_tree(mrc, mrc->now) - sum_tree(mrc, key->time + 1);
+	double distance = static_cast<double>(between)*SAMPLE_MODULUS/mrc->threshold + size;
+	mrc->reuse_counts[get_bucket(static_cast<uint64_t>(distance))] += 1;
+	use_key(mrc, key_hash, sample_value, key, size);
+}
+void mrc_set(Mrc* mrc, Index key_hash, Index value_size) {
+	uint32_t sample_value = get_sample_value(key_hash);
+	if(sample_value >= mrc->threshold) {
+		return;
+	}
+	auto found = mrc->keys.find(key_hash);
+	use_key(mrc, key_hash, sample_value, found == mrc->keys.end() ? NULL : &found->second, value_size);
+}
+void mrc_delete(Mrc* mrc, Index key_hash) {
+	uint32_t sample_value = get_sample_value(key_hash);
+	if(sample_value >= mrc->threshold) {
+		return;
+	}
+	auto found = mrc->keys.find(key_hash);
+	if(found != mrc->keys.end()) {
+		add_to_tree(mrc, found->second.time, -static_cast<uint64_t>(found->second.size));
+		mrc->by_sample_value.erase({sample_value, key_hash});
+		mrc->keys.erase(found);
+	}
+}
+
+double mrc_estimate_hit_ratio(const Mrc* mrc, uint64_t capacity) {
+	if(mrc->get_total == 0) {
+		return 0;
+	}
+	double hit_total = 0;
+	for(uint32_t i = 0; i < BUCKET_TOTAL; i += 1) {
+		double start = get_bucket_start(i);
+		if(start > capacity) {
+			break;
+		}
+		double end = i + 1 < BUCKET_TOTAL ? get_bucket_start(i + 1) : 2*start;
+		if(end <= capacity + 1) {
+			hit_total += mrc->reuse_counts[i];
+		} else {
+			//the distances in a bucket are taken to be spread evenly across it
+			hit_total += mrc->reuse_counts[i]*(capacity + 1 - start)/(end - start);
+		}
+	}
+	return hit_total/mrc->get_total;
+}
+Mrc_stats get_mrc_stats(const Mrc* mrc) {
+	Mrc_stats stats;
+	stats.sample_rate = static_cast<double>(mrc->threshold)/SAMPLE_MODULUS;
+	stats.sampled_key_total = mrc->keys.size();
+	stats.sampled_get_total = mrc->sampled_get_total;
+	return stats;
+}
+uint64_t get_mrc_size(const Mrc* mrc) {
+	//each sampled key is a node in both the map and the set, and the map has a bucket array besides
+	uint64_t size = sizeof(Mrc) + sizeof(uint64_t)*mrc->tree.capacity() + sizeof(void*)*mrc->keys.bucket_count();
+	size += mrc->keys.size()*(sizeof(void*) + sizeof(std::pair<const Index, Mrc_key>) + 4*sizeof(void*) + sizeof(std::pair<uint32_t, Index>));
+	return size;
+}
@@ -0,0 +1,28 @@
+//By Monica Moniot and Alyssa Riceman
+#ifndef MRC_H
+#define MRC_H
+#include "types.h"
+
+//Estimates the hit ratio gets would have at every capacity at once, by simulating an LRU cache of unbounded size
+//over a sample of the keys (SHARDS): a key is sampled when a remix of its hash falls under a threshold, so a key is
+//either always sampled or never, and the sampled keys see exactly the accesses they would have in the full cache
+//For each get of a sampled key we find how many bytes of other sampled keys were used since its last use, its
+//reuse distance; an LRU cache of capacity C would have hit it if that distance, scaled up by the sampling rate,
+//plus its own size, is at most C
+//Distances are counted with a Fenwick tree over the times of each key's last use, weighted by the keys' sizes
+//Memory stays constant: once more than max_keys keys are sampled, the threshold is lowered to drop the keys with
+//the highest remixed hashes, and everything counted so far is scaled down to the new rate
+
+Mrc* create_mrc(uint32_t max_keys);
+void destroy_mrc(Mrc* mrc);
+
+//key_hash is the hash as the table stores it; value_size is the key's value if the get found it, otherwise ignored
+void mrc_get(Mrc* mrc, Index key_hash, Index value_size, bool is_hit);
+void mrc_set(Mrc* mrc, Index key_hash, Index value_size);
+void mrc_delete(Mrc* mrc, Index key_hash);
+//the fraction of gets an LRU cache of capacity bytes of values would have hit
+double mrc_estimate_hit_ratio(const Mrc* mrc, uint64_t capacity);
+Mrc_stats get_mrc_stats(const Mrc* mrc);
+//bytes of memory the estimator has allocated
+uint64_t get_mrc_size(const Mrc* mrc);
+#endif
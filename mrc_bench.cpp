@@ -0,0 +1,132 @@
+//By Monica Moniot and Alyssa Riceman
+//Checks the hit ratio estimator against the real thing: a skewed mix of gets, setting every miss, is run against a
+//cache with cache_set_mrc on, then again against LRU caches of several capacities, and the hit ratio each of them
+//actually got is printed next to the estimate for its capacity
+//The mix is also timed with and without the estimator, to show what leaving it on costs
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "cache.h"
+
+constexpr int RUN_TOTAL = 3;
+
+struct Options {
+	uint32_t key_total;
+	uint32_t value_size;
+	uint32_t op_total;
+	uint32_t max_sampled_keys;
+};
+
+inline uint64_t get_time_ns() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+
+inline void make_key(char* key, uint32_t i) {
+	snprintf(key, 32, "key:%u", i);
+}
+
+void print_usage(const char* name) {
+	printf("Usage: %s [-k keys] [-v value bytes] [-n operations] [-s most keys sampled]\n", name);
+}
+
+double run_mix(const Options* options, cache_type cache, uint64_t* ret_hit_total) {
+	std::vector<char> value(options->value_size, 'v');
+	char key[32];
+	uint32_t seed = 1;
+	uint64_t hit_total = 0;
+	uint64_t start_time = get_time_ns();
+	for(uint32_t i = 0; i < options->op_total; i += 1) {
+		//the key is the product of two uniform picks, so small keys are far more popular than large ones
+		seed = seed*1103515245 + 12345;
+		uint64_t a = (seed>>8)%options->key_total;
+		seed = seed*1103515245 + 12345;
+		uint64_t b = (seed>>8)%options->key_total;
+		make_key(key, a*b/options->key_total);
+		index_type val_size;
+		if(cache_get(cache, key, &val_size) == NULL) {
+			cache_set(cache, key, value.data(), options->value_size);
+		} else {
+			hit_total += 1;
+		}
+	}
+	*ret_hit_total = hit_total;
+	return static_cast<double>(get_time_ns() - start_time)/options->op_total;
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	options.key_total = 1000000;
+	options.value_size = 64;
+	options.op_total = 10000000;
+	options.max_sampled_keys = 8192;
+	int opt;
+	while((opt = getopt(argc, argv, "k:v:n:s:h")) != -1) {
+		if(opt == 'k') {
+			options.key_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'v') {
+			options.value_size = strtoul(optarg, NULL, 10);
+		} else if(opt == 'n') {
+			options.op_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 's') {
+			options.max_sampled_keys = strtoul(optarg, NULL, 10);
+		} else {
+			print_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if(options.key_total == 0 or options.op_total == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	uint64_t all_bytes = static_cast<uint64_t>(options.key_total)*options.value_size;
+	index_type max_mem = all_bytes/10 > UINT32_MAX ? UINT32_MAX : all_bytes/10;
+	printf("%u gets of %u keys, setting each miss, estimated from a cache for 10%% of them\n", options.op_total, options.key_total);
+
+	//the two take turns, and each keeps its best run, since the difference is small next to the noise of one run
+	double plain_ns = 0;
+	double estimated_ns = 0;
+	std::vector<uint64_t> capacities;
+	const uint32_t percents[] = {1, 2, 5, 10, 20, 50, 100};
+	for(uint32_t percent : percents) {
+		capacities.push_back(all_bytes*percent/100);
+	}
+	std::vector<double> estimates(capacities.size());
+	Mrc_stats stats;
+	uint64_t mrc_bytes = 0;
+	for(int run = 0; run < RUN_TOTAL; run += 1) {
+		uint64_t hit_total;
+		cache_type cache = create_cache(max_mem, LRU, NULL);
+		double ns = run_mix(&options, cache, &hit_total);
+		plain_ns = run == 0 or ns < plain_ns ? ns : plain_ns;
+		destroy_cache(cache);
+
+		cache = create_cache(max_mem, LRU, NULL);
+		cache_set_mrc(cache, options.max_sampled_keys);
+		ns = run_mix(&options, cache, &hit_total);
+		estimated_ns = run == 0 or ns < estimated_ns ? ns : estimated_ns;
+		cache_estimate_hit_ratios(cache, capacities.data(), estimates.data(), capacities.size());
+		stats = cache_mrc_stats(cache);
+		mrc_bytes = cache_memory_report(cache).mrc_bytes;
+		destroy_cache(cache);
+	}
+	printf("without %6.1f ns/op  with %6.1f ns/op  %+5.1f%%\n", plain_ns, estimated_ns, 100*(estimated_ns - plain_ns)/plain_ns);
+	printf("sampled 1 key in %.0f, %llu keys, %llu gets, %llu bytes\n", 1/stats.sample_rate, static_cast<unsigned long long>(stats.sampled_key_total),
+		static_cast<unsigned long long>(stats.sampled_get_total), static_cast<unsigned long long>(mrc_bytes));
+
+	printf("%12s %10s %10s %8s\n", "capacity", "estimate", "actual", "error");
+	for(size_t i = 0; i < capacities.size(); i += 1) {
+		uint64_t capacity = capacities[i] > UINT32_MAX ? UINT32_MAX : capacities[i];
+		cache_type cache = create_cache(capacity, LRU, NULL);
+		uint64_t hit_total;
+		run_mix(&options, cache, &hit_total);
+		destroy_cache(cache);
+		double actual = static_cast<double>(hit_total)/options.op_total;
+		printf("%12llu %10.4f %10.4f %+8.4f\n", static_cast<unsigned long long>(capacity), estimates[i], actual, estimates[i] - actual);
+	}
+	return 0;
+}
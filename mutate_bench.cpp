@@ -0,0 +1,143 @@
+//By Monica Moniot and Alyssa Riceman
+//Compares changing values where they're stored with the read, copy and set they replace: counters are incremented
+//by cache_incr and by getting, parsing, formatting and setting them, and lists are grown a record at a time by
+//cache_append and by getting, copying and setting them whole
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "cache.h"
+
+constexpr int RUN_TOTAL = 3;
+
+struct Options {
+	uint32_t counter_total;
+	uint32_t list_total;
+	uint32_t record_size;
+	uint32_t op_total;
+};
+
+inline uint64_t get_time_ns() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+
+inline void make_key(char* key, uint32_t i) {
+	snprintf(key, 32, "key:%u", i);
+}
+
+void print_usage(const char* name) {
+	printf("Usage: %s [-c counters] [-l lists] [-r record bytes] [-n operations]\n", name);
+}
+
+double run_counters(const Options* options, bool is_in_place) {
+	cache_type cache = create_cache(UINT32_MAX, LRU, NULL);
+	char key[32];
+	for(uint32_t i = 0; i < options->counter_total; i += 1) {
+		make_key(key, i);
+		cache_set(cache, key, "0", 1);
+	}
+	uint32_t seed = 1;
+	uint64_t start_time = get_time_ns();
+	for(uint32_t i = 0; i < options->op_total; i += 1) {
+		seed = seed*1103515245 + 12345;
+		make_key(key, (seed>>8)%options->counter_total);
+		int64_t value;
+		if(is_in_place) {
+			cache_incr(cache, key, 1, &value);
+		} else {
+			index_type val_size;
+			auto val = static_cast<const char*>(cache_get(cache, key, &val_size));
+			char digits[24];
+			memcpy(digits, val, val_size);
+			digits[val_size] = 0;
+			value = strtoll(digits, NULL, 10) + 1;
+			int size = snprintf(digits, sizeof(digits), "%lld", static_cast<long long>(value));
+			cache_set(cache, key, digits, size);
+		}
+	}
+	double ns = static_cast<double>(get_time_ns() - start_time)/options->op_total;
+	destroy_cache(cache);
+	return ns;
+}
+
+double run_lists(const Options* options, bool is_in_place, Mutation_stats* ret_stats) {
+	cache_type cache = create_cache(UINT32_MAX, LRU, NULL);
+	char key[32];
+	std::vector<char> record(options->record_size, 'r');
+	for(uint32_t i = 0; i < options->list_total; i += 1) {
+		make_key(key, i);
+		cache_set(cache, key, record.data(), options->record_size);
+	}
+	std::vector<char> list;
+	uint32_t seed = 1;
+	uint64_t start_time = get_time_ns();
+	for(uint32_t i = 0; i < options->op_total; i += 1) {
+		seed = seed*1103515245 + 12345;
+		make_key(key, (seed>>8)%options->list_total);
+		if(is_in_place) {
+			cache_append(cache, key, record.data(), options->record_size);
+		} else {
+			index_type val_size;
+			auto val = static_cast<const char*>(cache_get(cache, key, &val_size));
+			list.assign(val, val + val_size);
+			list.insert(list.end(), record.begin(), record.end());
+			cache_set(cache, key, list.data(), list.size());
+		}
+	}
+	double ns = static_cast<double>(get_time_ns() - start_time)/options->op_total;
+	*ret_stats = cache_mutation_stats(cache);
+	destroy_cache(cache);
+	return ns;
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	options.counter_total = 100000;
+	options.list_total = 1000;
+	options.record_size = 32;
+	options.op_total = 1000000;
+	int opt;
+	while((opt = getopt(argc, argv, "c:l:r:n:h")) != -1) {
+		if(opt == 'c') {
+			options.counter_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'l') {
+			options.list_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'r') {
+			options.record_size = strtoul(optarg, NULL, 10);
+		} else if(opt == 'n') {
+			options.op_total = strtoul(optarg, NULL, 10);
+		} else {
+			print_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if(options.counter_total == 0 or options.list_total == 0 or options.op_total == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	printf("%u increments of %u counters, and %u appends of %u bytes to %u lists\n", options.op_total, options.counter_total, options.op_total, options.record_size, options.list_total);
+	//the two take turns, and each keeps its best run, since the difference is small next to the noise of one run
+	double set_ns[2] = {0, 0};
+	double in_place_ns[2] = {0, 0};
+	Mutation_stats stats;
+	for(int run = 0; run < RUN_TOTAL; run += 1) {
+		double ns = run_counters(&options, false);
+		set_ns[0] = run == 0 or ns < set_ns[0] ? ns : set_ns[0];
+		ns = run_counters(&options, true);
+		in_place_ns[0] = run == 0 or ns < in_place_ns[0] ? ns : in_place_ns[0];
+		ns = run_lists(&options, false, &stats);
+		set_ns[1] = run == 0 or ns < set_ns[1] ? ns : set_ns[1];
+		ns = run_lists(&options, true, &stats);
+		in_place_ns[1] = run == 0 or ns < in_place_ns[1] ? ns : in_place_ns[1];
+	}
+	const char* names[2] = {"counters", "lists"};
+	for(int i = 0; i < 2; i += 1) {
+		printf("%-9s get and set %8.1f ns/op  in place %8.1f ns/op  %+5.1f%%\n", names[i], set_ns[i], in_place_ns[i], 100*(in_place_ns[i] - set_ns[i])/set_ns[i]);
+	}
+	printf("appends made in place %llu, to a copy %llu\n", static_cast<unsigned long long>(stats.in_place_total), static_cast<unsigned long long>(stats.copy_total));
+	return 0;
+}
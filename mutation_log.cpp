@@ -0,0 +1,345 @@
+//By Monica Moniot and Alyssa Riceman
+#include <stdio.h>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "value.h"
+#include "mutation_log.h"
+
+constexpr size_t MAX_LOG_BUFFER = 64<<20;//past this many bytes waiting on the writer, appending waits too
+constexpr size_t LOG_WRITE_BATCH = 64<<10;//the writer is woken once this much is buffered
+constexpr uint64_t MAX_WRITE_DELAY_NS = 2000000;//and otherwise writes out what's buffered this often
+constexpr size_t COPY_BUFFER_SIZE = 1<<20;
+constexpr uint32_t FNV32_OFFSET = 2166136261u;
+constexpr uint32_t FNV32_PRIME = 16777619u;
+
+struct Mutation_log {
+	std::mutex lock;//guards everything but the writer's batch
+	std::condition_variable work_ready;
+	std::condition_variable work_done;
+	std::thread writer;
+	std::string path;
+	int fd;
+	int sync_mode;
+	uint64_t sync_interval_ns;
+	std::vector<byte> buffer;
+	uint64_t buffer_time;//when the first record in buffer was appended
+	uint64_t appended_size;//what the log's size will be once everything appended is written
+	uint64_t written_size;
+	uint64_t synced_size;
+	uint64_t flush_size;//someone is waiting for everything up to here to be synced
+	bool is_writing;
+	bool is_stopping;
+	bool is_failed;
+	Log_stats stats;
+};
+
+inline uint64_t get_time_ns() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+inline uint32_t add_checksum(uint32_t checksum, const byte* data, uint64_t size) {
+	//FNV-1a; we only need to catch torn and half written records, not tampering
+	for(uint64_t i = 0; i < size; i += 1) {
+		checksum = (checksum^data[i])*FNV32_PRIME;
+	}
+	return checksum;
+}
+inline uint32_t get_checksum(const Log_record* record, const byte* key, const byte* value) {
+	auto header = reinterpret_cast<const byte*>(record);
+	uint32_t checksum = add_checksum(FNV32_OFFSET, header + sizeof(uint32_t), sizeof(Log_record) - sizeof(uint32_t));
+	checksum = add_checksum(checksum, key, record->key_size);
+	return add_checksum(checksum, value, record->value_size);
+}
+
+void append_log_record(std::vector<byte>* buffer, uint8_t type, uint64_t sequence, Key_ptr key, Index key_size, const Value* value, Index value_size) {
+	Log_record record;
+	memset(&record, 0, sizeof(Log_record));
+	record.type = type;
+	record.sequence = sequence;
+	record.key_size = key_size;
+	const byte* value_data = NULL;
+	if(value != NULL) {
+		record.value_size = value_size;
+		record.raw_size = value->raw_size;
+		value_data = value->data;
+	}
+	auto key_data = reinterpret_cast<const byte*>(key);
+	record.checksum = get_checksum(&record, key_data, value_data);
+	auto header = reinterpret_cast<const byte*>(&record);
+	buffer->insert(buffer->end(), header, header + sizeof(Log_record));
+	buffer->insert(buffer->end(), key_data, key_data + key_size);
+	if(value != NULL) {
+		buffer->insert(buffer->end(), value_data, value_data + value_size);
+	}
+}
+
+inline bool write_all(int fd, const byte* data, uint64_t size) {
+	while(size > 0) {
+		ssize_t written = write(fd, data, size);
+		if(written < 0) {
+			if(errno == EINTR) continue;
+			return false;
+		}
+		data += written;
+		size -= written;
+	}
+	return true;
+}
+
+void run_log_writer(Mutation_log* log) {
+	std::vector<byte> batch;
+	uint64_t last_sync_time = get_time_ns();
+	std::unique_lock<std::mutex> guard(log->lock);
+	while(true) {
+		uint64_t now = get_time_ns();
+		bool is_write_due = log->buffer.size() >= LOG_WRITE_BATCH or now - log->buffer_time >= MAX_WRITE_DELAY_NS;
+		is_write_due = is_write_due or log->flush_size > log->written_size or log->is_stopping;
+		if(not log->buffer.empty() and is_write_due and not log->is_failed) {
+			//group commit: everything appended since our last write goes out in one write
+			batch.swap(log->buffer);
+			log->is_writing = true;
+			guard.unlock();
+			bool is_written = write_all(log->fd, batch.data(), batch.size());
+			guard.lock();
+			log->is_writing = false;
+			if(not is_written) {
+				printf("Error in mutation log: Could not write to %s: %s\n", log->path.c_str(), strerror(errno));
+				log->is_failed = true;
+			}
+			log->written_size += batch.size();
+			log->stats.write_total += 1;
+			batch.clear();
+			log->work_done.notify_all();
+			continue;
+		}
+		bool is_unsynced = log->synced_size < log->written_size;
+		bool is_sync_due = log->flush_size > log->synced_size or log->is_stopping or log->sync_mode == LOG_SYNC_ALWAYS;
+		if(log->sync_mode == LOG_SYNC_INTERVAL and now - last_sync_time >= log->sync_interval_ns) {
+			is_sync_due = true;
+		}
+		if(is_unsynced and is_sync_due and not log->is_failed) {
+			uint64_t sync_size = log->written_size;
+			guard.unlock();
+			bool is_synced = fdatasync(log->fd) == 0;
+			guard.lock();
+			if(not is_synced) {
+				printf("Error in mutation log: Could not sync %s: %s\n", log->path.c_str(), strerror(errno));
+				log->is_failed = true;
+			}
+			log->synced_size = sync_size;
+			log->stats.sync_total += 1;
+			last_sync_time = get_time_ns();
+			log->work_done.notify_all();
+			continue;
+		}
+		if(log->is_stopping) {
+			break;
+		}
+		//sleep until the buffer is due to be written or the log is due to be synced, whichever is first
+		uint64_t wake_time = -1;
+		if(not log->buffer.empty() and not log->is_failed) {
+			wake_time = log->buffer_time + MAX_WRITE_DELAY_NS;
+		}
+		if(log->sync_mode == LOG_SYNC_INTERVAL and is_unsynced and last_sync_time + log->sync_interval_ns < wake_time) {
+			wake_time = last_sync_time + log->sync_interval_ns;
+		}
+		if(wake_time == static_cast<uint64_t>(-1)) {
+			log->work_ready.wait(guard);
+		} else if(wake_time > now) {
+			log->work_ready.wait_for(guard, std::chrono::nanoseconds(wake_time - now));
+		}
+	}
+}
+
+
+Mutation_log* open_mutation_log(const char* path, int sync_mode, uint32_t sync_interval_ms) {
+	int fd = open(path, O_WRONLY|O_CREAT|O_APPEND|O_CLOEXEC, 0600);
+	if(fd < 0) {
+		printf("Error in mutation log: Could not open %s: %s\n", path, strerror(errno));
+		return NULL;
+	}
+	uint64_t size = lseek(fd, 0, SEEK_END);
+	Mutation_log* log = new Mutation_log;
+	log->path = path;
+	log->fd = fd;
+	log->sync_mode = sync_mode;
+	log->sync_interval_ns = static_cast<uint64_t>(sync_interval_ms)*1000000;
+	log->buffer_time = 0;
+	log->appended_size = size;
+	log->written_size = size;
+	log->synced_size = size;
+	log->flush_size = 0;
+	log->is_writing = false;
+	log->is_stopping = false;
+	log->is_failed = false;
+	memset(&log->stats, 0, sizeof(Log_stats));
+	log->writer = std::thread(run_log_writer, log);
+	return log;
+}
+void close_mutation_log(Mutation_log* log) {
+	{
+		std::lock_guard<std::mutex> guard(log->lock);
+		log->is_stopping = true;
+	}
+	//the writer writes and syncs whatever is left before it stops
+	log->work_ready.notify_one();
+	log->writer.join();
+	close(log->fd);
+	delete log;
+}
+
+inline bool wait_for_sync(Mutation_log* log, std::unique_lock<std::mutex>* guard, uint64_t size) {
+	if(log->flush_size < size) {
+		log->flush_size = size;
+	}
+	log->work_ready.notify_one();
+	log->work_done.wait(*guard, [log, size]() {return log->synced_size >= size or log->is_failed;});
+	return not log->is_failed;
+}
+inline void append(Mutation_log* log, uint8_t type, uint64_t sequence, Key_ptr key, Index key_size, const Value* value, Index value_size) {
+	std::unique_lock<std::mutex> guard(log->lock);
+	if(log->is_failed) {
+		//we already printed why; the log is useless from here on, so there's no point holding on to records
+		return;
+	}
+	if(log->buffer.size() > MAX_LOG_BUFFER) {
+		//the writer is behind, and rather than use unbounded memory we wait on it
+		log->stats.stall_total += 1;
+		log->work_done.wait(guard, [log]() {return log->buffer.size() <= MAX_LOG_BUFFER or log->is_failed;});
+	}
+	uint64_t pre_size = log->buffer.size();
+	if(pre_size == 0) {
+		log->buffer_time = get_time_ns();
+	}
+	append_log_record(&log->buffer, type, sequence, key, key_size, value, value_size);
+	log->appended_size += log->buffer.size() - pre_size;
+	log->stats.record_total += 1;
+	if(log->sync_mode == LOG_SYNC_ALWAYS) {
+		//records appended by others while we wait share our write and sync
+		wait_for_sync(log, &guard, log->appended_size);
+	} else if(pre_size == 0 or (pre_size < LOG_WRITE_BATCH and log->buffer.size() >= LOG_WRITE_BATCH)) {
+		//the writer only needs waking to start its delay, and again once it has a full batch
+		log->work_ready.notify_one();
+	}
+}
+void mutation_log_set(Mutation_log* log, uint64_t sequence, Key_ptr key, Index key_size, const Value* value, Index value_size) {
+	append(log, LOG_SET, sequence, key, key_size, value, value_size);
+}
+void mutation_log_delete(Mutation_log* log, uint64_t sequence, Key_ptr key, Index key_size) {
+	append(log, LOG_DELETE, sequence, key, key_size, NULL, 0);
+}
+bool flush_mutation_log(Mutation_log* log) {
+	std::unique_lock<std::mutex> guard(log->lock);
+	return wait_for_sync(log, &guard, log->appended_size);
+}
+const char* get_mutation_log_path(Mutation_log* log) {
+	return log->path.c_str();
+}
+
+inline bool copy_tail(int src_fd, uint64_t start, uint64_t end, int dst_fd) {
+	byte* buffer = new byte[COPY_BUFFER_SIZE];
+	bool is_copied = true;
+	while(start < end and is_copied) {
+		uint64_t size = end - start < COPY_BUFFER_SIZE ? end - start : COPY_BUFFER_SIZE;
+		ssize_t read_size = pread(src_fd, buffer, size, start);
+		is_copied = read_size > 0 and write_all(dst_fd, buffer, read_size);
+		start += read_size;
+	}
+	delete[] buffer;
+	return is_copied;
+}
+bool replace_mutation_log(Mutation_log* log, const char* new_path, uint64_t tail_start) {
+	std::unique_lock<std::mutex> guard(log->lock);
+	//once everything is written nobody can append until we let go of the lock, so the tail can't move under us
+	if(not wait_for_sync(log, &guard, log->appended_size) or log->is_writing) {
+		return false;
+	}
+	int src_fd = open(log->path.c_str(), O_RDONLY|O_CLOEXEC);
+	int dst_fd = open(new_path, O_WRONLY|O_APPEND|O_CLOEXEC);
+	bool is_replaced = src_fd >= 0 and dst_fd >= 0;
+	is_replaced = is_replaced and copy_tail(src_fd, tail_start, log->written_size, dst_fd);
+	is_replaced = is_replaced and fdatasync(dst_fd) == 0;
+	is_replaced = is_replaced and rename(new_path, log->path.c_str()) == 0;
+	if(src_fd >= 0) {
+		close(src_fd);
+	}
+	if(not is_replaced) {
+		printf("Error in mutation log: Could not replace %s with %s: %s\n", log->path.c_str(), new_path, strerror(errno));
+		if(dst_fd >= 0) {
+			close(dst_fd);
+		}
+		unlink(new_path);
+		return false;
+	}
+	close(log->fd);
+	log->fd = dst_fd;
+	uint64_t size = lseek(dst_fd, 0, SEEK_END);
+	log->appended_size = size;
+	log->written_size = size;
+	log->synced_size = size;
+	log->flush_size = 0;
+	log->stats.compaction_total += 1;
+	return true;
+}
+Log_stats get_mutation_log_stats(Mutation_log* log) {
+	std::lock_guard<std::mutex> guard(log->lock);
+	Log_stats stats = log->stats;
+	stats.log_size = log->appended_size;
+	stats.unsynced_size = log->appended_size - log->synced_size;
+	return stats;
+}
+
+bool replay_mutation_log(const char* path, uint64_t after_sequence, Log_replay_func replay, void* data) {
+	FILE* file = fopen(path, "rb");
+	if(file == NULL) {
+		return errno == ENOENT;
+	}
+	fseek(file, 0, SEEK_END);
+	uint64_t file_size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	std::vector<byte> payload;
+	uint64_t valid_size = 0;
+	while(true) {
+		Log_record record;
+		if(fread(&record, sizeof(Log_record), 1, file) != 1) {
+			break;
+		}
+		uint64_t payload_size = static_cast<uint64_t>(record.key_size) + record.value_size;
+		//a record running past the end of the file can only be a torn one, so its sizes aren't trusted
+		if(record.key_size == 0 or record.value_size > file_size or payload_size > file_size - valid_size - sizeof(Log_record)) {
+			break;
+		}
+		payload.resize(payload_size);
+		if(fread(payload.data(), 1, payload_size, file) != payload_size) {
+			break;
+		}
+		const byte* key = payload.data();
+		const byte* value = payload.data() + record.key_size;
+		if(record.checksum != get_checksum(&record, key, value) or key[record.key_size - 1] != 0) {
+			break;
+		}
+		if(record.sequence > after_sequence) {
+			replay(data, &record, reinterpret_cast<Key_ptr>(key), value);
+		}
+		valid_size += sizeof(Log_record) + payload_size;
+	}
+	bool is_torn = not feof(file) or ftell(file) != static_cast<long>(valid_size);
+	fclose(file);
+	if(is_torn) {
+		//a crash left a partial record at the end; appending after it would hide everything we log next
+		printf("Error in mutation log: %s has a torn record at %llu, cutting it off\n", path, static_cast<unsigned long long>(valid_size));
+		if(truncate(path, valid_size) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
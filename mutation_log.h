@@ -0,0 +1,48 @@
+//By Monica Moniot and Alyssa Riceman
+#ifndef MUTATION_LOG_H
+#define MUTATION_LOG_H
+#include <vector>
+#include "types.h"
+
+//An append only log of every set and delete, so that a cache can be rebuilt from its last snapshot after a crash
+//The caller only appends records to a buffer; a writer thread writes out everything buffered since its last
+//write in one go (group commit), and syncs it to disk as often as the sync mode asks
+//Every record has a checksum, so a record torn by a crash ends the log instead of corrupting the cache
+
+enum {//log_record_types
+	LOG_SET = 1,
+	LOG_DELETE = 2,
+	LOG_CLEAR = 3,//starts a compacted log, which holds the whole cache
+};
+struct Log_record {
+	uint32_t checksum;//of everything after it in the record
+	uint8_t type;
+	uint8_t unused[3];
+	uint64_t sequence;//every mutation of a cache gets the next one, and a snapshot remembers the last it saw
+	uint32_t key_size;
+	uint32_t unused1;
+	uint64_t value_size;//the value as the cache stored it, so a compressed value is logged compressed
+	uint64_t raw_size;
+};//followed by the key, then the value
+//the sizes are 64 bit whatever the width of Index, so builds of either width can replay each other's logs
+
+//adds a record to the end of buffer
+void append_log_record(std::vector<byte>* buffer, uint8_t type, uint64_t sequence, Key_ptr key, Index key_size, const Value* value, Index value_size);
+
+Mutation_log* open_mutation_log(const char* path, int sync_mode, uint32_t sync_interval_ms);
+//writes and syncs whatever is left
+void close_mutation_log(Mutation_log* log);
+void mutation_log_set(Mutation_log* log, uint64_t sequence, Key_ptr key, Index key_size, const Value* value, Index value_size);
+void mutation_log_delete(Mutation_log* log, uint64_t sequence, Key_ptr key, Index key_size);
+//waits until everything appended so far is written and synced; returns false if writing has failed
+bool flush_mutation_log(Mutation_log* log);
+const char* get_mutation_log_path(Mutation_log* log);
+//replaces the log with the file at new_path, after appending to it everything logged from tail_start on
+bool replace_mutation_log(Mutation_log* log, const char* new_path, uint64_t tail_start);
+Log_stats get_mutation_log_stats(Mutation_log* log);
+
+//calls replay on every valid record with a sequence past after_sequence, then cuts off anything torn at the end
+//returns false if path couldn't be read; a missing log is just empty
+typedef void (*Log_replay_func)(void* data, const Log_record* record, Key_ptr key, const byte* value);
+bool replay_mutation_log(const char* path, uint64_t after_sequence, Log_replay_func replay, void* data);
+#endif
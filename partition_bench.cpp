@@ -0,0 +1,152 @@
+//By Monica Moniot and Alyssa Riceman
+//Several quiet tenants read skewed keys of their own while one noisy tenant sets a stream of keys it never reads
+//again, all in one cache shared without partitions, in one cache with a partition per tenant, and in a separate
+//cache per tenant; each tenant's hit ratio is printed, with the time per operation of each arrangement
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "cache.h"
+
+constexpr int RUN_TOTAL = 3;
+
+struct Options {
+	uint32_t tenant_total;//the last one is the noisy one
+	uint32_t key_total;//per quiet tenant
+	uint32_t value_size;
+	uint32_t op_total;
+	uint32_t cache_percent;//of every quiet tenant's keys
+};
+
+inline uint64_t get_time_ns() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+
+inline void make_key(char* key, uint32_t tenant, uint32_t i) {
+	snprintf(key, 32, "t%u:key:%u", tenant, i);
+}
+
+void print_usage(const char* name) {
+	printf("Usage: %s [-t tenants] [-k keys per tenant] [-v value bytes] [-n operations] [-c percent of the keys the cache holds]\n", name);
+}
+
+enum {
+	SHARED,
+	PARTITIONED,
+	SEPARATE,
+};
+const char* ARRANGEMENT_NAMES[] = {"shared", "partitioned", "separate"};
+
+double run_tenants(const Options* options, int arrangement, std::vector<double>* ret_hit_ratios) {
+	uint64_t max_mem = static_cast<uint64_t>(options->key_total)*(options->tenant_total - 1)*options->value_size/100*options->cache_percent;
+	index_type quota = max_mem/options->tenant_total;
+	std::vector<cache_type> caches;
+	if(arrangement == SEPARATE) {
+		for(uint32_t tenant = 0; tenant < options->tenant_total; tenant += 1) {
+			caches.push_back(create_cache(quota, LRU, NULL));
+		}
+	} else {
+		caches.push_back(create_cache(max_mem > UINT32_MAX ? UINT32_MAX : max_mem, LRU, NULL));
+		if(arrangement == PARTITIONED) {
+			char prefix[32];
+			for(uint32_t tenant = 0; tenant < options->tenant_total; tenant += 1) {
+				snprintf(prefix, sizeof(prefix), "t%u:", tenant);
+				cache_add_partition(caches[0], prefix, quota, LRU);
+			}
+		}
+	}
+	std::vector<char> value(options->value_size, 'v');
+	std::vector<uint64_t> hit_totals(options->tenant_total, 0);
+	std::vector<uint64_t> get_totals(options->tenant_total, 0);
+	char key[32];
+	uint32_t seed = 1;
+	uint32_t noisy_i = 0;
+	uint64_t start_time = get_time_ns();
+	for(uint32_t i = 0; i < options->op_total; i += 1) {
+		uint32_t tenant = i%options->tenant_total;
+		cache_type cache = caches[arrangement == SEPARATE ? tenant : 0];
+		if(tenant == options->tenant_total - 1) {
+			make_key(key, tenant, noisy_i);
+			noisy_i += 1;
+			cache_set(cache, key, value.data(), options->value_size);
+			continue;
+		}
+		//the key is the product of two uniform picks, so small keys are far more popular than large ones
+		seed = seed*1103515245 + 12345;
+		uint64_t a = (seed>>8)%options->key_total;
+		seed = seed*1103515245 + 12345;
+		uint64_t b = (seed>>8)%options->key_total;
+		make_key(key, tenant, a*b/options->key_total);
+		index_type val_size;
+		get_totals[tenant] += 1;
+		if(cache_get(cache, key, &val_size) == NULL) {
+			cache_set(cache, key, value.data(), options->value_size);
+		} else {
+			hit_totals[tenant] += 1;
+		}
+	}
+	double ns = static_cast<double>(get_time_ns() - start_time)/options->op_total;
+	ret_hit_ratios->clear();
+	for(uint32_t tenant = 0; tenant + 1 < options->tenant_total; tenant += 1) {
+		ret_hit_ratios->push_back(static_cast<double>(hit_totals[tenant])/get_totals[tenant]);
+	}
+	for(cache_type cache : caches) {
+		destroy_cache(cache);
+	}
+	return ns;
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	options.tenant_total = 5;
+	options.key_total = 200000;
+	options.value_size = 64;
+	options.op_total = 5000000;
+	options.cache_percent = 20;
+	int opt;
+	while((opt = getopt(argc, argv, "t:k:v:n:c:h")) != -1) {
+		if(opt == 't') {
+			options.tenant_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'k') {
+			options.key_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'v') {
+			options.value_size = strtoul(optarg, NULL, 10);
+		} else if(opt == 'n') {
+			options.op_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'c') {
+			options.cache_percent = strtoul(optarg, NULL, 10);
+		} else {
+			print_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if(options.tenant_total < 2 or options.key_total == 0 or options.op_total == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	printf("%u operations by %u quiet tenants of %u keys each and 1 noisy one, in %u%% of the quiet tenants' keys\n",
+		options.op_total, options.tenant_total - 1, options.key_total, options.cache_percent);
+	//the arrangements take turns, and each keeps its best run, since the differences are small next to the noise of one run
+	double best_ns[3] = {0, 0, 0};
+	std::vector<double> hit_ratios[3];
+	for(int run = 0; run < RUN_TOTAL; run += 1) {
+		for(int arrangement = SHARED; arrangement <= SEPARATE; arrangement += 1) {
+			double ns = run_tenants(&options, arrangement, &hit_ratios[arrangement]);
+			best_ns[arrangement] = run == 0 or ns < best_ns[arrangement] ? ns : best_ns[arrangement];
+		}
+	}
+	printf("%-12s %8s %s\n", "arrangement", "ns/op", "hit ratio of each quiet tenant");
+	for(int arrangement = SHARED; arrangement <= SEPARATE; arrangement += 1) {
+		printf("%-12s %8.1f", ARRANGEMENT_NAMES[arrangement], best_ns[arrangement]);
+		for(double hit_ratio : hit_ratios[arrangement]) {
+			printf(" %7.4f", hit_ratio);
+		}
+		printf("\n");
+	}
+	printf("partitioned against separate caches: %+5.1f%%\n", 100*(best_ns[PARTITIONED] - best_ns[SEPARATE])/best_ns[SEPARATE]);
+	return 0;
+}
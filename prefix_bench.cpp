@@ -0,0 +1,108 @@
+//By Monica Moniot and Alyssa Riceman
+//Measures what the prefix index costs and what it buys: a cache is filled with "tenantN:table:id" keys with the
+//index off and then on, and with it on, one tenant's keys are scanned and then deleted by prefix
+//Without the index the only way to do either is a cache_scan of the whole cache, which is timed for comparison
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "cache.h"
+
+struct Options {
+	uint32_t key_total;
+	uint32_t tenant_total;
+};
+
+inline uint64_t get_time_ns() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+
+inline void make_key(char* key, uint32_t i, uint32_t tenant_total) {
+	snprintf(key, 64, "tenant%u:%s:%u", i%tenant_total, (i/tenant_total)%2 ? "orders" : "users", i/tenant_total);
+}
+
+struct Scan_count {
+	const char* prefix;
+	uint32_t prefix_size;
+	uint32_t found_total;
+};
+void count_key(void* data, key_type key, val_type, index_type) {
+	Scan_count* count = static_cast<Scan_count*>(data);
+	if(strncmp(key, count->prefix, count->prefix_size) == 0) {
+		count->found_total += 1;
+	}
+}
+
+void print_usage(const char* name) {
+	printf("Usage: %s [-k keys] [-n tenants]\n", name);
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	options.key_total = 2000000;
+	options.tenant_total = 100;
+	int opt;
+	while((opt = getopt(argc, argv, "k:n:h")) != -1) {
+		if(opt == 'k') {
+			options.key_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'n') {
+			options.tenant_total = strtoul(optarg, NULL, 10);
+		} else {
+			print_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if(options.key_total == 0 or options.tenant_total == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	printf("%u keys across %u tenants, 8 byte values\n", options.key_total, options.tenant_total);
+
+	char key[64];
+	uint64_t value = 0;
+	cache_type cache = NULL;
+	for(int is_indexed = 0; is_indexed < 2; is_indexed += 1) {
+		cache = create_cache(UINT32_MAX, LRU, NULL);
+		cache_set_prefix_index(cache, is_indexed);
+		uint64_t start_time = get_time_ns();
+		for(uint32_t i = 0; i < options.key_total; i += 1) {
+			make_key(key, i, options.tenant_total);
+			value = i;
+			cache_set(cache, key, &value, sizeof(value));
+		}
+		double ms = (get_time_ns() - start_time)/1e6;
+		Memory_report report = cache_memory_report(cache);
+		printf("fill, index %-3s %9.1f ms  %9.0f sets/s  index %6.1f B/entry\n", is_indexed ? "on" : "off", ms, options.key_total/(ms/1e3), report.prefix_index_bytes/static_cast<double>(options.key_total));
+		if(not is_indexed) {
+			destroy_cache(cache);
+		}
+	}
+
+	Scan_count count;
+	count.prefix = "tenant7:";
+	count.prefix_size = strlen(count.prefix);
+	count.found_total = 0;
+	uint64_t start_time = get_time_ns();
+	index_type cursor = 0;
+	do {
+		cursor = cache_scan(cache, cursor, 1024, &count_key, &count);
+	} while(cursor != 0);
+	double full_ms = (get_time_ns() - start_time)/1e6;
+	printf("cache_scan of everything for %s  %9.2f ms  %u found\n", count.prefix, full_ms, count.found_total);
+
+	count.found_total = 0;
+	start_time = get_time_ns();
+	index_type visit_total = cache_scan_prefix(cache, count.prefix, &count_key, &count);
+	double scan_ms = (get_time_ns() - start_time)/1e6;
+	printf("cache_scan_prefix %s            %9.2f ms  %u found\n", count.prefix, scan_ms, static_cast<uint32_t>(visit_total));
+
+	start_time = get_time_ns();
+	index_type deleted_total = cache_delete_prefix(cache, count.prefix);
+	double delete_ms = (get_time_ns() - start_time)/1e6;
+	printf("cache_delete_prefix %s          %9.2f ms  %u deleted\n", count.prefix, delete_ms, static_cast<uint32_t>(deleted_total));
+	destroy_cache(cache);
+	return 0;
+}
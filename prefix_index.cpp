@@ -0,0 +1,196 @@
+//By Monica Moniot and Alyssa Riceman
+#include <stdlib.h>
+#include <cstring>
+#include <vector>
+#include "types.h"
+#include "book.h"
+#include "prefix_index.h"
+
+//a reference to either a node or a leaf; the low bit tells them apart
+using Prefix_ref = uint64_t;
+constexpr Prefix_ref NO_REF = -1;
+constexpr Index NO_NODE = -1;
+
+struct Prefix_node {
+	Prefix_ref child[2];
+	Index byte;//the byte of the keys this node splits them by
+	uint8_t other_bits;//every bit but the one it splits them by; a free node uses child[0] as the next free node
+};
+
+struct Prefix_index {
+	Prefix_ref root;
+	std::vector<Prefix_node> nodes;//nodes are refered to by their place here, so growing this moves nothing
+	Index first_free;
+};
+
+constexpr inline bool is_leaf(Prefix_ref ref) {
+	return ref&1;
+}
+constexpr inline Prefix_ref make_leaf(Bookmark bookmark) {
+	return (static_cast<Prefix_ref>(bookmark)<<1)|1;
+}
+constexpr inline Bookmark get_leaf(Prefix_ref ref) {
+	return static_cast<Bookmark>(ref>>1);
+}
+constexpr inline Prefix_ref make_node_ref(Index node_i) {
+	return static_cast<Prefix_ref>(node_i)<<1;
+}
+constexpr inline Index get_node_i(Prefix_ref ref) {
+	return static_cast<Index>(ref>>1);
+}
+inline const byte* get_key(const Book* book, Bookmark bookmark, Index* ret_key_size) {
+	const Entry* entry = read_book(book, bookmark);
+	*ret_key_size = entry->key_size;
+	return reinterpret_cast<const byte*>(entry->key);
+}
+inline int get_direction(const Prefix_node* node, const byte* key, Index key_size) {
+	//keys are treated as followed by zeros forever, so a key is never cut short by a node deeper than it is long
+	byte c = node->byte < key_size ? key[node->byte] : 0;
+	return (1 + (node->other_bits|c))>>8;
+}
+
+inline Index alloc_node(Prefix_index* index) {
+	if(index->first_free != NO_NODE) {
+		Index node_i = index->first_free;
+		index->first_free = static_cast<Index>(index->nodes[node_i].child[0]);
+		return node_i;
+	}
+	index->nodes.emplace_back();
+	return index->nodes.size() - 1;
+}
+inline void free_node(Prefix_index* index, Index node_i) {
+	index->nodes[node_i].child[0] = index->first_free;
+	index->first_free = node_i;
+}
+
+
+Prefix_index* create_prefix_index() {
+	Prefix_index* index = new Prefix_index;
+	index->root = NO_REF;
+	index->first_free = NO_NODE;
+	return index;
+}
+void destroy_prefix_index(Prefix_index* index) {
+	delete index;
+}
+
+void prefix_index_insert(Prefix_index* index, const Book* book, Bookmark bookmark) {
+	Index key_size;
+	const byte* key = get_key(book, bookmark, &key_size);
+	if(index->root == NO_REF) {
+		index->root = make_leaf(bookmark);
+		return;
+	}
+	//find the leaf our key would be at, which shares the most bits with it of any key in the index
+	Prefix_ref ref = index->root;
+	while(not is_leaf(ref)) {
+		const Prefix_node* node = &index->nodes[get_node_i(ref)];
+		ref = node->child[get_direction(node, key, key_size)];
+	}
+	Index closest_size;
+	const byte* closest = get_key(book, get_leaf(ref), &closest_size);
+	//the first bit at which the two differ is where our key goes
+	Index new_byte = 0;
+	byte diff = 0;
+	for(; new_byte < key_size; new_byte += 1) {
+		byte c = new_byte < closest_size ? closest[new_byte] : 0;
+		diff = c^key[new_byte];
+		if(diff != 0) break;
+	}
+	if(diff == 0) {
+		//keys are null terminated, so two keys that don't differ by then are the same key
+		return;
+	}
+	while(diff&(diff - 1)) {
+		diff &= diff - 1;
+	}
+	byte other_bits = diff^255;
+	byte closest_c = new_byte < closest_size ? closest[new_byte] : 0;
+	int new_direction = (1 + (other_bits|closest_c))>>8;
+
+	Index node_i = alloc_node(index);
+	Prefix_node* new_node = &index->nodes[node_i];
+	new_node->byte = new_byte;
+	new_node->other_bits = other_bits;
+	new_node->child[1 - new_direction] = make_leaf(bookmark);
+
+	//the new node goes above the first node that splits on a later bit than it does
+	Prefix_ref* where = &index->root;
+	while(true) {
+		Prefix_ref cur = *where;
+		if(is_leaf(cur)) break;
+		Prefix_node* node = &index->nodes[get_node_i(cur)];
+		if(node->byte > new_byte or (node->byte == new_byte and node->other_bits > other_bits)) break;
+		where = &node->child[get_direction(node, key, key_size)];
+	}
+	new_node->child[new_direction] = *where;
+	*where = make_node_ref(node_i);
+}
+
+void prefix_index_remove(Prefix_index* index, const Book* book, Bookmark bookmark) {
+	Index key_size;
+	const byte* key = get_key(book, bookmark, &key_size);
+	if(index->root == NO_REF) {
+		return;
+	}
+	Prefix_ref* where = &index->root;
+	Prefix_ref* parent_where = NULL;
+	Index parent_i = NO_NODE;
+	int direction = 0;
+	while(not is_leaf(*where)) {
+		parent_where = where;
+		parent_i = get_node_i(*where);
+		Prefix_node* node = &index->nodes[parent_i];
+		direction = get_direction(node, key, key_size);
+		where = &node->child[direction];
+	}
+	if(get_leaf(*where) != bookmark) {
+		return;
+	}
+	if(parent_where == NULL) {
+		index->root = NO_REF;
+		return;
+	}
+	//our leaf's sibling takes the place of our parent
+	*parent_where = index->nodes[parent_i].child[1 - direction];
+	free_node(index, parent_i);
+}
+
+void prefix_index_find(Prefix_index* index, const Book* book, const byte* prefix, Index prefix_size, std::vector<Bookmark>* ret_bookmarks) {
+	if(index->root == NO_REF) {
+		return;
+	}
+	//follow the prefix down to the last node that splits on a bit inside it; everything under that shares its bits
+	Prefix_ref ref = index->root;
+	Prefix_ref top = ref;
+	while(not is_leaf(ref)) {
+		const Prefix_node* node = &index->nodes[get_node_i(ref)];
+		ref = node->child[get_direction(node, prefix, prefix_size)];
+		if(node->byte < prefix_size) {
+			top = ref;
+		}
+	}
+	//the bits nodes don't split by were never checked, so one leaf under top must be compared in full
+	Index key_size;
+	const byte* key = get_key(book, get_leaf(ref), &key_size);
+	if(key_size <= prefix_size or memcmp(key, prefix, prefix_size) != 0) {
+		return;
+	}
+	std::vector<Prefix_ref> stack;
+	stack.push_back(top);
+	while(not stack.empty()) {
+		ref = stack.back();
+		stack.pop_back();
+		if(is_leaf(ref)) {
+			ret_bookmarks->push_back(get_leaf(ref));
+		} else {
+			const Prefix_node* node = &index->nodes[get_node_i(ref)];
+			stack.push_back(node->child[1]);
+			stack.push_back(node->child[0]);
+		}
+	}
+}
+
+uint64_t get_prefix_index_size(Prefix_index* index) {
+	return sizeof(Prefix_index) + sizeof(Prefix_node)*index->nodes.capacity();
+}
@@ -0,0 +1,25 @@
+//By Monica Moniot and Alyssa Riceman
+#ifndef PREFIX_INDEX_H
+#define PREFIX_INDEX_H
+#include <vector>
+#include "types.h"
+
+//An ordered index of the keys in a cache, kept alongside the hash table, so that every key starting with a
+//given prefix can be found without looking at any key that doesn't
+//It is a crit-bit tree: each internal node splits the keys below it by the first bit at which they differ,
+//so the keys under any node share every bit before its own, and there is exactly one node fewer than keys
+//Leaves are the Bookmarks of entries; the tree reads their keys straight out of the book, so it stores no keys
+//of its own, and since an entry never leaves its page, growing the table never disturbs it
+
+Prefix_index* create_prefix_index();
+void destroy_prefix_index(Prefix_index* index);
+
+//the entry at bookmark must already hold its key, and must not be in the index yet
+void prefix_index_insert(Prefix_index* index, const Book* book, Bookmark bookmark);
+//the entry at bookmark must still hold its key
+void prefix_index_remove(Prefix_index* index, const Book* book, Bookmark bookmark);
+//appends the bookmark of every entry whose key starts with the prefix_size bytes of prefix, in key order
+void prefix_index_find(Prefix_index* index, const Book* book, const byte* prefix, Index prefix_size, std::vector<Bookmark>* ret_bookmarks);
+//bytes of memory the index has allocated
+uint64_t get_prefix_index_size(Prefix_index* index);
+#endif
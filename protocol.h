@@ -0,0 +1,40 @@
+//By Monica Moniot and Alyssa Riceman
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+//The compact binary protocol the server speaks next to the memcached text protocol
+//A connection speaks binary if the first byte it sends is BINARY_REQUEST_MAGIC
+//Every field is in the host's byte order, which is little endian on everything we run on
+#include <inttypes.h>
+
+constexpr uint8_t BINARY_REQUEST_MAGIC = 0xCA;
+constexpr uint8_t BINARY_RESPONSE_MAGIC = 0xCB;
+
+enum {//binary_opcodes
+	BINARY_GET = 1,
+	BINARY_SET = 2,
+	BINARY_DELETE = 3,
+};
+enum {//binary_statuses
+	BINARY_OK = 0,
+	BINARY_NOT_FOUND = 1,
+	BINARY_TOO_LARGE = 2,
+	BINARY_BAD_REQUEST = 3,
+};
+
+//a request is this header followed by the key (not null terminated), then the value if it is a SET
+struct Binary_request {
+	uint8_t magic;
+	uint8_t opcode;
+	uint16_t key_size;
+	uint32_t value_size;//ignored unless the opcode is BINARY_SET
+	uint32_t opaque;//echoed back in the response
+};
+//a response is this header followed by the value if it is a successful GET
+struct Binary_response {
+	uint8_t magic;
+	uint8_t status;
+	uint16_t unused;
+	uint32_t value_size;
+	uint32_t opaque;
+};
+#endif
@@ -0,0 +1,78 @@
+//By Monica Moniot and Alyssa Riceman
+//Measures how long growing a big table takes the caller: a cache is filled with small values while every set
+//is timed, so the slowest set is the one that rehashed the largest table
+//This is repeated for cache_set_rehash_threads doubling from 1 up to the maximum
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "cache.h"
+
+struct Options {
+	uint32_t key_total;
+	uint32_t max_threads;
+};
+
+inline uint64_t get_time_ns() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+
+inline void make_key(char* key, uint32_t i) {
+	snprintf(key, 32, "key:%u", i);
+}
+
+void print_usage(const char* name) {
+	printf("Usage: %s [-k keys] [-t max threads]\n", name);
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	options.key_total = 8000000;
+	options.max_threads = 32;
+	int opt;
+	while((opt = getopt(argc, argv, "k:t:h")) != -1) {
+		if(opt == 'k') {
+			options.key_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 't') {
+			options.max_threads = strtoul(optarg, NULL, 10);
+		} else {
+			print_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if(options.key_total == 0 or options.max_threads == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	printf("filling %u keys of 8 byte values\n", options.key_total);
+
+	char key[32];
+	uint64_t value = 0;
+	double single_ms = 0;
+	for(uint32_t thread_total = 1; thread_total <= options.max_threads; thread_total *= 2) {
+		cache_type cache = create_cache(UINT32_MAX, LRU, NULL);
+		cache_set_rehash_threads(cache, thread_total);
+		uint64_t slowest_ns = 0;
+		uint64_t start_time = get_time_ns();
+		for(uint32_t i = 0; i < options.key_total; i += 1) {
+			make_key(key, i);
+			value = i;
+			uint64_t op_start = get_time_ns();
+			cache_set(cache, key, &value, sizeof(value));
+			uint64_t op_ns = get_time_ns() - op_start;
+			if(op_ns > slowest_ns) {
+				slowest_ns = op_ns;
+			}
+		}
+		double fill_ms = (get_time_ns() - start_time)/1e6;
+		destroy_cache(cache);
+		if(thread_total == 1) {
+			single_ms = slowest_ns/1e6;
+		}
+		printf("%2u threads  largest resize %8.1f ms  %5.2fx  whole fill %9.1f ms\n", thread_total, slowest_ns/1e6, single_ms/(slowest_ns/1e6), fill_ms);
+	}
+	return 0;
+}
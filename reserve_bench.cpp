@@ -0,0 +1,106 @@
+//By Monica Moniot and Alyssa Riceman
+//Measures what writing values straight into the cache saves: each value is "received" by copying it out of a source
+//buffer, standing in for a read from a socket or a file, either into a buffer of the caller's that cache_set then
+//copies, into a buffer cache_set_reserve hands out, or into a malloced buffer handed over with cache_set_owned
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "cache.h"
+
+constexpr int RUN_TOTAL = 3;
+
+struct Options {
+	uint32_t key_total;
+	uint32_t value_size;
+	uint32_t op_total;
+};
+
+inline uint64_t get_time_ns() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+
+inline void make_key(char* key, uint32_t i) {
+	snprintf(key, 32, "key:%u", i);
+}
+
+void print_usage(const char* name) {
+	printf("Usage: %s [-k keys] [-v value bytes] [-n operations]\n", name);
+}
+
+enum {
+	COPIED,
+	RESERVED,
+	OWNED,
+};
+const char* WAY_NAMES[] = {"cache_set", "reserve", "owned"};
+
+double run_sets(const Options* options, int way) {
+	uint64_t max_mem = static_cast<uint64_t>(options->key_total)*options->value_size;
+	cache_type cache = create_cache(max_mem > UINT32_MAX ? UINT32_MAX : max_mem, LRU, NULL);
+	std::vector<char> source(options->value_size, 's');
+	std::vector<char> received(options->value_size);
+	char key[32];
+	uint64_t start_time = get_time_ns();
+	for(uint32_t i = 0; i < options->op_total; i += 1) {
+		make_key(key, i%options->key_total);
+		source[i%options->value_size] += 1;//so no two values are quite the same
+		if(way == COPIED) {
+			memcpy(received.data(), source.data(), options->value_size);
+			cache_set(cache, key, received.data(), options->value_size);
+		} else if(way == RESERVED) {
+			void* buffer;
+			reservation_type reservation = cache_set_reserve(cache, key, options->value_size, &buffer);
+			memcpy(buffer, source.data(), options->value_size);
+			cache_set_commit(cache, reservation);
+		} else {
+			void* buffer = malloc(options->value_size);
+			memcpy(buffer, source.data(), options->value_size);
+			cache_set_owned(cache, key, buffer, options->value_size, NULL, NULL);
+		}
+	}
+	double ns = static_cast<double>(get_time_ns() - start_time)/options->op_total;
+	destroy_cache(cache);
+	return ns;
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	options.key_total = 1000;
+	options.value_size = 256*1024;
+	options.op_total = 20000;
+	int opt;
+	while((opt = getopt(argc, argv, "k:v:n:h")) != -1) {
+		if(opt == 'k') {
+			options.key_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'v') {
+			options.value_size = strtoul(optarg, NULL, 10);
+		} else if(opt == 'n') {
+			options.op_total = strtoul(optarg, NULL, 10);
+		} else {
+			print_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if(options.key_total == 0 or options.value_size == 0 or options.op_total == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	printf("%u sets of %u byte values over %u keys\n", options.op_total, options.value_size, options.key_total);
+	//the three take turns, and each keeps its best run, since the differences are small next to the noise of one run
+	double best_ns[3] = {0, 0, 0};
+	for(int run = 0; run < RUN_TOTAL; run += 1) {
+		for(int way = COPIED; way <= OWNED; way += 1) {
+			double ns = run_sets(&options, way);
+			best_ns[way] = run == 0 or ns < best_ns[way] ? ns : best_ns[way];
+		}
+	}
+	for(int way = COPIED; way <= OWNED; way += 1) {
+		printf("%-10s %10.1f ns/set  %6.2f GB/s  %+5.1f%%\n", WAY_NAMES[way], best_ns[way], options.value_size/best_ns[way], 100*(best_ns[way] - best_ns[COPIED])/best_ns[COPIED]);
+	}
+	return 0;
+}
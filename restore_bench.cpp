@@ -0,0 +1,108 @@
+//By Monica Moniot and Alyssa Riceman
+//Measures how long a warm restart takes: a cache is filled and snapshotted once, then the snapshot is loaded
+//back with cache_load_snapshot_with_threads, doubling the threads each time up to the maximum
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "cache.h"
+
+struct Options {
+	uint32_t key_total;
+	uint32_t value_size;
+	uint32_t max_threads;
+	uint32_t repeat_total;
+	const char* path;
+};
+
+inline uint64_t get_time_ns() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+
+inline void make_key(char* key, uint32_t i) {
+	snprintf(key, 32, "key:%u", i);
+}
+
+void print_usage(const char* name) {
+	printf("Usage: %s [-k keys] [-v value bytes] [-t max threads] [-r repeats] [-o path]\n", name);
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	options.key_total = 1000000;
+	options.value_size = 100;
+	options.max_threads = 32;
+	options.repeat_total = 3;
+	options.path = "/tmp/restore_bench.snapshot";
+	int opt;
+	while((opt = getopt(argc, argv, "k:v:t:r:o:h")) != -1) {
+		if(opt == 'k') {
+			options.key_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'v') {
+			options.value_size = strtoul(optarg, NULL, 10);
+		} else if(opt == 't') {
+			options.max_threads = strtoul(optarg, NULL, 10);
+		} else if(opt == 'r') {
+			options.repeat_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'o') {
+			options.path = optarg;
+		} else {
+			print_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if(options.key_total == 0 or options.max_threads == 0 or options.repeat_total == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	uint64_t mem_capacity = 4*static_cast<uint64_t>(options.key_total)*options.value_size;
+	cache_type cache = create_cache(mem_capacity > UINT32_MAX ? UINT32_MAX : mem_capacity, LRU, NULL);
+	char key[32];
+	std::vector<char> value(options.value_size, 'v');
+	for(uint32_t i = 0; i < options.key_total; i += 1) {
+		make_key(key, i);
+		cache_set(cache, key, value.data(), options.value_size);
+	}
+	if(not cache_start_snapshot(cache, options.path) or not cache_finish_snapshot(cache)) {
+		return 1;
+	}
+	destroy_cache(cache);
+	printf("restoring %u keys of %u bytes from %s, best of %u\n", options.key_total, options.value_size, options.path, options.repeat_total);
+
+	//the snapshot is in the page cache after being written, so this is the restart of a process, not a machine
+	double single_ms = 0;
+	for(uint32_t thread_total = 1; thread_total <= options.max_threads; thread_total *= 2) {
+		double best_ms = 0;
+		for(uint32_t r = 0; r < options.repeat_total; r += 1) {
+			uint64_t start_time = get_time_ns();
+			cache_type restored = cache_load_snapshot_with_threads(options.path, NULL, thread_total);
+			double ms = (get_time_ns() - start_time)/1e6;
+			if(restored == NULL) {
+				unlink(options.path);
+				return 1;
+			}
+			index_type val_size;
+			make_key(key, options.key_total - 1);
+			if(cache_get(restored, key, &val_size) == NULL or val_size != options.value_size) {
+				printf("restored cache is missing %s\n", key);
+				unlink(options.path);
+				return 1;
+			}
+			destroy_cache(restored);
+			if(r == 0 or ms < best_ms) {
+				best_ms = ms;
+			}
+		}
+		if(thread_total == 1) {
+			single_ms = best_ms;
+		}
+		printf("%2u threads %9.1f ms  %5.2fx\n", thread_total, best_ms, single_ms/best_ms);
+	}
+	unlink(options.path);
+	return 0;
+}
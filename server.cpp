@@ -0,0 +1,1000 @@
+//By Monica Moniot and Alyssa Riceman
+//A network server exposing a cache over TCP using the memcached text protocol
+//Every worker thread runs its own non-blocking epoll loop on its own SO_REUSEPORT listener,
+//so the kernel spreads connections across cores and workers never share a socket
+//The cache itself is split into shards by key, each behind its own lock
+//Connections whose first byte is BINARY_REQUEST_MAGIC speak the binary protocol of protocol.h instead,
+//whose GET responses are sent straight out of the cache's storage by pinning the value until the kernel is done with it
+#include <stdlib.h>
+#include <stdio.h>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/errqueue.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "cache.h"
+#include "protocol.h"
+
+using byte = uint8_t;
+
+constexpr int MAX_EVENTS = 256;
+constexpr size_t READ_CHUNK = 16*1024;
+constexpr size_t MAX_KEY_SIZE = 250;//the memcached limit
+constexpr size_t MAX_TOKENS = 24;
+constexpr size_t MAX_LINE_SIZE = 2048;
+constexpr size_t MAX_IOVECS = 64;
+constexpr size_t MAX_SEGMENT_SIZE = 64*1024;//owned output is packed into segments up to this size
+
+struct Shard {
+	std::mutex lock;
+	cache_type cache;
+};
+struct Item_header {
+	//stored in front of every value so that flags and cas survive the round trip through the cache
+	uint32_t flags;
+	uint32_t unused;
+	uint64_t cas;
+};
+struct Worker_stats {
+	std::atomic<uint64_t> cmd_get;
+	std::atomic<uint64_t> get_hits;
+	std::atomic<uint64_t> get_misses;
+	std::atomic<uint64_t> cmd_set;
+	std::atomic<uint64_t> cmd_delete;
+	std::atomic<uint64_t> curr_connections;
+	std::atomic<uint64_t> total_connections;
+};
+enum {//protocols
+	UNKNOWN_PROTOCOL,
+	TEXT_PROTOCOL,
+	BINARY_PROTOCOL,
+};
+struct Out_segment {
+	//a piece of pending output, either owned by the connection or pinned inside the cache
+	std::vector<char> buffer;
+	pin_type pin;
+	const char* data;//only used if pin isn't NULL
+	size_t size;//only used if pin isn't NULL
+	uint32_t zerocopy_call;//the last MSG_ZEROCOPY send that read from this segment, 0 if none did
+};
+struct Pending_segment {
+	//output a MSG_ZEROCOPY send may still be reading from: MSG_ZEROCOPY covers every iovec of the call, so this is
+	//either a pinned value or a buffer of the connection's own sent alongside one
+	pin_type pin;//NULL if it's a buffer
+	std::vector<char> buffer;
+	uint32_t zerocopy_call;
+};
+struct Connection {
+	int fd;
+	uint32_t protocol;
+	std::vector<char> in;
+	size_t in_start;
+	uint64_t swallow_total;//bytes of a value too large to ever store, dropped as they arrive rather than buffered
+	std::deque<Out_segment> out;
+	size_t out_start;//offset into the first segment
+	bool is_closing;
+	bool is_zerocopy;//whether SO_ZEROCOPY could be enabled on the socket
+	uint32_t zerocopy_sent;//MSG_ZEROCOPY sends made so far
+	uint32_t zerocopy_done;//MSG_ZEROCOPY sends the kernel has reported complete
+	std::deque<Pending_segment> zerocopy_pending;
+};
+struct Server {
+	uint16_t port;
+	uint32_t thread_total;
+	uint64_t mem_capacity;
+	evictor_type policy;
+	uint32_t shard_total;
+	uint64_t shard_capacity;
+	bool is_copying;//send binary GETs through the copy path, for comparison
+	uint64_t zerocopy_threshold;//values at least this large are sent with MSG_ZEROCOPY
+	uint32_t compress_threshold;//values at least this large are compressed, 0 if compression is off
+	bool is_counting_footprint;//whether -m bounds everything the caches allocate or just their values
+	uint32_t low_water_percent;//what a shard evicts down to once it's full
+	uint32_t headroom_percent;//what each shard's maintenance thread keeps free, 0 if shards have none
+	const char* disk_dir;//where evicted items are kept, NULL if they are just dropped
+	uint64_t disk_capacity;
+	const char* trace_path;//each shard traces to this followed by its number, NULL if they aren't traced
+	Shard* shards;
+	Worker_stats* stats;
+	std::atomic<uint64_t> next_cas;
+	time_t start_time;
+};
+
+static Server server;
+
+inline uint32_t shard_hash(const char* key, size_t key_size) {
+	//FNV-1a; kept independent of the cache's own hash so shards don't correlate with table slots
+	uint32_t hash = 2166136261u;
+	for(size_t i = 0; i < key_size; i += 1) {
+		hash = (hash^static_cast<byte>(key[i]))*16777619u;
+	}
+	return hash;
+}
+inline Shard* get_shard(const char* key, size_t key_size) {
+	return &server.shards[shard_hash(key, key_size)%server.shard_total];
+}
+
+inline void append_out(Connection* conn, const char* data, size_t size) {
+	if(conn->out.empty() or conn->out.back().pin != NULL or conn->out.back().buffer.size() >= MAX_SEGMENT_SIZE) {
+		conn->out.emplace_back();
+		auto segment = &conn->out.back();
+		segment->pin = NULL;
+		segment->zerocopy_call = 0;
+	}
+	auto buffer = &conn->out.back().buffer;
+	buffer->insert(buffer->end(), data, data + size);
+}
+inline void append_pinned(Connection* conn, pin_type pin, const char* data, size_t size) {
+	//the connection takes over the pin, and releases it once the value has been sent
+	conn->out.emplace_back();
+	auto segment = &conn->out.back();
+	segment->pin = pin;
+	segment->data = data;
+	segment->size = size;
+	segment->zerocopy_call = 0;
+}
+inline void get_segment_bytes(const Out_segment* segment, const char** data, size_t* size) {
+	if(segment->pin == NULL) {
+		*data = segment->buffer.data();
+		*size = segment->buffer.size();
+	} else {
+		*data = segment->data;
+		*size = segment->size;
+	}
+}
+inline void append_out(Connection* conn, const char* str) {
+	append_out(conn, str, strlen(str));
+}
+
+size_t tokenize(char* line, char** tokens) {
+	//splits the command line in place on spaces
+	size_t token_total = 0;
+	char* cur = line;
+	while(*cur != 0 and token_total < MAX_TOKENS) {
+		while(*cur == ' ') {
+			cur += 1;
+		}
+		if(*cur == 0) {
+			break;
+		}
+		tokens[token_total] = cur;
+		token_total += 1;
+		while(*cur != ' ' and *cur != 0) {
+			cur += 1;
+		}
+		if(*cur == ' ') {
+			*cur = 0;
+			cur += 1;
+		}
+	}
+	return token_total;
+}
+bool parse_uint(const char* str, uint64_t* ret) {
+	if(*str == 0) {
+		return false;
+	}
+	char* end;
+	errno = 0;
+	*ret = strtoull(str, &end, 10);
+	return errno == 0 and *end == 0 and str[0] != '-';
+}
+
+bool store_value(const char* key, size_t key_size, uint32_t flags, const char* data, size_t data_size, std::vector<byte>* scratch) {
+	//stores the value behind an Item_header, returns false if it can never fit
+	if(sizeof(Item_header) + data_size > server.shard_capacity) {
+		return false;
+	}
+	Item_header header;
+	header.flags = flags;
+	header.unused = 0;
+	header.cas = server.next_cas.fetch_add(1, std::memory_order_relaxed);
+	scratch->resize(sizeof(Item_header) + data_size);
+	memcpy(scratch->data(), &header, sizeof(Item_header));
+	memcpy(scratch->data() + sizeof(Item_header), data, data_size);
+	Shard* shard = get_shard(key, key_size);
+	std::lock_guard<std::mutex> guard(shard->lock);
+	cache_set(shard->cache, key, scratch->data(), scratch->size());
+	return true;
+}
+bool delete_value(const char* key, size_t key_size) {
+	//returns whether the key was there to delete
+	Shard* shard = get_shard(key, key_size);
+	std::lock_guard<std::mutex> guard(shard->lock);
+	return cache_delete(shard->cache, key);
+}
+
+void process_get(Connection* conn, Worker_stats* stats, char** tokens, size_t token_total, bool with_cas) {
+	char line[MAX_KEY_SIZE + 64];
+	for(size_t i = 1; i < token_total; i += 1) {
+		const char* key = tokens[i];
+		size_t key_size = strlen(key);
+		if(key_size > MAX_KEY_SIZE) {
+			append_out(conn, "CLIENT_ERROR bad command line format\r\n");
+			return;
+		}
+		stats->cmd_get.fetch_add(1, std::memory_order_relaxed);
+		Shard* shard = get_shard(key, key_size);
+		//copy the value straight into the response while the shard is locked
+		std::lock_guard<std::mutex> guard(shard->lock);
+		index_type size = 0;
+		auto value = static_cast<const byte*>(cache_get(shard->cache, key, &size));
+		if(value == NULL or size < sizeof(Item_header)) {
+			stats->get_misses.fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+		stats->get_hits.fetch_add(1, std::memory_order_relaxed);
+		Item_header header;
+		memcpy(&header, value, sizeof(Item_header));
+		auto data_size = size - sizeof(Item_header);
+		int line_size;
+		if(with_cas) {
+			line_size = snprintf(line, sizeof(line), "VALUE %s %u %zu %llu\r\n", key, header.flags, data_size, static_cast<unsigned long long>(header.cas));
+		} else {
+			line_size = snprintf(line, sizeof(line), "VALUE %s %u %zu\r\n", key, header.flags, data_size);
+		}
+		append_out(conn, line, line_size);
+		append_out(conn, reinterpret_cast<const char*>(value + sizeof(Item_header)), data_size);
+		append_out(conn, "\r\n", 2);
+	}
+	append_out(conn, "END\r\n");
+}
+
+void process_delete(Connection* conn, Worker_stats* stats, char** tokens, size_t token_total) {
+	bool is_noreply = token_total == 3 and strcmp(tokens[2], "noreply") == 0;
+	if(token_total != 2 and not is_noreply) {
+		append_out(conn, "CLIENT_ERROR bad command line format\r\n");
+		return;
+	}
+	const char* key = tokens[1];
+	size_t key_size = strlen(key);
+	if(key_size > MAX_KEY_SIZE) {
+		append_out(conn, "CLIENT_ERROR bad command line format\r\n");
+		return;
+	}
+	stats->cmd_delete.fetch_add(1, std::memory_order_relaxed);
+	bool is_found = delete_value(key, key_size);
+	if(not is_noreply) {
+		append_out(conn, is_found ? "DELETED\r\n" : "NOT_FOUND\r\n");
+	}
+}
+
+void process_stats(Connection* conn) {
+	uint64_t totals[7] = {};
+	for(uint32_t i = 0; i < server.thread_total; i += 1) {
+		auto stats = &server.stats[i];
+		totals[0] += stats->cmd_get.load(std::memory_order_relaxed);
+		totals[1] += stats->get_hits.load(std::memory_order_relaxed);
+		totals[2] += stats->get_misses.load(std::memory_order_relaxed);
+		totals[3] += stats->cmd_set.load(std::memory_order_relaxed);
+		totals[4] += stats->cmd_delete.load(std::memory_order_relaxed);
+		totals[5] += stats->curr_connections.load(std::memory_order_relaxed);
+		totals[6] += stats->total_connections.load(std::memory_order_relaxed);
+	}
+	uint64_t bytes = 0;
+	uint64_t footprint = 0;
+	Compression_stats compression;
+	memset(&compression, 0, sizeof(compression));
+	Disk_tier_stats disk;
+	memset(&disk, 0, sizeof(disk));
+	//the shards' tables are summed, except the longest probe and chain, which are the longest of any shard
+	Table_stats table;
+	memset(&table, 0, sizeof(table));
+	for(uint32_t i = 0; i < server.shard_total; i += 1) {
+		auto shard = &server.shards[i];
+		std::lock_guard<std::mutex> guard(shard->lock);
+		bytes += cache_compression_stats(shard->cache).stored_bytes;
+		footprint += cache_memory_report(shard->cache).total;
+		auto shard_compression = cache_compression_stats(shard->cache);
+		compression.raw_bytes += shard_compression.raw_bytes;
+		compression.compress_total += shard_compression.compress_total;
+		compression.incompressible_total += shard_compression.incompressible_total;
+		compression.compress_ns += shard_compression.compress_ns;
+		compression.decompress_total += shard_compression.decompress_total;
+		compression.decompress_ns += shard_compression.decompress_ns;
+		auto shard_disk = cache_disk_tier_stats(shard->cache);
+		disk.hit_total += shard_disk.hit_total;
+		disk.miss_total += shard_disk.miss_total;
+		disk.bytes_written += shard_disk.bytes_written;
+		disk.dropped_total += shard_disk.dropped_total;
+		disk.entry_total += shard_disk.entry_total;
+		disk.disk_bytes += shard_disk.disk_bytes;
+		auto shard_table = cache_table_stats(shard->cache);
+		table.slot_total += shard_table.slot_total;
+		table.dead_total += shard_table.dead_total;
+		table.hit_total += shard_table.hit_total;
+		table.miss_total += shard_table.miss_total;
+		table.hit_probe_total += shard_table.hit_probe_total;
+		table.miss_probe_total += shard_table.miss_probe_total;
+		table.max_probe = shard_table.max_probe > table.max_probe ? shard_table.max_probe : table.max_probe;
+		table.max_chain = shard_table.max_chain > table.max_chain ? shard_table.max_chain : table.max_chain;
+		table.full_traversal_total += shard_table.full_traversal_total;
+		table.resize_total += shard_table.resize_total;
+	}
+	char buffer[2048];
+	int size = snprintf(buffer, sizeof(buffer),
+		"STAT pid %d\r\n"
+		"STAT uptime %llu\r\n"
+		"STAT time %llu\r\n"
+		"STAT threads %u\r\n"
+		"STAT curr_connections %llu\r\n"
+		"STAT total_connections %llu\r\n"
+		"STAT cmd_get %llu\r\n"
+		"STAT cmd_set %llu\r\n"
+		"STAT cmd_delete %llu\r\n"
+		"STAT get_hits %llu\r\n"
+		"STAT get_misses %llu\r\n"
+		"STAT bytes %llu\r\n"
+		"STAT limit_maxbytes %llu\r\n"
+		"STAT footprint_bytes %llu\r\n"
+		"STAT compress_threshold %u\r\n"
+		"STAT raw_bytes %llu\r\n"
+		"STAT compression_ratio %.3f\r\n"
+		"STAT compressions %llu\r\n"
+		"STAT incompressible %llu\r\n"
+		"STAT compress_usec %llu\r\n"
+		"STAT decompressions %llu\r\n"
+		"STAT decompress_usec %llu\r\n"
+		"STAT disk_limit_bytes %llu\r\n"
+		"STAT disk_hits %llu\r\n"
+		"STAT disk_misses %llu\r\n"
+		"STAT disk_items %llu\r\n"
+		"STAT disk_bytes %llu\r\n"
+		"STAT disk_bytes_written %llu\r\n"
+		"STAT disk_dropped %llu\r\n"
+		"STAT table_slots %llu\r\n"
+		"STAT table_graves %llu\r\n"
+		"STAT table_hit_probes %.3f\r\n"
+		"STAT table_miss_probes %.3f\r\n"
+		"STAT table_max_probe %llu\r\n"
+		"STAT table_max_chain %llu\r\n"
+		"STAT table_full_traversals %llu\r\n"
+		"STAT table_resizes %llu\r\n"
+		"END\r\n",
+		getpid(),
+		static_cast<unsigned long long>(time(NULL) - server.start_time),
+		static_cast<unsigned long long>(time(NULL)),
+		server.thread_total,
+		static_cast<unsigned long long>(totals[5]),
+		static_cast<unsigned long long>(totals[6]),
+		static_cast<unsigned long long>(totals[0]),
+		static_cast<unsigned long long>(totals[3]),
+		static_cast<unsigned long long>(totals[4]),
+		static_cast<unsigned long long>(totals[1]),
+		static_cast<unsigned long long>(totals[2]),
+		static_cast<unsigned long long>(bytes),
+		static_cast<unsigned long long>(server.mem_capacity),
+		static_cast<unsigned long long>(footprint),
+		server.compress_threshold,
+		static_cast<unsigned long long>(compression.raw_bytes),
+		bytes == 0 ? 1.0 : static_cast<double>(compression.raw_bytes)/bytes,
+		static_cast<unsigned long long>(compression.compress_total),
+		static_cast<unsigned long long>(compression.incompressible_total),
+		static_cast<unsigned long long>(compression.compress_ns/1000),
+		static_cast<unsigned long long>(compression.decompress_total),
+		static_cast<unsigned long long>(compression.decompress_ns/1000),
+		static_cast<unsigned long long>(server.disk_dir == NULL ? 0 : server.disk_capacity),
+		static_cast<unsigned long long>(disk.hit_total),
+		static_cast<unsigned long long>(disk.miss_total),
+		static_cast<unsigned long long>(disk.entry_total),
+		static_cast<unsigned long long>(disk.disk_bytes),
+		static_cast<unsigned long long>(disk.bytes_written),
+		static_cast<unsigned long long>(disk.dropped_total),
+		static_cast<unsigned long long>(table.slot_total),
+		static_cast<unsigned long long>(table.dead_total),
+		table.hit_total == 0 ? 0.0 : static_cast<double>(table.hit_probe_total)/table.hit_total,
+		table.miss_total == 0 ? 0.0 : static_cast<double>(table.miss_probe_total)/table.miss_total,
+		static_cast<unsigned long long>(table.max_probe),
+		static_cast<unsigned long long>(table.max_chain),
+		static_cast<unsigned long long>(table.full_traversal_total),
+		static_cast<unsigned long long>(table.resize_total));
+	append_out(conn, buffer, size);
+}
+
+inline bool swallow_input(Connection* conn) {
+	//drops what has arrived of a rejected value, returns whether there's more of it still to come
+	size_t available = conn->in.size() - conn->in_start;
+	size_t dropped = available < conn->swallow_total ? available : conn->swallow_total;
+	conn->in_start += dropped;
+	conn->swallow_total -= dropped;
+	return conn->swallow_total > 0;
+}
+
+void process_text_input(Connection* conn, Worker_stats* stats, std::vector<byte>* scratch) {
+	//consumes every complete request in the input buffer
+	char* tokens[MAX_TOKENS];
+	char line[MAX_LINE_SIZE + 1];
+	while(conn->in_start < conn->in.size()) {
+		if(swallow_input(conn)) {
+			return;
+		}
+		char* begin = conn->in.data() + conn->in_start;
+		size_t available = conn->in.size() - conn->in_start;
+		auto newline = static_cast<char*>(memchr(begin, '\n', available < MAX_LINE_SIZE ? available : MAX_LINE_SIZE));
+		if(newline == NULL) {
+			if(available >= MAX_LINE_SIZE) {//nobody sends command lines this long
+				append_out(conn, "CLIENT_ERROR line too long\r\n");
+				conn->is_closing = true;
+			}
+			return;
+		}
+		size_t line_size = newline - begin + 1;
+		//tokenize a copy, so a set can be left untouched in the buffer while its data arrives
+		size_t text_size = line_size - 1;
+		if(text_size > 0 and begin[text_size - 1] == '\r') {
+			text_size -= 1;
+		}
+		memcpy(line, begin, text_size);
+		line[text_size] = 0;
+		size_t token_total = tokenize(line, tokens);
+		if(token_total == 0) {
+			conn->in_start += line_size;
+			append_out(conn, "ERROR\r\n");
+			continue;
+		}
+		const char* command = tokens[0];
+		if(strcmp(command, "get") == 0 or strcmp(command, "gets") == 0) {
+			conn->in_start += line_size;
+			if(token_total < 2) {
+				append_out(conn, "ERROR\r\n");
+			} else {
+				process_get(conn, stats, tokens, token_total, command[3] == 's');
+			}
+		} else if(strcmp(command, "set") == 0) {
+			bool is_noreply = token_total == 6 and strcmp(tokens[5], "noreply") == 0;
+			uint64_t flags, exptime, data_size;
+			if((token_total != 5 and not is_noreply) or strlen(tokens[1]) > MAX_KEY_SIZE
+			or not parse_uint(tokens[2], &flags) or not parse_uint(tokens[3], &exptime) or not parse_uint(tokens[4], &data_size)
+			or flags > UINT32_MAX) {
+				conn->in_start += line_size;
+				append_out(conn, "CLIENT_ERROR bad command line format\r\n");
+				continue;
+			}
+			if(data_size > server.shard_capacity) {
+				//checked before anything is added to data_size, which the client may have set anywhere up to UINT64_MAX
+				stats->cmd_set.fetch_add(1, std::memory_order_relaxed);
+				conn->in_start += line_size;
+				conn->swallow_total = data_size + 2;
+				if(not is_noreply) {
+					append_out(conn, "SERVER_ERROR object too large for cache\r\n");
+				}
+				continue;
+			}
+			if(available < line_size + data_size + 2) {//the data block hasn't fully arrived yet
+				return;
+			}
+			const char* data = begin + line_size;
+			conn->in_start += line_size + data_size + 2;
+			if(data[data_size] != '\r' or data[data_size + 1] != '\n') {
+				append_out(conn, "CLIENT_ERROR bad data chunk\r\n");
+				continue;
+			}
+			//exptime is accepted for compatibility, the cache has no notion of expiry
+			stats->cmd_set.fetch_add(1, std::memory_order_relaxed);
+			const char* key = tokens[1];
+			bool is_stored = store_value(key, strlen(key), static_cast<uint32_t>(flags), data, data_size, scratch);
+			if(not is_noreply) {
+				append_out(conn, is_stored ? "STORED\r\n" : "SERVER_ERROR object too large for cache\r\n");
+			}
+		} else if(strcmp(command, "delete") == 0) {
+			conn->in_start += line_size;
+			process_delete(conn, stats, tokens, token_total);
+		} else if(strcmp(command, "stats") == 0) {
+			conn->in_start += line_size;
+			process_stats(conn);
+		} else if(strcmp(command, "version") == 0) {
+			conn->in_start += line_size;
+			append_out(conn, "VERSION 1.0\r\n");
+		} else if(strcmp(command, "quit") == 0) {
+			conn->in_start += line_size;
+			conn->is_closing = true;
+			return;
+		} else {
+			conn->in_start += line_size;
+			append_out(conn, "ERROR\r\n");
+		}
+	}
+}
+
+void append_binary_response(Connection* conn, uint8_t status, uint32_t value_size, uint32_t opaque) {
+	Binary_response response;
+	response.magic = BINARY_RESPONSE_MAGIC;
+	response.status = status;
+	response.unused = 0;
+	response.value_size = value_size;
+	response.opaque = opaque;
+	append_out(conn, reinterpret_cast<const char*>(&response), sizeof(response));
+}
+void process_binary_get(Connection* conn, Worker_stats* stats, const char* key, size_t key_size, uint32_t opaque) {
+	stats->cmd_get.fetch_add(1, std::memory_order_relaxed);
+	Shard* shard = get_shard(key, key_size);
+	std::lock_guard<std::mutex> guard(shard->lock);
+	val_type value;
+	index_type size = 0;
+	pin_type pin = NULL;
+	if(server.is_copying) {
+		value = cache_get(shard->cache, key, &size);
+	} else {
+		pin = cache_pin(shard->cache, key, &value, &size);
+		if(pin == NULL) {
+			value = NULL;
+		}
+	}
+	if(value == NULL or size < sizeof(Item_header)) {
+		if(pin != NULL) {
+			cache_unpin(pin);
+		}
+		stats->get_misses.fetch_add(1, std::memory_order_relaxed);
+		append_binary_response(conn, BINARY_NOT_FOUND, 0, opaque);
+		return;
+	}
+	stats->get_hits.fetch_add(1, std::memory_order_relaxed);
+	auto data = static_cast<const char*>(value) + sizeof(Item_header);
+	auto data_size = size - sizeof(Item_header);
+	append_binary_response(conn, BINARY_OK, data_size, opaque);
+	if(pin == NULL) {
+		append_out(conn, data, data_size);
+	} else {
+		//the value goes out straight from the cache's storage, pinned until the kernel is done with it
+		append_pinned(conn, pin, data, data_size);
+	}
+}
+void process_binary_input(Connection* conn, Worker_stats* stats, std::vector<byte>* scratch) {
+	//consumes every complete request in the input buffer
+	char key[MAX_KEY_SIZE + 1];
+	while(not swallow_input(conn) and conn->in.size() - conn->in_start >= sizeof(Binary_request)) {
+		const char* begin = conn->in.data() + conn->in_start;
+		size_t available = conn->in.size() - conn->in_start;
+		Binary_request request;
+		memcpy(&request, begin, sizeof(request));
+		if(request.magic != BINARY_REQUEST_MAGIC) {
+			//we can't find the next request anymore, so the connection is done for
+			append_binary_response(conn, BINARY_BAD_REQUEST, 0, request.opaque);
+			conn->is_closing = true;
+			return;
+		}
+		size_t value_size = request.opcode == BINARY_SET ? request.value_size : 0;
+		if(value_size > server.shard_capacity) {
+			stats->cmd_set.fetch_add(1, std::memory_order_relaxed);
+			conn->in_start += sizeof(request);
+			conn->swallow_total = request.key_size + value_size;
+			append_binary_response(conn, BINARY_TOO_LARGE, 0, request.opaque);
+			continue;
+		}
+		size_t request_size = sizeof(request) + request.key_size + value_size;
+		if(available < request_size) {
+			return;
+		}
+		conn->in_start += request_size;
+		const char* data = begin + sizeof(request) + request.key_size;
+		size_t key_size = request.key_size;
+		memcpy(key, begin + sizeof(request), key_size < MAX_KEY_SIZE ? key_size : MAX_KEY_SIZE);
+		if(key_size == 0 or key_size > MAX_KEY_SIZE or memchr(begin + sizeof(request), 0, key_size) != NULL) {
+			append_binary_response(conn, BINARY_BAD_REQUEST, 0, request.opaque);
+			continue;
+		}
+		key[key_size] = 0;
+		if(request.opcode == BINARY_GET) {
+			process_binary_get(conn, stats, key, key_size, request.opaque);
+		} else if(request.opcode == BINARY_SET) {
+			stats->cmd_set.fetch_add(1, std::memory_order_relaxed);
+			bool is_stored = store_value(key, key_size, 0, data, value_size, scratch);
+			append_binary_response(conn, is_stored ? BINARY_OK : BINARY_TOO_LARGE, 0, request.opaque);
+		} else if(request.opcode == BINARY_DELETE) {
+			stats->cmd_delete.fetch_add(1, std::memory_order_relaxed);
+			bool is_found = delete_value(key, key_size);
+			append_binary_response(conn, is_found ? BINARY_OK : BINARY_NOT_FOUND, 0, request.opaque);
+		} else {
+			append_binary_response(conn, BINARY_BAD_REQUEST, 0, request.opaque);
+		}
+	}
+}
+
+void process_input(Connection* conn, Worker_stats* stats, std::vector<byte>* scratch) {
+	if(conn->protocol == UNKNOWN_PROTOCOL) {
+		if(conn->in.size() == conn->in_start) {
+			return;
+		}
+		conn->protocol = static_cast<uint8_t>(conn->in[conn->in_start]) == BINARY_REQUEST_MAGIC ? BINARY_PROTOCOL : TEXT_PROTOCOL;
+	}
+	if(conn->protocol == BINARY_PROTOCOL) {
+		process_binary_input(conn, stats, scratch);
+	} else {
+		process_text_input(conn, stats, scratch);
+	}
+}
+
+
+int create_listener(uint16_t port) {
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if(fd < 0) {
+		perror("socket");
+		return -1;
+	}
+	int one = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if(setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+		perror("setsockopt SO_REUSEPORT");
+		close(fd);
+		return -1;
+	}
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port);
+	if(bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 or listen(fd, 1024) < 0) {
+		perror("bind/listen");
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+void release_pins(Connection* conn) {
+	//if the kernel is still sending from a pinned value it holds its own reference to the pages,
+	//so releasing early can at worst change bytes going to a peer that has already left
+	for(auto& segment : conn->out) {
+		if(segment.pin != NULL) {
+			cache_unpin(segment.pin);
+		}
+	}
+	conn->out.clear();
+	for(auto& pending : conn->zerocopy_pending) {
+		if(pending.pin != NULL) {
+			cache_unpin(pending.pin);
+		}
+	}
+	conn->zerocopy_pending.clear();
+}
+void close_connection(int epoll_fd, Connection* conn, Worker_stats* stats) {
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+	close(conn->fd);
+	release_pins(conn);
+	stats->curr_connections.fetch_sub(1, std::memory_order_relaxed);
+	delete conn;
+}
+
+void read_zerocopy_completions(Connection* conn) {
+	//the kernel reports finished MSG_ZEROCOPY sends as ranges of send ids on the error queue
+	while(true) {
+		char control[128];
+		msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if(recvmsg(conn->fd, &msg, MSG_ERRQUEUE) < 0) {
+			break;
+		}
+		for(cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			bool is_recverr = (cmsg->cmsg_level == SOL_IP and cmsg->cmsg_type == IP_RECVERR) or (cmsg->cmsg_level == SOL_IPV6 and cmsg->cmsg_type == IPV6_RECVERR);
+			if(not is_recverr) {
+				continue;
+			}
+			auto error = reinterpret_cast<sock_extended_err*>(CMSG_DATA(cmsg));
+			if(error->ee_origin == SO_EE_ORIGIN_ZEROCOPY and error->ee_errno == 0) {
+				//the kernel numbers sends from 0, we number them from 1
+				if(error->ee_data + 1 > conn->zerocopy_done) {
+					conn->zerocopy_done = error->ee_data + 1;
+				}
+			}
+		}
+	}
+	auto pending = &conn->zerocopy_pending;
+	while(not pending->empty() and pending->front().zerocopy_call <= conn->zerocopy_done) {
+		if(pending->front().pin != NULL) {
+			cache_unpin(pending->front().pin);
+		}
+		pending->pop_front();
+	}
+}
+
+void finish_segment(Connection* conn) {
+	auto segment = &conn->out.front();
+	if(segment->zerocopy_call != 0) {
+		//the kernel may still read the segment's pages, so it's kept until the send is reported complete
+		conn->zerocopy_pending.emplace_back();
+		auto pending = &conn->zerocopy_pending.back();
+		pending->pin = segment->pin;
+		pending->buffer.swap(segment->buffer);
+		pending->zerocopy_call = segment->zerocopy_call;
+	} else if(segment->pin != NULL) {
+		//a plain send has already copied the bytes into the kernel
+		cache_unpin(segment->pin);
+	}
+	conn->out.pop_front();
+	conn->out_start = 0;
+}
+bool flush_output(int epoll_fd, Connection* conn) {
+	//writes as much pending output as the socket takes, gathering segments with sendmsg
+	//returns false if the connection died
+	while(not conn->out.empty()) {
+		iovec iovecs[MAX_IOVECS];
+		size_t iovec_total = 0;
+		bool is_zerocopy = false;
+		size_t start = conn->out_start;
+		for(auto& segment : conn->out) {
+			if(iovec_total == MAX_IOVECS) {
+				break;
+			}
+			const char* data;
+			size_t size;
+			get_segment_bytes(&segment, &data, &size);
+			iovecs[iovec_total].iov_base = const_cast<char*>(data + start);
+			iovecs[iovec_total].iov_len = size - start;
+			iovec_total += 1;
+			start = 0;
+			if(segment.pin != NULL and size >= server.zerocopy_threshold and conn->is_zerocopy) {
+				//page pinning only beats a copy for large values
+				is_zerocopy = true;
+			}
+		}
+		msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iovecs;
+		msg.msg_iovlen = iovec_total;
+		auto sent = sendmsg(conn->fd, &msg, MSG_NOSIGNAL | (is_zerocopy ? MSG_ZEROCOPY : 0));
+		if(sent < 0) {
+			if(errno == EAGAIN or errno == EWOULDBLOCK) {
+				break;
+			} else if(errno == EINTR) {
+				continue;
+			} else if(errno == ENOBUFS and is_zerocopy) {
+				//we ran out of optmem for notifications, so fall back to copying
+				conn->is_zerocopy = false;
+				continue;
+			}
+			return false;
+		}
+		uint32_t zerocopy_call = 0;
+		if(is_zerocopy) {
+			conn->zerocopy_sent += 1;
+			zerocopy_call = conn->zerocopy_sent;
+		}
+		size_t left = sent;
+		while(not conn->out.empty()) {//empty segments are finished here too
+			auto segment = &conn->out.front();
+			const char* data;
+			size_t size;
+			get_segment_bytes(segment, &data, &size);
+			if(zerocopy_call != 0) {
+				segment->zerocopy_call = zerocopy_call;
+			}
+			auto segment_left = size - conn->out_start;
+			if(left < segment_left) {
+				conn->out_start += left;
+				break;
+			}
+			left -= segment_left;
+			finish_segment(conn);
+		}
+	}
+	epoll_event event;
+	event.data.ptr = conn;
+	event.events = conn->out.empty() ? EPOLLIN : EPOLLIN | EPOLLOUT;
+	epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+	return true;
+}
+
+void run_worker(uint32_t worker_i) {
+	auto stats = &server.stats[worker_i];
+	int listen_fd = create_listener(server.port);
+	if(listen_fd < 0) {
+		exit(1);
+	}
+	int epoll_fd = epoll_create1(0);
+	epoll_event event;
+	event.events = EPOLLIN;
+	event.data.ptr = NULL;//the listener is the only event without a connection
+	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+
+	std::vector<byte> scratch;
+	epoll_event events[MAX_EVENTS];
+	while(true) {
+		int event_total = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+		if(event_total < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			perror("epoll_wait");
+			exit(1);
+		}
+		for(int i = 0; i < event_total; i += 1) {
+			auto conn = static_cast<Connection*>(events[i].data.ptr);
+			if(conn == NULL) {//accept every pending connection
+				while(true) {
+					int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK);
+					if(fd < 0) {
+						break;
+					}
+					int one = 1;
+					setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+					conn = new Connection;
+					conn->fd = fd;
+					conn->protocol = UNKNOWN_PROTOCOL;
+					conn->in_start = 0;
+					conn->swallow_total = 0;
+					conn->out_start = 0;
+					conn->is_closing = false;
+					conn->is_zerocopy = not server.is_copying and setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+					conn->zerocopy_sent = 0;
+					conn->zerocopy_done = 0;
+					epoll_event conn_event;
+					conn_event.events = EPOLLIN;
+					conn_event.data.ptr = conn;
+					epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &conn_event);
+					stats->curr_connections.fetch_add(1, std::memory_order_relaxed);
+					stats->total_connections.fetch_add(1, std::memory_order_relaxed);
+				}
+				continue;
+			}
+			bool is_alive = true;
+			if(events[i].events & EPOLLERR) {
+				//zerocopy completions arrive as errors, so check for a real one after reading them
+				read_zerocopy_completions(conn);
+				int error = 0;
+				socklen_t error_size = sizeof(error);
+				if(getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &error, &error_size) < 0 or error != 0) {
+					is_alive = false;
+				}
+			}
+			if(events[i].events & EPOLLHUP) {
+				is_alive = false;
+			}
+			if(is_alive and (events[i].events & EPOLLIN)) {
+				while(true) {
+					auto pre_size = conn->in.size();
+					conn->in.resize(pre_size + READ_CHUNK);
+					auto got = recv(conn->fd, conn->in.data() + pre_size, READ_CHUNK, 0);
+					if(got <= 0) {
+						conn->in.resize(pre_size);
+						if(got == 0 or (errno != EAGAIN and errno != EWOULDBLOCK and errno != EINTR)) {
+							is_alive = false;
+						}
+						break;
+					}
+					conn->in.resize(pre_size + got);
+					if(static_cast<size_t>(got) < READ_CHUNK) {
+						break;
+					}
+				}
+				process_input(conn, stats, &scratch);
+				//drop everything we have consumed
+				conn->in.erase(conn->in.begin(), conn->in.begin() + conn->in_start);
+				conn->in_start = 0;
+			}
+			if(is_alive and not conn->out.empty()) {
+				is_alive = flush_output(epoll_fd, conn);
+			}
+			if(not is_alive or (conn->is_closing and conn->out.empty())) {
+				close_connection(epoll_fd, conn, stats);
+			}
+		}
+	}
+}
+
+
+void print_usage(const char* name) {
+	printf("Usage: %s [-p port] [-t threads] [-m megabytes] [-e fifo|lifo|lru|mru|clock|slru|rr] [-z zerocopy threshold bytes] [-c (copy binary values)] [-F (count keys and metadata against -m)] [-Z compression threshold bytes] [-D disk tier directory] [-S disk tier megabytes] [-W percent a full shard evicts down to] [-M percent a maintenance thread per shard keeps free] [-T trace path, for trace_replay]\n", name);
+}
+
+int main(int argc, char** argv) {
+	server.port = 11211;
+	server.thread_total = std::thread::hardware_concurrency();
+	if(server.thread_total == 0) {
+		server.thread_total = 1;
+	}
+	server.mem_capacity = 64*1024*1024;
+	server.policy = LRU;
+	server.is_copying = false;
+	server.zerocopy_threshold = 16*1024;
+	server.compress_threshold = 0;
+	server.is_counting_footprint = false;
+	server.low_water_percent = 100;
+	server.headroom_percent = 0;
+	server.disk_dir = NULL;
+	server.disk_capacity = 1024*1024*1024;
+	server.trace_path = NULL;
+	int opt;
+	while((opt = getopt(argc, argv, "p:t:m:e:z:cFZ:D:S:W:M:T:h")) != -1) {
+		if(opt == 'p') {
+			server.port = atoi(optarg);
+		} else if(opt == 't') {
+			server.thread_total = atoi(optarg);
+		} else if(opt == 'm') {
+			server.mem_capacity = strtoull(optarg, NULL, 10)*1024*1024;
+		} else if(opt == 'z') {
+			server.zerocopy_threshold = strtoull(optarg, NULL, 10);
+		} else if(opt == 'c') {
+			server.is_copying = true;
+		} else if(opt == 'Z') {
+			server.compress_threshold = strtoul(optarg, NULL, 10);
+		} else if(opt == 'F') {
+			server.is_counting_footprint = true;
+		} else if(opt == 'D') {
+			server.disk_dir = optarg;
+		} else if(opt == 'S') {
+			server.disk_capacity = strtoull(optarg, NULL, 10)*1024*1024;
+		} else if(opt == 'W') {
+			server.low_water_percent = strtoul(optarg, NULL, 10);
+		} else if(opt == 'M') {
+			server.headroom_percent = strtoul(optarg, NULL, 10);
+		} else if(opt == 'T') {
+			server.trace_path = optarg;
+		} else if(opt == 'e') {
+			const char* names[] = {"fifo", "lifo", "lru", "mru", "clock", "slru", "rr"};
+			bool is_found = false;
+			for(evictor_type i = 0; i < 7; i += 1) {
+				if(strcmp(optarg, names[i]) == 0) {
+					server.policy = i;
+					is_found = true;
+				}
+			}
+			if(not is_found) {
+				print_usage(argv[0]);
+				return 1;
+			}
+		} else {
+			print_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if(server.thread_total == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	signal(SIGPIPE, SIG_IGN);
+	//more shards than threads keeps two workers from fighting over the same lock too often
+	server.shard_total = 4*server.thread_total;
+	uint64_t shard_capacity = server.mem_capacity/server.shard_total;
+	server.shard_capacity = shard_capacity;
+	if(shard_capacity > static_cast<index_type>(-1)) {
+		printf("Error: %llu bytes per shard exceeds the cache's index_type\n", static_cast<unsigned long long>(shard_capacity));
+		return 1;
+	}
+	server.shards = new Shard[server.shard_total];
+	for(uint32_t i = 0; i < server.shard_total; i += 1) {
+		server.shards[i].cache = create_cache(static_cast<index_type>(shard_capacity), server.policy, NULL);
+		cache_set_compression(server.shards[i].cache, server.compress_threshold);
+		cache_set_footprint_mode(server.shards[i].cache, server.is_counting_footprint);
+		cache_set_low_watermark(server.shards[i].cache, server.low_water_percent);
+		if(server.headroom_percent != 0) {
+			cache_start_maintenance(server.shards[i].cache, &server.shards[i].lock, server.headroom_percent);
+		}
+		if(server.trace_path != NULL) {
+			char shard_path[4096];
+			snprintf(shard_path, sizeof(shard_path), "%s.%u", server.trace_path, i);
+			if(not cache_start_trace(server.shards[i].cache, shard_path, 0)) {
+				return 1;
+			}
+		}
+		//every shard gets its own slice of the disk and its own writer
+		if(server.disk_dir != NULL and not cache_set_disk_tier(server.shards[i].cache, server.disk_dir, server.disk_capacity/server.shard_total)) {
+			return 1;
+		}
+	}
+	server.stats = new Worker_stats[server.thread_total]();
+	server.next_cas = 1;
+	server.start_time = time(NULL);
+
+	printf("Listening on port %u with %u threads and %llu bytes\n", server.port, server.thread_total, static_cast<unsigned long long>(server.mem_capacity));
+	fflush(stdout);
+	std::vector<std::thread> workers;
+	for(uint32_t i = 1; i < server.thread_total; i += 1) {
+		workers.emplace_back(run_worker, i);
+	}
+	run_worker(0);
+	return 0;
+}
@@ -0,0 +1,166 @@
+//By Monica Moniot and Alyssa Riceman
+//Measures what a snapshot costs the caller of a busy cache
+//The cache is filled, then a single thread runs a mix of sets and gets, timing each one, and part way through
+//takes a snapshot, either in the background with cache_start_snapshot or stopping the world with serialize_cache
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#include "cache.h"
+
+struct Options {
+	uint32_t key_total;
+	uint32_t value_size;
+	double duration;
+	double snapshot_time;
+	bool is_blocking;
+	const char* path;
+};
+
+inline uint64_t get_time_ns() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+
+inline void make_key(char* key, uint32_t i) {
+	snprintf(key, 32, "key:%u", i);
+}
+
+void print_latencies(const char* name, std::vector<uint64_t>* latencies, uint64_t duration_ns) {
+	if(latencies->empty()) {
+		printf("%-16s no operations\n", name);
+		return;
+	}
+	std::sort(latencies->begin(), latencies->end());
+	auto at = [latencies](double quantile) {
+		size_t i = static_cast<size_t>(quantile*(latencies->size() - 1));
+		return (*latencies)[i]/1000.0;
+	};
+	printf("%-16s %9.0f ops/s  p50 %7.2f us  p99 %7.2f us  p99.9 %9.2f us  max %10.2f us\n", name,
+		latencies->size()/(duration_ns/1e9), at(.5), at(.99), at(.999), latencies->back()/1000.0);
+}
+
+void print_usage(const char* name) {
+	printf("Usage: %s [-k keys] [-v value bytes] [-d seconds] [-s seconds until the snapshot] [-b (block on serialize_cache instead)] [-o path]\n", name);
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	options.key_total = 1000000;
+	options.value_size = 100;
+	options.duration = 4;
+	options.snapshot_time = 1;
+	options.is_blocking = false;
+	options.path = "/tmp/snapshot_bench.snapshot";
+	int opt;
+	while((opt = getopt(argc, argv, "k:v:d:s:bo:h")) != -1) {
+		if(opt == 'k') {
+			options.key_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'v') {
+			options.value_size = strtoul(optarg, NULL, 10);
+		} else if(opt == 'd') {
+			options.duration = atof(optarg);
+		} else if(opt == 's') {
+			options.snapshot_time = atof(optarg);
+		} else if(opt == 'b') {
+			options.is_blocking = true;
+		} else if(opt == 'o') {
+			options.path = optarg;
+		} else {
+			print_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if(options.key_total == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	uint64_t mem_capacity = 4*static_cast<uint64_t>(options.key_total)*options.value_size;
+	cache_type cache = create_cache(mem_capacity > UINT32_MAX ? UINT32_MAX : mem_capacity, LRU, NULL);
+	char key[32];
+	std::vector<char> value(options.value_size, 'v');
+	for(uint32_t i = 0; i < options.key_total; i += 1) {
+		make_key(key, i);
+		cache_set(cache, key, value.data(), options.value_size);
+	}
+	printf("filled %u keys of %u bytes, snapshotting %s after %.1fs\n", options.key_total, options.value_size, options.is_blocking ? "with serialize_cache" : "in the background", options.snapshot_time);
+
+	std::vector<uint64_t> before;
+	std::vector<uint64_t> during;
+	std::vector<uint64_t> after;
+	uint64_t start_time = get_time_ns();
+	uint64_t end_time = start_time + static_cast<uint64_t>(options.duration*1e9);
+	uint64_t snapshot_start = start_time + static_cast<uint64_t>(options.snapshot_time*1e9);
+	uint64_t snapshot_end = 0;
+	uint64_t call_ns = 0;
+	bool is_snapshotting = false;
+	uint32_t seed = 1;
+	uint64_t now = start_time;
+	while(now < end_time) {
+		if(snapshot_end == 0 and not is_snapshotting and now >= snapshot_start) {
+			snapshot_start = now;
+			if(options.is_blocking) {
+				Mem_array arr = serialize_cache(cache);
+				FILE* file = fopen(options.path, "wb");
+				if(file != NULL) {
+					fwrite(arr.data, 1, arr.size, file);
+					fclose(file);
+				}
+				delete[] static_cast<char*>(arr.data);
+				now = get_time_ns();
+				snapshot_end = now;
+				call_ns = now - snapshot_start;
+				//the request that arrived first had to wait for all of it
+				during.push_back(call_ns);
+			} else {
+				if(not cache_start_snapshot(cache, options.path)) {
+					return 1;
+				}
+				now = get_time_ns();
+				call_ns = now - snapshot_start;
+				during.push_back(call_ns);
+				is_snapshotting = true;
+			}
+		}
+		seed = seed*1103515245 + 12345;
+		make_key(key, (seed>>8)%options.key_total);
+		uint64_t op_start = now;
+		if(seed&(1<<30)) {
+			cache_set(cache, key, value.data(), options.value_size);
+		} else {
+			index_type val_size;
+			cache_get(cache, key, &val_size);
+		}
+		//the first call to notice the snapshot is done frees what it deferred, so that's timed too
+		bool is_done = is_snapshotting and not cache_is_snapshotting(cache);
+		now = get_time_ns();
+		if(is_snapshotting) {
+			during.push_back(now - op_start);
+			if(is_done) {
+				is_snapshotting = false;
+				snapshot_end = now;
+			}
+		} else if(snapshot_end == 0) {
+			before.push_back(now - op_start);
+		} else {
+			after.push_back(now - op_start);
+		}
+	}
+	if(is_snapshotting) {
+		cache_finish_snapshot(cache);
+		snapshot_end = get_time_ns();
+		end_time = snapshot_end;
+	}
+	printf("snapshot took %.1f ms, of which the call held up the caller for %.2f ms\n", (snapshot_end - snapshot_start)/1e6, call_ns/1e6);
+	print_latencies("before snapshot", &before, snapshot_start - start_time);
+	print_latencies("during snapshot", &during, snapshot_end - snapshot_start);
+	print_latencies("after snapshot", &after, end_time > snapshot_end ? end_time - snapshot_end : 1);
+	destroy_cache(cache);
+	unlink(options.path);
+	return 0;
+}
@@ -0,0 +1,127 @@
+//By Monica Moniot and Alyssa Riceman
+//Shows what cache_table_stats says about a hash that clusters: a cache is filled with keys under each of a few
+//hash functions, then got at random as many times as there are keys, and as many keys that aren't there are got
+//too; the mean probes of each are printed next to what an even hash would average, along with what a get cost
+//The hashes are the default, the default without its final fold, as it was on 32 bit builds, and a sum of the bytes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "cache.h"
+
+constexpr int RUN_TOTAL = 3;
+
+struct Options {
+	uint32_t key_total;
+	uint32_t value_size;
+};
+
+inline uint64_t get_time_ns() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+
+inline void make_key(char* key, uint32_t i) {
+	snprintf(key, 32, "key:%u", i);
+}
+inline void make_absent_key(char* key, uint32_t i) {
+	snprintf(key, 32, "absent:%u", i);
+}
+
+index_type unfolded_hash(key_type key) {
+	//the multiplicative hash the cache uses, a word at a time, but without folding the high half into the low
+	constexpr index_type multiplier = sizeof(index_type) == 8 ? static_cast<index_type>(11400714819323198485ull) : static_cast<index_type>(2654435769u);
+	size_t size = strlen(key) + 1;
+	index_type hash = size*multiplier;
+	size_t i = 0;
+	for(; i + sizeof(index_type) <= size; i += sizeof(index_type)) {
+		index_type word;
+		memcpy(&word, &key[i], sizeof(index_type));
+		hash = (hash^word)*multiplier;
+	}
+	for(; i < size; i += 1) {
+		hash = (hash^key[i])*multiplier;
+	}
+	return hash;
+}
+index_type byte_sum_hash(key_type key) {
+	index_type hash = 0;
+	for(size_t i = 0; key[i] != 0; i += 1) {
+		hash += static_cast<unsigned char>(key[i]);
+	}
+	return hash;
+}
+
+void print_usage(const char* name) {
+	printf("Usage: %s [-k keys] [-v value bytes]\n", name);
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	options.key_total = 1000000;
+	options.value_size = 16;
+	int opt;
+	while((opt = getopt(argc, argv, "k:v:h")) != -1) {
+		if(opt == 'k') {
+			options.key_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'v') {
+			options.value_size = strtoul(optarg, NULL, 10);
+		} else {
+			print_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if(options.key_total == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	const char* names[] = {"default", "unfolded", "byte sum"};
+	hash_func hashes[] = {NULL, unfolded_hash, byte_sum_hash};
+	//the byte sum puts every key in a few hundred chains, so it only gets a slice of the keys, or it would take hours
+	uint32_t key_totals[] = {options.key_total, options.key_total, options.key_total < 20000 ? options.key_total : 20000};
+
+	uint64_t mem_capacity = 4*static_cast<uint64_t>(options.key_total)*options.value_size;
+	std::vector<char> value(options.value_size, 'v');
+	char key[32];
+	printf("%u keys of %u bytes, as many gets of random ones, and as many of keys that aren't there\n", options.key_total, options.value_size);
+	printf("%10s %8s %10s %10s %10s %10s %9s %9s %10s\n", "hash", "keys", "hit probes", "even", "miss probes", "even", "max chain", "hit ns", "");
+	for(uint32_t h = 0; h < 3; h += 1) {
+		cache_type cache = create_cache(mem_capacity > UINT32_MAX ? UINT32_MAX : mem_capacity, LRU, hashes[h]);
+		uint32_t key_total = key_totals[h];
+		for(uint32_t i = 0; i < key_total; i += 1) {
+			make_key(key, i);
+			cache_set(cache, key, value.data(), options.value_size);
+		}
+		Table_stats before = cache_table_stats(cache);
+		//gets are timed best of several runs, since the difference is small next to the noise of one run
+		//keys are got in random order, since in the order they were set their chains would still be in the cpu's cache
+		double hit_ns = 0;
+		index_type val_size;
+		uint32_t seed = 1;
+		for(int run = 0; run < RUN_TOTAL; run += 1) {
+			uint64_t start_time = get_time_ns();
+			for(uint32_t i = 0; i < key_total; i += 1) {
+				seed = seed*1103515245 + 12345;
+				make_key(key, (seed>>4)%key_total);
+				cache_get(cache, key, &val_size);
+			}
+			double ns = static_cast<double>(get_time_ns() - start_time)/key_total;
+			hit_ns = run == 0 or ns < hit_ns ? ns : hit_ns;
+		}
+		for(uint32_t i = 0; i < key_total; i += 1) {
+			make_absent_key(key, i);
+			cache_get(cache, key, &val_size);
+		}
+		Table_stats stats = cache_table_stats(cache);
+		destroy_cache(cache);
+		double hit_mean = static_cast<double>(stats.hit_probe_total - before.hit_probe_total)/(stats.hit_total - before.hit_total);
+		double miss_mean = static_cast<double>(stats.miss_probe_total - before.miss_probe_total)/(stats.miss_total - before.miss_total);
+		bool is_clustered = hit_mean > 2*stats.expected_hit_probes or miss_mean > 2*stats.expected_miss_probes;
+		printf("%10s %8u %10.2f %10.2f %10.2f %10.2f %9llu %9.1f %10s\n", names[h], key_total, hit_mean, stats.expected_hit_probes,
+			miss_mean, stats.expected_miss_probes, static_cast<unsigned long long>(stats.max_chain), hit_ns, is_clustered ? "clustered" : "");
+	}
+	return 0;
+}
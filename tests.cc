@@ -3,12 +3,19 @@
 #include <iostream>
 #include <cmath>
 #include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
 #include <cstdlib>
 #include <ctime>
+#include <cstring>
+#include <unistd.h>
 #include "cache.h"
 #include "book.h"
 #include "eviction.h"
 #include "types.h"
+#include "trace.h"
 
 //////////////////////
 // Helper Functions //
@@ -29,6 +36,15 @@ index_type bad_hash_func(const char* message) {
     return message[0];
 }
 
+// Helper function for test_parallel_rehash; every key lands in one of 8192 probe sequences
+index_type colliding_hash_func(const char* message) {
+    index_type hash = 0;
+    for (const char* c = message; *c != 0; c++) {
+        hash = 31 * hash + *c;
+    }
+    return hash % 8192;
+}
+
 // Helper function for reading values
 std::string read_val(val_type value) {
     const char* val_as_cstring = static_cast<const char*>(value);
@@ -102,7 +118,10 @@ int test_cache_delete(cache_type cache1) {
         return -1;
     }
 
-    cache_delete(cache1, KEY1);
+    if (!cache_delete(cache1, KEY1) || cache_delete(cache1, KEY1)) {
+        std::cout << "Delete did not report whether the key was there.\n";
+        return -1;
+    }
     retrieved_val = cache_get(cache1, KEY1, &SMALLVAL_SIZE);
     if (retrieved_val != NULL) {
         std::cout << "Small value was not deleted cleanly. Expected null pointer; received pointer to value " << read_val(retrieved_val) << ".\n";
@@ -215,6 +234,159 @@ int test_evictor(cache_type cache1) {
     return 0;
 }
 
+// Helpers for the eviction policy tests; every value is the same size, so the cache always holds the same number of them
+const index_type POLICY_VAL_SIZE = 32;
+const int POLICY_KEY_TOTAL = CACHE_SIZE / POLICY_VAL_SIZE;
+std::string policy_key(int i) {
+    return "key" + std::to_string(i);
+}
+std::string policy_val(int i, int version) {
+    std::string val = std::to_string(i) + ":" + std::to_string(version);
+    val.resize(POLICY_VAL_SIZE - 1, 'v');
+    return val;
+}
+void set_policy_key(cache_type cache1, int i, int version) {
+    std::string key = policy_key(i);
+    std::string val = policy_val(i, version);
+    cache_set(cache1, key.c_str(), val.c_str(), POLICY_VAL_SIZE);
+}
+bool has_policy_key(cache_type cache1, int i) {
+    std::string key = policy_key(i);
+    index_type retrieved_size = 0;
+    return cache_get(cache1, key.c_str(), &retrieved_size) != NULL;
+}
+
+int test_lifo_evictor(cache_type cache1) {
+    //the newest entries are evicted first, so the oldest ones survive sets past capacity, even one that evicts two
+    for (int i = 0; i < POLICY_KEY_TOTAL + 8; i++) {
+        set_policy_key(cache1, i, 0);
+    }
+    std::string double_val(2 * POLICY_VAL_SIZE - 1, 'v');
+    cache_set(cache1, "double", double_val.c_str(), 2 * POLICY_VAL_SIZE);
+    for (int i = 0; i < POLICY_KEY_TOTAL - 2; i++) {
+        if (!has_policy_key(cache1, i)) {
+            std::cout << "Cache evicted an old entry under LIFO policy. Evicted: " << policy_key(i) << ".\n";
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int test_mru_evictor(cache_type cache1) {
+    //the entry used last is evicted first, then the one set last, and no others
+    for (int i = 0; i < POLICY_KEY_TOTAL; i++) {
+        set_policy_key(cache1, i, 0);
+    }
+    has_policy_key(cache1, 5);
+    std::string double_val(2 * POLICY_VAL_SIZE - 1, 'v');
+    cache_set(cache1, "double", double_val.c_str(), 2 * POLICY_VAL_SIZE);
+    if (has_policy_key(cache1, 5) || has_policy_key(cache1, POLICY_KEY_TOTAL - 1)) {
+        std::cout << "Cache did not evict the most recently used entries under MRU policy.\n";
+        return -1;
+    }
+    for (int i = 0; i < POLICY_KEY_TOTAL - 1; i++) {
+        if (i != 5 && !has_policy_key(cache1, i)) {
+            std::cout << "Cache evicted an unexpected entry under MRU policy. Evicted: " << policy_key(i) << ".\n";
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int test_slru_evictor(cache_type cache1) {
+    //using half the entries fills the protected segment, so using one more demotes the oldest protected entry;
+    //using that demoted entry again must promote it and demote the next oldest in turn
+    const int PROTECTED_TOTAL = POLICY_KEY_TOTAL / 2;
+    for (int i = 0; i < POLICY_KEY_TOTAL; i++) {
+        set_policy_key(cache1, i, 0);
+    }
+    for (int i = 0; i <= PROTECTED_TOTAL; i++) {
+        has_policy_key(cache1, i);
+    }
+    has_policy_key(cache1, 0);
+    //the new sets evict every entry that was never used, then the two oldest demoted ones
+    for (int i = 0; i < POLICY_KEY_TOTAL - PROTECTED_TOTAL + 1; i++) {
+        set_policy_key(cache1, POLICY_KEY_TOTAL + i, 0);
+    }
+    if (has_policy_key(cache1, 1) || has_policy_key(cache1, 2)) {
+        std::cout << "Cache did not evict the demoted entries under SLRU policy.\n";
+        return -1;
+    }
+    for (int i = 0; i <= PROTECTED_TOTAL; i++) {
+        if (i == 0 || i > 2) {
+            if (!has_policy_key(cache1, i)) {
+                std::cout << "Cache evicted a protected entry under SLRU policy. Evicted: " << policy_key(i) << ".\n";
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int test_clock_evictor(cache_type cache1) {
+    //every entry has been used, so the hand clears them all and comes back around to the oldest
+    for (int i = 0; i < POLICY_KEY_TOTAL; i++) {
+        set_policy_key(cache1, i, 0);
+    }
+    for (int i = 0; i < POLICY_KEY_TOTAL; i++) {
+        has_policy_key(cache1, i);
+    }
+    set_policy_key(cache1, POLICY_KEY_TOTAL, 0);
+    if (has_policy_key(cache1, 0)) {
+        std::cout << "Cache did not evict the oldest entry once every entry was used under CLOCK policy.\n";
+        return -1;
+    }
+    for (int i = 1; i <= POLICY_KEY_TOTAL; i++) {
+        if (!has_policy_key(cache1, i)) {
+            std::cout << "Cache evicted an unexpected entry under CLOCK policy. Evicted: " << policy_key(i) << ".\n";
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int test_evictor_consistency(cache_type cache1) {
+    //a long mix of sets, gets and deletes over more keys than fit; whatever the policy evicts, what's left
+    //must read back as it was last set and add up to the space the cache reports
+    const int KEY_SPACE = 4 * POLICY_KEY_TOTAL;
+    int versions[KEY_SPACE];
+    for (int i = 0; i < KEY_SPACE; i++) {
+        versions[i] = -1;
+    }
+    uint32_t seed = 1;
+    for (int step = 0; step < 20000; step++) {
+        seed = seed * 1103515245 + 12345;
+        int i = (seed >> 8) % KEY_SPACE;
+        uint32_t op = (seed >> 4) % 8;
+        std::string key = policy_key(i);
+        if (op < 4) {
+            set_policy_key(cache1, i, step);
+            versions[i] = step;
+        } else if (op < 7) {
+            index_type retrieved_size = 0;
+            val_type retrieved_val = cache_get(cache1, key.c_str(), &retrieved_size);
+            if (retrieved_val != NULL && (versions[i] == -1 || read_val(retrieved_val) != policy_val(i, versions[i]))) {
+                std::cout << "Cache returned a stale or mangled value after evicting. Key: " << key << "; retrieved value: " << read_val(retrieved_val) << ".\n";
+                return -1;
+            }
+        } else {
+            cache_delete(cache1, key.c_str());
+            versions[i] = -1;
+        }
+    }
+    index_type present_total = 0;
+    for (int i = 0; i < KEY_SPACE; i++) {
+        if (has_policy_key(cache1, i)) {
+            present_total += 1;
+        }
+    }
+    if (present_total == 0 || cache_space_used(cache1) != present_total * POLICY_VAL_SIZE) {
+        std::cout << "Space used does not match the entries left after evicting. Entries: " << present_total << "; space used: " << cache_space_used(cache1) << ".\n";
+        return -1;
+    }
+    return 0;
+}
+
 int test_resizing(cache_type cache1) {
     const int ONE_MORE_THAN_CAPACITY = 129; //Should be enough to make the cache resize, or to throw an error if it fails
 
@@ -228,6 +400,276 @@ int test_resizing(cache_type cache1) {
     return 0;
 }
 
+int test_pin(cache_type cache1) {
+    cache_set(cache1, KEY1, SMALLVAL, SMALLVAL_SIZE);
+    val_type pinned_val;
+    index_type pinned_size;
+    pin_type pin = cache_pin(cache1, KEY1, &pinned_val, &pinned_size);
+    if (pin == NULL || read_val(pinned_val) != read_val(SMALLVAL)) {
+        std::cout << "Value could not be pinned after being stored.\n";
+        return -1;
+    }
+
+    cache_set(cache1, KEY1, LARGEVAL, LARGEVAL_SIZE); //Overwriting and deleting must leave the pinned value intact
+    cache_delete(cache1, KEY1);
+    if (read_val(pinned_val) != read_val(SMALLVAL) || pinned_size != SMALLVAL_SIZE) {
+        std::cout << "Pinned value changed after its key was overwritten and deleted. Pinned value: " << read_val(SMALLVAL) << "; value read through pin: " << read_val(pinned_val) << ".\n";
+        cache_unpin(pin);
+        return -1;
+    }
+    cache_unpin(pin);
+
+    pin = cache_pin(cache1, UNUSEDKEY, &pinned_val, &pinned_size);
+    if (pin != NULL) {
+        std::cout << "Unassigned key could be pinned.\n";
+        cache_unpin(pin);
+        return -1;
+    }
+
+    return 0;
+}
+
+int test_compression(cache_type cache1) {
+    const index_type RAW_SIZE = 1024;
+    char* compressible_val = new char[RAW_SIZE];
+    for (index_type i = 0; i < RAW_SIZE - 1; i++) {
+        compressible_val[i] = "{\"id\": 12, \"name\": \"abc\"}"[i % 26];
+    }
+    compressible_val[RAW_SIZE - 1] = 0;
+    cache_set_compression(cache1, LARGEVAL_SIZE);
+
+    cache_set(cache1, KEY1, compressible_val, RAW_SIZE);
+    cache_set(cache1, KEY2, SMALLVAL, SMALLVAL_SIZE); //Below the threshold, so it is stored as is
+    const index_type space = cache_space_used(cache1);
+    if (space >= RAW_SIZE) {
+        std::cout << "Compressible value was not compressed. Raw size: " << RAW_SIZE << "; space used: " << space << ".\n";
+        delete[] compressible_val;
+        return -1;
+    }
+
+    index_type retrieved_size = 0;
+    val_type retrieved_val = cache_get(cache1, KEY1, &retrieved_size);
+    if (retrieved_val == NULL || retrieved_size != RAW_SIZE || read_val(retrieved_val) != read_val(compressible_val)) {
+        std::cout << "Compressed value was not decompressed correctly by cache_get.\n";
+        delete[] compressible_val;
+        return -1;
+    }
+
+    char* buffer = new char[RAW_SIZE];
+    bool is_found = cache_get_into(cache1, KEY1, buffer, RAW_SIZE - 1, &retrieved_size);
+    if (is_found || retrieved_size != RAW_SIZE) {
+        std::cout << "cache_get_into did not reject a buffer too small for the value. Reported size: " << retrieved_size << ".\n";
+        delete[] compressible_val;
+        delete[] buffer;
+        return -1;
+    }
+    is_found = cache_get_into(cache1, KEY1, buffer, RAW_SIZE, &retrieved_size);
+    if (!is_found || read_val(buffer) != read_val(compressible_val)) {
+        std::cout << "Compressed value was not decompressed correctly by cache_get_into.\n";
+        delete[] compressible_val;
+        delete[] buffer;
+        return -1;
+    }
+    delete[] buffer;
+
+    retrieved_val = cache_get(cache1, KEY2, &retrieved_size);
+    if (retrieved_val == NULL || read_val(retrieved_val) != read_val(SMALLVAL)) {
+        std::cout << "Value below the compression threshold was stored or retrieved incorrectly.\n";
+        delete[] compressible_val;
+        return -1;
+    }
+
+    Compression_stats stats = cache_compression_stats(cache1);
+    if (stats.raw_bytes != RAW_SIZE + SMALLVAL_SIZE || stats.stored_bytes != space || stats.compress_total != 1 || stats.decompress_total != 2) {
+        std::cout << "Compression stats are wrong. Raw bytes: " << stats.raw_bytes << "; stored bytes: " << stats.stored_bytes << "; compressions: " << stats.compress_total << "; decompressions: " << stats.decompress_total << ".\n";
+        delete[] compressible_val;
+        return -1;
+    }
+
+    delete[] compressible_val;
+    return 0;
+}
+
+int test_disk_tier(cache_type cache1) {
+    if (!cache_set_disk_tier(cache1, "/tmp", LARGE_CACHE_SIZE)) {
+        std::cout << "Disk tier could not be created in /tmp.\n";
+        return -1;
+    }
+    index_type largevals_per_cache = CACHE_SIZE / LARGEVAL_SIZE;
+    key_type activekey;
+    for (index_type i = 0; i < 2 * largevals_per_cache; i++) { //Half of these get evicted to disk
+        activekey = make_str_of_defined_length(i + 2);
+        cache_set(cache1, activekey, LARGEVAL, LARGEVAL_SIZE);
+        delete[] activekey;
+    }
+    cache_flush_disk_tier(cache1);
+
+    index_type retrieved_size = 0;
+    activekey = make_str_of_defined_length(2);
+    val_type retrieved_val = cache_get(cache1, activekey, &retrieved_size);
+    if (retrieved_val == NULL || retrieved_size != LARGEVAL_SIZE || read_val(retrieved_val) != read_val(LARGEVAL)) {
+        std::cout << "Evicted value was not read back from the disk tier.\n";
+        delete[] activekey;
+        return -1;
+    }
+    delete[] activekey;
+
+    activekey = make_str_of_defined_length(3); //Deleting or overwriting a key must forget its copy on disk
+    cache_delete(cache1, activekey);
+    retrieved_val = cache_get(cache1, activekey, &retrieved_size);
+    delete[] activekey;
+    if (retrieved_val != NULL) {
+        std::cout << "Deleted value was read back from the disk tier.\n";
+        return -1;
+    }
+    activekey = make_str_of_defined_length(4);
+    cache_set(cache1, activekey, SMALLVAL, SMALLVAL_SIZE);
+    retrieved_val = cache_get(cache1, activekey, &retrieved_size);
+    delete[] activekey;
+    if (retrieved_val == NULL || read_val(retrieved_val) != read_val(SMALLVAL)) {
+        std::cout << "Overwritten value was read back from the disk tier instead of its new value.\n";
+        return -1;
+    }
+
+    Disk_tier_stats stats = cache_disk_tier_stats(cache1);
+    if (stats.hit_total != 1 || stats.write_total < largevals_per_cache) {
+        std::cout << "Disk tier stats are wrong. Hits: " << stats.hit_total << "; records written: " << stats.write_total << ".\n";
+        return -1;
+    }
+    return 0;
+}
+
+int test_memory_report(cache_type cache1) {
+    const index_type KEY_TOTAL = 1000; //Their values alone would fit many times over, but not with their keys and entries
+    key_type activekey;
+    cache_set_footprint_mode(cache1, true);
+    for (index_type i = 0; i < KEY_TOTAL; i++) {
+        std::string key = "key" + std::to_string(i);
+        cache_set(cache1, key.c_str(), SMALLVAL, SMALLVAL_SIZE);
+        //room is made before a key goes in, so even a LIFO cache mustn't evict the key just set
+        index_type set_size = 0;
+        if (cache_get(cache1, key.c_str(), &set_size) == NULL) {
+            std::cout << "A key was evicted by its own set in footprint mode.\n";
+            return -1;
+        }
+    }
+
+    Memory_report report = cache_memory_report(cache1);
+    uint64_t sum = report.value_bytes + report.value_overhead + report.key_bytes + report.key_overhead + report.table_bytes + report.page_bytes + report.evictor_bytes + report.buffer_bytes + report.prefix_index_bytes + report.load_bytes + report.trace_bytes + report.mrc_bytes + report.adaptive_bytes + report.partition_bytes + report.cache_bytes;
+    if (report.total != sum || report.total > report.capacity || cache_space_used(cache1) != report.total) {
+        std::cout << "Memory report is inconsistent or over capacity. Total: " << report.total << "; sum of parts: " << sum << "; capacity: " << report.capacity << "; space used: " << cache_space_used(cache1) << ".\n";
+        return -1;
+    }
+    if (report.value_bytes >= KEY_TOTAL * SMALLVAL_SIZE || report.key_bytes == 0 || report.value_overhead == 0) {
+        std::cout << "Footprint mode did not evict for keys and metadata. Value bytes: " << report.value_bytes << "; key bytes: " << report.key_bytes << ".\n";
+        return -1;
+    }
+
+    activekey = "key999"; //The newest entry is never the one evicted
+    index_type retrieved_size = 0;
+    val_type retrieved_val = cache_get(cache1, activekey, &retrieved_size);
+    if (retrieved_val == NULL || read_val(retrieved_val) != read_val(SMALLVAL)) {
+        std::cout << "Newest entry was evicted in footprint mode.\n";
+        return -1;
+    }
+    return 0;
+}
+
+int test_snapshot(cache_type cache1) {
+    const char* path = "/tmp/cache_test_snapshot";
+    cache_set(cache1, KEY1, SMALLVAL, SMALLVAL_SIZE);
+    cache_set(cache1, KEY2, LARGEVAL, LARGEVAL_SIZE);
+    if (!cache_start_snapshot(cache1, path)) {
+        std::cout << "Snapshot could not be started.\n";
+        return -1;
+    }
+    cache_set(cache1, KEY1, LARGEVAL, LARGEVAL_SIZE); //None of these may show up in the snapshot
+    cache_delete(cache1, KEY2);
+    cache_set(cache1, UNUSEDKEY, SMALLVAL, SMALLVAL_SIZE);
+    if (!cache_finish_snapshot(cache1)) {
+        std::cout << "Snapshot could not be written.\n";
+        return -1;
+    }
+
+    cache_type loaded = cache_load_snapshot(path, NULL);
+    remove(path);
+    if (loaded == NULL) {
+        std::cout << "Snapshot could not be loaded.\n";
+        return -1;
+    }
+    index_type retrieved_size = 0;
+    val_type retrieved_val = cache_get(loaded, KEY1, &retrieved_size);
+    bool is_key1_right = retrieved_val != NULL && read_val(retrieved_val) == read_val(SMALLVAL);
+    retrieved_val = cache_get(loaded, KEY2, &retrieved_size);
+    bool is_key2_right = retrieved_val != NULL && read_val(retrieved_val) == read_val(LARGEVAL);
+    bool is_unused_right = cache_get(loaded, UNUSEDKEY, &retrieved_size) == NULL;
+    destroy_cache(loaded);
+    if (!is_key1_right || !is_key2_right || !is_unused_right) {
+        std::cout << "Snapshot did not hold the cache as it was when the snapshot started.\n";
+        return -1;
+    }
+
+    retrieved_val = cache_get(cache1, KEY1, &retrieved_size);
+    if (retrieved_val == NULL || read_val(retrieved_val) != read_val(LARGEVAL) || cache_get(cache1, KEY2, &retrieved_size) != NULL) {
+        std::cout << "Cache did not keep the changes made while the snapshot was written.\n";
+        return -1;
+    }
+    return 0;
+}
+
+int test_mutation_log(cache_type cache1) {
+    const char* path = "/tmp/cache_test_log";
+    remove(path);
+    if (!cache_open_log(cache1, path, LOG_SYNC_INTERVAL, 10)) {
+        std::cout << "Mutation log could not be opened.\n";
+        return -1;
+    }
+    cache_set(cache1, KEY1, SMALLVAL, SMALLVAL_SIZE);
+    cache_set(cache1, KEY2, LARGEVAL, LARGEVAL_SIZE);
+    cache_delete(cache1, KEY2);
+    cache_set(cache1, KEY1, LARGEVAL, LARGEVAL_SIZE);
+    cache_set(cache1, UNUSEDKEY, SMALLVAL, SMALLVAL_SIZE);
+    if (!cache_flush_log(cache1)) {
+        std::cout << "Mutation log could not be flushed.\n";
+        return -1;
+    }
+    FILE* log_file = fopen(path, "ab"); //A crash in the middle of a write leaves a torn record behind
+    fwrite("torn", 1, 4, log_file);
+    fclose(log_file);
+
+    index_type retrieved_size = 0;
+    cache_type recovered = cache_recover(NULL, path, CACHE_SIZE, LRU, NULL);
+    val_type retrieved_val = cache_get(recovered, KEY1, &retrieved_size);
+    bool is_key1_right = retrieved_val != NULL && read_val(retrieved_val) == read_val(LARGEVAL);
+    bool is_key2_right = cache_get(recovered, KEY2, &retrieved_size) == NULL;
+    if (!is_key1_right || !is_key2_right) {
+        destroy_cache(recovered);
+        remove(path);
+        std::cout << "Recovering from the mutation log did not replay it in order.\n";
+        return -1;
+    }
+
+    //Compacting must keep what's logged after it starts, and must not bring back what was deleted before
+    cache_open_log(recovered, path, LOG_SYNC_NEVER, 0);
+    cache_delete(recovered, UNUSEDKEY);
+    Log_stats stats = cache_log_stats(recovered);
+    cache_compact_log(recovered);
+    cache_set(recovered, KEY2, SMALLVAL, SMALLVAL_SIZE);
+    bool is_compacted = cache_finish_snapshot(recovered) && cache_log_stats(recovered).log_size < stats.log_size;
+    destroy_cache(recovered);
+    recovered = cache_recover(NULL, path, CACHE_SIZE, LRU, NULL);
+    retrieved_val = cache_get(recovered, KEY2, &retrieved_size);
+    bool is_tail_kept = retrieved_val != NULL && read_val(retrieved_val) == read_val(SMALLVAL);
+    bool is_delete_kept = cache_get(recovered, UNUSEDKEY, &retrieved_size) == NULL && cache_get(recovered, KEY1, &retrieved_size) != NULL;
+    destroy_cache(recovered);
+    remove(path);
+    if (!is_compacted || !is_tail_kept || !is_delete_kept) {
+        std::cout << "Mutation log was not compacted correctly.\n";
+        return -1;
+    }
+    return 0;
+}
+
 // int test_serialize(cache_type cache1) {
 //     cache_set(cache1, KEY1, SMALLVAL, SMALLVAL_SIZE);
 
@@ -315,37 +757,1458 @@ int compositional_testing(uint32_t test_iters, uint32_t internal_iters) {
     return external_error_pile;
 }
 
-int main() {
-    int32_t error_pile = 0;
-
-    error_pile += test_create_cache_and_destroy_cache();
-
-    cache_type cache1 = create_cache(CACHE_SIZE, FIFO, NULL);
-    error_pile += test_cache_set_and_get(cache1);
-    destroy_cache(cache1);
-
-    cache1 = create_cache(CACHE_SIZE, FIFO, NULL);
-    error_pile += test_cache_delete(cache1);
-    destroy_cache(cache1);
+int check_restored(cache_type restored, int key_total) {
+    if (restored == NULL) {
+        std::cout << "Restored cache could not be loaded.\n";
+        return -1;
+    }
+    char key[32];
+    char val[32];
+    index_type retrieved_size = 0;
+    for (int i = 0; i < key_total; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        snprintf(val, sizeof(val), "value%d", i);
+        val_type retrieved_val = cache_get(restored, key, &retrieved_size);
+        if (retrieved_val == NULL || retrieved_size != strlen(val) + 1 || strcmp(static_cast<const char*>(retrieved_val), val) != 0) {
+            std::cout << "Restored cache lost or mangled " << key << ".\n";
+            destroy_cache(restored);
+            return -1;
+        }
+    }
+    destroy_cache(restored);
+    return 0;
+}
+int test_parallel_restore(cache_type cache1) {
+    //enough entries that the table is split between several threads
+    const char* path = "/tmp/cache_test_restore";
+    const int KEY_TOTAL = 40000;
+    char key[32];
+    char val[32];
+    for (int i = 0; i < KEY_TOTAL; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        snprintf(val, sizeof(val), "value%d", i);
+        cache_set(cache1, key, val, strlen(val) + 1);
+    }
+    if (!cache_start_snapshot(cache1, path) || !cache_finish_snapshot(cache1)) {
+        std::cout << "Snapshot could not be written.\n";
+        return -1;
+    }
+    const uint32_t thread_totals[] = {1, 3, 8, 0};
+    for (uint32_t thread_total : thread_totals) {
+        if (check_restored(cache_load_snapshot_with_threads(path, NULL, thread_total), KEY_TOTAL) != 0) {
+            remove(path);
+            return -1;
+        }
+    }
+    Mem_array serialized = serialize_cache(cache1);
+    int result = check_restored(deserialize_cache_with_threads(serialized, NULL, 4), KEY_TOTAL);
+    delete[] static_cast<char*>(serialized.data);
+    if (result != 0) {
+        remove(path);
+        return -1;
+    }
 
-    cache1 = create_cache(CACHE_SIZE, FIFO, NULL);
-    error_pile += test_cache_space_used(cache1);
-    destroy_cache(cache1);
+    //a snapshot whose header doesn't match this build must be refused: the magic, the format version, the width of
+    //index_type and the size of the cache are at these offsets
+    const long header_offsets[] = {0, 8, 12, 16};
+    for (long offset : header_offsets) {
+        FILE* header_file = fopen(path, "r+b");
+        uint32_t field;
+        fseek(header_file, offset, SEEK_SET);
+        fread(&field, sizeof(field), 1, header_file);
+        uint32_t wrong_field = field ^ 12;
+        fseek(header_file, offset, SEEK_SET);
+        fwrite(&wrong_field, sizeof(wrong_field), 1, header_file);
+        fclose(header_file);
+        cache_type mismatched = cache_load_snapshot_with_threads(path, NULL, 4);
+        header_file = fopen(path, "r+b");
+        fseek(header_file, offset, SEEK_SET);
+        fwrite(&field, sizeof(field), 1, header_file);
+        fclose(header_file);
+        if (mismatched != NULL) {
+            destroy_cache(mismatched);
+            std::cout << "A snapshot with a mismatched header was loaded.\n";
+            remove(path);
+            return -1;
+        }
+    }
+    if (check_restored(cache_load_snapshot_with_threads(path, NULL, 4), KEY_TOTAL) != 0) {
+        remove(path);
+        return -1;
+    }
 
-    cache1 = create_cache(CACHE_SIZE, FIFO, NULL);
-    error_pile += test_hasher(cache1);
-    destroy_cache(cache1);
+    //a snapshot cut short must fail to load rather than give back a partial cache
+    FILE* snapshot_file = fopen(path, "rb");
+    fseek(snapshot_file, 0, SEEK_END);
+    long snapshot_size = ftell(snapshot_file);
+    fclose(snapshot_file);
+    if (truncate(path, snapshot_size - 100) != 0) {
+        std::cout << "Snapshot could not be truncated.\n";
+        remove(path);
+        return -1;
+    }
+    cache_type truncated = cache_load_snapshot_with_threads(path, NULL, 4);
+    remove(path);
+    if (truncated != NULL) {
+        destroy_cache(truncated);
+        std::cout << "A truncated snapshot was loaded.\n";
+        return -1;
+    }
+    return 0;
+}
+int test_parallel_rehash(cache_type cache1) {
+    //a cache that rehashes single threaded goes through the same sets and deletes, and both must end up holding the same
+    cache_type reference = create_cache(LARGE_CACHE_SIZE / 16, LRU, &colliding_hash_func);
+    cache_set_rehash_threads(cache1, 8);
+    char key[32];
+    char val[32];
+    for (int i = 0; i < 150000; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        snprintf(val, sizeof(val), "value%d", i);
+        cache_set(cache1, key, val, strlen(val) + 1);
+        cache_set(reference, key, val, strlen(val) + 1);
+        if (i % 3 == 0) {
+            snprintf(key, sizeof(key), "key%d", i / 2);
+            cache_delete(cache1, key);
+            cache_delete(reference, key);
+        }
+    }
+    index_type retrieved_size = 0;
+    for (int i = 0; i < 150000; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        val_type expected_val = cache_get(reference, key, &retrieved_size);
+        val_type retrieved_val = cache_get(cache1, key, &retrieved_size);
+        if ((expected_val == NULL) != (retrieved_val == NULL) || (retrieved_val != NULL && read_val(retrieved_val) != read_val(expected_val))) {
+            std::cout << "Parallel rehashing lost or mangled " << key << ".\n";
+            destroy_cache(reference);
+            return -1;
+        }
+    }
+    bool is_space_right = cache_space_used(cache1) == cache_space_used(reference);
+    destroy_cache(reference);
+    if (!is_space_right) {
+        std::cout << "Parallel rehashing changed the space used.\n";
+        return -1;
+    }
+    return 0;
+}
+int test_bulk_load(cache_type cache1) {
+    //reserving room up front must keep the table from growing while it fills
+    cache_reserve(cache1, 10000);
+    uint64_t table_bytes = cache_memory_report(cache1).table_bytes;
+    char key[32];
+    for (int i = 0; i < 9999; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        cache_set(cache1, key, SMALLVAL, SMALLVAL_SIZE);
+    }
+    if (cache_memory_report(cache1).table_bytes != table_bytes) {
+        std::cout << "The table grew despite being reserved.\n";
+        return -1;
+    }
 
-    cache1 = create_cache(CACHE_SIZE, FIFO, NULL);
-    error_pile += test_evictor(cache1);
-    destroy_cache(cache1);
+    //the bulk items overwrite what's there, repeat keys among themselves, and compress some values
+    const int ITEM_TOTAL = 30000;
+    cache_set_compression(cache1, 64);
+    std::vector<std::string> keys(ITEM_TOTAL);
+    std::vector<std::string> vals(ITEM_TOTAL);
+    std::vector<Bulk_item> items(ITEM_TOTAL + 1);
+    for (int i = 0; i < ITEM_TOTAL; i++) {
+        keys[i] = "key" + std::to_string(i % 20000);
+        vals[i] = "value" + std::to_string(i) + (i % 2 == 0 ? std::string(100, 'a') : std::string());
+        items[i].key = keys[i].c_str();
+        items[i].val = vals[i].c_str();
+        items[i].val_size = vals[i].size() + 1;
+    }
+    items[ITEM_TOTAL].key = "too big";
+    items[ITEM_TOTAL].val = LARGEVAL;
+    items[ITEM_TOTAL].val_size = LARGE_CACHE_SIZE + 1;
+    if (cache_set_bulk(cache1, items.data(), ITEM_TOTAL + 1, 4) != ITEM_TOTAL) {
+        std::cout << "Bulk loading did not set every item that fit.\n";
+        return -1;
+    }
+    index_type retrieved_size = 0;
+    for (int i = 0; i < 20000; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        int last = i + 20000 < ITEM_TOTAL ? i + 20000 : i;
+        val_type retrieved_val = cache_get(cache1, key, &retrieved_size);
+        if (retrieved_val == NULL || read_val(retrieved_val) != vals[last]) {
+            std::cout << "Bulk loading lost or mangled " << key << ".\n";
+            return -1;
+        }
+    }
+    if (cache_compression_stats(cache1).compress_total != ITEM_TOTAL / 2) {
+        std::cout << "Bulk loading did not compress the values it should have.\n";
+        return -1;
+    }
+    snprintf(key, sizeof(key), "key%d", 9998);
+    if (cache_get(cache1, "too big", &retrieved_size) != NULL || cache_get(cache1, key, &retrieved_size) == NULL) {
+        std::cout << "Bulk loading set a value bigger than the cache or lost an older one.\n";
+        return -1;
+    }
 
-    cache1 = create_cache(CACHE_SIZE, LRU, NULL);
-    error_pile += test_evictor(cache1);
-    destroy_cache(cache1);
+    //a small cache only reserves a table for the items that fit in it, not for every item
+    cache_type set_cache = create_cache(CACHE_SIZE, LRU, NULL);
+    cache_type bulk_cache = create_cache(CACHE_SIZE, LRU, NULL);
+    for (int i = 0; i < ITEM_TOTAL; i++) {
+        cache_set(set_cache, items[i].key, items[i].val, items[i].val_size);
+    }
+    cache_set_bulk(bulk_cache, items.data(), ITEM_TOTAL, 4);
+    uint64_t set_table_bytes = cache_memory_report(set_cache).table_bytes;
+    uint64_t bulk_table_bytes = cache_memory_report(bulk_cache).table_bytes;
+    destroy_cache(set_cache);
+    destroy_cache(bulk_cache);
+    if (bulk_table_bytes > set_table_bytes) {
+        std::cout << "Bulk loading reserved a table for more items than fit. Bulk table: " << bulk_table_bytes << "; table of sets: " << set_table_bytes << ".\n";
+        return -1;
+    }
+    return 0;
+}
+// Helper for test_scan; counts the visits to each keyN, and deletes the ones ending in 7 if asked to
+struct Scan_state {
+    cache_type cache;
+    bool is_deleting;
+    std::vector<int> visits;
+};
+void count_visit(void* data, key_type key, val_type, index_type) {
+    Scan_state* state = static_cast<Scan_state*>(data);
+    if (strncmp(key, "key", 3) == 0) {
+        state->visits[atoi(key + 3)] += 1;
+        if (state->is_deleting && key[strlen(key) - 1] == '7') {
+            cache_delete(state->cache, key);
+        }
+    }
+}
+int test_scan(cache_type cache1) {
+    //a small cache holding exactly 2048 keys; after touching key0, key1 is the next to go unless scanning touches anything
+    const int SMALL_KEY_TOTAL = CACHE_SIZE / SMALLVAL_SIZE;
+    cache_type small_cache = create_cache(CACHE_SIZE, LRU, NULL);
+    char key[32];
+    for (int i = 0; i < SMALL_KEY_TOTAL; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        cache_set(small_cache, key, SMALLVAL, SMALLVAL_SIZE);
+    }
+    index_type retrieved_size = 0;
+    cache_get(small_cache, "key0", &retrieved_size);
+    Scan_state state;
+    state.cache = small_cache;
+    state.is_deleting = false;
+    state.visits.assign(SMALL_KEY_TOTAL, 0);
+    index_type cursor = 0;
+    do {
+        cursor = cache_scan(small_cache, cursor, 100, &count_visit, &state);
+    } while (cursor != 0);
+    cache_set(small_cache, "one more", SMALLVAL, SMALLVAL_SIZE);
+    bool is_order_kept = cache_get(small_cache, "key0", &retrieved_size) != NULL && cache_get(small_cache, "key1", &retrieved_size) == NULL;
+    destroy_cache(small_cache);
+    if (!is_order_kept) {
+        std::cout << "Scanning changed the eviction order.\n";
+        return -1;
+    }
 
-    cache1 = create_cache(CACHE_SIZE, FIFO, NULL);
-    error_pile += test_resizing(cache1);
+    //between batches the table grows several times over and a key not yet visited is deleted,
+    //while the callback deletes keys as it visits them
+    const int KEY_TOTAL = 3000;
+    for (int i = 0; i < KEY_TOTAL; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        cache_set(cache1, key, SMALLVAL, SMALLVAL_SIZE);
+    }
+    state.cache = cache1;
+    state.is_deleting = true;
+    state.visits.assign(KEY_TOTAL, 0);
+    std::string compressible(200, 'a');
+    int batch_total = 0;
+    cursor = 0;
+    do {
+        cursor = cache_scan(cache1, cursor, 50, &count_visit, &state);
+        batch_total += 1;
+        if (batch_total == 3) {
+            cache_set_compression(cache1, 64);
+            for (int i = 0; i < 10000; i++) {
+                snprintf(key, sizeof(key), "extra%d", i);
+                cache_set(cache1, key, compressible.c_str(), compressible.size() + 1);
+            }
+            cache_delete(cache1, "key1000");
+        }
+    } while (cursor != 0);
+    if (batch_total < KEY_TOTAL / 50) {
+        std::cout << "Scan visited more entries per call than it was asked for.\n";
+        return -1;
+    }
+    for (int i = 0; i < KEY_TOTAL; i++) {
+        if (state.visits[i] != (i == 1000 ? 0 : 1)) {
+            std::cout << "Scan visited key" << i << " " << state.visits[i] << " times.\n";
+            return -1;
+        }
+        snprintf(key, sizeof(key), "key%d", i);
+        bool is_present = cache_get(cache1, key, &retrieved_size) != NULL;
+        if (is_present == (i % 10 == 7 || i == 1000)) {
+            std::cout << "Scan did not let its callback delete " << key << ".\n";
+            return -1;
+        }
+    }
+    return 0;
+}
+// Helper for test_prefix_index; records the keys visited, in order
+void record_key(void* data, key_type key, val_type, index_type) {
+    static_cast<std::vector<std::string>*>(data)->push_back(key);
+}
+int test_prefix_index(cache_type cache1) {
+    //keys are made before the index is turned on, so it must pick up what is already there
+    char key[64];
+    for (int t = 0; t < 4; t++) {
+        for (int i = 0; i < 500; i++) {
+            snprintf(key, sizeof(key), "tenant%d:%s:%d", t, i % 2 == 0 ? "users" : "orders", i);
+            cache_set(cache1, key, SMALLVAL, SMALLVAL_SIZE);
+        }
+    }
+    if (!cache_set_prefix_index(cache1, true)) {
+        std::cout << "Failed to turn on the prefix index.\n";
+        return -1;
+    }
+    //more keys, enough to grow the table, go in after
+    for (int i = 500; i < 3000; i++) {
+        snprintf(key, sizeof(key), "tenant1:users:%d", i);
+        cache_set(cache1, key, SMALLVAL, SMALLVAL_SIZE);
+    }
+    std::vector<std::string> found;
+    index_type visit_total = cache_scan_prefix(cache1, "tenant1:users:", &record_key, &found);
+    if (visit_total != 2750 || found.size() != 2750) {
+        std::cout << "Prefix scan found " << visit_total << " keys instead of 2750.\n";
+        return -1;
+    }
+    for (size_t i = 1; i < found.size(); i++) {
+        if (found[i - 1] >= found[i]) {
+            std::cout << "Prefix scan visited " << found[i - 1] << " before " << found[i] << ".\n";
+            return -1;
+        }
+    }
+    found.clear();
+    if (cache_scan_prefix(cache1, "tenant2:orders:99", &record_key, &found) != 1 || found[0] != "tenant2:orders:99") {
+        std::cout << "Prefix scan didn't find exactly one key with a full key as its prefix.\n";
+        return -1;
+    }
+    if (cache_scan_prefix(cache1, "tenant9", &record_key, &found) != 0 || cache_scan_prefix(cache1, "tenant1:usersx", &record_key, &found) != 0) {
+        std::cout << "Prefix scan found keys that don't match.\n";
+        return -1;
+    }
+
+    index_type deleted_total = cache_delete_prefix(cache1, "tenant1:");
+    if (deleted_total != 3000) {
+        std::cout << "Prefix delete removed " << deleted_total << " keys instead of 3000.\n";
+        return -1;
+    }
+    index_type retrieved_size = 0;
+    if (cache_get(cache1, "tenant1:orders:1", &retrieved_size) != NULL || cache_get(cache1, "tenant1:users:2999", &retrieved_size) != NULL) {
+        std::cout << "A key survived the prefix delete.\n";
+        return -1;
+    }
+    if (cache_get(cache1, "tenant0:orders:1", &retrieved_size) == NULL || cache_get(cache1, "tenant3:users:498", &retrieved_size) == NULL) {
+        std::cout << "Prefix delete removed a key that didn't match.\n";
+        return -1;
+    }
+    if (cache_space_used(cache1) != 1500 * SMALLVAL_SIZE) {
+        std::cout << "Prefix delete left the cache's space used wrong.\n";
+        return -1;
+    }
+
+    //a cache small enough to evict keeps its index in step with what it holds
+    cache_type small_cache = create_cache(CACHE_SIZE, LRU, NULL);
+    cache_set_prefix_index(small_cache, true);
+    const int SMALL_KEY_TOTAL = CACHE_SIZE / SMALLVAL_SIZE;
+    for (int i = 0; i < 3 * SMALL_KEY_TOTAL; i++) {
+        snprintf(key, sizeof(key), "k:%d", i);
+        cache_set(small_cache, key, SMALLVAL, SMALLVAL_SIZE);
+    }
+    found.clear();
+    visit_total = cache_scan_prefix(small_cache, "k:", &record_key, &found);
+    bool is_live = true;
+    for (const std::string& found_key : found) {
+        is_live = is_live && cache_get(small_cache, found_key.c_str(), &retrieved_size) != NULL;
+    }
+    bool has_disk_tier = cache_set_disk_tier(small_cache, "/tmp", 1 << 20);
+    destroy_cache(small_cache);
+    if (visit_total != static_cast<index_type>(SMALL_KEY_TOTAL) || !is_live) {
+        std::cout << "The prefix index fell out of step with evictions.\n";
+        return -1;
+    }
+    if (has_disk_tier) {
+        std::cout << "A cache with a prefix index was given a disk tier.\n";
+        return -1;
+    }
+    return 0;
+}
+
+int test_low_watermark(cache_type cache1) {
+    //a full cache going over capacity evicts the oldest half at once, then takes half its capacity before evicting again
+    const int KEY_TOTAL = CACHE_SIZE / SMALLVAL_SIZE;
+    cache_set_low_watermark(cache1, 50);
+    char key[32];
+    for (int i = 0; i < KEY_TOTAL; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        cache_set(cache1, key, SMALLVAL, SMALLVAL_SIZE);
+    }
+    if (cache_space_used(cache1) != CACHE_SIZE) {
+        std::cout << "The cache evicted before it was over capacity.\n";
+        return -1;
+    }
+    cache_set(cache1, "over", SMALLVAL, SMALLVAL_SIZE);
+    if (cache_space_used(cache1) != CACHE_SIZE / 2) {
+        std::cout << "Going over capacity left " << cache_space_used(cache1) << " bytes instead of " << CACHE_SIZE / 2 << ".\n";
+        return -1;
+    }
+    index_type retrieved_size = 0;
+    //the new value counts too, so key0 through keyN/2 make way for it
+    snprintf(key, sizeof(key), "key%d", KEY_TOTAL / 2 + 1);
+    bool is_newest_kept = cache_get(cache1, "over", &retrieved_size) != NULL && cache_get(cache1, key, &retrieved_size) != NULL;
+    snprintf(key, sizeof(key), "key%d", KEY_TOTAL / 2);
+    if (!is_newest_kept || cache_get(cache1, key, &retrieved_size) != NULL) {
+        std::cout << "Evicting to the low watermark didn't evict the oldest entries.\n";
+        return -1;
+    }
+    for (int i = 0; i < KEY_TOTAL / 2; i++) {
+        snprintf(key, sizeof(key), "more%d", i);
+        cache_set(cache1, key, SMALLVAL, SMALLVAL_SIZE);
+    }
+    if (cache_space_used(cache1) != CACHE_SIZE) {
+        std::cout << "The cache evicted again before it was over capacity.\n";
+        return -1;
+    }
+    //back at 100 it only evicts what it must
+    cache_set_low_watermark(cache1, 100);
+    cache_set(cache1, "one more", SMALLVAL, SMALLVAL_SIZE);
+    if (cache_space_used(cache1) != CACHE_SIZE) {
+        std::cout << "The default watermark evicted more than it had to.\n";
+        return -1;
+    }
+    return 0;
+}
+
+int test_maintenance(cache_type cache1) {
+    //with pauses between bursts of sets, the maintenance thread keeps up, so the sets themselves barely evict
+    std::mutex lock;
+    if (cache_start_maintenance(cache1, NULL, 25)) {
+        std::cout << "A maintenance thread was started without a lock.\n";
+        return -1;
+    }
+    if (!cache_start_maintenance(cache1, &lock, 25) || cache_start_maintenance(cache1, &lock, 25)) {
+        std::cout << "A cache didn't get exactly one maintenance thread.\n";
+        return -1;
+    }
+    char key[32];
+    char val[100];
+    const int KEY_TOTAL = 40000;
+    for (int i = 0; i < KEY_TOTAL; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        snprintf(val, sizeof(val), "val%d", i);
+        lock.lock();
+        cache_set(cache1, key, val, sizeof(val));
+        lock.unlock();
+        if (i % 100 == 99) {
+            usleep(2000);
+        }
+    }
+    lock.lock();
+    Maintenance_stats stats = cache_maintenance_stats(cache1);
+    index_type space_used = cache_space_used(cache1);
+    bool is_intact = true;
+    int found_total = 0;
+    for (int i = 0; i < KEY_TOTAL; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        snprintf(val, sizeof(val), "val%d", i);
+        index_type retrieved_size = 0;
+        val_type retrieved = cache_get(cache1, key, &retrieved_size);
+        if (retrieved != NULL) {
+            found_total += 1;
+            is_intact = is_intact && retrieved_size == sizeof(val) && strcmp(static_cast<const char*>(retrieved), val) == 0;
+        }
+    }
+    lock.unlock();
+    if (!is_intact || found_total == 0 || space_used > LARGE_CACHE_SIZE / 4) {
+        std::cout << "The cache was left broken or over capacity by its maintenance thread.\n";
+        return -1;
+    }
+    if (stats.background_evict_total == 0 || stats.background_grow_total == 0 || stats.deferred_free_total == 0) {
+        std::cout << "The maintenance thread didn't evict, grow or free anything.\n";
+        return -1;
+    }
+    if (stats.inline_evict_total > stats.background_evict_total / 10) {
+        std::cout << "Sets did " << stats.inline_evict_total << " evictions themselves to the maintenance thread's " << stats.background_evict_total << ".\n";
+        return -1;
+    }
+    //stopping leaves the cache to its callers, and destroy_cache stops a thread still running
+    cache_stop_maintenance(cache1);
+    cache_set(cache1, "after", val, sizeof(val));
+    cache_type other_cache = create_cache(CACHE_SIZE, LRU, NULL);
+    std::mutex other_lock;
+    cache_start_maintenance(other_cache, &other_lock, 50);
+    destroy_cache(other_cache);
+    return 0;
+}
+
+int test_linear_index(cache_type cache1) {
+    //keys alike in size and in their first and last 8 bytes share a tag, so only their full keys tell them apart
+    std::vector<std::string> keys = {"a", "b", "", "ab", "abcdefgh", "abcdefgi", "tenant:0001:table:users", "tenant:0001:tabla:users"};
+    for (int i = 0; i < 150; i++) {
+        keys.push_back("tenant:0001:" + std::to_string(i) + ":users");
+    }
+    //the set of keys in the cache goes up past the threshold, down below half of it, and up again, checking every key each step
+    std::vector<int> steps = {10, 20, 33, 90, 40, 16, 5, 0, 31, 150, 3};
+    int present_total = 0;
+    for (int step : steps) {
+        while (present_total < step) {
+            std::string val = "val" + keys[present_total];
+            cache_set(cache1, keys[present_total].c_str(), val.c_str(), val.size() + 1);
+            present_total++;
+        }
+        while (present_total > step) {
+            present_total--;
+            cache_delete(cache1, keys[present_total].c_str());
+        }
+        for (size_t i = 0; i < keys.size(); i++) {
+            index_type retrieved_size = 0;
+            val_type retrieved = cache_get(cache1, keys[i].c_str(), &retrieved_size);
+            bool is_present = static_cast<int>(i) < present_total;
+            if ((retrieved != NULL) != is_present || (is_present && "val" + keys[i] != static_cast<const char*>(retrieved))) {
+                std::cout << "With " << present_total << " entries, the cache got " << keys[i] << " wrong.\n";
+                return -1;
+            }
+        }
+    }
+    //overwriting a key leaves the key sharing its tag alone
+    cache_set(cache1, "abcdefgh", "old", 4);
+    cache_set(cache1, "abcdefgi", "other", 6);
+    cache_set(cache1, "abcdefgh", "new", 4);
+    index_type retrieved_size = 0;
+    val_type retrieved = cache_get(cache1, "abcdefgh", &retrieved_size);
+    val_type other = cache_get(cache1, "abcdefgi", &retrieved_size);
+    if (retrieved == NULL || strcmp(static_cast<const char*>(retrieved), "new") != 0 || other == NULL || strcmp(static_cast<const char*>(other), "other") != 0 || cache_space_used(cache1) != 5 + 5 + 4 + 4 + 6) {
+        std::cout << "Overwriting a key in a small cache went wrong.\n";
+        return -1;
+    }
+    //every threshold, including none, finds the same keys, even with a hash that puts every key in one probe sequence
+    cache_type colliding_cache = create_cache(CACHE_SIZE, LRU, &bad_hash_func);
+    for (index_type threshold : {0, 1, 8, 256}) {
+        cache_set_linear_threshold(colliding_cache, threshold);
+        for (int i = 0; i < 20; i++) {
+            cache_set(colliding_cache, keys[i].c_str(), SMALLVAL, SMALLVAL_SIZE);
+        }
+        for (int i = 0; i < 40; i++) {
+            if ((cache_get(colliding_cache, keys[i].c_str(), &retrieved_size) != NULL) != (i < 20)) {
+                std::cout << "With a linear threshold of " << threshold << ", the cache got " << keys[i] << " wrong.\n";
+                destroy_cache(colliding_cache);
+                return -1;
+            }
+        }
+    }
+    destroy_cache(colliding_cache);
+    //with scanning off, emptying the cache doesn't build a linear index either
+    cache_type unscanned_cache = create_cache(CACHE_SIZE, LRU, NULL);
+    cache_set_linear_threshold(unscanned_cache, 0);
+    uint64_t empty_cache_bytes = cache_memory_report(unscanned_cache).cache_bytes;
+    for (int i = 0; i < 20; i++) {
+        cache_set(unscanned_cache, keys[i].c_str(), SMALLVAL, SMALLVAL_SIZE);
+    }
+    for (int i = 0; i < 20; i++) {
+        cache_delete(unscanned_cache, keys[i].c_str());
+    }
+    uint64_t emptied_cache_bytes = cache_memory_report(unscanned_cache).cache_bytes;
+    destroy_cache(unscanned_cache);
+    if (emptied_cache_bytes != empty_cache_bytes) {
+        std::cout << "Emptying a cache with a linear threshold of 0 built a linear index.\n";
+        return -1;
+    }
+    return 0;
+}
+
+// Helpers for test_get_or_load; the loader counts its calls and makes "key=version" values
+struct Load_state {
+    std::atomic<int> load_total;
+    std::atomic<int> version;
+    int sleep_ms;
+    bool is_failing;
+};
+void* load_version(void* data, key_type key, index_type* val_size) {
+    Load_state* state = static_cast<Load_state*>(data);
+    state->load_total++;
+    usleep(state->sleep_ms * 1000);
+    if (state->is_failing) {
+        return NULL;
+    }
+    char* val = static_cast<char*>(malloc(64));
+    *val_size = snprintf(val, 64, "%s=%d", key, state->version.load()) + 1;
+    return val;
+}
+// Starts thread_total threads at once, each calling cache_get_or_load on its key, and collects what they got
+std::vector<std::string> load_at_once(cache_type cache, std::mutex* lock, Load_state* state, const std::vector<std::string>& keys) {
+    std::vector<std::string> results(keys.size());
+    std::atomic<int> ready_total(0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < keys.size(); t++) {
+        threads.emplace_back([&, t] {
+            ready_total++;
+            while (ready_total.load() < static_cast<int>(keys.size())) {
+                std::this_thread::yield();
+            }
+            val_type val;
+            index_type val_size;
+            pin_type pin = cache_get_or_load(cache, lock, keys[t].c_str(), &load_version, state, 0, 0, &val, &val_size);
+            if (pin != NULL) {
+                results[t] = static_cast<const char*>(val);
+                cache_unpin(pin);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return results;
+}
+int test_get_or_load(cache_type cache1) {
+    std::mutex lock;
+    Load_state state;
+    state.load_total = 0;
+    state.version = 1;
+    state.sleep_ms = 50;
+    state.is_failing = false;
+    //16 threads missing on one key make one load, and all get its value
+    std::vector<std::string> results = load_at_once(cache1, &lock, &state, std::vector<std::string>(16, "hot"));
+    for (auto& result : results) {
+        if (result != "hot=1") {
+            std::cout << "A caller of cache_get_or_load got " << result << " instead of hot=1.\n";
+            return -1;
+        }
+    }
+    if (state.load_total != 1) {
+        std::cout << "16 callers missing on one key made " << state.load_total << " loads.\n";
+        return -1;
+    }
+    //32 threads over 4 keys make one load per key
+    std::vector<std::string> keys;
+    for (int t = 0; t < 32; t++) {
+        keys.push_back("warm" + std::to_string(t % 4));
+    }
+    state.load_total = 0;
+    results = load_at_once(cache1, &lock, &state, keys);
+    for (int t = 0; t < 32; t++) {
+        if (results[t] != keys[t] + "=1") {
+            std::cout << "A caller of cache_get_or_load got " << results[t] << " for " << keys[t] << ".\n";
+            return -1;
+        }
+    }
+    if (state.load_total != 4) {
+        std::cout << "32 callers missing on 4 keys made " << state.load_total << " loads.\n";
+        return -1;
+    }
+    //a failed load is handed to everyone waiting on it, and nothing is cached
+    state.load_total = 0;
+    state.is_failing = true;
+    results = load_at_once(cache1, &lock, &state, std::vector<std::string>(8, "broken"));
+    state.is_failing = false;
+    index_type retrieved_size = 0;
+    for (auto& result : results) {
+        if (result != "") {
+            std::cout << "A caller of cache_get_or_load got a value from a failed load.\n";
+            return -1;
+        }
+    }
+    if (state.load_total != 1 || cache_get(cache1, "broken", &retrieved_size) != NULL) {
+        std::cout << "A failed load was repeated or cached.\n";
+        return -1;
+    }
+
+    //a stale entry is handed out while the first caller to find it stale loads it again
+    val_type val;
+    index_type val_size;
+    state.load_total = 0;
+    cache_unpin(cache_get_or_load(cache1, &lock, "ttl", &load_version, &state, 50, 5000, &val, &val_size));
+    cache_unpin(cache_get_or_load(cache1, &lock, "ttl", &load_version, &state, 50, 5000, &val, &val_size));
+    if (state.load_total != 1) {
+        std::cout << "A fresh entry was loaded again.\n";
+        return -1;
+    }
+    usleep(80 * 1000);
+    state.version = 2;
+    state.sleep_ms = 200;
+    std::string refreshed;
+    std::thread refresher([&] {
+        val_type refreshed_val;
+        index_type refreshed_size;
+        pin_type pin = cache_get_or_load(cache1, &lock, "ttl", &load_version, &state, 50, 5000, &refreshed_val, &refreshed_size);
+        refreshed = static_cast<const char*>(refreshed_val);
+        cache_unpin(pin);
+    });
+    while (state.load_total < 2) {
+        std::this_thread::yield();
+    }
+    pin_type pin = cache_get_or_load(cache1, &lock, "ttl", &load_version, &state, 50, 5000, &val, &val_size);
+    std::string stale = static_cast<const char*>(val);
+    cache_unpin(pin);
+    bool is_refresh_running = state.load_total == 2 && refreshed == "";
+    refresher.join();
+    if (stale != "ttl=1" || !is_refresh_running || refreshed != "ttl=2") {
+        std::cout << "A stale entry wasn't handed out while it was refreshed.\n";
+        return -1;
+    }
+    //past its stale time an entry is a miss
+    state.sleep_ms = 0;
+    state.version = 3;
+    cache_unpin(cache_get_or_load(cache1, &lock, "gone", &load_version, &state, 20, 20, &val, &val_size));
+    usleep(60 * 1000);
+    pin = cache_get_or_load(cache1, &lock, "gone", &load_version, &state, 20, 20, &val, &val_size);
+    std::string reloaded = static_cast<const char*>(val);
+    cache_unpin(pin);
+    if (state.load_total != 4 || reloaded != "gone=3") {
+        std::cout << "An entry past its stale time wasn't loaded again.\n";
+        return -1;
+    }
+    //setting a key by hand makes it never expire
+    cache_unpin(cache_get_or_load(cache1, &lock, "manual", &load_version, &state, 20, 0, &val, &val_size));
+    cache_set(cache1, "manual", "by hand", 8);
+    usleep(40 * 1000);
+    pin = cache_get_or_load(cache1, &lock, "manual", &load_version, &state, 20, 0, &val, &val_size);
+    std::string kept = static_cast<const char*>(val);
+    cache_unpin(pin);
+    if (state.load_total != 5 || kept != "by hand") {
+        std::cout << "An entry set by hand still expired.\n";
+        return -1;
+    }
+    return 0;
+}
+
+int test_trace(cache_type cache1) {
+    const char* path = "/tmp/cache_test_trace";
+    if (!cache_start_trace(cache1, path, 16)) {
+        std::cout << "Trace could not be started.\n";
+        return -1;
+    }
+    if (cache_start_trace(cache1, path, 16)) {
+        std::cout << "A cache was traced twice at once.\n";
+        return -1;
+    }
+    //More operations than the ring holds, so the writer has to keep emptying it
+    index_type retrieved_size = 0;
+    char buffer[256];
+    cache_set(cache1, KEY1, LARGEVAL, LARGEVAL_SIZE);
+    cache_get(cache1, KEY1, &retrieved_size);
+    cache_get(cache1, KEY2, &retrieved_size);
+    cache_get_into(cache1, KEY1, buffer, sizeof(buffer), &retrieved_size);
+    val_type pinned_val;
+    pin_type pin = cache_pin(cache1, KEY1, &pinned_val, &retrieved_size);
+    if (pin != NULL) {
+        cache_unpin(pin);
+    }
+    for (int i = 0; i < 100; i++) {
+        usleep(i % 10 == 0 ? 2000 : 0);
+        cache_set(cache1, KEY2, SMALLVAL, SMALLVAL_SIZE);
+    }
+    cache_delete(cache1, KEY1);
+    Memory_report report = cache_memory_report(cache1);
+    bool is_stopped = cache_stop_trace(cache1);
+    Trace_stats stats = cache_trace_stats(cache1);
+
+    std::vector<Trace_record> records;
+    bool is_read = read_trace(path, &records);
+    remove(path);
+    if (!is_stopped || !is_read || report.trace_bytes == 0 || cache_memory_report(cache1).trace_bytes != 0) {
+        std::cout << "Trace could not be written or read back.\n";
+        return -1;
+    }
+    if (stats.record_total + stats.dropped_total != 106 || records.size() != stats.record_total) {
+        std::cout << "Trace lost track of its records. Recorded: " << stats.record_total << "; dropped: " << stats.dropped_total << "; read back: " << records.size() << ".\n";
+        return -1;
+    }
+    //Dropped records are the latest ones, so the first few are always there
+    bool is_first_right = records.size() >= 5 && records[0].op == TRACE_SET && records[0].value_size == LARGEVAL_SIZE && records[0].key_size == strlen(KEY1);
+    bool are_gets_right = is_first_right && records[1].op == TRACE_GET && records[1].is_hit && records[1].value_size == LARGEVAL_SIZE && records[2].op == TRACE_GET && !records[2].is_hit && records[2].key_hash != records[1].key_hash && records[3].key_hash == records[1].key_hash && records[4].op == TRACE_GET;
+    bool is_last_right = stats.dropped_total > 0 || (records.back().op == TRACE_DELETE && records.back().key_hash == records[0].key_hash);
+    if (!is_first_right || !are_gets_right || !is_last_right) {
+        std::cout << "Trace records do not match the operations made.\n";
+        return -1;
+    }
+    return 0;
+}
+
+int test_mrc(cache_type cache1) {
+    //20000 keys of 10 bytes read in a loop: an LRU cache of 200000 bytes hits every pass after the first, and a
+    //smaller one never hits, since each key is evicted just before it comes around again
+    cache_set_mrc(cache1, 4096);
+    char key[16];
+    char value[10] = "mrc value";
+    index_type retrieved_size = 0;
+    for (int pass = 0; pass < 10; pass++) {
+        for (int i = 0; i < 20000; i++) {
+            snprintf(key, sizeof(key), "mrc:%d", i);
+            if (cache_get(cache1, key, &retrieved_size) == NULL) {
+                cache_set(cache1, key, value, sizeof(value));
+            }
+        }
+    }
+    uint64_t capacities[] = {100000, 400000};
+    double hit_ratios[2];
+    cache_estimate_hit_ratios(cache1, capacities, hit_ratios, 2);
+    Mrc_stats stats = cache_mrc_stats(cache1);
+    if (stats.sampled_get_total == 0 || cache_memory_report(cache1).mrc_bytes == 0) {
+        std::cout << "Hit ratio estimator sampled nothing.\n";
+        return -1;
+    }
+    if (hit_ratios[0] > 0.05 || hit_ratios[1] < 0.85 || hit_ratios[1] > 0.95) {
+        std::cout << "Hit ratio estimates are off. At 100000 bytes: " << hit_ratios[0] << "; expected 0. At 400000 bytes: " << hit_ratios[1] << "; expected 0.9.\n";
+        return -1;
+    }
+
+    //Sampling fewer keys than there are must lower the rate rather than use more memory
+    cache_set_mrc(cache1, 64);
+    for (int i = 0; i < 20000; i++) {
+        snprintf(key, sizeof(key), "mrc:%d", i);
+        cache_set(cache1, key, value, sizeof(value));
+    }
+    stats = cache_mrc_stats(cache1);
+    if (stats.sampled_key_total > 64 || stats.sample_rate >= 1.0 / 64) {
+        std::cout << "Hit ratio estimator kept too many keys. Keys: " << stats.sampled_key_total << "; rate: " << stats.sample_rate << ".\n";
+        return -1;
+    }
+    cache_set_mrc(cache1, 0);
+    if (cache_mrc_stats(cache1).sampled_key_total != 0 || cache_memory_report(cache1).mrc_bytes != 0) {
+        std::cout << "Hit ratio estimator could not be turned off.\n";
+        return -1;
+    }
+    return 0;
+}
+
+int test_adaptive(cache_type cache1) {
+    //A loop over more keys than fit is what LRU does worst at, never hitting, while MRU and LIFO keep most of a
+    //cacheful for good; a few keys read over and over is the opposite, since they never let a new key in
+    evictor_type policies[] = {FIFO, LIFO, LRU, MRU, CLOCK, SLRU, RR};
+    if (cache_set_adaptive(cache1, policies, 6, 1, 1000) != true) {
+        std::cout << "Adaptive eviction could not be turned on.\n";
+        return -1;
+    }
+    char key[16];
+    char value[10] = "adaptive";
+    index_type retrieved_size = 0;
+    for (int pass = 0; pass < 10; pass++) {
+        for (int i = 0; i < 1000; i++) {
+            snprintf(key, sizeof(key), "loop:%d", i);
+            if (cache_get(cache1, key, &retrieved_size) == NULL) {
+                cache_set(cache1, key, value, sizeof(value));
+            }
+        }
+    }
+    Adaptive_stats stats = cache_adaptive_stats(cache1);
+    if (stats.switch_total == 0 || (stats.policy != MRU && stats.policy != LIFO) || stats.hit_ratios[MRU] <= stats.hit_ratios[LRU]) {
+        std::cout << "Adaptive eviction did not switch away from LRU for a loop. Policy: " << stats.policy << "; switches: " << stats.switch_total << ".\n";
+        return -1;
+    }
+
+    int hit_total = 0;
+    for (int pass = 0; pass < 200; pass++) {
+        for (int i = 0; i < 100; i++) {
+            snprintf(key, sizeof(key), "hot:%d", i);
+            if (cache_get(cache1, key, &retrieved_size) == NULL) {
+                cache_set(cache1, key, value, sizeof(value));
+            } else if (pass >= 150) {
+                hit_total += 1;
+            }
+        }
+    }
+    stats = cache_adaptive_stats(cache1);
+    if (stats.policy == MRU || stats.policy == LIFO || hit_total < 5000) {
+        std::cout << "Adaptive eviction did not switch back for a few hot keys. Policy: " << stats.policy << "; hits: " << hit_total << "; expected 5000.\n";
+        return -1;
+    }
+    if (cache_memory_report(cache1).adaptive_bytes == 0) {
+        std::cout << "Adaptive eviction's simulations are missing from the memory report.\n";
+        return -1;
+    }
+
+    //Every switch must have left the entries where the evictor can still find them
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "loop:%d", i);
+        cache_delete(cache1, key);
+    }
+    for (int i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "hot:%d", i);
+        cache_delete(cache1, key);
+    }
+    if (cache_space_used(cache1) != 0) {
+        std::cout << "Entries were lost switching policies. Space used: " << cache_space_used(cache1) << "; expected 0.\n";
+        return -1;
+    }
+    cache_set_adaptive(cache1, policies, 0, 0, 0);
+    if (cache_memory_report(cache1).adaptive_bytes != 0 || cache_set_adaptive(cache1, policies, 7, 0, 0) != false) {
+        std::cout << "Adaptive eviction could not be turned off, or took RR.\n";
+        return -1;
+    }
+    return 0;
+}
+
+int test_partitions(cache_type cache1) {
+    //A first partition that's refused must leave the cache without any
+    if (cache_add_partition(cache1, "a:", 8192, LRU) != 0 || cache_memory_report(cache1).partition_bytes != 0) {
+        std::cout << "A refused partition left the cache partitioned.\n";
+        return -1;
+    }
+    //Two tenants get a quarter of the cache each, and the keys of neither share the rest
+    if (cache_add_partition(cache1, "a:", 1024, LRU) != 1 || cache_add_partition(cache1, "b:", 1024, FIFO) != 2) {
+        std::cout << "Partitions could not be added.\n";
+        return -1;
+    }
+    if (cache_add_partition(cache1, "a:", 16, LRU) != 0 || cache_add_partition(cache1, "d:", 4096, LRU) != 0 || cache_add_partition(cache1, "d:", 16, RR) != 0) {
+        std::cout << "A duplicate prefix, too big a quota or RR was allowed.\n";
+        return -1;
+    }
+    char key[16];
+    char value[10] = "partition";
+    index_type retrieved_size = 0;
+    for (int i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "b:%d", i);
+        cache_set(cache1, key, value, sizeof(value));
+    }
+    //A noisy tenant, and then the keys in no partition, may only evict their own
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "a:%d", i);
+        cache_set(cache1, key, value, sizeof(value));
+    }
+    for (int i = 0; i < 500; i++) {
+        snprintf(key, sizeof(key), "c:%d", i);
+        cache_set(cache1, key, value, sizeof(value));
+    }
+    for (int i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "b:%d", i);
+        if (cache_get(cache1, key, &retrieved_size) == NULL) {
+            std::cout << "Another partition evicted a key of one under its quota.\n";
+            return -1;
+        }
+    }
+    Partition_stats a_stats = cache_partition_stats(cache1, 1);
+    Partition_stats b_stats = cache_partition_stats(cache1, 2);
+    Partition_stats rest_stats = cache_partition_stats(cache1, 0);
+    if (a_stats.mem_total > 1024 || a_stats.evict_total == 0 || b_stats.evict_total != 0 || b_stats.hit_total != 100 || rest_stats.evict_total == 0 || rest_stats.quota != 2048) {
+        std::cout << "Partition stats are wrong. Space used by a: " << a_stats.mem_total << "; evictions from a: " << a_stats.evict_total << ", from b: " << b_stats.evict_total << ", from the rest: " << rest_stats.evict_total << ".\n";
+        return -1;
+    }
+
+    //Keys already in the cache move into a new partition that claims them
+    uint64_t rest_total = cache_partition_stats(cache1, 0).entry_total;
+    if (cache_add_partition(cache1, "c:4", 2048, SLRU) != 3) {
+        std::cout << "A partition could not be added to a full cache.\n";
+        return -1;
+    }
+    uint64_t moved_total = cache_partition_stats(cache1, 3).entry_total;
+    if (moved_total == 0 || moved_total != rest_total - cache_partition_stats(cache1, 0).entry_total || cache_get(cache1, "c:499", &retrieved_size) == NULL) {
+        std::cout << "Keys were not moved into a new partition. Moved: " << moved_total << ".\n";
+        return -1;
+    }
+    uint64_t mem_total = 0;
+    for (uint32_t partition = 0; partition < 4; partition++) {
+        mem_total += cache_partition_stats(cache1, partition).mem_total;
+    }
+    if (mem_total != cache_space_used(cache1) || cache_memory_report(cache1).partition_bytes == 0) {
+        std::cout << "Partitions do not add up to the cache. Their total: " << mem_total << "; the cache's: " << cache_space_used(cache1) << ".\n";
+        return -1;
+    }
+
+    //Bulk loading turns away a value over its partition's quota, as cache_set does
+    std::string big_value(2000, 'x');
+    Bulk_item bulk_items[2] = {{"a:big", big_value.c_str(), 2000}, {"c:bulk", value, sizeof(value)}};
+    if (cache_set_bulk(cache1, bulk_items, 2, 1) != 1 || cache_get(cache1, "a:big", &retrieved_size) != NULL || cache_get(cache1, "c:bulk", &retrieved_size) == NULL) {
+        std::cout << "Bulk loading set a value over its partition's quota.\n";
+        return -1;
+    }
+
+    //A loaded snapshot holds every entry, back under the cache's own evictor
+    const char* path = "/tmp/cache_test_partitions";
+    if (!cache_start_snapshot(cache1, path) || !cache_finish_snapshot(cache1)) {
+        std::cout << "Snapshot of partitions could not be written.\n";
+        return -1;
+    }
+    cache_type loaded = cache_load_snapshot(path, NULL);
+    remove(path);
+    if (loaded == NULL || cache_space_used(loaded) != cache_space_used(cache1) || cache_get(loaded, "b:0", &retrieved_size) == NULL) {
+        std::cout << "Snapshot of partitions could not be loaded.\n";
+        return -1;
+    }
+    for (int i = 0; i < 2000; i++) {
+        snprintf(key, sizeof(key), "e:%d", i);
+        cache_set(loaded, key, value, sizeof(value));
+    }
+    bool is_evicting = cache_get(loaded, "b:0", &retrieved_size) == NULL && cache_space_used(loaded) <= 4096;
+    destroy_cache(loaded);
+    if (!is_evicting) {
+        std::cout << "A loaded cache does not evict what was in partitions.\n";
+        return -1;
+    }
+    return 0;
+}
+
+int test_mutation(cache_type cache1) {
+    index_type retrieved_size = 0;
+    int64_t result = 0;
+    cache_set(cache1, "counter", "41", 2);
+    if (!cache_incr(cache1, "counter", 1, &result) || result != 42 || !cache_decr(cache1, "counter", 50, &result) || result != -8) {
+        std::cout << "Counter was not incremented and decremented. Result: " << result << ".\n";
+        return -1;
+    }
+    val_type retrieved_val = cache_get(cache1, "counter", &retrieved_size);
+    if (retrieved_val == NULL || std::string(static_cast<const char*>(retrieved_val), retrieved_size) != "-8") {
+        std::cout << "Counter was not stored as a decimal integer.\n";
+        return -1;
+    }
+    cache_set(cache1, "max", "9223372036854775807", 19);
+    cache_set(cache1, "text", "abc", 3);
+    if (cache_incr(cache1, "max", 1, &result) || cache_incr(cache1, "text", 1, &result) || cache_incr(cache1, UNUSEDKEY, 1, &result) || cache_append(cache1, UNUSEDKEY, "a", 1)) {
+        std::cout << "Overflow, a non-integer or a missing key was mutated.\n";
+        return -1;
+    }
+
+    cache_set(cache1, "list", "ab", 2);
+    if (!cache_append(cache1, "list", "cd", 2) || !cache_prepend(cache1, "list", "xy", 2) || !cache_write_range(cache1, "list", 2, "ZZ", 2) || !cache_write_range(cache1, "list", 8, "!", 1)) {
+        std::cout << "List could not be mutated.\n";
+        return -1;
+    }
+    retrieved_val = cache_get(cache1, "list", &retrieved_size);
+    if (retrieved_val == NULL || std::string(static_cast<const char*>(retrieved_val), retrieved_size) != std::string("xyZZcd\0\0!", 9)) {
+        std::cout << "List was mutated wrongly.\n";
+        return -1;
+    }
+
+    //A value that keeps growing is only copied every so often, and never while it's pinned
+    Mutation_stats before = cache_mutation_stats(cache1);
+    for (int i = 0; i < 100; i++) {
+        cache_append(cache1, "list", "-", 1);
+    }
+    Mutation_stats after = cache_mutation_stats(cache1);
+    if (after.in_place_total - before.in_place_total < 80 || after.copy_total - before.copy_total > 20) {
+        std::cout << "Appends were not made in place. In place: " << after.in_place_total - before.in_place_total << "; copied: " << after.copy_total - before.copy_total << ".\n";
+        return -1;
+    }
+    val_type pinned_val;
+    index_type pinned_size;
+    pin_type pin = cache_pin(cache1, "list", &pinned_val, &pinned_size);
+    std::string pinned(static_cast<const char*>(pinned_val), pinned_size);
+    cache_write_range(cache1, "list", 0, "PP", 2);
+    bool is_intact = std::string(static_cast<const char*>(pinned_val), pinned_size) == pinned;
+    cache_unpin(pin);
+    retrieved_val = cache_get(cache1, "list", &retrieved_size);
+    if (!is_intact || retrieved_size != 109 || memcmp(retrieved_val, "PPZZ", 4) != 0) {
+        std::cout << "Mutating a pinned value changed what the pin reads.\n";
+        return -1;
+    }
+
+    //A compressed value is compressed again, and no value may grow past max_mem
+    cache_set_compression(cache1, 64);
+    char* zeros = new char[CACHE_SIZE]();
+    cache_set(cache1, "zip", zeros, 512);
+    bool is_appended = cache_append(cache1, "zip", "end", 3);
+    Compression_stats compression = cache_compression_stats(cache1);
+    bool is_too_big = cache_append(cache1, "zip", zeros, CACHE_SIZE);
+    delete[] zeros;
+    retrieved_val = cache_get(cache1, "zip", &retrieved_size);
+    if (!is_appended || is_too_big || retrieved_val == NULL || retrieved_size != 515 || memcmp(static_cast<const char*>(retrieved_val) + 512, "end", 3) != 0 || compression.stored_bytes >= compression.raw_bytes) {
+        std::cout << "Compressed value was mutated wrongly, or grew past max_mem.\n";
+        return -1;
+    }
+
+    uint64_t mem_total = 0;
+    const key_type keys[] = {"counter", "max", "text", "list", "zip"};
+    for (key_type key : keys) {
+        cache_get(cache1, key, &retrieved_size);
+        mem_total += retrieved_size;
+    }
+    if (cache_space_used(cache1) != compression.stored_bytes || compression.raw_bytes != mem_total) {
+        std::cout << "Space used does not match the mutated values. Space used: " << cache_space_used(cache1) << "; sum of values: " << mem_total << ".\n";
+        return -1;
+    }
+    return 0;
+}
+
+// Helper function for test_set_reserve; counts the values the cache has freed
+void count_and_free(void* data, void* val) {
+    *static_cast<int*>(data) += 1;
+    delete[] static_cast<char*>(val);
+}
+
+int test_set_reserve(cache_type cache1) {
+    index_type retrieved_size = 0;
+    void* buffer = NULL;
+    reservation_type reservation = cache_set_reserve(cache1, KEY1, LARGEVAL_SIZE, &buffer);
+    if (reservation == NULL || buffer == NULL) {
+        std::cout << "Room for a value could not be reserved.\n";
+        return -1;
+    }
+    memcpy(buffer, LARGEVAL, LARGEVAL_SIZE);
+    if (cache_get(cache1, KEY1, &retrieved_size) != NULL || cache_space_used(cache1) != 0) {
+        std::cout << "A reserved value was set before it was committed.\n";
+        cache_set_abort(reservation);
+        return -1;
+    }
+    val_type retrieved_val;
+    if (!cache_set_commit(cache1, reservation) || (retrieved_val = cache_get(cache1, KEY1, &retrieved_size)) == NULL || read_val(retrieved_val) != read_val(LARGEVAL)) {
+        std::cout << "A committed value could not be retrieved.\n";
+        return -1;
+    }
+    reservation = cache_set_reserve(cache1, KEY2, SMALLVAL_SIZE, &buffer);
+    cache_set_abort(reservation);
+    if (cache_get(cache1, KEY2, &retrieved_size) != NULL || cache_set_reserve(cache1, KEY2, CACHE_SIZE + 1, &buffer) != NULL) {
+        std::cout << "An aborted value was set, or a value over max_mem was reserved.\n";
+        return -1;
+    }
+
+    //A value handed over is kept as it is, and freed once neither the cache nor a pin needs it
+    int free_total = 0;
+    char* owned = new char[LARGEVAL_SIZE];
+    memcpy(owned, LARGEVAL, LARGEVAL_SIZE);
+    cache_set_owned(cache1, KEY2, owned, LARGEVAL_SIZE, &count_and_free, &free_total);
+    if (cache_get(cache1, KEY2, &retrieved_size) != owned || free_total != 0) {
+        std::cout << "A value handed over was copied or freed.\n";
+        return -1;
+    }
+    val_type pinned_val;
+    index_type pinned_size;
+    pin_type pin = cache_pin(cache1, KEY2, &pinned_val, &pinned_size);
+    cache_delete(cache1, KEY2);
+    int pinned_free_total = free_total;
+    cache_unpin(pin);
+    if (pinned_free_total != 0 || free_total != 1) {
+        std::cout << "A value handed over was not freed once, after its pin. Freed while pinned: " << pinned_free_total << "; after: " << free_total << ".\n";
+        return -1;
+    }
+    cache_set_owned(cache1, KEY2, new char[CACHE_SIZE + 1], CACHE_SIZE + 1, &count_and_free, &free_total);
+    cache_set_compression(cache1, 64);
+    cache_set_owned(cache1, KEY2, new char[1024](), 1024, &count_and_free, &free_total);
+    retrieved_val = cache_get(cache1, KEY2, &retrieved_size);
+    if (free_total != 3 || retrieved_val == NULL || retrieved_size != 1024 || cache_space_used(cache1) >= LARGEVAL_SIZE + 1024) {
+        std::cout << "A value handed over was not freed when too big or compressed. Freed: " << free_total << ".\n";
+        return -1;
+    }
+    return 0;
+}
+
+int test_front(cache_type cache1) {
+    front_type front = cache_create_front(cache1, NULL, 16);
+    val_type val;
+    index_type val_size;
+    cache_set(cache1, KEY1, SMALLVAL, SMALLVAL_SIZE);
+    //A key only takes a slot the second time in a row it misses there
+    cache_unpin(cache_front_pin(front, KEY1, &val, &val_size));
+    cache_unpin(cache_front_pin(front, KEY1, &val, &val_size));
+    pin_type pin = cache_front_pin(front, KEY1, &val, &val_size);
+    if (pin == NULL || read_val(val) != read_val(SMALLVAL) || cache_front_stats(front).hit_total != 1) {
+        std::cout << "A key in the front was not hit.\n";
+        cache_destroy_front(front);
+        return -1;
+    }
+    cache_unpin(pin);
+    //Setting, changing and deleting the key each leave the front stale
+    cache_set(cache1, KEY1, LARGEVAL, LARGEVAL_SIZE);
+    pin = cache_front_pin(front, KEY1, &val, &val_size);
+    bool is_refreshed = pin != NULL && read_val(val) == read_val(LARGEVAL);
+    cache_unpin(pin);
+    cache_set(cache1, "counter", "7", 1);
+    cache_unpin(cache_front_pin(front, "counter", &val, &val_size));
+    cache_unpin(cache_front_pin(front, "counter", &val, &val_size));
+    int64_t result = 0;
+    cache_incr(cache1, "counter", 1, &result);
+    pin = cache_front_pin(front, "counter", &val, &val_size);
+    is_refreshed = is_refreshed && pin != NULL && val_size == 1 && static_cast<const char*>(val)[0] == '8';
+    cache_unpin(pin);
+    cache_delete(cache1, KEY1);
+    is_refreshed = is_refreshed && cache_front_pin(front, KEY1, &val, &val_size) == NULL;
+    Front_stats stats = cache_front_stats(front);
+    cache_destroy_front(front);
+    if (!is_refreshed || stats.stale_total != 3) {
+        std::cout << "The front handed out a value the cache had let go of. Stale: " << stats.stale_total << ".\n";
+        return -1;
+    }
+
+    //Keys used once don't push out one that keeps being hit, and compressed values are held decompressed
+    front = cache_create_front(cache1, NULL, 1);
+    cache_set_compression(cache1, 64);
+    char* zeros = new char[512]();
+    cache_set(cache1, "hot", zeros, 512);
+    cache_set(cache1, "cold1", SMALLVAL, SMALLVAL_SIZE);
+    cache_set(cache1, "cold2", SMALLVAL, SMALLVAL_SIZE);
+    for (int i = 0; i < 4; i++) {
+        cache_unpin(cache_front_pin(front, "hot", &val, &val_size));
+    }
+    cache_unpin(cache_front_pin(front, "cold1", &val, &val_size));
+    cache_unpin(cache_front_pin(front, "cold2", &val, &val_size));
+    Front_stats before = cache_front_stats(front);
+    pin = cache_front_pin(front, "hot", &val, &val_size);
+    bool is_hot = cache_front_stats(front).hit_total == before.hit_total + 1 && val_size == 512 && memcmp(val, zeros, 512) == 0;
+    cache_unpin(pin);
+    delete[] zeros;
+    cache_destroy_front(front);
+    if (!is_hot) {
+        std::cout << "Keys used once pushed a hot key out of the front, or a compressed value was held wrongly.\n";
+        return -1;
+    }
+
+    //Readers each with a front of their own only ever see whole values, and see the last one once it's set
+    std::mutex lock;
+    cache_set(cache1, "shared", "v0", 3);
+    std::atomic<bool> is_writing(true);
+    std::atomic<int> error_total(0);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&] {
+            front_type reader_front = cache_create_front(cache1, &lock, 0);
+            val_type reader_val;
+            index_type reader_size;
+            int last_version = 0;
+            bool is_done = false;
+            while (!is_done) {
+                is_done = !is_writing.load();
+                pin_type reader_pin = cache_front_pin(reader_front, "shared", &reader_val, &reader_size);
+                int version = reader_pin == NULL ? -1 : atoi(static_cast<const char*>(reader_val) + 1);
+                if (version < last_version) {
+                    error_total++;
+                }
+                last_version = version;
+                if (reader_pin != NULL) {
+                    cache_unpin(reader_pin);
+                }
+            }
+            if (last_version != 200) {
+                error_total++;
+            }
+            cache_destroy_front(reader_front);
+        });
+    }
+    for (int version = 1; version <= 200; version++) {
+        std::string value = "v" + std::to_string(version);
+        std::lock_guard<std::mutex> guard(lock);
+        cache_set(cache1, "shared", value.c_str(), value.size() + 1);
+    }
+    is_writing = false;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    if (error_total != 0) {
+        std::cout << "Readers through fronts saw an old value after a newer one, or not the last one.\n";
+        return -1;
+    }
+    return 0;
+}
+
+int test_table_stats(cache_type cache1) {
+    for (int i = 0; i < 1000; i++) {
+        std::string key = "key" + std::to_string(i);
+        cache_set(cache1, key.c_str(), SMALLVAL, SMALLVAL_SIZE);
+    }
+    index_type val_size;
+    for (int i = 0; i < 1000; i++) {
+        std::string key = "key" + std::to_string(i);
+        cache_get(cache1, key.c_str(), &val_size);
+        key = "absent" + std::to_string(i);
+        cache_get(cache1, key.c_str(), &val_size);
+    }
+    Table_stats stats = cache_table_stats(cache1);
+    //New keys are misses of the set that adds them
+    if (stats.hit_total != 1000 || stats.miss_total < 2000 || stats.entry_total != 1000 || stats.full_traversal_total != 0) {
+        std::cout << "Lookups of the table were miscounted. Hits: " << stats.hit_total << ", misses: " << stats.miss_total << ".\n";
+        return -1;
+    }
+    double hit_mean = static_cast<double>(stats.hit_probe_total) / stats.hit_total;
+    if (hit_mean > 2 * stats.expected_hit_probes || stats.max_chain == 0 || stats.max_probe < stats.max_chain) {
+        std::cout << "The default hash looks clustered. Mean hit probes: " << hit_mean << ", expected: " << stats.expected_hit_probes << ".\n";
+        return -1;
+    }
+    uint32_t last = (stats.resize_total < RESIZE_HISTORY_TOTAL ? stats.resize_total : static_cast<uint64_t>(RESIZE_HISTORY_TOTAL)) - 1;
+    if (stats.resize_total == 0 || stats.resizes[last].slot_total != stats.slot_total || stats.resizes[last].pre_slot_total >= stats.slot_total) {
+        std::cout << "The table's last resize wasn't recorded.\n";
+        return -1;
+    }
+    for (int i = 0; i < 100; i++) {
+        std::string key = "key" + std::to_string(i);
+        cache_delete(cache1, key.c_str());
+    }
+    stats = cache_table_stats(cache1);
+    if (stats.dead_total != 100 || stats.dead_ratio != 0.1) {
+        std::cout << "Deleted keys weren't counted as graves. Graves: " << stats.dead_total << ".\n";
+        return -1;
+    }
+
+    //Every key hashes the same, so each new one is placed one slot further along the same chain
+    cache_type clustered = create_cache(LARGE_CACHE_SIZE, LRU, bad_hash_func);
+    FILE* dump_file = tmpfile();
+    for (int i = 0; i < 200; i++) {
+        std::string key = "key" + std::to_string(i);
+        cache_set(clustered, key.c_str(), SMALLVAL, SMALLVAL_SIZE);
+    }
+    cache_set_table_dump(clustered, dump_file, 100);
+    for (int i = 0; i < 200; i++) {
+        std::string key = "key" + std::to_string(i);
+        cache_get(clustered, key.c_str(), &val_size);
+    }
+    stats = cache_table_stats(clustered);
+    destroy_cache(clustered);
+    char line[512];
+    int line_total = 0;
+    bool is_flagged = true;
+    rewind(dump_file);
+    while (fgets(line, sizeof(line), dump_file) != NULL) {
+        line_total++;
+        is_flagged = is_flagged && strstr(line, ", clustered") != NULL;
+    }
+    fclose(dump_file);
+    if (stats.max_chain != 200 || line_total != 2 || !is_flagged) {
+        std::cout << "A hash that clusters every key wasn't caught. Longest chain: " << stats.max_chain << ", lines dumped: " << line_total << ".\n";
+        return -1;
+    }
+    return 0;
+}
+
+int main() {
+    int32_t error_pile = 0;
+
+    error_pile += test_create_cache_and_destroy_cache();
+
+    cache_type cache1 = create_cache(CACHE_SIZE, FIFO, NULL);
+    error_pile += test_cache_set_and_get(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(CACHE_SIZE, FIFO, NULL);
+    error_pile += test_cache_delete(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(CACHE_SIZE, FIFO, NULL);
+    error_pile += test_cache_space_used(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(CACHE_SIZE, FIFO, NULL);
+    error_pile += test_hasher(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(CACHE_SIZE, FIFO, NULL);
+    error_pile += test_evictor(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(CACHE_SIZE, LRU, NULL);
+    error_pile += test_evictor(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(CACHE_SIZE, LIFO, NULL);
+    error_pile += test_lifo_evictor(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(CACHE_SIZE, MRU, NULL);
+    error_pile += test_mru_evictor(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(CACHE_SIZE, CLOCK, NULL);
+    error_pile += test_clock_evictor(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(CACHE_SIZE, SLRU, NULL);
+    error_pile += test_slru_evictor(cache1);
+    destroy_cache(cache1);
+
+    const evictor_type tested_policies[] = {FIFO, LIFO, LRU, MRU, CLOCK, SLRU, RR};
+    for (evictor_type policy : tested_policies) {
+        cache1 = create_cache(CACHE_SIZE, policy, NULL);
+        error_pile += test_evictor_consistency(cache1);
+        destroy_cache(cache1);
+    }
+
+    cache1 = create_cache(CACHE_SIZE, FIFO, NULL);
+    error_pile += test_resizing(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(CACHE_SIZE, LRU, NULL);
+    error_pile += test_pin(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(CACHE_SIZE, LRU, NULL);
+    error_pile += test_compression(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(CACHE_SIZE, FIFO, NULL);
+    error_pile += test_disk_tier(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(8 * CACHE_SIZE, FIFO, NULL);
+    error_pile += test_memory_report(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(3 * CACHE_SIZE, LIFO, NULL); //Small enough that the table can't grow without evicting
+    error_pile += test_memory_report(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(CACHE_SIZE, LRU, NULL);
+    error_pile += test_snapshot(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(CACHE_SIZE, LRU, NULL);
+    error_pile += test_mutation_log(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(LARGE_CACHE_SIZE, LRU, NULL);
+    error_pile += test_parallel_restore(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(LARGE_CACHE_SIZE / 16, LRU, &colliding_hash_func);
+    error_pile += test_parallel_rehash(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(LARGE_CACHE_SIZE, LRU, NULL);
+    error_pile += test_bulk_load(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(LARGE_CACHE_SIZE, LRU, NULL);
+    error_pile += test_scan(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(LARGE_CACHE_SIZE, LRU, NULL);
+    error_pile += test_prefix_index(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(CACHE_SIZE, LRU, NULL);
+    error_pile += test_get_or_load(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(CACHE_SIZE, LRU, NULL);
+    error_pile += test_low_watermark(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(LARGE_CACHE_SIZE / 4, LRU, NULL);
+    error_pile += test_maintenance(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(LARGE_CACHE_SIZE, LRU, NULL);
+    error_pile += test_linear_index(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(CACHE_SIZE, LRU, NULL);
+    error_pile += test_trace(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(CACHE_SIZE, LRU, NULL);
+    error_pile += test_mrc(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(CACHE_SIZE, LRU, NULL);
+    error_pile += test_adaptive(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(CACHE_SIZE, LRU, NULL);
+    error_pile += test_partitions(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(CACHE_SIZE, LRU, NULL);
+    error_pile += test_mutation(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(CACHE_SIZE, LRU, NULL);
+    error_pile += test_set_reserve(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(CACHE_SIZE, LRU, NULL);
+    error_pile += test_front(cache1);
+    destroy_cache(cache1);
+
+    cache1 = create_cache(LARGE_CACHE_SIZE, LRU, NULL);
+    error_pile += test_table_stats(cache1);
     destroy_cache(cache1);
 
     // cache1 = create_cache(CACHE_SIZE, FIFO, NULL);
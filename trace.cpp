@@ -0,0 +1,221 @@
+//By Monica Moniot and Alyssa Riceman
+#include <stdio.h>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "trace.h"
+
+constexpr uint32_t DEFAULT_RING_RECORDS = 1<<16;
+constexpr uint64_t TRACE_WRITE_INTERVAL_MS = 10;//the writer empties the ring this often, or sooner once it's half full
+constexpr uint64_t HASH_MULTIPLIER = 11400714819323198485ull;
+constexpr uint16_t MAX_TRACE_KEY_SIZE = -1;
+constexpr uint32_t MAX_TRACE_VALUE_SIZE = -1;
+
+struct Trace {
+	std::mutex lock;//only guards the writer's sleep; the ring itself is lock free
+	std::condition_variable work_ready;
+	std::thread writer;
+	std::string path;
+	int fd;
+	Trace_record* ring;
+	uint64_t ring_mask;//the ring's capacity, a power of 2, minus 1
+	std::atomic<uint64_t> head;//records written into the ring, only ever moved by the caller
+	std::atomic<uint64_t> tail;//records written out of it, only ever moved by the writer
+	std::atomic<uint64_t> bytes_written;
+	std::atomic<bool> is_failed;
+	bool is_stopping;
+	uint64_t record_total;
+	uint64_t dropped_total;
+};
+
+inline uint64_t get_coarse_time_ns() {
+	//the coarse clock only ticks every few milliseconds, but reading it costs a fifth of what the precise one does,
+	//which is most of what tracing an operation costs; records are written in order anyway
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+inline bool write_all(int fd, const byte* data, uint64_t size) {
+	while(size > 0) {
+		ssize_t written = write(fd, data, size);
+		if(written < 0) {
+			if(errno == EINTR) continue;
+			return false;
+		}
+		data += written;
+		size -= written;
+	}
+	return true;
+}
+
+uint64_t get_trace_key_hash(const byte* key, uint64_t key_size) {
+	//a word at a time, like the cache's own hash, but always 64 bits wide so that replay rarely confuses two keys
+	uint64_t hash = key_size*HASH_MULTIPLIER;
+	uint64_t i = 0;
+	for(; i + 8 <= key_size; i += 8) {
+		uint64_t word;
+		memcpy(&word, key + i, 8);
+		hash = (hash^word)*HASH_MULTIPLIER;
+		hash ^= hash>>32;
+	}
+	for(; i < key_size; i += 1) {
+		hash = (hash^key[i])*HASH_MULTIPLIER;
+	}
+	return hash^(hash>>29);
+}
+
+void run_trace_writer(Trace* trace) {
+	std::unique_lock<std::mutex> guard(trace->lock);
+	while(true) {
+		bool is_stopping = trace->is_stopping;
+		guard.unlock();
+		uint64_t head = trace->head.load(std::memory_order_acquire);
+		uint64_t tail = trace->tail.load(std::memory_order_relaxed);
+		//the records between tail and head are at most two runs of the ring, one before it wraps and one after
+		while(tail < head and not trace->is_failed.load(std::memory_order_relaxed)) {
+			uint64_t start = tail&trace->ring_mask;
+			uint64_t run = trace->ring_mask + 1 - start;
+			if(run > head - tail) {
+				run = head - tail;
+			}
+			if(not write_all(trace->fd, reinterpret_cast<const byte*>(&trace->ring[start]), run*sizeof(Trace_record))) {
+				printf("Error in trace: Could not write to %s: %s\n", trace->path.c_str(), strerror(errno));
+				trace->is_failed.store(true, std::memory_order_relaxed);
+				break;
+			}
+			trace->bytes_written.fetch_add(run*sizeof(Trace_record), std::memory_order_relaxed);
+			tail += run;
+		}
+		//once writing has failed the ring is still emptied, so that callers don't fill it and count drops
+		trace->tail.store(head, std::memory_order_release);
+		guard.lock();
+		if(is_stopping) {
+			break;
+		}
+		if(not trace->is_stopping) {
+			trace->work_ready.wait_for(guard, std::chrono::milliseconds(TRACE_WRITE_INTERVAL_MS));
+		}
+	}
+}
+
+
+Trace* open_trace(const char* path, uint32_t ring_records) {
+	int fd = open(path, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0600);
+	if(fd < 0) {
+		printf("Error in trace: Could not open %s: %s\n", path, strerror(errno));
+		return NULL;
+	}
+	Trace_header header;
+	memset(&header, 0, sizeof(Trace_header));
+	memcpy(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+	header.record_size = sizeof(Trace_record);
+	if(not write_all(fd, reinterpret_cast<const byte*>(&header), sizeof(Trace_header))) {
+		printf("Error in trace: Could not write to %s: %s\n", path, strerror(errno));
+		close(fd);
+		return NULL;
+	}
+	if(ring_records == 0) {
+		ring_records = DEFAULT_RING_RECORDS;
+	}
+	uint64_t ring_capacity = 2;
+	while(ring_capacity < ring_records) {
+		ring_capacity *= 2;
+	}
+	Trace* trace = new Trace;
+	trace->path = path;
+	trace->fd = fd;
+	trace->ring = new Trace_record[ring_capacity];
+	trace->ring_mask = ring_capacity - 1;
+	trace->head.store(0, std::memory_order_relaxed);
+	trace->tail.store(0, std::memory_order_relaxed);
+	trace->bytes_written.store(sizeof(Trace_header), std::memory_order_relaxed);
+	trace->is_failed.store(false, std::memory_order_relaxed);
+	trace->is_stopping = false;
+	trace->record_total = 0;
+	trace->dropped_total = 0;
+	trace->writer = std::thread(run_trace_writer, trace);
+	return trace;
+}
+bool close_trace(Trace* trace, Trace_stats* ret_stats) {
+	{
+		std::lock_guard<std::mutex> guard(trace->lock);
+		trace->is_stopping = true;
+	}
+	//the writer empties the ring once more before it stops
+	trace->work_ready.notify_one();
+	trace->writer.join();
+	bool is_ok = not trace->is_failed.load(std::memory_order_relaxed);
+	if(close(trace->fd) != 0 and is_ok) {
+		printf("Error in trace: Could not write to %s: %s\n", trace->path.c_str(), strerror(errno));
+		is_ok = false;
+	}
+	*ret_stats = get_trace_stats(trace);
+	delete[] trace->ring;
+	delete trace;
+	return is_ok;
+}
+
+void trace_op(Trace* trace, uint8_t op, Key_ptr key, Index value_size, bool is_hit) {
+	uint64_t head = trace->head.load(std::memory_order_relaxed);
+	uint64_t backlog = head - trace->tail.load(std::memory_order_acquire);
+	if(backlog > trace->ring_mask) {
+		trace->dropped_total += 1;
+		return;
+	}
+	uint64_t key_size = strlen(key);
+	Trace_record* record = &trace->ring[head&trace->ring_mask];
+	record->time_ns = get_coarse_time_ns();
+	record->key_hash = get_trace_key_hash(reinterpret_cast<const byte*>(key), key_size);
+	record->value_size = value_size < MAX_TRACE_VALUE_SIZE ? value_size : MAX_TRACE_VALUE_SIZE;
+	record->key_size = key_size < MAX_TRACE_KEY_SIZE ? key_size : MAX_TRACE_KEY_SIZE;
+	record->op = op;
+	record->is_hit = is_hit;
+	trace->head.store(head + 1, std::memory_order_release);
+	trace->record_total += 1;
+	if(backlog == (trace->ring_mask + 1)/2) {
+		//the writer is asleep more often than not, so it's only woken once per half ring rather than every record
+		trace->work_ready.notify_one();
+	}
+}
+
+Trace_stats get_trace_stats(const Trace* trace) {
+	Trace_stats stats;
+	stats.record_total = trace->record_total;
+	stats.dropped_total = trace->dropped_total;
+	stats.bytes_written = trace->bytes_written.load(std::memory_order_relaxed);
+	return stats;
+}
+uint64_t get_trace_size(const Trace* trace) {
+	return sizeof(Trace) + sizeof(Trace_record)*(trace->ring_mask + 1);
+}
+
+bool read_trace(const char* path, std::vector<Trace_record>* ret_records) {
+	FILE* file = fopen(path, "rb");
+	if(file == NULL) {
+		printf("Error in trace: Could not open %s: %s\n", path, strerror(errno));
+		return false;
+	}
+	Trace_header header;
+	if(fread(&header, sizeof(Trace_header), 1, file) != 1 or memcmp(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 or header.record_size != sizeof(Trace_record)) {
+		printf("Error in trace: %s is not a trace\n", path);
+		fclose(file);
+		return false;
+	}
+	const size_t CHUNK_RECORDS = 1<<16;
+	size_t read_total;
+	do {
+		size_t old_size = ret_records->size();
+		ret_records->resize(old_size + CHUNK_RECORDS);
+		read_total = fread(&(*ret_records)[old_size], sizeof(Trace_record), CHUNK_RECORDS, file);
+		ret_records->resize(old_size + read_total);
+	} while(read_total == CHUNK_RECORDS);
+	fclose(file);
+	return true;
+}
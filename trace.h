@@ -0,0 +1,44 @@
+//By Monica Moniot and Alyssa Riceman
+#ifndef TRACE_H
+#define TRACE_H
+#include <vector>
+#include "types.h"
+
+//A record of every get, set and delete made on a cache, compact enough to leave on in production, so that
+//trace_replay can play real traffic back against every policy and size
+//Keys aren't kept, only a 64 bit hash and the size of each; values are kept as just their size
+//The caller writes records into a ring buffer and never waits: a writer thread empties the ring to the file every
+//so often, and a record that finds the ring full is dropped and counted
+
+enum {//trace_ops
+	TRACE_GET = 1,//cache_get, cache_get_into, cache_pin, and the lookup of cache_get_or_load
+	TRACE_SET = 2,
+	TRACE_DELETE = 3,
+};
+struct Trace_record {
+	uint64_t time_ns;//CLOCK_MONOTONIC_COARSE, good to a few milliseconds, so the traces of several caches on one machine can be merged
+	uint64_t key_hash;
+	uint32_t value_size;//the value set or found, uncompressed; 0 for a miss or a delete
+	uint16_t key_size;//without the null terminator, up to 65535
+	uint8_t op;
+	uint8_t is_hit;//whether a get found its key
+};
+
+constexpr char TRACE_MAGIC[8] = {'c', 't', 'r', 'a', 'c', 'e', '0', '1'};
+struct Trace_header {
+	char magic[8];
+	uint32_t record_size;
+	uint32_t unused;
+};//followed by records, until the end of the file
+
+Trace* open_trace(const char* path, uint32_t ring_records);
+//writes whatever is left in the ring; returns false if writing failed at any point
+bool close_trace(Trace* trace, Trace_stats* ret_stats);
+void trace_op(Trace* trace, uint8_t op, Key_ptr key, Index value_size, bool is_hit);
+Trace_stats get_trace_stats(const Trace* trace);
+uint64_t get_trace_size(const Trace* trace);
+
+uint64_t get_trace_key_hash(const byte* key, uint64_t key_size);
+//appends every record in the file at path; a record torn off the end is left out
+bool read_trace(const char* path, std::vector<Trace_record>* ret_records);
+#endif
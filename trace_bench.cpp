@@ -0,0 +1,111 @@
+//By Monica Moniot and Alyssa Riceman
+//Measures what tracing costs the caller: the same skewed mix of gets and sets is run against a cache with and
+//without cache_start_trace, and the time per operation of each compared
+//The trace is left at the path given, so it can be played back with trace_replay
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "cache.h"
+
+constexpr int RUN_TOTAL = 3;
+
+struct Options {
+	uint32_t key_total;
+	uint32_t value_size;
+	uint32_t op_total;
+	uint32_t cache_percent;
+	const char* path;
+};
+
+inline uint64_t get_time_ns() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+
+inline void make_key(char* key, uint32_t i) {
+	snprintf(key, 32, "key:%u", i);
+}
+
+void print_usage(const char* name) {
+	printf("Usage: %s [-k keys] [-v value bytes] [-n operations] [-c percent of the keys the cache holds] [-o trace path]\n", name);
+}
+
+double run_mix(const Options* options, bool is_tracing, Trace_stats* ret_stats) {
+	uint64_t max_mem = static_cast<uint64_t>(options->key_total)*options->value_size/100*options->cache_percent;
+	cache_type cache = create_cache(max_mem > UINT32_MAX ? UINT32_MAX : max_mem, LRU, NULL);
+	if(is_tracing and not cache_start_trace(cache, options->path, 0)) {
+		exit(1);
+	}
+	std::vector<char> value(options->value_size, 'v');
+	char key[32];
+	uint32_t seed = 1;
+	uint64_t start_time = get_time_ns();
+	for(uint32_t i = 0; i < options->op_total; i += 1) {
+		//the key is the product of two uniform picks, so small keys are far more popular than large ones
+		seed = seed*1103515245 + 12345;
+		uint64_t a = (seed>>8)%options->key_total;
+		seed = seed*1103515245 + 12345;
+		uint64_t b = (seed>>8)%options->key_total;
+		make_key(key, a*b/options->key_total);
+		index_type val_size;
+		if(cache_get(cache, key, &val_size) == NULL) {
+			cache_set(cache, key, value.data(), options->value_size);
+		}
+	}
+	double ns = static_cast<double>(get_time_ns() - start_time)/options->op_total;
+	if(is_tracing) {
+		cache_stop_trace(cache);
+		*ret_stats = cache_trace_stats(cache);
+	}
+	destroy_cache(cache);
+	return ns;
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	options.key_total = 1000000;
+	options.value_size = 64;
+	options.op_total = 10000000;
+	options.cache_percent = 10;
+	options.path = "trace_bench.trace";
+	int opt;
+	while((opt = getopt(argc, argv, "k:v:n:c:o:h")) != -1) {
+		if(opt == 'k') {
+			options.key_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'v') {
+			options.value_size = strtoul(optarg, NULL, 10);
+		} else if(opt == 'n') {
+			options.op_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'c') {
+			options.cache_percent = strtoul(optarg, NULL, 10);
+		} else if(opt == 'o') {
+			options.path = optarg;
+		} else {
+			print_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if(options.key_total == 0 or options.op_total == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	printf("%u gets of %u keys, setting each miss, in a cache for %u%% of them\n", options.op_total, options.key_total, options.cache_percent);
+	//the two take turns, and each keeps its best run, since the difference is small next to the noise of one run
+	Trace_stats stats;
+	double plain_ns = 0;
+	double traced_ns = 0;
+	for(int run = 0; run < RUN_TOTAL; run += 1) {
+		double ns = run_mix(&options, false, &stats);
+		plain_ns = run == 0 or ns < plain_ns ? ns : plain_ns;
+		ns = run_mix(&options, true, &stats);
+		traced_ns = run == 0 or ns < traced_ns ? ns : traced_ns;
+	}
+	printf("untraced %6.1f ns/op  traced %6.1f ns/op  %+5.1f%%\n", plain_ns, traced_ns, 100*(traced_ns - plain_ns)/plain_ns);
+	printf("%llu records, %llu dropped, %.1f MB written to %s\n", static_cast<unsigned long long>(stats.record_total),
+		static_cast<unsigned long long>(stats.dropped_total), stats.bytes_written/1e6, options.path);
+	return 0;
+}
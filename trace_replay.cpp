@@ -0,0 +1,266 @@
+//By Monica Moniot and Alyssa Riceman
+//Plays traces recorded by cache_start_trace back against every eviction policy at several sizes, to choose a
+//policy and a size from real traffic rather than a synthetic test
+//Every policy and size is a cache of its own, replayed on its own thread; gets that miss don't load anything,
+//since whatever the traced program set after a miss was traced as a set and is replayed too
+//Only the hashes of keys were traced, so each key is replayed as its hash written out in hex, padded to its traced
+//size; a cache counts only values against its capacity unless -f is given, so the key sizes matter only then
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "trace.h"
+#include "cache.h"
+
+struct Options {
+	std::vector<uint64_t> sizes;
+	std::vector<evictor_type> policies;
+	uint32_t thread_total;
+	bool is_counting_footprint;
+};
+struct Replay_op {
+	uint32_t key_i;
+	uint32_t value_size;
+	uint8_t op;
+};
+struct Replay {
+	evictor_type policy;
+	uint64_t size;
+	uint64_t get_total;
+	uint64_t hit_total;
+	uint64_t requested_bytes;
+	uint64_t hit_bytes;
+	double seconds;
+};
+
+const char* POLICY_NAMES[] = {"fifo", "lifo", "lru", "mru", "clock", "slru", "rr"};
+constexpr evictor_type POLICY_TOTAL = 7;
+
+inline uint64_t get_thread_time_ns() {
+	//replays share the cores, so each is timed by the cpu time of its own thread rather than by the clock
+	timespec time;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+	return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+}
+
+inline uint64_t parse_size(const char* str) {
+	char* end;
+	uint64_t size = strtoull(str, &end, 10);
+	if(*end == 'k' or *end == 'K') {
+		size <<= 10;
+	} else if(*end == 'm' or *end == 'M') {
+		size <<= 20;
+	} else if(*end == 'g' or *end == 'G') {
+		size <<= 30;
+	}
+	return size;
+}
+
+void print_usage(const char* name) {
+	printf("Usage: %s [-s sizes, comma separated, with k, m or g] [-p policies, comma separated] [-t threads, 0 for one per core] [-f (count keys and metadata against each size)] trace...\n", name);
+}
+
+void run_replay(Replay* replay, const Options* options, const std::vector<Replay_op>* ops, const std::vector<std::string>* keys, const std::vector<uint32_t>* known_sizes, const char* value) {
+	cache_type cache = create_cache(replay->size, replay->policy, NULL);
+	cache_set_footprint_mode(cache, options->is_counting_footprint);
+	//the size of each key's value as of its last set, so a miss can be counted in bytes; a key not set yet starts
+	//at the last size the traces saw for it
+	std::vector<uint32_t> value_sizes(*known_sizes);
+	uint64_t start_time = get_thread_time_ns();
+	for(const Replay_op& op : *ops) {
+		const char* key = (*keys)[op.key_i].c_str();
+		if(op.op == TRACE_GET) {
+			index_type val_size;
+			replay->get_total += 1;
+			if(cache_get(cache, key, &val_size) != NULL) {
+				replay->hit_total += 1;
+				replay->hit_bytes += val_size;
+				replay->requested_bytes += val_size;
+			} else {
+				replay->requested_bytes += value_sizes[op.key_i];
+			}
+		} else if(op.op == TRACE_SET) {
+			value_sizes[op.key_i] = op.value_size;
+			if(op.value_size <= replay->size) {
+				cache_set(cache, key, value, op.value_size);
+			}
+		} else if(op.op == TRACE_DELETE) {
+			cache_delete(cache, key);
+		}
+	}
+	replay->seconds = (get_thread_time_ns() - start_time)/1e9;
+	destroy_cache(cache);
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	options.thread_total = 0;
+	options.is_counting_footprint = false;
+	int opt;
+	while((opt = getopt(argc, argv, "s:p:t:fh")) != -1) {
+		if(opt == 's') {
+			for(char* str = strtok(optarg, ","); str != NULL; str = strtok(NULL, ",")) {
+				uint64_t size = parse_size(str);
+				options.sizes.push_back(size > static_cast<index_type>(-1) ? static_cast<index_type>(-1) : size);
+			}
+		} else if(opt == 'p') {
+			for(char* str = strtok(optarg, ","); str != NULL; str = strtok(NULL, ",")) {
+				evictor_type policy = 0;
+				while(policy < POLICY_TOTAL and strcasecmp(str, POLICY_NAMES[policy]) != 0) {
+					policy += 1;
+				}
+				if(policy == POLICY_TOTAL) {
+					print_usage(argv[0]);
+					return 1;
+				}
+				options.policies.push_back(policy);
+			}
+		} else if(opt == 't') {
+			options.thread_total = strtoul(optarg, NULL, 10);
+		} else if(opt == 'f') {
+			options.is_counting_footprint = true;
+		} else {
+			print_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if(optind >= argc) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	if(options.policies.empty()) {
+		for(evictor_type policy = 0; policy < POLICY_TOTAL; policy += 1) {
+			options.policies.push_back(policy);
+		}
+	}
+	if(options.thread_total == 0) {
+		options.thread_total = std::thread::hardware_concurrency();
+	}
+	if(options.thread_total == 0) {
+		options.thread_total = 1;
+	}
+
+	std::vector<Trace_record> records;
+	for(int i = optind; i < argc; i += 1) {
+		if(not read_trace(argv[i], &records)) {
+			return 1;
+		}
+	}
+	//the traces of several caches, such as the shards of a server, are merged by time
+	std::stable_sort(records.begin(), records.end(), [](const Trace_record& a, const Trace_record& b) {
+		return a.time_ns < b.time_ns;
+	});
+
+	//keys are written out once up front, so that replays time only the cache
+	std::unordered_map<uint64_t, uint32_t> key_is;
+	std::vector<std::string> keys;
+	std::vector<uint32_t> known_sizes;
+	std::vector<Replay_op> ops(records.size());
+	uint64_t traced_get_total = 0;
+	uint64_t traced_hit_total = 0;
+	uint32_t max_value_size = 0;
+	for(size_t i = 0; i < records.size(); i += 1) {
+		const Trace_record* record = &records[i];
+		auto found = key_is.find(record->key_hash);
+		uint32_t key_i;
+		if(found == key_is.end()) {
+			key_i = keys.size();
+			key_is[record->key_hash] = key_i;
+			char hex[17];
+			snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(record->key_hash));
+			std::string key(hex);
+			if(record->key_size > key.size()) {
+				key.resize(record->key_size, '.');
+			}
+			keys.push_back(key);
+			known_sizes.push_back(0);
+		} else {
+			key_i = found->second;
+		}
+		ops[i].key_i = key_i;
+		ops[i].value_size = record->value_size;
+		ops[i].op = record->op;
+		if(record->op == TRACE_GET) {
+			traced_get_total += 1;
+			traced_hit_total += record->is_hit;
+			if(record->is_hit) {
+				known_sizes[key_i] = record->value_size;
+			}
+		} else if(record->op == TRACE_SET) {
+			known_sizes[key_i] = record->value_size;
+		}
+		if(record->op != TRACE_DELETE and record->value_size > max_value_size) {
+			max_value_size = record->value_size;
+		}
+	}
+	if(records.empty()) {
+		printf("The traces are empty\n");
+		return 0;
+	}
+	//what the cache would need to hold every key at once
+	uint64_t unique_bytes = 0;
+	for(uint32_t size : known_sizes) {
+		unique_bytes += size;
+	}
+	if(options.sizes.empty()) {
+		//without sizes given, the cache is tried at fractions of every value the traces saw
+		const uint32_t percents[] = {1, 2, 5, 10, 20, 50};
+		for(uint32_t percent : percents) {
+			uint64_t size = unique_bytes*percent/100;
+			options.sizes.push_back(size > static_cast<index_type>(-1) ? static_cast<index_type>(-1) : size);
+		}
+	}
+	double seconds = (records.back().time_ns - records.front().time_ns)/1e9;
+	printf("%zu operations over %.1f s, %zu keys, %llu bytes of values\n", records.size(), seconds, keys.size(), static_cast<unsigned long long>(unique_bytes));
+	if(traced_get_total > 0) {
+		printf("traced hit ratio %.4f over %llu gets\n", static_cast<double>(traced_hit_total)/traced_get_total, static_cast<unsigned long long>(traced_get_total));
+	}
+
+	std::vector<Replay> replays;
+	for(uint64_t size : options.sizes) {
+		for(evictor_type policy : options.policies) {
+			Replay replay;
+			memset(&replay, 0, sizeof(Replay));
+			replay.policy = policy;
+			replay.size = size;
+			replays.push_back(replay);
+		}
+	}
+	std::vector<char> value(max_value_size + 1, 'v');
+	std::atomic<size_t> next_replay(0);
+	std::vector<std::thread> threads;
+	for(uint32_t t = 0; t < options.thread_total; t += 1) {
+		threads.emplace_back([&]() {
+			for(size_t i = next_replay.fetch_add(1); i < replays.size(); i = next_replay.fetch_add(1)) {
+				run_replay(&replays[i], &options, &ops, &keys, &known_sizes, value.data());
+			}
+		});
+	}
+	for(auto& thread : threads) {
+		thread.join();
+	}
+
+	printf("%12s %6s %10s %10s %12s\n", "size", "policy", "hit ratio", "byte hits", "ops/s");
+	for(size_t i = 0; i < replays.size(); i += 1) {
+		const Replay* replay = &replays[i];
+		//the best hit ratio at each size is starred
+		bool is_best = true;
+		for(const Replay& other : replays) {
+			if(other.size == replay->size and other.hit_total > replay->hit_total) {
+				is_best = false;
+			}
+		}
+		double hit_ratio = replay->get_total == 0 ? 0 : static_cast<double>(replay->hit_total)/replay->get_total;
+		double byte_ratio = replay->requested_bytes == 0 ? 0 : static_cast<double>(replay->hit_bytes)/replay->requested_bytes;
+		printf("%12llu %6s %10.4f %10.4f %12.0f%s\n", static_cast<unsigned long long>(replay->size), POLICY_NAMES[replay->policy],
+			hit_ratio, byte_ratio, ops.size()/replay->seconds, is_best ? " *" : "");
+	}
+	return 0;
+}
@@ -1,6 +1,7 @@
 //By Monica Moniot and Alyssa Riceman
 #ifndef TYPES_H
 #define TYPES_H
+#include <atomic>
 #include "cache.h"
 
 using byte = uint8_t;//this must have the size of a unit of memory (a byte)
@@ -11,6 +12,9 @@ using Key_ptr = key_type;
 using Value_ptr = val_type;
 using Index = index_type;
 using Hash_func = hash_func;
+using Scan_func = scan_func;
+using Load_func = load_func;
+using Free_func = free_func;
 
 //different evictors want to use memory differently
 //we define these different types of memory here and combine them all in a union so that each policy has access to its data
@@ -50,11 +54,45 @@ struct Evictor {
 
 
 
+//values are reference counted so that a pinned value outlives being overwritten, evicted or deleted
+//the bytes of the value are allocated right behind this header
+struct cache_value {//Definition of Value
+	std::atomic<Index> refs;//the cache holds one reference and every pin holds another
+	Index capacity;//bytes allocated for data, which only a value mutated in place may have more of than it's using
+	Index raw_size;//if the data is compressed, its size once decompressed; otherwise 0
+	std::atomic<bool> is_retired;//set once the cache lets go of it, so that front caches holding on to it know it's stale
+	byte* data;
+};
+using Value = cache_value;
+
+//a value reserved by cache_set_reserve, and the key it'll be set under
+struct cache_reservation {//Definition of Reservation
+	Value* value;
+	byte* key;//a copy, since the caller's key needn't outlive the call
+};
+using Reservation = cache_reservation;
+
+struct Disk_tier;//defined in disk_tier.cpp
+struct Snapshot;//defined in cache.cpp
+struct Mutation_log;//defined in mutation_log.cpp
+struct Prefix_index;//defined in prefix_index.cpp
+struct Load_table;//defined in cache.cpp
+struct Maintenance;//defined in cache.cpp
+struct Linear_index;//defined in linear_index.cpp
+struct Trace;//defined in trace.cpp
+struct Mrc;//defined in mrc.cpp
+struct Adaptive;//defined in adaptive.cpp
+struct Partitions;//defined in cache.cpp
+struct cache_front;//defined in cache.cpp
+struct Table_dump;//defined in cache.cpp
+using Front = cache_front;
+
 struct Entry {
 	Index cur_i;//index to the entry's position in the hash table
 	Key_ptr key;
 	Index key_size;
-	byte* value;
+	uint16_t partition;//0 unless its key belongs to a partition added by cache_add_partition
+	Value* value;
 	Index value_size;
 	Evict_item evict_item;
 };
@@ -82,5 +120,38 @@ struct cache_obj {//Definition of Cache
 	Book entry_book;
 	Hash_func hash;
 	Evictor evictor;
+	Index compress_threshold;//values at least this large get compressed, 0 turns compression off
+	uint64_t raw_total;//what mem_total would be without compression
+	byte* compress_buffer;//scratch space for compressing a value before we know its size
+	Index compress_buffer_size;
+	byte* read_buffer;//cache_get decompresses into here
+	Index read_buffer_size;
+	Compression_stats compression_stats;
+	Mutation_stats mutation_stats;
+	Disk_tier* disk_tier;//where evicted entries go, NULL if they're just deleted
+	bool is_counting_footprint;//whether mem_capacity bounds everything we allocate or just the values
+	uint64_t key_total;
+	uint64_t key_footprint;//what the keys cost including allocator overhead
+	uint64_t value_footprint;//what the values cost including their headers and allocator overhead
+	Snapshot* snapshot;//the snapshot being written in the background, if any
+	bool is_snapshot_ok;//whether the last snapshot to finish was written successfully
+	Mutation_log* log;//where sets and deletes are logged, NULL if they aren't
+	uint64_t log_sequence;//the sequence of the last mutation logged, which a snapshot takes with it
+	uint32_t rehash_thread_total;//how many threads grow_cache_size may split a big table between
+	Prefix_index* prefix_index;//the keys in order, NULL unless it's been turned on
+	Load_table* loads;//what cache_get_or_load keeps track of, NULL until it's first called
+	uint32_t low_water_percent;//of mem_capacity, what eviction brings the cache down to once it's over
+	Maintenance* maintenance;//the thread doing housekeeping in the background, NULL if callers do it all
+	Maintenance_stats maintenance_stats;
+	Index linear_threshold;//caches of no more than this many entries find keys by scanning rather than hashing
+	Linear_index* linear;//NULL while the cache is too big for it
+	Trace* trace;//where gets, sets and deletes are traced, NULL if they aren't
+	Trace_stats trace_stats;//of the last trace to be stopped
+	Mrc* mrc;//estimates the hit ratio at other capacities, NULL unless it's been turned on
+	Adaptive* adaptive;//picks which policy evictor should use, NULL unless it's been turned on
+	Partitions* partitions;//the prefixes of keys given budgets and evictors of their own, NULL until one is added
+	uint32_t partition_total;//a snapshot keeps this, so a cache restored from it knows to take back their entries
+	Table_stats table_stats;//only the counts; what describes the table as it is now is filled in when asked for
+	Table_dump* table_dump;//where a line of table_stats is printed every so often, NULL unless it's been turned on
 };
 #endif
@@ -0,0 +1,65 @@
+//By Monica Moniot and Alyssa Riceman
+#ifndef VALUE_H
+#define VALUE_H
+#include <new>
+#include "cache.h"
+#include "types.h"
+
+
+//Values are reference counted blocks of memory holding the bytes of a value behind a small header
+//The cache holds one reference to each of its values; pins, and anything else that must keep a value
+//alive after the cache lets go of it, hold their own
+//Releasing the last reference frees the value, and this may happen on any thread
+//A value may instead hold bytes the caller allocated and handed over, which the caller's deleter frees along with it;
+//its bytes aren't right behind its header, which is how it's told apart
+
+struct Owned_value {
+	Value value;//first, so that a pointer to it is a pointer to the whole
+	Free_func deleter;
+	void* deleter_data;
+};
+
+inline Value* alloc_value(Index size) {
+	//the value's header and bytes are one allocation, so reading a value stays one cache miss
+	byte* mem = new byte[sizeof(Value) + size];
+	Value* value = new(mem) Value;
+	value->refs.store(1, std::memory_order_relaxed);
+	value->capacity = size;
+	value->raw_size = 0;
+	value->is_retired.store(false, std::memory_order_relaxed);
+	value->data = mem + sizeof(Value);
+	return value;
+}
+inline Value* alloc_owned_value(void* val, Index size, Free_func deleter, void* deleter_data) {
+	//allocated as bytes like any other value, so that every value is freed the same way
+	byte* mem = new byte[sizeof(Owned_value)];
+	Owned_value* owned = new(mem) Owned_value;
+	owned->value.refs.store(1, std::memory_order_relaxed);
+	owned->value.capacity = size;
+	owned->value.raw_size = 0;
+	owned->value.is_retired.store(false, std::memory_order_relaxed);
+	owned->value.data = static_cast<byte*>(val);
+	owned->deleter = deleter;
+	owned->deleter_data = deleter_data;
+	return &owned->value;
+}
+inline bool is_owned(const Value* value) {
+	return value->data != reinterpret_cast<const byte*>(value) + sizeof(Value);
+}
+inline void retain_value(Value* value) {
+	value->refs.fetch_add(1, std::memory_order_relaxed);
+}
+inline void release_value(Value* value) {
+	//drops one reference; the last one frees the value
+	if(value->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		if(is_owned(value)) {
+			Owned_value* owned = reinterpret_cast<Owned_value*>(value);
+			owned->deleter(owned->deleter_data, value->data);
+			owned->~Owned_value();
+		} else {
+			value->~Value();
+		}
+		delete[] reinterpret_cast<byte*>(value);
+	}
+}
+#endif